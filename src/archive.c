@@ -36,6 +36,8 @@
 #include "bg.h"
 #include "osk.h"
 #include "archive.h"
+#include "chmcache.h"
+#include "zipread.h"
 #ifdef DMALLOC
 #include "dmalloc.h"
 #endif
@@ -85,13 +87,53 @@ static void extract_zip_file_into_buffer_with_password(buffer * buf, const char
 	unzClose(unzf);
 }
 
+/**
+ * minizip, ֱӽѹδܵZIPļ
+ *
+ * @return ɹ0, Ҳļ-1, 轻minizip-2
+ */
+static int extract_zip_file_direct(buffer * buf, const char *archname, const char *archpath)
+{
+	t_zip_entry entry;
+	int ret;
+
+	ret = zipread_locate(archname, archpath, &entry);
+
+	if (ret < 0)
+		return ret;
+
+	buffer_prepare_copy(buf, entry.usize + 1);
+
+	if (buf->ptr == NULL)
+		return -1;
+
+	if (zipread_extract(archname, &entry, buf->ptr) < 0) {
+		free(buf->ptr);
+		buf->ptr = NULL;
+		buf->size = buf->used = 0;
+		return -2;
+	}
+
+	buf->ptr[entry.usize] = '\0';
+	buf->used = entry.usize;
+
+	return 0;
+}
+
 static void extract_zip_file_into_buffer(buffer * buf, const char *archname, const char *archpath)
 {
-	unzFile unzf = unzOpen(archname);
+	unzFile unzf;
 	unz_file_info info;
 	char pass[128];
 	int ret;
 
+	ret = extract_zip_file_direct(buf, archname, archpath);
+
+	if (ret == 0)
+		return;
+
+	unzf = unzOpen(archname);
+
 	if (unzf == NULL)
 		return;
 	if (unzLocateFile(unzf, archpath, 0) != UNZ_OK || unzOpenCurrentFile(unzf) != UNZ_OK) {
@@ -320,29 +362,29 @@ static void extract_rar_file_into_buffer(buffer * buf, const char *archname, con
 
 static void extract_chm_file_into_buffer(buffer * buf, const char *archname, const char *archpath)
 {
-	struct chmFile *chm = chm_open(archname);
+	struct chmFile *chm = chmcache_open(archname);
 	struct chmUnitInfo ui;
 
 	if (chm == NULL) {
 		return;
 	}
 
-	if (chm_resolve_object(chm, archpath, &ui) != CHM_RESOLVE_SUCCESS) {
-		chm_close(chm);
+	if (chmcache_resolve(chm, archpath, &ui) != CHM_RESOLVE_SUCCESS) {
+		chmcache_close(chm);
 		return;
 	}
 
 	buffer_prepare_copy(buf, ui.length + 1);
 
 	if (buf->ptr == NULL) {
-		chm_close(chm);
+		chmcache_close(chm);
 		return;
 	}
 
 	buf->ptr[ui.length] = '\0';
 
 	buf->used = chm_retrieve_object(chm, &ui, (u8 *) buf->ptr, 0, ui.length);
-	chm_close(chm);
+	chmcache_close(chm);
 }
 
 /**
@@ -560,6 +602,35 @@ extern void extract_rar_file_into_image(t_image_rar * image, const char *archnam
 	}
 }
 
+extern int extract_zip_file_into_image(t_image_rar * image, const char *archname, const char *archpath)
+{
+	t_zip_entry entry;
+	int ret;
+
+	image->buf = NULL;
+	image->size = image->idx = 0;
+
+	ret = zipread_locate(archname, archpath, &entry);
+
+	if (ret < 0)
+		return ret;
+
+	image->buf = malloc(entry.usize);
+
+	if (image->buf == NULL)
+		return -2;
+
+	if (zipread_extract(archname, &entry, image->buf) < 0) {
+		free(image->buf);
+		image->buf = NULL;
+		return -2;
+	}
+
+	image->size = entry.usize;
+
+	return 0;
+}
+
 extern HANDLE reopen_rar_with_passwords(struct RAROpenArchiveData *arcdata)
 {
 	struct RARHeaderData header;
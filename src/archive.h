@@ -32,4 +32,11 @@ extern void extract_archive_file_into_buffer(buffer ** buf, const char *archname
 
 extern void extract_rar_file_into_image(t_image_rar * image, const char *archname, const char *archpath);
 
+/**
+ * ZIPеͼֱӽѹڴ
+ *
+ * @return ɹ0, ʧܷظ, ʱӦminizip
+ */
+extern int extract_zip_file_into_image(t_image_rar * image, const char *archname, const char *archpath);
+
 extern HANDLE reopen_rar_with_passwords(struct RAROpenArchiveData *arcdata);
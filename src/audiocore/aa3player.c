@@ -37,6 +37,7 @@
 #include "strsafe.h"
 #include "musicdrv.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "dbg.h"
 #include "scene.h"
 #include "apetaglib/APETag.h"
@@ -170,34 +171,6 @@ static int aa3_seek_seconds(double seconds)
 	return -1;
 }
 
-/**
- * ݵ
- *
- * @note ĸʽΪ˫16λ
- *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param frames ֡
- * @param channels 
- */
-static void send_to_sndbuf(void *buf, uint16_t * srcbuf, int frames, int channels)
-{
-	int n;
-	signed short *p = (signed short *) buf;
-
-	if (frames <= 0)
-		return;
-
-	if (channels == 2) {
-		memcpy(buf, srcbuf, frames * channels * sizeof(*srcbuf));
-	} else {
-		for (n = 0; n < frames * channels; n++) {
-			*p++ = srcbuf[n];
-			*p++ = srcbuf[n];
-		}
-	}
-}
-
 /**
  * AA3ֲŻص
  * 𽫽
@@ -248,7 +221,7 @@ static int aa3_audiocallback(void *buf, unsigned int reqn, void *pdata)
 		avail_frame = g_buff_frame_size - g_buff_frame_start;
 
 		if (avail_frame >= snd_buf_frame_size) {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * 2], snd_buf_frame_size, 2);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * 2], snd_buf_frame_size, 2);
 			g_buff_frame_start += snd_buf_frame_size;
 			audio_buf += snd_buf_frame_size * 2;
 			snd_buf_frame_size = 0;
@@ -258,7 +231,7 @@ static int aa3_audiocallback(void *buf, unsigned int reqn, void *pdata)
 			int res;
 			uint16_t *output;
 
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * 2], avail_frame, 2);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * 2], avail_frame, 2);
 			snd_buf_frame_size -= avail_frame;
 			audio_buf += avail_frame * 2;
 			memset(aa3_mix_buffer, 0, 2048 * 2 * 2);
@@ -634,6 +607,10 @@ static int aa3_get_info(struct music_info *info)
 	return generic_get_info(info);
 }
 
+static const char *aa3_exts[] = {
+	"aa3", "oma", NULL
+};
+
 /**
  * ǷΪAA3ļĿǰֻļ׺
  *
@@ -643,20 +620,7 @@ static int aa3_get_info(struct music_info *info)
  */
 static int aa3_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "aa3") == 0) {
-			return 1;
-		}
-		if (stricmp(p, "oma") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, aa3_exts);
 }
 
 /**
@@ -746,6 +710,7 @@ static struct music_ops aa3_ops = {
 	.resume = aa3_resume,
 	.get_info = aa3_get_info,
 	.probe = aa3_probe,
+	.exts = aa3_exts,
 	.next = NULL,
 };
 
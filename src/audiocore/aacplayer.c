@@ -37,6 +37,7 @@
 #include "strsafe.h"
 #include "musicdrv.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "dbg.h"
 #include "scene.h"
 #include "genericplayer.h"
@@ -128,34 +129,6 @@ static int __end(void)
 	return 0;
 }
 
-/**
- * ݵ
- *
- * @note ĸʽΪ˫16λ
- *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param frames ֡
- * @param channels 
- */
-static void send_to_sndbuf(void *buf, uint16_t * srcbuf, int frames, int channels)
-{
-	int n;
-	signed short *p = (signed short *) buf;
-
-	if (frames <= 0)
-		return;
-
-	if (channels == 2) {
-		memcpy(buf, srcbuf, frames * channels * sizeof(*srcbuf));
-	} else {
-		for (n = 0; n < frames * channels; n++) {
-			*p++ = srcbuf[n];
-			*p++ = srcbuf[n];
-		}
-	}
-}
-
 /**
  * AACֲŻص
  * 𽫽
@@ -191,7 +164,7 @@ static int aac_audiocallback(void *buf, unsigned int reqn, void *pdata)
 		avail_frame = g_buff_frame_size - g_buff_frame_start;
 
 		if (avail_frame >= snd_buf_frame_size) {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * 2], snd_buf_frame_size, 2);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * 2], snd_buf_frame_size, 2);
 			g_buff_frame_start += snd_buf_frame_size;
 			audio_buf += snd_buf_frame_size * 2;
 			snd_buf_frame_size = 0;
@@ -204,7 +177,7 @@ static int aac_audiocallback(void *buf, unsigned int reqn, void *pdata)
 			int res;
 			uint16_t *output;
 
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * 2], avail_frame, 2);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * 2], avail_frame, 2);
 			snd_buf_frame_size -= avail_frame;
 			audio_buf += avail_frame * 2;
 
@@ -510,6 +483,10 @@ static int aac_get_info(struct music_info *info)
 	return generic_get_info(info);
 }
 
+static const char *aac_exts[] = {
+	"aac", NULL
+};
+
 /**
  * ǷΪAT3ļĿǰֻļ׺
  *
@@ -519,17 +496,7 @@ static int aac_get_info(struct music_info *info)
  */
 static int aac_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "aac") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, aac_exts);
 }
 
 /**
@@ -615,6 +582,7 @@ static struct music_ops aac_ops = {
 	.resume = aac_resume,
 	.get_info = aac_get_info,
 	.probe = aac_probe,
+	.exts = aac_exts,
 	.next = NULL,
 };
 
@@ -25,6 +25,7 @@
 #include <assert.h>
 #include "scene.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "musicmgr.h"
 #include "musicdrv.h"
 #include "All.h"
@@ -78,34 +79,6 @@ static char g_encode_name[80];
  */
 static CAPEDecompress *g_decoder = NULL;
 
-/**
- * ݵ
- *
- * @note ĸʽΪ˫16λ
- *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param frames ֡
- * @param channels 
- */
-static void send_to_sndbuf(void *buf, short *srcbuf, int frames, int channels)
-{
-	int n;
-	signed short *p = (signed short *) buf;
-
-	if (frames <= 0)
-		return;
-
-	for (n = 0; n < frames * channels; n++) {
-		if (channels == 2)
-			*p++ = srcbuf[n];
-		else if (channels == 1) {
-			*p++ = srcbuf[n];
-			*p++ = srcbuf[n];
-		}
-	}
-}
-
 static int ape_seek_seconds(double seconds)
 {
 	uint32_t sample;
@@ -137,109 +110,6 @@ static int ape_seek_seconds(double seconds)
 	return -1;
 }
 
-/**
- * 
- *
- * @return
- * - -1 should exit
- * - 0 OK
- */
-static int handle_seek(void)
-{
-	u64 timer_end;
-
-	if (1) {
-
-		if (g_status == ST_FFORWARD) {
-			sceRtcGetCurrentTick(&timer_end);
-
-			generic_lock();
-			if (g_last_seek_is_forward) {
-				generic_unlock();
-
-				if (pspDiffTime(&timer_end, (u64 *) & g_last_seek_tick) <= 1.0) {
-					generic_lock();
-
-					if (g_seek_count > 0) {
-						g_play_time += g_seek_seconds;
-						g_seek_count--;
-					}
-
-					generic_unlock();
-
-					if (g_play_time >= g_info.duration) {
-						return -1;
-					}
-
-					sceKernelDelayThread(100000);
-				} else {
-					generic_lock();
-
-					g_seek_count = 0;
-					generic_set_playback(true);
-
-					if (ape_seek_seconds(g_play_time) < 0) {
-						generic_unlock();
-						return -1;
-					}
-
-					generic_set_status(ST_PLAYING);
-
-					generic_unlock();
-					sceKernelDelayThread(100000);
-				}
-			} else {
-				generic_unlock();
-			}
-		} else if (g_status == ST_FBACKWARD) {
-			sceRtcGetCurrentTick(&timer_end);
-
-			generic_lock();
-			if (!g_last_seek_is_forward) {
-				generic_unlock();
-
-				if (pspDiffTime(&timer_end, (u64 *) & g_last_seek_tick) <= 1.0) {
-					generic_lock();
-
-					if (g_seek_count > 0) {
-						g_play_time -= g_seek_seconds;
-						g_seek_count--;
-					}
-
-					generic_unlock();
-
-					if (g_play_time < 0) {
-						g_play_time = 0;
-					}
-
-					sceKernelDelayThread(100000);
-				} else {
-					generic_lock();
-
-					g_seek_count = 0;
-					generic_set_playback(true);
-
-					if (ape_seek_seconds(g_play_time) < 0) {
-						generic_unlock();
-						return -1;
-					}
-
-					generic_set_status(ST_PLAYING);
-
-					generic_unlock();
-					sceKernelDelayThread(100000);
-				}
-			} else {
-				generic_unlock();
-			}
-		}
-
-		return 0;
-	}
-
-	return 0;
-}
-
 /**
  * APEֲŻص
  * 𽫽
@@ -261,7 +131,7 @@ static int ape_audiocallback(void *buf, unsigned int reqn, void *pdata)
 	UNUSED(pdata);
 
 	if (g_status != ST_PLAYING) {
-		if (handle_seek() == -1) {
+		if (generic_handle_seek(ape_seek_seconds) == -1) {
 			__end();
 			return -1;
 		}
@@ -275,16 +145,12 @@ static int ape_audiocallback(void *buf, unsigned int reqn, void *pdata)
 		avail_frame = g_buff_frame_size - g_buff_frame_start;
 
 		if (avail_frame >= snd_buf_frame_size) {
-			send_to_sndbuf(audio_buf,
-						   &g_buff[g_buff_frame_start * g_info.channels],
-						   snd_buf_frame_size, g_info.channels);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], snd_buf_frame_size, g_info.channels);
 			g_buff_frame_start += snd_buf_frame_size;
 			audio_buf += snd_buf_frame_size * 2;
 			snd_buf_frame_size = 0;
 		} else {
-			send_to_sndbuf(audio_buf,
-						   &g_buff[g_buff_frame_start * g_info.channels],
-						   avail_frame, g_info.channels);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], avail_frame, g_info.channels);
 			snd_buf_frame_size -= avail_frame;
 			audio_buf += avail_frame * 2;
 			int block = -1;
@@ -551,6 +417,10 @@ static int ape_get_info(struct music_info *pinfo)
 	return generic_get_info(pinfo);
 }
 
+static const char *ape_exts[] = {
+	"ape", "mac", NULL
+};
+
 /**
  * ǷΪAPEļĿǰֻļ׺
  *
@@ -560,21 +430,7 @@ static int ape_get_info(struct music_info *pinfo)
  */
 static int ape_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "ape") == 0) {
-			return 1;
-		}
-
-		if (stricmp(p, "mac") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, ape_exts);
 }
 
 static struct music_ops ape_ops = {
@@ -591,6 +447,7 @@ static struct music_ops ape_ops = {
 	ape_resume,
 	ape_end,
 	ape_probe,
+	ape_exts,
 	NULL
 };
 
@@ -37,6 +37,7 @@
 #include "strsafe.h"
 #include "musicdrv.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "dbg.h"
 #include "scene.h"
 #include "apetaglib/APETag.h"
@@ -169,34 +170,6 @@ static int at3_seek_seconds(double seconds)
 	return -1;
 }
 
-/**
- * ݵ
- *
- * @note ĸʽΪ˫16λ
- *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param frames ֡
- * @param channels 
- */
-static void send_to_sndbuf(void *buf, uint16_t * srcbuf, int frames, int channels)
-{
-	int n;
-	signed short *p = (signed short *) buf;
-
-	if (frames <= 0)
-		return;
-
-	if (channels == 2) {
-		memcpy(buf, srcbuf, frames * channels * sizeof(*srcbuf));
-	} else {
-		for (n = 0; n < frames * channels; n++) {
-			*p++ = srcbuf[n];
-			*p++ = srcbuf[n];
-		}
-	}
-}
-
 /**
  * AT3ֲŻص
  * 𽫽
@@ -247,7 +220,7 @@ static int at3_audiocallback(void *buf, unsigned int reqn, void *pdata)
 		avail_frame = g_buff_frame_size - g_buff_frame_start;
 
 		if (avail_frame >= snd_buf_frame_size) {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * 2], snd_buf_frame_size, 2);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * 2], snd_buf_frame_size, 2);
 			g_buff_frame_start += snd_buf_frame_size;
 			audio_buf += snd_buf_frame_size * 2;
 			snd_buf_frame_size = 0;
@@ -257,7 +230,7 @@ static int at3_audiocallback(void *buf, unsigned int reqn, void *pdata)
 			int res;
 			uint16_t *output;
 
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * 2], avail_frame, 2);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * 2], avail_frame, 2);
 			snd_buf_frame_size -= avail_frame;
 			audio_buf += avail_frame * 2;
 			memset(at3_mix_buffer, 0, 2048 * 2 * 2);
@@ -599,6 +572,10 @@ static int at3_get_info(struct music_info *info)
 	return generic_get_info(info);
 }
 
+static const char *at3_exts[] = {
+	"at3", NULL
+};
+
 /**
  * ǷΪAT3ļĿǰֻļ׺
  *
@@ -608,17 +585,7 @@ static int at3_get_info(struct music_info *info)
  */
 static int at3_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "at3") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, at3_exts);
 }
 
 /**
@@ -708,6 +675,7 @@ static struct music_ops at3_ops = {
 	.resume = at3_resume,
 	.get_info = at3_get_info,
 	.probe = at3_probe,
+	.exts = at3_exts,
 	.next = NULL,
 };
 
@@ -20,34 +20,74 @@
  */
 
 #include <pspiofilemgr.h>
+#include <pspthreadman.h>
 #include <stdlib.h>
 #include <string.h>
 #include <malloc.h>
 #include <stdint.h>
 #include "config.h"
+#define BUFFERED_READER_INTERNAL
+#include "buffered_reader.h"
+#include "dbg.h"
 #ifdef DMALLOC
 #include "dmalloc.h"
 #endif
 
+/* smallest read issued, as a fraction of the configured block size */
+#define BUFFERED_READER_MIN_BLOCK_DIV 4
+
+/* the first read after a seek covers this many times the storage latency */
+#define BUFFERED_READER_LATENCY_FACTOR 4
+
+/* seek mode 1 starts a missed block this fraction of a block early */
+#define BUFFERED_READER_BACKTRACK_DIV 8
+
+/* with a read in flight, poll again after consuming this fraction of the smallest read */
+#define BUFFERED_READER_POLL_DIV 4
+
+enum
+{
+	BLOCK_EMPTY = 0,
+	BLOCK_PENDING,
+	BLOCK_READY
+};
+
 typedef struct
+{
+	uint8_t *data;
+	/* file offset of data[0] */
+	int32_t pos;
+	/* bytes requested while pending, bytes read once ready */
+	int32_t len;
+	int32_t state;
+} reader_block_t;
+
+struct buffered_reader_s
 {
 	SceUID handle;
 	int32_t cache_enabled;
 	int32_t length;
-	int32_t buffer_size;
 	int32_t seek_mode;
-	uint8_t *buffer_0;			//[BUFFERED_READER_BUFFER_SIZE];
-	uint8_t *buffer_1;			//[BUFFERED_READER_BUFFER_SIZE];
-	uint8_t *buffer_2;			//[BUFFERED_READER_BUFFER_SIZE];
-	uint8_t *first_buffer;
-	uint8_t *second_buffer;
-	uint8_t *third_buffer;
-	int32_t position_0;
-	int32_t position_1;
-	int32_t position_2;
-	int32_t position_3;
+	/* block size given at open, the largest read issued */
+	int32_t max_block_size;
+	int32_t min_block_size;
+	/* size of the next read-ahead, grows after a seek */
+	int32_t block_size;
+	int32_t nblocks;
+	reader_block_t blocks[BUFFERED_READER_MAX_BLOCKS];
+	/* block with the one async read in flight, -1 if none */
+	int32_t pending;
+	SceInt64 pending_start;
+	/* position at the last poll of the pending read */
+	int32_t poll_position;
 	int32_t current_position;
-} buffered_reader_t;
+	/* consumption since rate_start, for the bitrate estimate */
+	SceInt64 rate_start;
+	int32_t rate_bytes;
+	/* rate_bytes at which the clock is looked at next */
+	int32_t rate_check;
+	buffered_reader_stats_t stats;
+};
 
 static void *malloc_64(int size)
 {
@@ -64,51 +104,289 @@ static void free_64(void *p)
 	free(p);
 }
 
+static inline int32_t align_64(int32_t v)
+{
+	return (v + 63) & ~63;
+}
+
+/**
+ * Collect the async read in flight
+ *
+ * @param wait block until it finishes, otherwise only poll
+ *
+ * @return 0 when nothing is in flight any more, 1 if still busy
+ */
+static int finish_pending(buffered_reader_t * reader, int wait)
+{
+	reader_block_t *b;
+	SceInt64 result = 0, now;
+
+	if (reader->pending < 0)
+		return 0;
+
+	if (wait) {
+		SceInt64 start = sceKernelGetSystemTimeWide();
+
+		sceIoWaitAsync(reader->handle, &result);
+		now = sceKernelGetSystemTimeWide();
+		reader->stats.wait_us += now - start;
+	} else {
+		if (sceIoPollAsync(reader->handle, &result) == 1)
+			return 1;
+
+		now = sceKernelGetSystemTimeWide();
+	}
+
+	b = &reader->blocks[reader->pending];
+	b->len = result > 0 ? result : 0;
+	b->state = b->len > 0 ? BLOCK_READY : BLOCK_EMPTY;
+	reader->pending = -1;
+
+	// a polled read finished some time before now, so this is an upper bound
+	if (reader->stats.latency_us == 0)
+		reader->stats.latency_us = now - reader->pending_start;
+	else
+		reader->stats.latency_us = (reader->stats.latency_us * 3 + (now - reader->pending_start)) / 4;
+
+	return 0;
+}
+
+static void start_read(buffered_reader_t * reader, int32_t idx, int32_t pos)
+{
+	reader_block_t *b = &reader->blocks[idx];
+	int32_t len = reader->length - pos;
+
+	if (len > reader->block_size)
+		len = reader->block_size;
+
+	if (len <= 0) {
+		b->state = BLOCK_EMPTY;
+		return;
+	}
+
+	b->pos = pos;
+	b->len = len;
+	b->state = BLOCK_PENDING;
+
+	sceIoLseek32(reader->handle, pos, PSP_SEEK_SET);
+
+	if (sceIoReadAsync(reader->handle, b->data, len) < 0) {
+		b->state = BLOCK_EMPTY;
+		return;
+	}
+
+	reader->pending = idx;
+	reader->pending_start = sceKernelGetSystemTimeWide();
+	reader->poll_position = reader->current_position;
+	reader->stats.reads++;
+	reader->stats.bytes += len;
+}
+
+static int32_t find_block(buffered_reader_t * reader, int32_t pos)
+{
+	int32_t i;
+
+	for (i = 0; i < reader->nblocks; ++i) {
+		reader_block_t *b = &reader->blocks[i];
+
+		if (b->state != BLOCK_EMPTY && pos >= b->pos && pos < b->pos + b->len)
+			return i;
+	}
+
+	return -1;
+}
+
+/**
+ * End of the data buffered or requested contiguously from the current position
+ */
+static int32_t ahead_end(buffered_reader_t * reader)
+{
+	int32_t end = reader->current_position;
+	int32_t i;
+
+	while ((i = find_block(reader, end)) >= 0) {
+		end = reader->blocks[i].pos + reader->blocks[i].len;
+	}
+
+	return end;
+}
+
+/**
+ * Choose a block to reuse: an empty one, one out of the read-ahead chain,
+ * or the oldest one behind the current position
+ *
+ * @note seek mode 1 keeps the block just behind the current position
+ */
+static int32_t pick_victim(buffered_reader_t * reader, int32_t end)
+{
+	int32_t keep = reader->seek_mode == 1 ? reader->current_position - reader->max_block_size : reader->current_position;
+	int32_t i, victim = -1;
+
+	for (i = 0; i < reader->nblocks; ++i) {
+		reader_block_t *b = &reader->blocks[i];
+
+		if (i == reader->pending)
+			continue;
+
+		if (b->state == BLOCK_EMPTY || b->pos >= end)
+			return i;
+
+		if (b->pos + b->len <= keep && (victim < 0 || b->pos < reader->blocks[victim].pos))
+			victim = i;
+	}
+
+	return victim;
+}
+
+/**
+ * Keep one async read in flight while there is room ahead
+ */
+static void prefetch(buffered_reader_t * reader)
+{
+	int32_t end, victim;
+
+	// polling is a syscall, the read-ahead covers the consumption between polls
+	if (reader->pending >= 0) {
+		if (abs(reader->current_position - reader->poll_position) < reader->min_block_size / BUFFERED_READER_POLL_DIV)
+			return;
+
+		reader->poll_position = reader->current_position;
+
+		if (finish_pending(reader, 0) != 0)
+			return;
+	}
+
+	end = ahead_end(reader);
+
+	if (end >= reader->length)
+		return;
+
+	victim = pick_victim(reader, end);
+
+	if (victim < 0)
+		return;
+
+	start_read(reader, victim, end);
+
+	// sequential reading: double the read size up to the configured block size
+	if (reader->block_size < reader->max_block_size) {
+		reader->block_size *= 2;
+
+		if (reader->block_size > reader->max_block_size)
+			reader->block_size = reader->max_block_size;
+	}
+}
+
+/**
+ * Size of the first read after a seek, enough to cover the storage latency
+ * at the measured bitrate
+ */
+static void adapt_block_size(buffered_reader_t * reader)
+{
+	int64_t size = (int64_t) reader->stats.rate * reader->stats.latency_us / 1000000 * BUFFERED_READER_LATENCY_FACTOR;
+
+	if (size < reader->min_block_size)
+		size = reader->min_block_size;
+	else if (size > reader->max_block_size)
+		size = reader->max_block_size;
+
+	reader->block_size = align_64(size);
+}
+
+/**
+ * Request the block containing the current position
+ *
+ * @note only issues an async read, the data is waited for when read
+ */
+static void request_block(buffered_reader_t * reader)
+{
+	int32_t pos = reader->current_position, victim;
+
+	reader->stats.misses++;
+	finish_pending(reader, 1);
+
+	if (find_block(reader, pos) >= 0)
+		return;
+
+	adapt_block_size(reader);
+
+	if (reader->seek_mode == 1)
+		pos -= reader->block_size / BUFFERED_READER_BACKTRACK_DIV;
+
+	if (pos < 0)
+		pos = 0;
+
+	pos &= ~63;
+	victim = pick_victim(reader, reader->current_position);
+
+	if (victim < 0)
+		victim = 0;
+
+	start_read(reader, victim, pos);
+}
+
+static void reset_blocks(buffered_reader_t * reader)
+{
+	int32_t i;
+
+	finish_pending(reader, 1);
+
+	for (i = 0; i < reader->nblocks; ++i) {
+		reader->blocks[i].state = BLOCK_EMPTY;
+	}
+}
+
 void buffered_reader_close(buffered_reader_t * reader)
 {
+	int32_t i;
+
 	if (reader) {
-		if (!(reader->handle < 0))
+		if (!(reader->handle < 0)) {
+			finish_pending(reader, 1);
 			sceIoClose(reader->handle);
-		if (reader->buffer_0 != 0)
-			free_64(reader->buffer_0);
-		if (reader->buffer_1 != 0)
-			free_64(reader->buffer_1);
-		if (reader->buffer_2 != 0)
-			free_64(reader->buffer_2);
+			dbg_printf(d, "%s: %u hits, %u misses, %u reads, %u ms waited", __func__,
+					   (unsigned) reader->stats.hits, (unsigned) reader->stats.misses, (unsigned) reader->stats.reads, (unsigned) (reader->stats.wait_us / 1000));
+		}
+
+		for (i = 0; i < reader->nblocks; ++i) {
+			if (reader->blocks[i].data != 0)
+				free_64(reader->blocks[i].data);
+		}
+
 		free(reader);
 	}
 }
 
-buffered_reader_t *buffered_reader_open(const char *path, int32_t buffer_size, int32_t seek_mode)
+buffered_reader_t *buffered_reader_open_ex(const char *path, int32_t buffer_size, int32_t seek_mode, int32_t nblocks)
 {
 	buffered_reader_t *reader = malloc(sizeof(buffered_reader_t));
-	long long result;
+	int32_t i;
 
 	if (reader == 0)
 		return 0;
 
+	if (nblocks < 2)
+		nblocks = 2;
+	else if (nblocks > BUFFERED_READER_MAX_BLOCKS)
+		nblocks = BUFFERED_READER_MAX_BLOCKS;
+
 	memset(reader, 0, sizeof(buffered_reader_t));
 	reader->cache_enabled = 1;
 	reader->handle = -1;
-	reader->buffer_size = buffer_size;
+	reader->pending = -1;
+	reader->max_block_size = align_64(buffer_size);
+	reader->min_block_size = align_64(buffer_size / BUFFERED_READER_MIN_BLOCK_DIV);
+	reader->block_size = reader->max_block_size;
 	reader->seek_mode = seek_mode;
+	reader->nblocks = nblocks;
 
-	reader->buffer_0 = malloc_64(reader->buffer_size);
-	if (reader->buffer_0 == 0) {
-		buffered_reader_close(reader);
-		return 0;
-	}
+	for (i = 0; i < nblocks; ++i) {
+		reader->blocks[i].data = malloc_64(reader->max_block_size);
 
-	reader->buffer_1 = malloc_64(reader->buffer_size);
-	if (reader->buffer_1 == 0) {
-		buffered_reader_close(reader);
-		return 0;
-	}
-
-	reader->buffer_2 = malloc_64(reader->buffer_size);
-	if (reader->buffer_2 == 0) {
-		buffered_reader_close(reader);
-		return 0;
+		if (reader->blocks[i].data == 0) {
+			buffered_reader_close(reader);
+			return 0;
+		}
 	}
 
 	reader->handle = sceIoOpen(path, PSP_O_RDONLY, 0777);
@@ -123,22 +401,20 @@ buffered_reader_t *buffered_reader_open(const char *path, int32_t buffer_size, i
 	}
 
 	reader->length = sceIoLseek32(reader->handle, 0, PSP_SEEK_END);
+	reader->rate_start = sceKernelGetSystemTimeWide();
+	reader->rate_check = reader->min_block_size;
+
+	// the head of the file is read while the caller sets up
+	start_read(reader, 0, 0);
 
-	reader->first_buffer = reader->buffer_0;
-	reader->second_buffer = reader->buffer_1;
-	reader->third_buffer = reader->buffer_2;
-
-	sceIoLseek32(reader->handle, reader->position_0, PSP_SEEK_SET);
-	sceIoReadAsync(reader->handle, reader->first_buffer, reader->position_1 - reader->position_0);
-	sceIoWaitAsync(reader->handle, &result);
-	sceIoLseek32(reader->handle, reader->position_1, PSP_SEEK_SET);
-	sceIoReadAsync(reader->handle, reader->second_buffer, reader->position_2 - reader->position_1);
-	sceIoWaitAsync(reader->handle, &result);
-	sceIoLseek32(reader->handle, reader->position_2, PSP_SEEK_SET);
-	sceIoReadAsync(reader->handle, reader->third_buffer, reader->position_3 - reader->position_2);
 	return reader;
 }
 
+buffered_reader_t *buffered_reader_open(const char *path, int32_t buffer_size, int32_t seek_mode)
+{
+	return buffered_reader_open_ex(path, buffer_size, seek_mode, BUFFERED_READER_BLOCKS);
+}
+
 int32_t buffered_reader_length(buffered_reader_t * reader)
 {
 	if (!reader->cache_enabled) {
@@ -154,206 +430,27 @@ int32_t buffered_reader_length(buffered_reader_t * reader)
 	return reader->length;
 }
 
-static int32_t buffered_reader_reset_buffer(buffered_reader_t * reader, const int32_t position)
-{
-	long long result;
-
-	sceIoWaitAsync(reader->handle, &result);
-	if (position >= reader->position_2 && position < reader->position_3) {
-		uint8_t *temp = reader->first_buffer;
-
-		reader->first_buffer = reader->second_buffer;
-		reader->second_buffer = reader->third_buffer;
-		reader->third_buffer = temp;
-		reader->position_0 = reader->position_1;
-		reader->position_1 = reader->position_2;
-		reader->position_2 = reader->position_3;
-		reader->current_position = position;
-		reader->position_3 = reader->position_2 + reader->buffer_size;
-		if (reader->position_3 >= reader->length)
-			reader->position_3 = reader->length;
-		sceIoLseek32(reader->handle, reader->position_2, PSP_SEEK_SET);
-		sceIoReadAsync(reader->handle, reader->third_buffer, reader->position_3 - reader->position_2);
-		return position;
-	} else {
-		if (reader->seek_mode == 0) {
-			reader->position_0 = position;
-			reader->position_1 = reader->position_0 + reader->buffer_size;
-			if (reader->position_1 >= reader->length)
-				reader->position_1 = reader->length;
-			reader->position_2 = reader->position_1 + reader->buffer_size;
-			if (reader->position_2 >= reader->length)
-				reader->position_2 = reader->length;
-			reader->position_3 = reader->position_2 + reader->buffer_size;
-			if (reader->position_3 >= reader->length)
-				reader->position_3 = reader->length;
-
-			reader->current_position = reader->position_0;
-		} else if (reader->seek_mode == 1) {
-			reader->position_1 = position;
-			reader->position_0 = reader->position_1 - reader->buffer_size;
-			if (reader->position_0 < 0)
-				reader->position_0 = 0;
-			reader->position_2 = reader->position_1 + reader->buffer_size;
-			if (reader->position_2 >= reader->length)
-				reader->position_2 = reader->length;
-			reader->position_3 = reader->position_2 + reader->buffer_size;
-			if (reader->position_3 >= reader->length)
-				reader->position_3 = reader->length;
-
-			reader->current_position = reader->position_1;
-		}
-
-		sceIoLseek32(reader->handle, reader->position_0, PSP_SEEK_SET);
-		sceIoRead(reader->handle, reader->first_buffer, reader->position_1 - reader->position_0);
-		sceIoLseek32(reader->handle, reader->position_1, PSP_SEEK_SET);
-		sceIoRead(reader->handle, reader->second_buffer, reader->position_2 - reader->position_1);
-		sceIoLseek32(reader->handle, reader->position_2, PSP_SEEK_SET);
-		sceIoReadAsync(reader->handle, reader->third_buffer, reader->position_3 - reader->position_2);
-		return position;
-	}
-
-	return 0;
-}
-
 int32_t buffered_reader_seek(buffered_reader_t * reader, const int32_t position)
 {
-	int32_t seek = 0;
-
 	if (!reader->cache_enabled) {
 		return sceIoLseek32(reader->handle, position, PSP_SEEK_SET);
 	}
 
-	if (position >= reader->position_0 && position < reader->position_2) {
-		reader->current_position = position;
-		return position;
-	} else {
-		long long result;
-		sceIoWaitAsync(reader->handle, &result);
-		if (position >= reader->position_2 && position < reader->position_3) {
-			uint8_t *temp = reader->first_buffer;
-			reader->first_buffer = reader->second_buffer;
-			reader->second_buffer = reader->third_buffer;
-			reader->third_buffer = temp;
-			reader->position_0 = reader->position_1;
-			reader->position_1 = reader->position_2;
-			reader->position_2 = reader->position_3;
-			reader->current_position = position;
-			reader->position_3 = reader->position_2 + reader->buffer_size;
-			if (reader->position_3 >= reader->length)
-				reader->position_3 = reader->length;
-			sceIoLseek32(reader->handle, reader->position_2, PSP_SEEK_SET);
-			sceIoReadAsync(reader->handle, reader->third_buffer, reader->position_3 - reader->position_2);
-			return position;
-		} else {
-			if (position < reader->position_0)
-				seek = -1;
-			else
-				seek = 1;
-
-			{
-				int32_t old_position_0 = reader->position_0;
-				int32_t old_position_1 = reader->position_1;
-				int32_t old_position_2 = reader->position_2;
-
-				reader->position_0 = position & 0xFFFFFFC0;
-				reader->position_1 = reader->position_0 + reader->buffer_size;
-				if (reader->position_1 >= reader->length)
-					reader->position_1 = reader->length;
-				reader->position_2 = reader->position_1 + reader->buffer_size;
-				if (reader->position_2 >= reader->length)
-					reader->position_2 = reader->length;
-				reader->position_3 = reader->position_2 + reader->buffer_size;
-				if (reader->position_3 >= reader->length)
-					reader->position_3 = reader->length;
-
-				reader->current_position = position;
-
-				if (seek > 0 || (reader->position_3 <= old_position_0)) {
-					sceIoLseek32(reader->handle, reader->position_0, PSP_SEEK_SET);
-					sceIoRead(reader->handle, reader->first_buffer, reader->position_1 - reader->position_0);
-					sceIoLseek32(reader->handle, reader->position_1, PSP_SEEK_SET);
-					sceIoRead(reader->handle, reader->second_buffer, reader->position_2 - reader->position_1);
-					sceIoLseek32(reader->handle, reader->position_2, PSP_SEEK_SET);
-					sceIoReadAsync(reader->handle, reader->third_buffer, reader->position_3 - reader->position_2);
-				} else {
-					int32_t copy;
-					uint8_t *dest;
-					uint8_t *src;
-					if (old_position_0 >= reader->position_2) {
-						copy = reader->position_3 - old_position_0;
-						dest = reader->third_buffer + (old_position_0 - reader->position_2);
-						src = reader->first_buffer;
-						memcpy(dest, src, copy);
-
-						sceIoLseek32(reader->handle, reader->position_0, PSP_SEEK_SET);
-						sceIoRead(reader->handle, reader->first_buffer, reader->position_1 - reader->position_0);
-						sceIoLseek32(reader->handle, reader->position_1, PSP_SEEK_SET);
-						sceIoRead(reader->handle, reader->second_buffer, reader->position_2 - reader->position_1);
-						sceIoLseek32(reader->handle, reader->position_2, PSP_SEEK_SET);
-						sceIoReadAsync(reader->handle, reader->third_buffer, old_position_0 - reader->position_2);
-					} else if (old_position_0 >= reader->position_1) {
-
-						copy = reader->position_3 - old_position_1;
-						dest = reader->third_buffer + (old_position_1 - reader->position_2);
-						src = reader->second_buffer;
-						memcpy(dest, src, copy);
-
-						copy = old_position_1 - reader->position_2;
-						dest = reader->third_buffer;
-						src = reader->first_buffer + (reader->position_2 - old_position_0);
-						memcpy(dest, src, copy);
-
-						copy = reader->position_2 - old_position_0;
-						dest = reader->second_buffer + (old_position_0 - reader->position_1);
-						src = reader->first_buffer;
-						memcpy(dest, src, copy);
-
-						sceIoLseek32(reader->handle, reader->position_0, PSP_SEEK_SET);
-						sceIoRead(reader->handle, reader->first_buffer, reader->position_1 - reader->position_0);
-						sceIoLseek32(reader->handle, reader->position_1, PSP_SEEK_SET);
-						sceIoRead(reader->handle, reader->second_buffer, old_position_0 - reader->position_1);
-						sceIoLseek32(reader->handle, reader->position_2, PSP_SEEK_SET);
-						sceIoReadAsync(reader->handle, reader->third_buffer, 0);
-					} else {
-						copy = reader->position_3 - old_position_2;
-						dest = reader->third_buffer + (old_position_2 - reader->position_2);
-						src = reader->third_buffer;
-						memmove(dest, src, copy);
-
-						copy = old_position_2 - reader->position_2;
-						dest = reader->third_buffer;
-						src = reader->second_buffer + (reader->position_2 - old_position_1);
-						memcpy(dest, src, copy);
-
-						copy = reader->position_2 - old_position_1;
-						dest = reader->second_buffer + (old_position_1 - reader->position_1);
-						src = reader->second_buffer;
-						memmove(dest, src, copy);
-
-						copy = old_position_1 - reader->position_1;
-						dest = reader->second_buffer;
-						src = reader->first_buffer + (reader->position_1 - old_position_0);
-						memcpy(dest, src, copy);
-
-						copy = reader->position_1 - old_position_0;
-						dest = reader->first_buffer + (old_position_0 - reader->position_0);
-						src = reader->first_buffer;
-						memmove(dest, src, copy);
-
-						sceIoLseek32(reader->handle, reader->position_0, PSP_SEEK_SET);
-						sceIoRead(reader->handle, reader->first_buffer, old_position_0 - reader->position_0);
-						sceIoLseek32(reader->handle, reader->position_1, PSP_SEEK_SET);
-						sceIoRead(reader->handle, reader->second_buffer, 0);
-						sceIoLseek32(reader->handle, reader->position_2, PSP_SEEK_SET);
-						sceIoReadAsync(reader->handle, reader->third_buffer, 0);
-					}
-				}
-				return position;
-			}
-		}
+	reader->current_position = position;
+
+	if (reader->current_position < 0)
+		reader->current_position = 0;
+	else if (reader->current_position > reader->length)
+		reader->current_position = reader->length;
+
+	if (reader->current_position < reader->length) {
+		if (find_block(reader, reader->current_position) >= 0)
+			reader->stats.hits++;
+		else
+			request_block(reader);
 	}
-	return 0;
+
+	return position;
 }
 
 SceUID buffered_reader_get_handle(buffered_reader_t * reader)
@@ -371,44 +468,83 @@ int buffered_reader_set_seek_mode(buffered_reader_t * reader, int new_mode)
 
 	reader->seek_mode = new_mode;
 
-	if (old_seek_mode != new_mode) {
-		buffered_reader_reset_buffer(reader, reader->current_position);
-	}
-
 	return old_seek_mode;
 }
 
+/**
+ * Update the bitrate estimate
+ *
+ * @note the clock is only read once per min_block_size bytes consumed
+ */
+static void update_rate(buffered_reader_t * reader, int32_t size)
+{
+	SceInt64 now;
+
+	reader->rate_bytes += size;
+
+	if (reader->rate_bytes < reader->rate_check)
+		return;
+
+	reader->rate_check = reader->rate_bytes + reader->min_block_size;
+	now = sceKernelGetSystemTimeWide();
+
+	if (now - reader->rate_start >= 1000000) {
+		reader->stats.rate = reader->rate_bytes * 1000000LL / (now - reader->rate_start);
+		reader->rate_bytes = 0;
+		reader->rate_check = reader->min_block_size;
+		reader->rate_start = now;
+	}
+}
+
 int32_t buffered_reader_read(buffered_reader_t * reader, void *buffer, uint32_t size)
 {
+	int32_t copied = 0;
+	int32_t idx;
+
 	if (!reader->cache_enabled) {
 		return sceIoRead(reader->handle, buffer, size);
 	}
 
-	if (reader->current_position == reader->length)
-		return 0;
-	if (size <= reader->position_2 - reader->current_position) {
-		if (reader->current_position < reader->position_1) {
-			if (size <= reader->position_1 - reader->current_position) {
-				memcpy(buffer, reader->first_buffer + (reader->current_position - reader->position_0), size);
-			} else {
-				memcpy(buffer, reader->first_buffer + (reader->current_position - reader->position_0), reader->position_1 - reader->current_position);
-				memcpy(buffer + (reader->position_1 - reader->current_position), reader->second_buffer, size - (reader->position_1 - reader->current_position));
-			}
-		} else {
-			memcpy(buffer, reader->second_buffer + (reader->current_position - reader->position_1), size);
+	while (size > 0 && reader->current_position < reader->length) {
+		reader_block_t *b;
+		int32_t n;
+
+		idx = find_block(reader, reader->current_position);
+
+		if (idx < 0) {
+			request_block(reader);
+			idx = find_block(reader, reader->current_position);
+
+			if (idx < 0)
+				break;
+		} else if (copied == 0) {
+			reader->stats.hits++;
 		}
-		reader->current_position += size;
-		if (reader->current_position == reader->position_2)
-			buffered_reader_seek(reader, reader->position_2);
-		return size;
-	} else {
-		uint32_t data_size;
 
-		data_size = reader->position_2 - reader->current_position;
-		buffered_reader_read(reader, buffer, data_size);
-		data_size += buffered_reader_read(reader, buffer + data_size, size - data_size);
-		return data_size;
+		b = &reader->blocks[idx];
+
+		if (b->state == BLOCK_PENDING) {
+			finish_pending(reader, 1);
+
+			if (b->state != BLOCK_READY || reader->current_position >= b->pos + b->len)
+				break;
+		}
+
+		n = b->pos + b->len - reader->current_position;
+
+		if (n > size)
+			n = size;
+
+		memcpy((uint8_t *) buffer + copied, b->data + (reader->current_position - b->pos), n);
+		reader->current_position += n;
+		copied += n;
+		size -= n;
 	}
+
+	update_rate(reader, copied);
+	prefetch(reader);
+
+	return copied;
 }
 
 int32_t buffered_reader_position(buffered_reader_t * reader)
@@ -427,11 +563,10 @@ int32_t buffered_reader_enable_cache(buffered_reader_t * reader, int32_t enabled
 	prev = reader->cache_enabled;
 
 	if (!prev && enabled) {
-		buffered_reader_reset_buffer(reader, buffered_reader_position(reader));
+		reader->current_position = sceIoLseek32(reader->handle, 0, PSP_SEEK_CUR);
+		reset_blocks(reader);
 	} else if (prev && !enabled) {
-		long long result;
-
-		sceIoWaitAsync(reader->handle, &result);
+		finish_pending(reader, 1);
 		sceIoLseek32(reader->handle, buffered_reader_position(reader), PSP_SEEK_SET);
 	}
 
@@ -439,3 +574,8 @@ int32_t buffered_reader_enable_cache(buffered_reader_t * reader, int32_t enabled
 
 	return prev;
 }
+
+void buffered_reader_get_stats(buffered_reader_t * reader, buffered_reader_stats_t * stats)
+{
+	*stats = reader->stats;
+}
@@ -29,7 +29,39 @@ extern "C"
 
 #define BUFFERED_READER_BUFFER_SIZE 65536	//131072//65536 //262144
 
+/* read-ahead blocks used by buffered_reader_open() */
+#define BUFFERED_READER_BLOCKS 3
+#define BUFFERED_READER_MAX_BLOCKS 16
+
+#ifdef BUFFERED_READER_INTERNAL
+	typedef struct buffered_reader_s buffered_reader_t;
+#else
 	typedef void *buffered_reader_t;
+#endif
+
+	typedef struct
+	{
+		/* reads and seeks served from the buffer */
+		uint32_t hits;
+		/* reads and seeks that had to request a block */
+		uint32_t misses;
+		/* async reads issued */
+		uint32_t reads;
+		uint64_t bytes;
+		/* time spent waiting for reads */
+		uint64_t wait_us;
+		/* measured consumption in bytes per second */
+		uint32_t rate;
+		/* estimated time per read */
+		uint32_t latency_us;
+	} buffered_reader_stats_t;
+
+	/*
+	 * buffer_size is the largest read issued, nblocks of that size are
+	 * allocated. Seek mode 1 keeps a block behind the read position for
+	 * decoders that step back.
+	 */
+	buffered_reader_t *buffered_reader_open_ex(const char *path, int32_t buffer_size, int32_t seek_mode, int32_t nblocks);
 
 	buffered_reader_t *buffered_reader_open(const char *path, int32_t buffer_size, int32_t seek_mode);
 
@@ -47,6 +79,8 @@ extern "C"
 
 	int32_t buffered_reader_enable_cache(buffered_reader_t * reader, int32_t enabled);
 
+	void buffered_reader_get_stats(buffered_reader_t * reader, buffered_reader_stats_t * stats);
+
 #ifdef __cplusplus
 }
 #endif
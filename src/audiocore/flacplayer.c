@@ -26,6 +26,7 @@
 #include "config.h"
 #include "scene.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "musicmgr.h"
 #include "musicdrv.h"
 #include "FLAC/stream_decoder.h"
@@ -37,6 +38,7 @@
 #include "genericplayer.h"
 #include "musicinfo.h"
 #include "simple_gettext.h"
+#include "seekcache.h"
 #ifdef DMALLOC
 #include "dmalloc.h"
 #endif
@@ -90,40 +92,66 @@ static FLAC__StreamDecoder *g_decoder = NULL;
 static FLAC__uint64 decode_position = 0;
 static FLAC__uint64 last_decode_position = 0;
 
+/**
+ * Flac֡ʼ
+ */
+static FLAC__uint64 g_frame_sample = 0;
+
+/**
+ * м¼֡λ, ˼߻ָʹ
+ */
+static t_seekcache g_seekcache;
+
 static buffered_reader_t *flacfile = NULL;
 
 /**
- * ݵ
+ * ӻĶλ㿪ʼ뵽Ŀ
  *
- * @note ĸʽΪ˫16λ
+ * @note Ŀ֡ڲŻ, libFLACֲļ
  *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param frames ֡
- * @param channels 
+ * @param target Ŀ
+ *
+ * @return ɹ0, ûпõĶλ㷵-1
  */
-static void send_to_sndbuf(void *buf, uint16_t * srcbuf, int frames, int channels)
+static int flac_seek_cached(FLAC__uint64 target)
 {
-	int n;
-	signed short *p = (signed short *) buf;
-
-	if (frames <= 0)
-		return;
-
-	if (channels == 2) {
-		memcpy(buf, srcbuf, frames * channels * sizeof(*srcbuf));
-	} else {
-		for (n = 0; n < frames * channels; n++) {
-			*p++ = srcbuf[n];
-			*p++ = srcbuf[n];
-		}
-	}
+	t_seekpoint pt;
+	FLAC__StreamDecoderState state;
+
+	if (seekcache_find(&g_seekcache, target, &pt) < 0)
+		return -1;
 
+	if (buffered_reader_seek(flacfile, pt.offset) < 0)
+		return -1;
+
+	FLAC__stream_decoder_flush(g_decoder);
+
+	do {
+		g_decoded_sample_size = 0;
+
+		if (!FLAC__stream_decoder_process_single(g_decoder))
+			return -1;
+
+		state = FLAC__stream_decoder_get_state(g_decoder);
+
+		if (state == FLAC__STREAM_DECODER_END_OF_STREAM || state == FLAC__STREAM_DECODER_ABORTED || state == FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR)
+			return -1;
+
+		// λ֡, libFLAC
+		if (g_decoded_sample_size > 0 && g_frame_sample > target)
+			return -1;
+	} while (g_decoded_sample_size == 0 || g_frame_sample + g_decoded_sample_size <= target);
+
+	g_buff_frame_size = g_decoded_sample_size;
+	g_buff_frame_start = target - g_frame_sample;
+
+	return 0;
 }
 
 static int flac_seek_seconds(double seconds)
 {
 	FLAC__StreamDecoderState state;
+	FLAC__uint64 target;
 
 	if (g_info.duration == 0)
 		return -1;
@@ -137,16 +165,25 @@ static int flac_seek_seconds(double seconds)
 		seconds = 0;
 
 	free_bitrate(&g_inst_br);
+	target = g_info.samples * seconds / g_info.duration;
 
-	if (!FLAC__stream_decoder_seek_absolute(g_decoder, g_info.samples * seconds / g_info.duration)) {
-		return -1;
-	}
+	if (flac_seek_cached(target) < 0) {
+		g_decoded_sample_size = 0;
 
-	state = FLAC__stream_decoder_get_state(g_decoder);
+		if (!FLAC__stream_decoder_seek_absolute(g_decoder, target)) {
+			return -1;
+		}
 
-	if (state == FLAC__STREAM_DECODER_SEEK_ERROR) {
-		dbg_printf(d, "Reflush the stream");
-		FLAC__stream_decoder_flush(g_decoder);
+		state = FLAC__stream_decoder_get_state(g_decoder);
+
+		if (state == FLAC__STREAM_DECODER_SEEK_ERROR) {
+			dbg_printf(d, "Reflush the stream");
+			FLAC__stream_decoder_flush(g_decoder);
+			g_decoded_sample_size = 0;
+		}
+		// libFLACѽĿ֡Ŀʼд
+		g_buff_frame_size = g_decoded_sample_size;
+		g_buff_frame_start = 0;
 	}
 
 	g_play_time = seconds;
@@ -210,9 +247,6 @@ static FLAC__bool flac_eof_cb(const FLAC__StreamDecoder * decoder, void *client_
 static FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *
 													 decoder, const FLAC__Frame * frame, const FLAC__int32 * const buffer[], void *client_data)
 {
-	size_t i;
-	uint16_t *output;
-
 	(void) decoder;
 
 	if (g_info.samples == 0) {
@@ -226,6 +260,11 @@ static FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *
 
 	g_decoded_sample_size = frame->header.blocksize;
 
+	if (frame->header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER)
+		g_frame_sample = frame->header.number.sample_number;
+	else
+		g_frame_sample = (FLAC__uint64) frame->header.number.frame_number * frame->header.blocksize;
+
 	if (frame->header.blocksize > g_buff_size) {
 		g_buff_size = frame->header.blocksize;
 		g_buff = safe_realloc(g_buff, g_buff_size * frame->header.channels * sizeof(*g_buff));
@@ -234,19 +273,7 @@ static FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *
 			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 	}
 
-	output = (uint16_t *) g_buff;
-
-	if (frame->header.channels == 2) {
-		for (i = 0; i < frame->header.blocksize; i++) {
-			*output++ = (FLAC__int16) buffer[0][i];
-			*output++ = (FLAC__int16) buffer[1][i];
-		}
-	} else if (frame->header.channels == 1) {
-		for (i = 0; i < frame->header.blocksize; i++) {
-			*output++ = (FLAC__int16) buffer[0][i];
-			*output++ = (FLAC__int16) buffer[0][i];
-		}
-	}
+	pcm_planar_to_stereo(g_buff, buffer, frame->header.blocksize, frame->header.channels, 0);
 
 	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
@@ -281,104 +308,6 @@ static void error_callback(const FLAC__StreamDecoder * decoder, FLAC__StreamDeco
 	dbg_printf(d, "Got error callback: %s", FLAC__StreamDecoderErrorStatusString[status]);
 }
 
-/**
- * 
- *
- * @return
- * - -1 should exit
- * - 0 OK
- */
-static int handle_seek(void)
-{
-	u64 timer_end;
-
-	if (g_status == ST_FFORWARD) {
-		sceRtcGetCurrentTick(&timer_end);
-
-		generic_lock();
-		if (g_last_seek_is_forward) {
-			generic_unlock();
-
-			if (pspDiffTime(&timer_end, (u64 *) & g_last_seek_tick) <= 1.0) {
-				generic_lock();
-
-				if (g_seek_count > 0) {
-					g_play_time += g_seek_seconds;
-					g_seek_count--;
-				}
-
-				generic_unlock();
-
-				if (g_play_time >= g_info.duration) {
-					return -1;
-				}
-
-				sceKernelDelayThread(100000);
-			} else {
-				generic_lock();
-
-				g_seek_count = 0;
-				generic_set_playback(true);
-
-				if (flac_seek_seconds(g_play_time) < 0) {
-					generic_unlock();
-					return -1;
-				}
-
-				generic_set_status(ST_PLAYING);
-
-				generic_unlock();
-				sceKernelDelayThread(100000);
-			}
-		} else {
-			generic_unlock();
-		}
-	} else if (g_status == ST_FBACKWARD) {
-		sceRtcGetCurrentTick(&timer_end);
-
-		generic_lock();
-		if (!g_last_seek_is_forward) {
-			generic_unlock();
-
-			if (pspDiffTime(&timer_end, (u64 *) & g_last_seek_tick) <= 1.0) {
-				generic_lock();
-
-				if (g_seek_count > 0) {
-					g_play_time -= g_seek_seconds;
-					g_seek_count--;
-				}
-
-				generic_unlock();
-
-				if (g_play_time < 0) {
-					g_play_time = 0;
-				}
-
-				sceKernelDelayThread(100000);
-			} else {
-				generic_lock();
-
-				g_seek_count = 0;
-				generic_set_playback(true);
-
-				if (flac_seek_seconds(g_play_time) < 0) {
-					generic_unlock();
-					return -1;
-				}
-
-				generic_set_status(ST_PLAYING);
-
-				generic_unlock();
-				sceKernelDelayThread(100000);
-			}
-		} else {
-			generic_unlock();
-		}
-	}
-
-	return 0;
-}
-
 /**
  * FlacֲŻص
  * 𽫽
@@ -399,12 +328,11 @@ static int flac_audiocallback(void *buf, unsigned int reqn, void *pdata)
 	UNUSED(pdata);
 
 	if (g_status != ST_PLAYING) {
-		if (handle_seek() == -1) {
+		if (generic_handle_seek(flac_seek_seconds) == -1) {
 			__end();
 			return -1;
 		}
 
-		g_buff_frame_size = g_buff_frame_start = 0;
 		xAudioClearSndBuf(buf, snd_buf_frame_size);
 		return 0;
 	}
@@ -413,14 +341,14 @@ static int flac_audiocallback(void *buf, unsigned int reqn, void *pdata)
 		avail_frame = g_buff_frame_size - g_buff_frame_start;
 
 		if (avail_frame >= snd_buf_frame_size) {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], snd_buf_frame_size, g_info.channels);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], snd_buf_frame_size, g_info.channels);
 			g_buff_frame_start += snd_buf_frame_size;
 			audio_buf += snd_buf_frame_size * 2;
 			snd_buf_frame_size = 0;
 		} else {
 			FLAC__StreamDecoderState state;
 
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], avail_frame, g_info.channels);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], avail_frame, g_info.channels);
 			snd_buf_frame_size -= avail_frame;
 			audio_buf += avail_frame * 2;
 
@@ -455,6 +383,9 @@ static int flac_audiocallback(void *buf, unsigned int reqn, void *pdata)
 
 				bitrate = (decode_position - last_decode_position) * 8.0 / (g_buff_frame_size * 4 / (float) bytes_per_sec);
 				add_bitrate(&g_inst_br, bitrate, incr);
+
+				// last_decode_positionΪ֡ʼ
+				seekcache_add(&g_seekcache, g_frame_sample, last_decode_position);
 			}
 
 			last_decode_position = decode_position;
@@ -480,6 +411,7 @@ static int __init(void)
 	memset(&g_info, 0, sizeof(g_info));
 	g_decoder = NULL;
 	g_encode_name[0] = '\0';
+	g_frame_sample = 0;
 
 	return 0;
 }
@@ -590,6 +522,11 @@ static int flac_load(const char *spath, const char *lpath)
 		return -1;
 	}
 
+	if (!FLAC__stream_decoder_get_decode_position(g_decoder, &decode_position))
+		decode_position = 0;
+
+	last_decode_position = decode_position;
+
 	if (g_info.channels != 1 && g_info.channels != 2) {
 		__end();
 		return -1;
@@ -610,6 +547,7 @@ static int flac_load(const char *spath, const char *lpath)
 		return -1;
 	}
 
+	seekcache_open(&g_seekcache, spath, g_info.filesize, g_info.sample_freq);
 	generic_set_status(ST_LOADED);
 
 	dbg_printf(d,
@@ -651,7 +589,7 @@ static int __end(void)
  *
  * @return ɹʱ0
  */
-static int flac_end(void)
+static int flac_close(void)
 {
 	__end();
 
@@ -680,6 +618,19 @@ static int flac_end(void)
 	return 0;
 }
 
+/**
+ * ֹͣFlacļĲţٶλ㻺
+ *
+ * @return ɹʱ0
+ */
+static int flac_end(void)
+{
+	flac_close();
+	seekcache_free(&g_seekcache);
+
+	return 0;
+}
+
 /**
  * PSP׼ʱFlacĲ
  *
@@ -688,7 +639,8 @@ static int flac_end(void)
 static int flac_suspend(void)
 {
 	generic_suspend();
-	flac_end();
+	// λ㻺, ָʱֱӶλ
+	flac_close();
 
 	return 0;
 }
@@ -754,6 +706,10 @@ static int flac_get_info(struct music_info *pinfo)
 	return generic_get_info(pinfo);
 }
 
+static const char *flac_exts[] = {
+	"flac", NULL
+};
+
 /**
  * ǷΪFLACļĿǰֻļ׺
  *
@@ -763,17 +719,7 @@ static int flac_get_info(struct music_info *pinfo)
  */
 static int flac_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "flac") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, flac_exts);
 }
 
 static int flac_set_opt(const char *unused, const char *values)
@@ -831,6 +777,7 @@ static struct music_ops flac_ops = {
 	.resume = flac_resume,
 	.get_info = flac_get_info,
 	.probe = flac_probe,
+	.exts = flac_exts,
 	.next = NULL
 };
 
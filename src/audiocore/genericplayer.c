@@ -162,6 +162,19 @@ int generic_set_status(int status)
 	g_status = status;
 	generic_unlock();
 
+	// ѽ, ʹͣ˲صȴ岥;
+	// ֹͣʱʣµĿβ, Ӧճ
+	if (prev != status && status != ST_STOPPED) {
+		double dropped = xAudioFlush();
+
+		// ˴λÿʼ, ǽλ
+		if (status == ST_FFORWARD || status == ST_FBACKWARD) {
+			generic_lock();
+			g_play_time = max(g_play_time - dropped, 0);
+			generic_unlock();
+		}
+	}
+
 	return prev;
 }
 
@@ -245,6 +258,72 @@ int generic_fbackward(int sec)
 	return 0;
 }
 
+/**
+ * 
+ *
+ * @note ʱֻۼӲʱ, ֹͣ1ŵһseek
+ *
+ * @param seek Ķλ, λ, ʧܷظ
+ *
+ * @return
+ * - -1 should exit
+ * - 0 OK
+ */
+int generic_handle_seek(int (*seek) (double seconds))
+{
+	u64 timer_end;
+	bool forward;
+
+	if (g_status != ST_FFORWARD && g_status != ST_FBACKWARD)
+		return 0;
+
+	forward = g_status == ST_FFORWARD;
+	sceRtcGetCurrentTick(&timer_end);
+
+	generic_lock();
+
+	if (g_last_seek_is_forward != forward) {
+		generic_unlock();
+		return 0;
+	}
+
+	if (pspDiffTime(&timer_end, (u64 *) & g_last_seek_tick) <= 1.0) {
+		if (g_seek_count > 0) {
+			g_play_time += forward ? g_seek_seconds : -g_seek_seconds;
+			g_seek_count--;
+		}
+
+		generic_unlock();
+
+		if (forward && g_play_time >= g_info.duration) {
+			return -1;
+		}
+
+		if (g_play_time < 0) {
+			g_play_time = 0;
+		}
+
+		sceKernelDelayThread(100000);
+
+		return 0;
+	}
+
+	g_seek_count = 0;
+	generic_set_playback(true);
+
+	if ((*seek) (g_play_time) < 0) {
+		generic_unlock();
+		return -1;
+	}
+
+	generic_set_status(ST_PLAYING);
+
+	generic_unlock();
+	sceKernelDelayThread(100000);
+
+	return 0;
+}
+
 int generic_end(void)
 {
 	xr_lock_destroy(&generic_l);
@@ -282,7 +361,8 @@ int generic_resume(const char *spath, const char *lpath)
 int generic_suspend(void)
 {
 	g_suspend_status = g_status;
-	g_suspend_playing_time = g_play_time;
+	// δŵĲָֻ½
+	g_suspend_playing_time = max(g_play_time - xAudioGetQueuedSeconds(), 0);
 
 	return 0;
 }
@@ -103,6 +103,7 @@ extern "C"
 	void generic_set_playback(bool playing);
 	int generic_get_info(struct music_info *info);
 	int generic_set_status(int status);
+	int generic_handle_seek(int (*seek) (double seconds));
 
 #ifdef __cplusplus
 }
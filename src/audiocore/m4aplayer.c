@@ -37,6 +37,7 @@
 #include "strsafe.h"
 #include "musicdrv.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "dbg.h"
 #include "scene.h"
 #include "apetaglib/APETag.h"
@@ -146,34 +147,6 @@ static int m4a_seek_seconds(double seconds)
 	return 0;
 }
 
-/**
- * ݵ
- *
- * @note ĸʽΪ˫16λ
- *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param frames ֡
- * @param channels 
- */
-static void send_to_sndbuf(void *buf, uint16_t * srcbuf, int frames, int channels)
-{
-	int n;
-	signed short *p = (signed short *) buf;
-
-	if (frames <= 0)
-		return;
-
-	if (channels == 2) {
-		memcpy(buf, srcbuf, frames * channels * sizeof(*srcbuf));
-	} else {
-		for (n = 0; n < frames * channels; n++) {
-			*p++ = srcbuf[n];
-			*p++ = srcbuf[n];
-		}
-	}
-}
-
 /**
  * MP3ֲŻصME汾
  * 𽫽
@@ -224,7 +197,7 @@ static int m4a_audiocallback(void *buf, unsigned int reqn, void *pdata)
 		avail_frame = g_buff_frame_size - g_buff_frame_start;
 
 		if (avail_frame >= snd_buf_frame_size) {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * 2], snd_buf_frame_size, 2);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * 2], snd_buf_frame_size, 2);
 			g_buff_frame_start += snd_buf_frame_size;
 			audio_buf += snd_buf_frame_size * 2;
 			snd_buf_frame_size = 0;
@@ -235,7 +208,7 @@ static int m4a_audiocallback(void *buf, unsigned int reqn, void *pdata)
 			u_int32_t buffer_size = 0;
 			uint16_t *output;
 
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * 2], avail_frame, 2);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * 2], avail_frame, 2);
 			snd_buf_frame_size -= avail_frame;
 			audio_buf += avail_frame * 2;
 			memset(aac_mix_buffer, 0, sizeof(aac_mix_buffer));
@@ -570,6 +543,10 @@ static int m4a_get_info(struct music_info *info)
 	return generic_get_info(info);
 }
 
+static const char *m4a_exts[] = {
+	"mp4", "m4a", NULL
+};
+
 /**
  * ǷΪAT3ļĿǰֻļ׺
  *
@@ -579,20 +556,7 @@ static int m4a_get_info(struct music_info *info)
  */
 static int m4a_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "mp4") == 0) {
-			return 1;
-		}
-		if (stricmp(p, "m4a") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, m4a_exts);
 }
 
 /**
@@ -687,6 +651,7 @@ static struct music_ops m4a_ops = {
 	.resume = m4a_resume,
 	.get_info = m4a_get_info,
 	.probe = m4a_probe,
+	.exts = m4a_exts,
 	.next = NULL,
 };
 
@@ -35,6 +35,7 @@
 #include "config.h"
 #include "mediaengine.h"
 #include "pspvaudio.h"
+#include "xaudiolib.h"
 #include "common/datatype.h"
 #include "scene.h"
 #include "strsafe.h"
@@ -179,7 +180,8 @@ int unload_prx(void)
 		b_avcodec_prx_loaded = false;
 	}
 
-	if (b_vaudio_prx_loaded) {
+	// the channel kept for the next track is still playing through vaudio
+	if (b_vaudio_prx_loaded && !xAudioIsDetached()) {
 		sceUtilityUnloadModule(0x0305);
 		b_vaudio_prx_loaded = false;
 	}
@@ -510,6 +510,16 @@ static int mp3_parse_vbr_tags(mp3_reader_data * data, struct MP3Info *info, uint
 		if (!strncmp(info->lame_str, "LAME", 4)
 			|| !strncmp(info->lame_str, "GOGO", 4))
 			info->lame_encoded = true;
+
+		/* skip the ABR bitrate byte, then 12 bits encoder delay and 12 bits padding */
+		if (info->lame_encoded && buffered_reader_read(data->r, &b, sizeof(b)) == sizeof(b)) {
+			uint8_t *q = (uint8_t *) & b;
+
+			info->enc_delay = (q[1] << 4) | (q[2] >> 4);
+			info->enc_padding = ((q[2] & 0xf) << 8) | q[3];
+		}
+
+		info->have_xing = true;
 	}
 
 	/* Check for VBRI tag (always 32 bytes after end of mpegaudio header) */
@@ -554,14 +564,25 @@ static int mp3_parse_vbr_tags(mp3_reader_data * data, struct MP3Info *info, uint
 	return frames;
 }
 
-int read_mp3_info_brute(struct MP3Info *info, mp3_reader_data * data)
+/* bytes scanned to estimate the frame count of a file without Xing header */
+#define MP3_ESTIMATE_SIZE (256 * 1024)
+
+/*
+ * Scan frame headers from the start of the file, up to limit bytes
+ * (0 for the whole file). Every toc_step'th frame offset is recorded
+ * into info->frameoff, none if toc_step is 0.
+ *
+ * Returns the offset of the first frame, or -1 on failure or cancel.
+ */
+static int mp3_scan_frames(struct MP3Info *info, mp3_reader_data * data, u32 limit, u32 toc_step, const volatile bool * cancel, u32 * last)
 {
-	uint32_t off;
-	int size, br = 0, dcount = 0;
+	uint32_t off, pos;
+	int size, dcount = 0;
 	int end;
 	int level;
-	static uint8_t *buf;
-	uint32_t first_frame = (uint32_t) - 1;
+	uint8_t *buf;
+	int first_frame = -1;
+	u32 cap = 0;
 
 	if (data->r == NULL)
 		return -1;
@@ -586,26 +607,39 @@ int read_mp3_info_brute(struct MP3Info *info, mp3_reader_data * data)
 
 	level = info->sample_freq = info->channels = info->frames = 0;
 	info->frameoff = NULL;
+	info->toc_step = toc_step;
+	info->toc_count = 0;
+	*last = 0;
 
 	while ((end = buffered_reader_read(data->r, &buf[4], 65536)) > 0) {
+		if (cancel != NULL && *cancel)
+			goto fail;
+
 		while (off < end) {
 			int brate = 0;
 
-			if ((size = parse_frame(buf, off, end, &level, &brate, info, data, dcount * 65536 + off)) > 0) {
-				br += brate;
-				if (first_frame == (uint32_t) - 1)
-					first_frame = dcount * 65536 + off;
-
-				if (info->frames >= 0) {
-					if (info->frames == 0)
-						info->frameoff = malloc(sizeof(u32) * 1024);
-					else
-						info->frameoff = safe_realloc(info->frameoff, sizeof(u32) * (info->frames + 1024));
-					if (info->frameoff == NULL)
-						info->frames = -1;
-					else
-						info->frameoff[info->frames++] = dcount * 65536 + off;
+			pos = dcount * 65536 + off;
+
+			if ((size = parse_frame(buf, off, end, &level, &brate, info, data, pos)) > 0) {
+				if (first_frame < 0)
+					first_frame = pos;
+
+				if (toc_step > 0 && info->frames % toc_step == 0) {
+					if (info->toc_count >= cap) {
+						u32 *p = safe_realloc(info->frameoff, sizeof(u32) * (cap + 1024));
+
+						if (p == NULL)
+							goto fail;
+
+						info->frameoff = p;
+						cap += 1024;
+					}
+
+					info->frameoff[info->toc_count++] = pos;
 				}
+
+				info->frames++;
+				*last = pos + size;
 				off += size;
 			} else
 				off++;
@@ -613,24 +647,87 @@ int read_mp3_info_brute(struct MP3Info *info, mp3_reader_data * data)
 		off -= end;
 		memmove(buf, &buf[end], 4);
 		dcount++;
+
+		if (limit > 0 && dcount * 65536 >= limit)
+			break;
 	}
 
+	free(buf);
+
+	return first_frame;
+
+  fail:
+	free_mp3_info(info);
+	info->frames = 0;
+	free(buf);
+
+	return -1;
+}
+
+int mp3_build_toc(struct MP3Info *info, mp3_reader_data * data, u32 toc_step, const volatile bool * cancel)
+{
+	u32 last;
+	int first_frame;
+
+	first_frame = mp3_scan_frames(info, data, 0, toc_step, cancel, &last);
+
+	if (first_frame < 0)
+		return -1;
+
 	if (info->frames) {
 		info->duration = 1.0 * info->spf * info->frames / info->sample_freq;
 		info->average_bitrate = (double) data->size * 8 / info->duration;
 	}
 
+	return first_frame;
+}
+
+int read_mp3_info_brute(struct MP3Info *info, mp3_reader_data * data)
+{
+	int first_frame;
+
+	first_frame = mp3_build_toc(info, data, MP3_TOC_STEP, NULL);
+
+	if (first_frame < 0)
+		return -1;
+
 	buffered_reader_seek(data->r, first_frame);
-	free(buf);
 
 	return 0;
 }
 
+/*
+ * Guess frame count from the leading frames, the exact seek table
+ * is built later by mp3_build_toc
+ *
+ * Returns 1 on success to tell it from an exact Xing frame count.
+ */
+static int mp3_estimate_info(struct MP3Info *info, mp3_reader_data * data)
+{
+	u32 last;
+	int first_frame;
+
+	first_frame = mp3_scan_frames(info, data, MP3_ESTIMATE_SIZE, 0, NULL, &last);
+
+	if (first_frame < 0 || info->frames == 0 || last <= first_frame)
+		return -1;
+
+	if (last < data->size)
+		info->frames = (double) info->frames * (data->size - first_frame) / (last - first_frame);
+
+	info->duration = 1.0 * info->spf * info->frames / info->sample_freq;
+	info->average_bitrate = (double) data->size * 8 / info->duration;
+	buffered_reader_seek(data->r, first_frame);
+
+	return 1;
+}
+
 int read_mp3_info(struct MP3Info *info, mp3_reader_data * data)
 {
 	uint32_t off;
 
 	info->frameoff = NULL;
+	info->toc_step = info->toc_count = 0;
 
 	if (skip_id3v2_tag(data) == -1)
 		return -1;
@@ -638,8 +735,8 @@ int read_mp3_info(struct MP3Info *info, mp3_reader_data * data)
 	off = buffered_reader_position(data->r);
 
 	if (mp3_parse_vbr_tags(data, info, off) < 0) {
-		dbg_printf(d, "%s: No Xing header found, use brute force search method", __func__);
-		return read_mp3_info_brute(info, data);
+		dbg_printf(d, "%s: No Xing header found, estimate from leading frames", __func__);
+		return mp3_estimate_info(info, data);
 	}
 
 	buffered_reader_seek(data->r, off);
@@ -654,6 +751,8 @@ int free_mp3_info(struct MP3Info *info)
 		info->frameoff = NULL;
 	}
 
+	info->toc_count = 0;
+
 	return 0;
 }
 
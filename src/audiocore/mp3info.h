@@ -36,6 +36,9 @@
 #define MODE_EXT_MS_STEREO   2
 #define MPA_MONO   3
 
+/* frames per seek table entry */
+#define MP3_TOC_STEP 32
+
 typedef struct mp3_reader_data_t
 {
 	buffered_reader_t *r;
@@ -59,15 +62,24 @@ struct MP3Info
 	int sample_freq;
 	double duration;
 	double average_bitrate;
+	/* offset of every toc_step'th frame, toc_count entries */
 	u32 *frameoff;
+	u32 toc_step;
+	u32 toc_count;
 	bool lame_encoded;
 	short lame_mode;
 	short lame_vbr_quality;
 	char lame_str[20];
+	/* first frame is a Xing/Info header that decodes to silence */
+	bool have_xing;
+	/* samples added by the encoder, from the LAME tag */
+	u16 enc_delay;
+	u16 enc_padding;
 };
 
 int read_mp3_info(struct MP3Info *info, mp3_reader_data * data);
 int read_mp3_info_brute(struct MP3Info *info, mp3_reader_data * data);
+int mp3_build_toc(struct MP3Info *info, mp3_reader_data * data, u32 toc_step, const volatile bool * cancel);
 int free_mp3_info(struct MP3Info *info);
 int search_valid_frame_me(mp3_reader_data * data, int *brate);
 int read_id3v2_tag(int fd, struct MP3Info *info);
@@ -37,11 +37,13 @@
 #include "strsafe.h"
 #include "musicdrv.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "dbg.h"
 #include "scene.h"
 #include "apetaglib/APETag.h"
 #include "genericplayer.h"
 #include "mp3info.h"
+#include "mp3toc.h"
 #include "musicinfo.h"
 #include "common/utils.h"
 #include "mediaengine.h"
@@ -54,6 +56,11 @@
 #define UNUSED(x) ((void)(x))
 #define BUFF_SIZE	8*1152
 
+/**
+ * MP3еӳ
+ */
+#define MP3_DECODER_DELAY 529
+
 static mp3_reader_data mp3_data;
 
 static int __end(void);
@@ -84,54 +91,35 @@ static struct MP3Info mp3info;
 static bool use_brute_method = false;
 
 /**
- * Media Engine buffer
+ * ͷӦ: Xing֡, ӳ
  */
-static unsigned long mp3_codec_buffer[65] __attribute__ ((aligned(64)));
+static u32 g_trim_start;
 
-static bool mp3_getEDRAM = false;
-
-static uint8_t memp3_input_buf[2889] __attribute__ ((aligned(64)));
-
-int memp3_decode(void *data, u32 data_len, void *pcm_data);
+/**
+ * ЧĽλ, Ϊ, 0Ϊض
+ */
+static u32 g_trim_end;
 
 /**
- * ݵ
- *
- * @note ĸʽΪ˫16λ
- *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param samples 
- * @param channels 
- * 
- * @return ƽַ
+ * ѽλ, 
  */
-static u16 *copy_to_sndbuf(u16 *buf, u16 *srcbuf, int samples, int channels)
-{
-	int n;
-	u16 *p;
+static u32 g_stream_pos;
 
-	if (channels == 2) {
-		memcpy(buf, srcbuf, samples * channels * sizeof(*srcbuf));
-		p = buf + samples * channels;
-	} else {
-		n = samples * channels;
+/**
+ * Media Engine buffer
+ */
+static unsigned long mp3_codec_buffer[65] __attribute__ ((aligned(64)));
 
-		while(n-- > 0) {
-			*buf++ = *srcbuf;
-			*buf++ = *srcbuf;
-			srcbuf++;
-		}
+static bool mp3_getEDRAM = false;
 
-		p = buf;
-	}
+static uint8_t memp3_input_buf[2889] __attribute__ ((aligned(64)));
 
-	return p;
-}
+int memp3_decode(void *data, u32 data_len, void *pcm_data);
 
 static int mp3_seek_seconds_offset_brute(double npt)
 {
 	int pos;
+	u32 idx;
 
 	pos = (int) ((double) g_info.samples * (npt) / g_info.duration);
 
@@ -139,20 +127,19 @@ static int mp3_seek_seconds_offset_brute(double npt)
 		pos = 0;
 	}
 
-	dbg_printf(d, "%s: jumping to %d frame, offset %08x", __func__, pos, (int) mp3info.frameoff[pos]);
-	dbg_printf(d, "%s: frame range (0~%u)", __func__, (unsigned) g_info.samples);
-
 	if (pos >= g_info.samples) {
 		__end();
 		return -1;
 	}
 
-	buffered_reader_seek(mp3_data.r, mp3info.frameoff[pos]);
+	/* λÿtoc_step֡һ, Ŀһ */
+	idx = min(pos / mp3info.toc_step, mp3info.toc_count - 1);
 
-	if (pos <= 0)
-		g_play_time = 0.0;
-	else
-		g_play_time = npt;
+	dbg_printf(d, "%s: jumping to %d frame, offset %08x", __func__, (int) (idx * mp3info.toc_step), (int) mp3info.frameoff[idx]);
+	dbg_printf(d, "%s: frame range (0~%u)", __func__, (unsigned) g_info.samples);
+
+	buffered_reader_seek(mp3_data.r, mp3info.frameoff[idx]);
+	g_play_time = (double) idx * mp3info.toc_step * mp3info.spf / mp3info.sample_freq;
 
 	return 0;
 }
@@ -282,15 +269,82 @@ static int mp3_seek_seconds(double npt)
 {
 	int ret;
 
-	if (mp3info.frameoff && g_info.samples > 0) {
+	if (mp3toc_scan_fetch(&mp3info)) {
+		g_info.samples = mp3info.frames;
+		g_info.duration = mp3info.duration;
+		g_info.avg_bps = mp3info.average_bitrate;
+	}
+
+	if (mp3info.frameoff && mp3info.toc_count > 0 && g_info.samples > 0) {
 		ret = mp3_seek_seconds_offset_brute(npt);
 	} else {
 		ret = mp3_seek_seconds_offset(npt);
 	}
 
+	// g_play_timeͷ; صͷʱ´֡, ٴνȥ
+	if (ret == 0) {
+		g_stream_pos = g_play_time > 0 ? g_trim_start + (u32) (g_play_time * mp3info.sample_freq) : 0;
+	}
+
 	return ret;
 }
 
+/**
+ * ӳȥս֡β
+ */
+static void trim_frame(void)
+{
+	u32 pos = g_stream_pos;
+
+	g_stream_pos += g_buff_sample_size;
+
+	if (pos < g_trim_start) {
+		g_buff_sample_start = min(g_trim_start - pos, g_buff_sample_size);
+	}
+
+	if (g_trim_end > 0 && g_stream_pos > g_trim_end) {
+		g_buff_sample_size = max(g_trim_end, pos + g_buff_sample_start) - pos;
+	}
+}
+
+/**
+ * LAMEǩiTunSMPB޷첥Ҫȥ
+ *
+ * @param exact ֡ǷXing/VBRIͷȷ
+ */
+static void setup_gapless(bool exact)
+{
+	u32 delay, padding, total, lead;
+
+	g_trim_start = g_trim_end = g_stream_pos = 0;
+
+	if (mp3info.lame_encoded && (mp3info.enc_delay != 0 || mp3info.enc_padding != 0)) {
+		delay = mp3info.enc_delay;
+		padding = mp3info.enc_padding;
+		lead = MP3_DECODER_DELAY;
+	} else if (g_info.enc_delay > 0 || g_info.enc_padding > 0) {
+		/* iTunSMPBӳѰӳ */
+		delay = g_info.enc_delay;
+		padding = g_info.enc_padding;
+		lead = 0;
+	} else {
+		return;
+	}
+
+	if (mp3info.have_xing) {
+		lead += mp3info.spf;
+	}
+
+	g_trim_start = lead + delay;
+	total = mp3info.frames * mp3info.spf;
+
+	if (exact && total > delay + padding) {
+		g_trim_end = g_trim_start + total - delay - padding;
+	}
+
+	dbg_printf(d, "%s: delay %u, padding %u, samples %u-%u", __func__, (unsigned) delay, (unsigned) padding, (unsigned) g_trim_start, (unsigned) g_trim_end);
+}
+
 /**
  * 
  *
@@ -340,6 +394,7 @@ int memp3_decode(void *data, u32 data_len, void *pcm_data)
 static int memp3_audiocallback(void *buf, unsigned int snd_buf_sample_size, void *pdata)
 {
 	int avail_sample, copy_sample;
+	unsigned int reqn = snd_buf_sample_size;
 	u16 *audio_buf = buf;
 	double incr;
 
@@ -358,7 +413,8 @@ static int memp3_audiocallback(void *buf, unsigned int snd_buf_sample_size, void
 	while (snd_buf_sample_size != 0) {
 		avail_sample = g_buff_sample_size - g_buff_sample_start;
 		copy_sample = min(avail_sample, snd_buf_sample_size);
-		audio_buf = copy_to_sndbuf(audio_buf, &g_buff[g_buff_sample_start * g_info.channels], copy_sample, g_info.channels);
+		pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_sample_start * g_info.channels], copy_sample, g_info.channels);
+		audio_buf += copy_sample * 2;
 		g_buff_sample_start += copy_sample;
 		snd_buf_sample_size -= copy_sample;
 		incr = (double) (copy_sample) / g_info.sample_freq;
@@ -367,9 +423,15 @@ static int memp3_audiocallback(void *buf, unsigned int snd_buf_sample_size, void
 		if(g_buff_sample_start == g_buff_sample_size) {
 			int brate = 0, ret;
 
-			ret = seek_and_decode(&brate, NULL);
+			if (g_trim_end > 0 && g_stream_pos >= g_trim_end) {
+				ret = -1;
+			} else {
+				ret = seek_and_decode(&brate, NULL);
+			}
 
 			if (ret < 0) {
+				/* дĲճ, һ */
+				xAudioSetTailFrames(reqn - snd_buf_sample_size);
 				__end();
 				return -1;
 			}
@@ -378,6 +440,7 @@ static int memp3_audiocallback(void *buf, unsigned int snd_buf_sample_size, void
 			incr = (double) g_buff_sample_size / mp3info.sample_freq;
 			add_bitrate(&g_inst_br, brate * 1000, incr);
 			g_buff_sample_start = 0;
+			trim_frame();
 		}
 	}
 
@@ -510,16 +573,14 @@ static int mp3_load(const char *spath, const char *lpath)
 		return -1;
 	}
 
-	if (use_brute_method) {
-		if (read_mp3_info_brute(&mp3info, &mp3_data) < 0) {
-			__end();
-			return -1;
-		}
-	} else {
-		if (read_mp3_info(&mp3info, &mp3_data) < 0) {
-			__end();
-			return -1;
-		}
+	if ((ret = read_mp3_info(&mp3info, &mp3_data)) < 0) {
+		__end();
+		return -1;
+	}
+
+	/* ûлĶλʱ, ڲſʼɺ̨߳ɨ */
+	if (mp3toc_load(spath, &mp3info) < 0 && (use_brute_method || ret > 0)) {
+		mp3toc_scan_start(spath);
 	}
 
 	/* MediaEngine always decodes mp3 data into stereo */
@@ -530,6 +591,7 @@ static int mp3_load(const char *spath, const char *lpath)
 	g_info.duration = mp3info.duration;
 
 	generic_readtag(&g_info, spath);
+	setup_gapless(ret == 0);
 
 	dbg_printf(d, "[%d channel(s), %d Hz, %.2f kbps, %02d:%02d%sframes %d]",
 			   g_info.channels, g_info.sample_freq,
@@ -708,6 +770,7 @@ static int mp3_end(void)
 	if (mp3_getEDRAM)
 		sceAudiocodecReleaseEDRAM(mp3_codec_buffer);
 
+	mp3toc_scan_stop();
 	free_mp3_info(&mp3info);
 	free_bitrate(&g_inst_br);
 
@@ -769,6 +832,10 @@ static int mp3_resume(const char *spath, const char *lpath)
 	return 0;
 }
 
+static const char *mp3_exts[] = {
+	"mp1", "mp2", "mp3", "mpa", "mpeg", NULL
+};
+
 /**
  * ǷΪMP3ļĿǰֻļ׺
  *
@@ -778,29 +845,7 @@ static int mp3_resume(const char *spath, const char *lpath)
  */
 static int mp3_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "mp1") == 0) {
-			return 1;
-		}
-		if (stricmp(p, "mp2") == 0) {
-			return 1;
-		}
-		if (stricmp(p, "mp3") == 0) {
-			return 1;
-		}
-		if (stricmp(p, "mpa") == 0) {
-			return 1;
-		}
-		if (stricmp(p, "mpeg") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, mp3_exts);
 }
 
 static struct music_ops mp3_ops = {
@@ -817,6 +862,7 @@ static struct music_ops mp3_ops = {
 	.resume = mp3_resume,
 	.get_info = mp3_get_info,
 	.probe = mp3_probe,
+	.exts = mp3_exts,
 	.next = NULL,
 };
 
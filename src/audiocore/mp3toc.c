@@ -0,0 +1,268 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pspkernel.h>
+#include "config.h"
+#include "common/utils.h"
+#include "strsafe.h"
+#include "bookmark.h"
+#include "scene.h"
+#include "mp3info.h"
+#include "mp3toc.h"
+#include "dbg.h"
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+#ifdef ENABLE_MP3
+
+#define MP3TOC_MAGIC 0x434f5433
+#define MP3TOC_VERSION 1
+
+/** ɨ߳ȼ, ߳ */
+#define MP3TOC_THREAD_PRIORITY 0x40
+
+typedef struct
+{
+	u32 magic;
+	u32 version;
+	SceOff size;
+	ScePspDateTime mtime;
+	u32 frames;
+	u32 toc_step;
+	u32 toc_count;
+	char path[PATH_MAX];
+} t_mp3toc_header;
+
+static SceUID scan_thread = -1;
+static volatile bool scan_cancel = false;
+static volatile bool scan_done = false;
+static char scan_path[PATH_MAX];
+static struct MP3Info scan_info;
+
+static void mp3toc_dir(char *path, size_t size)
+{
+	snprintf_s(path, size, "%smp3toc", scene_appdir());
+}
+
+static void mp3toc_path(const char *mp3file, char *path, size_t size)
+{
+	snprintf_s(path, size, "%smp3toc/%08X.toc", scene_appdir(), (unsigned) bookmark_encode(mp3file));
+}
+
+int mp3toc_load(const char *path, struct MP3Info *info)
+{
+	char tocpath[PATH_MAX];
+	SceIoStat sta, tocsta;
+	t_mp3toc_header *hdr;
+	SceUID fd;
+	u8 *buf;
+	u32 size, tocsize;
+
+	if (info->spf == 0 || info->sample_freq == 0)
+		return -1;
+
+	memset(&sta, 0, sizeof(sta));
+	memset(&tocsta, 0, sizeof(tocsta));
+	mp3toc_path(path, tocpath, sizeof(tocpath));
+
+	if (sceIoGetstat(path, &sta) < 0 || sceIoGetstat(tocpath, &tocsta) < 0)
+		return -1;
+
+	size = tocsta.st_size;
+
+	if (size <= sizeof(*hdr))
+		return -1;
+
+	fd = sceIoOpen(tocpath, PSP_O_RDONLY, 0777);
+
+	if (fd < 0)
+		return -1;
+
+	buf = malloc(size);
+
+	// ļͷ붨λһζ
+	if (buf == NULL || sceIoRead(fd, buf, size) != size) {
+		free(buf);
+		sceIoClose(fd);
+		return -1;
+	}
+
+	sceIoClose(fd);
+	hdr = (t_mp3toc_header *) buf;
+	tocsize = hdr->toc_count * sizeof(u32);
+
+	if (hdr->magic != MP3TOC_MAGIC || hdr->version != MP3TOC_VERSION
+		|| hdr->size != sta.st_size || memcmp(&hdr->mtime, &sta.st_mtime, sizeof(hdr->mtime)) != 0
+		|| strcmp(hdr->path, path) != 0 || hdr->frames == 0 || hdr->toc_step == 0
+		|| hdr->toc_count != (hdr->frames + hdr->toc_step - 1) / hdr->toc_step || size != sizeof(*hdr) + tocsize) {
+		free(buf);
+		return -1;
+	}
+
+	free_mp3_info(info);
+	info->frames = hdr->frames;
+	info->toc_step = hdr->toc_step;
+	info->toc_count = hdr->toc_count;
+	memmove(buf, buf + sizeof(*hdr), tocsize);
+	info->frameoff = safe_realloc(buf, tocsize);
+
+	if (info->frameoff == NULL)
+		info->toc_count = 0;
+
+	info->duration = 1.0 * info->spf * info->frames / info->sample_freq;
+	info->average_bitrate = (double) sta.st_size * 8 / info->duration;
+
+	dbg_printf(d, "%s: %u entries loaded for %s", __func__, (unsigned) info->toc_count, path);
+
+	return 0;
+}
+
+int mp3toc_save(const char *path, const struct MP3Info *info)
+{
+	char tocpath[PATH_MAX];
+	t_mp3toc_header hdr;
+	SceIoStat sta;
+	SceUID fd;
+	u32 tocsize;
+	bool ok;
+
+	if (info->frameoff == NULL || info->toc_count == 0)
+		return -1;
+
+	memset(&sta, 0, sizeof(sta));
+
+	if (sceIoGetstat(path, &sta) < 0)
+		return -1;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = MP3TOC_MAGIC;
+	hdr.version = MP3TOC_VERSION;
+	hdr.size = sta.st_size;
+	hdr.mtime = sta.st_mtime;
+	hdr.frames = info->frames;
+	hdr.toc_step = info->toc_step;
+	hdr.toc_count = info->toc_count;
+	STRCPY_S(hdr.path, path);
+
+	mp3toc_dir(tocpath, sizeof(tocpath));
+	sceIoMkdir(tocpath, 0777);
+	mp3toc_path(path, tocpath, sizeof(tocpath));
+
+	fd = sceIoOpen(tocpath, PSP_O_WRONLY | PSP_O_CREAT | PSP_O_TRUNC, 0777);
+
+	if (fd < 0)
+		return -1;
+
+	tocsize = info->toc_count * sizeof(u32);
+	ok = sceIoWrite(fd, &hdr, sizeof(hdr)) == sizeof(hdr);
+	ok = ok && sceIoWrite(fd, info->frameoff, tocsize) == tocsize;
+	sceIoClose(fd);
+
+	if (!ok) {
+		sceIoRemove(tocpath);
+		return -1;
+	}
+
+	dbg_printf(d, "%s: %u entries saved for %s", __func__, (unsigned) info->toc_count, path);
+
+	return 0;
+}
+
+static int mp3toc_thread(SceSize args, void *argp)
+{
+	mp3_reader_data data;
+
+	data.r = buffered_reader_open(scan_path, BUFFERED_READER_BUFFER_SIZE, 1);
+
+	if (data.r == NULL)
+		return 0;
+
+	data.size = buffered_reader_length(data.r);
+	memset(&scan_info, 0, sizeof(scan_info));
+
+	if (mp3_build_toc(&scan_info, &data, MP3_TOC_STEP, &scan_cancel) >= 0 && scan_info.frames > 0) {
+		mp3toc_save(scan_path, &scan_info);
+		scan_done = true;
+	} else {
+		free_mp3_info(&scan_info);
+	}
+
+	buffered_reader_close(data.r);
+
+	return 0;
+}
+
+int mp3toc_scan_start(const char *path)
+{
+	mp3toc_scan_stop();
+
+	STRCPY_S(scan_path, path);
+	scan_cancel = scan_done = false;
+	scan_thread = sceKernelCreateThread("MP3 TOC Thread", mp3toc_thread, MP3TOC_THREAD_PRIORITY, 0x4000, 0, NULL);
+
+	if (scan_thread < 0) {
+		scan_thread = -1;
+		return -1;
+	}
+
+	sceKernelStartThread(scan_thread, 0, NULL);
+
+	return 0;
+}
+
+bool mp3toc_scan_fetch(struct MP3Info *info)
+{
+	if (!scan_done)
+		return false;
+
+	scan_done = false;
+	free_mp3_info(info);
+	info->frames = scan_info.frames;
+	info->duration = scan_info.duration;
+	info->average_bitrate = scan_info.average_bitrate;
+	info->frameoff = scan_info.frameoff;
+	info->toc_step = scan_info.toc_step;
+	info->toc_count = scan_info.toc_count;
+	scan_info.frameoff = NULL;
+	scan_info.toc_count = 0;
+
+	dbg_printf(d, "%s: %u frames, %u entries", __func__, (unsigned) info->frames, (unsigned) info->toc_count);
+
+	return true;
+}
+
+void mp3toc_scan_stop(void)
+{
+	if (scan_thread >= 0) {
+		scan_cancel = true;
+		sceKernelWaitThreadEnd(scan_thread, NULL);
+		sceKernelDeleteThread(scan_thread);
+		scan_thread = -1;
+	}
+
+	scan_done = false;
+	free_mp3_info(&scan_info);
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef MP3TOC_H
+#define MP3TOC_H
+
+#include "mp3info.h"
+
+/**
+ * 뻺MP3λ
+ *
+ * @note 汣ڳĿ¼µmp3toc/, ļС޸ʱУ
+ * @note infoеĲʺÿ֡read_mp3_infoõ
+ *
+ * @param path MP3ļ·
+ * @param info MP3ļϢ, ɹʱ滻֡, ʱ붨λ
+ *
+ * @return ɹ0, ûЧ淵-1
+ */
+extern int mp3toc_load(const char *path, struct MP3Info *info);
+
+/**
+ * MP3λ
+ *
+ * @param path MP3ļ·
+ * @param info жλMP3ļϢ
+ *
+ * @return ɹ0
+ */
+extern int mp3toc_save(const char *path, const struct MP3Info *info);
+
+/**
+ * ں̨߳ɨMP3ļλ
+ *
+ * @note ɺλᱻ浽
+ *
+ * @param path MP3ļ·
+ *
+ * @return ɹ0
+ */
+extern int mp3toc_scan_start(const char *path);
+
+/**
+ * ȡų́ɨĽ
+ *
+ * @param info MP3ļϢ, ɨʱ滻֡, ʱ붨λ
+ *
+ * @return ɨɷtrue
+ */
+extern bool mp3toc_scan_fetch(struct MP3Info *info);
+
+/**
+ * ֹ̨ɨ貢ͷԴ
+ */
+extern void mp3toc_scan_stop(void);
+
+#endif
@@ -27,6 +27,7 @@
 #include "ssv.h"
 #include "scene.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "musicmgr.h"
 #include "musicdrv.h"
 #include "strsafe.h"
@@ -61,65 +62,6 @@ static unsigned g_buff_sample_size;
  */
 static int g_buff_sample_start;
 
-#ifdef MPC_FIXED_POINT
-static int shift_signed(MPC_SAMPLE_FORMAT val, int shift)
-{
-	if (shift > 0)
-		val <<= shift;
-	else if (shift < 0)
-		val >>= -shift;
-	return (int) val;
-}
-#endif
-
-/**
- * ݵ
- *
- * @note ĸʽΪ˫16λ
- *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param samples 
- * @param channels 
- * 
- * @return ƽַ
- */
-static u16 *copy_to_sndbuf(u16 *buf, MPC_SAMPLE_FORMAT * srcbuf, int frames, int channels)
-{
-	unsigned n;
-	unsigned bps = 16;
-	u16 *p = buf;
-	int clip_min = -1 << (bps - 1), clip_max = (1 << (bps - 1)) - 1;
-#ifndef MPC_FIXED_POINT
-	int float_scale = 1 << (bps - 1);
-#endif
-
-	if (frames <= 0)
-		return buf;
-
-	for (n = 0; n < frames * channels; n++) {
-		int val;
-
-#ifdef MPC_FIXED_POINT
-		val = shift_signed(srcbuf[n], bps - MPC_FIXED_POINT_SCALE_SHIFT);
-#else
-		val = (int) (srcbuf[n] * float_scale);
-#endif
-		if (val < clip_min)
-			val = clip_min;
-		else if (val > clip_max)
-			val = clip_max;
-		if (channels == 2)
-			*p++ = val;
-		else if (channels == 1) {
-			*p++ = val;
-			*p++ = val;
-		}
-	}
-
-	return p;
-}
-
 static int handle_seek(void)
 {
 	if (g_status == ST_FFORWARD) {
@@ -183,7 +125,12 @@ static int mpc_audiocallback(void *buf, unsigned int snd_buf_sample_size, void *
 	while (snd_buf_sample_size != 0) {
 		avail_sample = g_buff_sample_size - g_buff_sample_start;
 		copy_sample = min(avail_sample, snd_buf_sample_size);
-		audio_buf = copy_to_sndbuf(audio_buf, &g_buff[g_buff_sample_start * g_info.channels], copy_sample, g_info.channels);
+#ifdef MPC_FIXED_POINT
+		pcm_s32_to_stereo(audio_buf, &g_buff[g_buff_sample_start * g_info.channels], copy_sample, g_info.channels, MPC_FIXED_POINT_SCALE_SHIFT - 16);
+#else
+		pcm_float_to_stereo(audio_buf, &g_buff[g_buff_sample_start * g_info.channels], copy_sample, g_info.channels);
+#endif
+		audio_buf += copy_sample * 2;
 		g_buff_sample_start += copy_sample;
 		snd_buf_sample_size -= copy_sample;
 		incr = (double) (copy_sample) / g_info.sample_freq;
@@ -511,6 +458,10 @@ static int mpc_get_info(struct music_info *pinfo)
 	return generic_get_info(pinfo);
 }
 
+static const char *mpc_exts[] = {
+	"mpc", "mp+", "mpp", NULL
+};
+
 /**
  * ǷΪMPCļĿǰֻļ׺
  *
@@ -520,23 +471,7 @@ static int mpc_get_info(struct music_info *pinfo)
  */
 static int mpc_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "mpc") == 0) {
-			return 1;
-		}
-		if (stricmp(p, "mp+") == 0) {
-			return 1;
-		}
-		if (stricmp(p, "mpp") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, mpc_exts);
 }
 
 static int mpc_set_opt(const char *unused, const char *values)
@@ -584,6 +519,7 @@ static struct music_ops mpc_ops = {
 	.resume = mpc_resume,
 	.get_info = mpc_get_info,
 	.probe = mpc_probe,
+	.exts = mpc_exts,
 	.next = NULL
 };
 
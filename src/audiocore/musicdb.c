@@ -0,0 +1,678 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pspkernel.h>
+#include "config.h"
+#include "common/utils.h"
+#include "strsafe.h"
+#include "hash.h"
+#include "thread_lock.h"
+#include "scene.h"
+#include "musicdrv.h"
+#include "musicinfo.h"
+#include "musicdb.h"
+#include "dbg.h"
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+#define MUSICDB_MAGIC 0x42444d58
+#define MUSICDB_VERSION 1
+
+/** ·ַÿС */
+#define MUSICDB_POOL_SIZE (16 * 1024)
+
+#define MUSICDB_ENTRY_STEP 256
+
+/** ɨ߳ȼ, ߳ */
+#define MUSICDB_THREAD_PRIORITY 0x40
+
+/** ɨ߳ÿôĿһ */
+#define MUSICDB_SAVE_INTERVAL 64
+
+typedef struct
+{
+	u32 magic;
+	u32 version;
+	u32 count;
+} t_musicdb_header;
+
+/** ļеĿ, pathlenֽڵ·(β0) */
+typedef struct
+{
+	SceOff size;
+	ScePspDateTime mtime;
+	s32 mp3encode;
+	s32 apetagorder;
+	t_musicdb_info info;
+	u32 pathlen;
+} t_musicdb_record;
+
+typedef struct
+{
+	t_musicdb_record rec;
+	const char *spath;
+} t_musicdb_entry;
+
+typedef struct _musicdb_pool
+{
+	struct _musicdb_pool *next;
+	size_t used;
+	char data[MUSICDB_POOL_SIZE];
+} t_musicdb_pool;
+
+typedef struct _musicdb_scan_item
+{
+	struct _musicdb_scan_item *next;
+	char spath[1];
+} t_musicdb_scan_item;
+
+static struct psp_mutex_t musicdb_l;
+
+/** ɨ̶߳߳ᱣ, ֤ͬһʱֻһдmusic.db */
+static struct psp_mutex_t musicdb_save_l;
+static t_musicdb_entry *entries = NULL;
+static size_t entry_cnt = 0, entry_cap = 0;
+static struct hash_control *entry_hash = NULL;
+static t_musicdb_pool *pool = NULL;
+static bool dirty = false;
+
+static t_musicdb_scan_item *scan_head = NULL, *scan_tail = NULL;
+static SceUID scan_thread = -1;
+static bool scan_running = false;
+static volatile bool scan_cancel = false;
+
+static void musicdb_path(char *path, size_t size)
+{
+	snprintf_s(path, size, "%smusic.db", scene_appdir());
+}
+
+static char *pool_strdup(const char *s)
+{
+	size_t len = strlen(s) + 1;
+	char *p;
+
+	if (len > MUSICDB_POOL_SIZE)
+		return NULL;
+
+	if (pool == NULL || pool->used + len > MUSICDB_POOL_SIZE) {
+		t_musicdb_pool *n = malloc(sizeof(*n));
+
+		if (n == NULL)
+			return NULL;
+
+		n->next = pool;
+		n->used = 0;
+		pool = n;
+	}
+
+	p = &pool->data[pool->used];
+	memcpy(p, s, len);
+	pool->used += len;
+
+	return p;
+}
+
+static void free_db(void)
+{
+	while (pool != NULL) {
+		t_musicdb_pool *n = pool->next;
+
+		free(pool);
+		pool = n;
+	}
+
+	if (entry_hash != NULL) {
+		hash_die(entry_hash);
+		entry_hash = NULL;
+	}
+
+	free(entries);
+	entries = NULL;
+	entry_cnt = entry_cap = 0;
+	dirty = false;
+}
+
+static t_musicdb_entry *find_entry(const char *spath)
+{
+	size_t idx;
+
+	if (entry_hash == NULL)
+		return NULL;
+
+	idx = (size_t) hash_find(entry_hash, spath);
+
+	return idx != 0 ? &entries[idx - 1] : NULL;
+}
+
+static t_musicdb_entry *add_entry(const char *spath)
+{
+	t_musicdb_entry *e;
+
+	if (entry_hash == NULL) {
+		entry_hash = hash_new();
+
+		if (entry_hash == NULL)
+			return NULL;
+	}
+
+	if (entry_cnt >= entry_cap) {
+		t_musicdb_entry *p = safe_realloc(entries, sizeof(*entries) * (entry_cap + MUSICDB_ENTRY_STEP));
+
+		if (p == NULL)
+			return NULL;
+
+		entries = p;
+		entry_cap += MUSICDB_ENTRY_STEP;
+	}
+
+	e = &entries[entry_cnt];
+	memset(e, 0, sizeof(*e));
+	e->spath = pool_strdup(spath);
+
+	if (e->spath == NULL || hash_insert(entry_hash, e->spath, (PTR) (entry_cnt + 1)) != NULL)
+		return NULL;
+
+	e->rec.pathlen = strlen(spath) + 1;
+	entry_cnt++;
+
+	return e;
+}
+
+static bool is_same_file(const t_musicdb_entry * e, const SceIoStat * sta)
+{
+	return e->rec.size == sta->st_size && memcmp(&e->rec.mtime, &sta->st_mtime, sizeof(e->rec.mtime)) == 0;
+}
+
+static bool is_tag_valid(const t_musicdb_entry * e)
+{
+	return (e->rec.info.flags & MUSICDB_TAG) && e->rec.mp3encode == config.mp3encode && e->rec.apetagorder == config.apetagorder;
+}
+
+/**
+ * ȡļǰ״̬һµĿ, ûлѹʱ½
+ */
+static t_musicdb_entry *get_entry(const char *spath, const SceIoStat * sta)
+{
+	t_musicdb_entry *e = find_entry(spath);
+
+	if (e == NULL)
+		e = add_entry(spath);
+
+	if (e == NULL)
+		return NULL;
+
+	if (!is_same_file(e, sta)) {
+		memset(&e->rec.info, 0, sizeof(e->rec.info));
+		e->rec.size = sta->st_size;
+		e->rec.mtime = sta->st_mtime;
+	}
+
+	return e;
+}
+
+static void set_tag(t_musicdb_entry * e, const MusicInfo * music_info, bool has_lyric)
+{
+	e->rec.info.tag = music_info->tag;
+	e->rec.info.enc_delay = music_info->enc_delay;
+	e->rec.info.enc_padding = music_info->enc_padding;
+	e->rec.info.flags |= MUSICDB_TAG;
+
+	if (has_lyric)
+		e->rec.info.flags |= MUSICDB_LYRIC;
+	else
+		e->rec.info.flags &= ~MUSICDB_LYRIC;
+
+	e->rec.mp3encode = config.mp3encode;
+	e->rec.apetagorder = config.apetagorder;
+	dirty = true;
+}
+
+int musicdb_init(void)
+{
+	char path[PATH_MAX];
+	t_musicdb_header hdr;
+	SceIoStat sta;
+	SceUID fd;
+	u8 *buf;
+	u32 size, pos, i;
+
+	xr_lock(&musicdb_l);
+	free_db();
+	musicdb_path(path, sizeof(path));
+	memset(&sta, 0, sizeof(sta));
+
+	if (sceIoGetstat(path, &sta) < 0 || sta.st_size <= sizeof(hdr)) {
+		xr_unlock(&musicdb_l);
+		return -1;
+	}
+
+	size = sta.st_size;
+	fd = sceIoOpen(path, PSP_O_RDONLY, 0777);
+
+	if (fd < 0) {
+		xr_unlock(&musicdb_l);
+		return -1;
+	}
+
+	buf = malloc(size);
+
+	// ֿһζ
+	if (buf == NULL || sceIoRead(fd, buf, size) != size) {
+		free(buf);
+		sceIoClose(fd);
+		xr_unlock(&musicdb_l);
+		return -1;
+	}
+
+	sceIoClose(fd);
+	memcpy(&hdr, buf, sizeof(hdr));
+
+	if (hdr.magic != MUSICDB_MAGIC || hdr.version != MUSICDB_VERSION) {
+		free(buf);
+		xr_unlock(&musicdb_l);
+		return -1;
+	}
+
+	pos = sizeof(hdr);
+
+	for (i = 0; i < hdr.count; ++i) {
+		t_musicdb_record rec;
+		const char *spath;
+		t_musicdb_entry *e;
+
+		if (pos + sizeof(rec) > size)
+			break;
+
+		// Ŀһ, ƺٷ
+		memcpy(&rec, buf + pos, sizeof(rec));
+		pos += sizeof(rec);
+
+		if (rec.pathlen < 2 || rec.pathlen > PATH_MAX || pos + rec.pathlen > size)
+			break;
+
+		spath = (const char *) buf + pos;
+		pos += rec.pathlen;
+
+		if (spath[rec.pathlen - 1] != '\0' || find_entry(spath) != NULL)
+			continue;
+
+		e = add_entry(spath);
+
+		if (e == NULL)
+			break;
+
+		e->rec = rec;
+	}
+
+	free(buf);
+	dirty = false;
+	dbg_printf(d, "%s: %u entries loaded", __func__, (unsigned) entry_cnt);
+	xr_unlock(&musicdb_l);
+
+	return 0;
+}
+
+int musicdb_save(void)
+{
+	char path[PATH_MAX];
+	t_musicdb_header hdr;
+	SceUID fd;
+	u8 *buf;
+	u32 size, pos, i;
+	bool ok;
+
+	xr_lock(&musicdb_save_l);
+	xr_lock(&musicdb_l);
+
+	if (!dirty) {
+		xr_unlock(&musicdb_l);
+		xr_unlock(&musicdb_save_l);
+		return 0;
+	}
+
+	size = sizeof(hdr);
+
+	for (i = 0; i < entry_cnt; ++i) {
+		size += sizeof(t_musicdb_record) + entries[i].rec.pathlen;
+	}
+
+	buf = malloc(size);
+
+	if (buf == NULL) {
+		xr_unlock(&musicdb_l);
+		xr_unlock(&musicdb_save_l);
+		return -1;
+	}
+
+	hdr.magic = MUSICDB_MAGIC;
+	hdr.version = MUSICDB_VERSION;
+	hdr.count = entry_cnt;
+	memcpy(buf, &hdr, sizeof(hdr));
+	pos = sizeof(hdr);
+
+	for (i = 0; i < entry_cnt; ++i) {
+		memcpy(buf + pos, &entries[i].rec, sizeof(t_musicdb_record));
+		pos += sizeof(t_musicdb_record);
+		memcpy(buf + pos, entries[i].spath, entries[i].rec.pathlen);
+		pos += entries[i].rec.pathlen;
+	}
+
+	// дڼ޸Ļλdirty, ´αд
+	dirty = false;
+	xr_unlock(&musicdb_l);
+
+	musicdb_path(path, sizeof(path));
+	fd = sceIoOpen(path, PSP_O_WRONLY | PSP_O_CREAT | PSP_O_TRUNC, 0777);
+	ok = fd >= 0;
+
+	if (ok) {
+		ok = sceIoWrite(fd, buf, size) == size;
+		sceIoClose(fd);
+
+		if (!ok)
+			sceIoRemove(path);
+	}
+
+	free(buf);
+
+	if (!ok) {
+		xr_lock(&musicdb_l);
+		dirty = true;
+		xr_unlock(&musicdb_l);
+		xr_unlock(&musicdb_save_l);
+		return -1;
+	}
+
+	xr_unlock(&musicdb_save_l);
+	dbg_printf(d, "%s: %u entries saved", __func__, (unsigned) hdr.count);
+
+	return 0;
+}
+
+void musicdb_free(void)
+{
+	xr_lock(&musicdb_l);
+	free_db();
+	xr_unlock(&musicdb_l);
+}
+
+int musicdb_get(const char *spath, bool check, t_musicdb_info * info)
+{
+	t_musicdb_entry *e;
+	SceIoStat sta;
+
+	if (spath == NULL || info == NULL)
+		return -1;
+
+	memset(&sta, 0, sizeof(sta));
+
+	if (check && sceIoGetstat(spath, &sta) < 0)
+		return -1;
+
+	xr_lock(&musicdb_l);
+	e = find_entry(spath);
+
+	if (e == NULL || (check && !is_same_file(e, &sta))) {
+		xr_unlock(&musicdb_l);
+		return -1;
+	}
+
+	*info = e->rec.info;
+
+	if (!is_tag_valid(e))
+		info->flags &= ~(MUSICDB_TAG | MUSICDB_LYRIC);
+
+	xr_unlock(&musicdb_l);
+
+	return 0;
+}
+
+int musicdb_put_tag(const char *spath, const MusicInfo * music_info, bool has_lyric)
+{
+	t_musicdb_entry *e;
+	SceIoStat sta;
+
+	if (spath == NULL || music_info == NULL)
+		return -1;
+
+	memset(&sta, 0, sizeof(sta));
+
+	if (sceIoGetstat(spath, &sta) < 0)
+		return -1;
+
+	xr_lock(&musicdb_l);
+	e = get_entry(spath, &sta);
+
+	if (e != NULL)
+		set_tag(e, music_info, has_lyric);
+
+	xr_unlock(&musicdb_l);
+
+	return e != NULL ? 0 : -1;
+}
+
+int musicdb_put_stream(const char *spath, const char *codec, const struct music_info *info)
+{
+	t_musicdb_entry *e;
+	SceIoStat sta;
+
+	if (spath == NULL || info == NULL)
+		return -1;
+
+	memset(&sta, 0, sizeof(sta));
+
+	if (sceIoGetstat(spath, &sta) < 0)
+		return -1;
+
+	xr_lock(&musicdb_l);
+	e = get_entry(spath, &sta);
+
+	if (e == NULL) {
+		xr_unlock(&musicdb_l);
+		return -1;
+	}
+
+	e->rec.info.duration = info->duration;
+	e->rec.info.sample_freq = info->freq;
+	STRCPY_S(e->rec.info.codec, codec != NULL ? codec : "");
+	e->rec.info.flags |= MUSICDB_STREAM;
+
+	// Դǩĸʽ(FLAC, OGG)Ϊ׼, UCSֽڿΪ0
+	if (info->title[0] != '\0' || info->title[1] != '\0') {
+		e->rec.info.tag.encode = info->encode;
+		memcpy(e->rec.info.tag.title, info->title, sizeof(e->rec.info.tag.title));
+		memcpy(e->rec.info.tag.artist, info->artist, sizeof(e->rec.info.tag.artist));
+		memcpy(e->rec.info.tag.album, info->album, sizeof(e->rec.info.tag.album));
+	}
+
+	dirty = true;
+	xr_unlock(&musicdb_l);
+
+	return 0;
+}
+
+/**
+ * ɨһļ
+ *
+ * @return Ŀ1, ĿȻЧ0, ʧܷ-1
+ */
+static int scan_file(const char *spath)
+{
+	MusicInfo music_info;
+	t_musicdb_entry *e;
+	struct music_ops *drv;
+	SceIoStat sta;
+	bool has_lyric = false;
+	bool fresh;
+
+	memset(&sta, 0, sizeof(sta));
+
+	if (sceIoGetstat(spath, &sta) < 0)
+		return -1;
+
+	xr_lock(&musicdb_l);
+	e = find_entry(spath);
+	fresh = e != NULL && is_same_file(e, &sta) && is_tag_valid(e);
+	xr_unlock(&musicdb_l);
+
+	if (fresh)
+		return 0;
+
+	memset(&music_info, 0, sizeof(music_info));
+	music_info.filesize = sta.st_size;
+
+	if (generic_readtag_scan(&music_info, spath, &has_lyric) < 0)
+		return -1;
+
+	drv = musicdrv_chk_file(spath);
+
+	xr_lock(&musicdb_l);
+	e = get_entry(spath, &sta);
+
+	if (e != NULL) {
+		set_tag(e, &music_info, has_lyric);
+
+		if (drv != NULL && e->rec.info.codec[0] == '\0')
+			STRCPY_S(e->rec.info.codec, drv->name);
+	}
+
+	xr_unlock(&musicdb_l);
+
+	return e != NULL ? 1 : -1;
+}
+
+static int musicdb_scan_thread(SceSize args, void *argp)
+{
+	u32 updated = 0;
+
+	while (!scan_cancel) {
+		t_musicdb_scan_item *item;
+
+		xr_lock(&musicdb_l);
+		item = scan_head;
+
+		if (item != NULL) {
+			scan_head = item->next;
+
+			if (scan_head == NULL)
+				scan_tail = NULL;
+		} else {
+			scan_running = false;
+		}
+
+		xr_unlock(&musicdb_l);
+
+		if (item == NULL)
+			break;
+
+		if (scan_file(item->spath) > 0 && ++updated >= MUSICDB_SAVE_INTERVAL) {
+			musicdb_save();
+			updated = 0;
+		}
+
+		free(item);
+	}
+
+	musicdb_save();
+
+	return 0;
+}
+
+int musicdb_scan_add(const char *spath)
+{
+	t_musicdb_scan_item *item;
+	size_t len;
+	bool start;
+
+	if (spath == NULL)
+		return -1;
+
+	len = strlen(spath);
+	item = malloc(sizeof(*item) + len);
+
+	if (item == NULL)
+		return -1;
+
+	item->next = NULL;
+	memcpy(item->spath, spath, len + 1);
+
+	xr_lock(&musicdb_l);
+
+	if (scan_tail != NULL)
+		scan_tail->next = item;
+	else
+		scan_head = item;
+
+	scan_tail = item;
+	start = !scan_running;
+	scan_running = true;
+	xr_unlock(&musicdb_l);
+
+	if (!start)
+		return 0;
+
+	// һɨ߳ȡն, ˳
+	if (scan_thread >= 0) {
+		sceKernelWaitThreadEnd(scan_thread, NULL);
+		sceKernelDeleteThread(scan_thread);
+	}
+
+	scan_cancel = false;
+	scan_thread = sceKernelCreateThread("Music DB Thread", musicdb_scan_thread, MUSICDB_THREAD_PRIORITY, 0x4000, 0, NULL);
+
+	if (scan_thread < 0) {
+		scan_thread = -1;
+		xr_lock(&musicdb_l);
+		scan_running = false;
+		xr_unlock(&musicdb_l);
+		return -1;
+	}
+
+	sceKernelStartThread(scan_thread, 0, NULL);
+
+	return 0;
+}
+
+void musicdb_scan_stop(void)
+{
+	if (scan_thread >= 0) {
+		scan_cancel = true;
+		sceKernelWaitThreadEnd(scan_thread, NULL);
+		sceKernelDeleteThread(scan_thread);
+		scan_thread = -1;
+	}
+
+	xr_lock(&musicdb_l);
+
+	while (scan_head != NULL) {
+		t_musicdb_scan_item *n = scan_head->next;
+
+		free(scan_head);
+		scan_head = n;
+	}
+
+	scan_tail = NULL;
+	scan_running = false;
+	xr_unlock(&musicdb_l);
+}
@@ -0,0 +1,123 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef MUSICDB_H
+#define MUSICDB_H
+
+#include "musicinfo.h"
+
+struct music_info;
+
+/** ĿеıǩѶȡ */
+#define MUSICDB_TAG 0x1
+/** Ŀеʱ, ɲȡ */
+#define MUSICDB_STREAM 0x2
+/** ļǶ, ʱضǩ */
+#define MUSICDB_LYRIC 0x4
+
+typedef struct
+{
+	u32 flags;
+	MusicTagInfo tag;
+	int enc_delay;
+	int enc_padding;
+	float duration;
+	int sample_freq;
+	/**  */
+	char codec[16];
+} t_musicdb_info;
+
+/**
+ * ֿ
+ *
+ * @note ֿⱣڳĿ¼µmusic.db, ·Ϊ, ļС޸ʱУ
+ *
+ * @return ɹ0, ûЧֿⷵ-1
+ */
+extern int musicdb_init(void);
+
+/**
+ * ֿ
+ *
+ * @note ûиĶʱʲôҲ
+ *
+ * @return ɹ0
+ */
+extern int musicdb_save(void);
+
+/**
+ * ͷֿ
+ */
+extern void musicdb_free(void);
+
+/**
+ * ѯļϢ
+ *
+ * @note ǩǰmp3encodeapetagorderöȡ, øıǩΪδȡ
+ *
+ * @param spath ļ·
+ * @param check ǷļС޸ʱУĿ, Ϊfalseʱļϵͳ
+ * @param info صϢ
+ *
+ * @return ɹ0, ûЧĿ-1
+ */
+extern int musicdb_get(const char *spath, bool check, t_musicdb_info * info);
+
+/**
+ * ¼ļıǩ
+ *
+ * @param spath ļ·
+ * @param music_info generic_readtagϢ
+ * @param has_lyric ǩǷи
+ *
+ * @return ɹ0
+ */
+extern int musicdb_put_tag(const char *spath, const MusicInfo * music_info, bool has_lyric);
+
+/**
+ * ¼ʱȡõļϢ
+ *
+ * @note infoеı, רΪʱһ¼
+ *
+ * @param spath ļ·
+ * @param codec 
+ * @param info صϢ, 뺬ʱ
+ *
+ * @return ɹ0
+ */
+extern int musicdb_put_stream(const char *spath, const char *codec, const struct music_info *info);
+
+/**
+ * ļ̨ɨ
+ *
+ * @note ɨ߳ȡǩֿ, ЧĿļֻļϢ
+ *
+ * @param spath ļ·
+ *
+ * @return ɹ0
+ */
+extern int musicdb_scan_add(const char *spath);
+
+/**
+ * ֹ̨ɨ貢ɨ
+ */
+extern void musicdb_scan_stop(void);
+
+#endif
@@ -24,9 +24,12 @@
 #include <string.h>
 #include <errno.h>
 #include <pspkernel.h>
+#include "common/datatype.h"
 #include "musicdrv.h"
 #include "genericplayer.h"
+#include "xaudiolib.h"
 #include "freq_lock.h"
+#include "common/utils.h"
 #ifdef DMALLOC
 #include "dmalloc.h"
 #endif
@@ -104,6 +107,39 @@ struct music_ops *musicdrv_chk_file(const char *name)
 	return NULL;
 }
 
+/**
+ * صһעnext
+ */
+struct music_ops *musicdrv_first(void)
+{
+	return music_drivers;
+}
+
+/**
+ * ļ׺Ƿĺ׺
+ *
+ * @param spath ļ
+ * @param exts ׺NULLβ
+ *
+ * @return ƥ䷵1򷵻0
+ */
+int musicdrv_has_ext(const char *spath, const char **exts)
+{
+	const char *p;
+
+	p = utils_fileext(spath);
+
+	if (p == NULL)
+		return 0;
+
+	for (; *exts != NULL; exts++) {
+		if (stricmp(p, *exts) == 0)
+			return 1;
+	}
+
+	return 0;
+}
+
 struct music_ops *get_musicdrv(const char *name)
 {
 	struct music_ops *tmp;
@@ -239,9 +275,15 @@ int musicdrv_get_info(struct music_info *info)
 		return -EINVAL;
 	if (cur_musicdrv == NULL)
 		return -EBUSY;
-	if (cur_musicdrv->get_info)
-		return cur_musicdrv->get_info(info);
-	else
+	if (cur_musicdrv->get_info) {
+		int ret = cur_musicdrv->get_info(info);
+
+		// ǽλ, ȥλδŵĲ, ʲͬ
+		if (ret == 0 && (info->type & MD_GET_CURTIME))
+			info->cur_time = max(info->cur_time - xAudioGetQueuedSeconds(), 0);
+
+		return ret;
+	} else
 		return -ENOSYS;
 }
 
@@ -278,64 +320,45 @@ bool opt_is_on(const char *str)
 
 int get_inst_bitrate(struct instant_bitrate *inst)
 {
-	size_t i;
-	int r = 0;
-
-	if (inst == NULL)
+	if (inst == NULL || inst->n == 0)
 		return 0;
 
-	if (inst->n == 0)
-		return 0;
-
-	for (i = 0; i < inst->n; ++i) {
-		r += inst->frames[i].framebits;
-	}
-
-	r /= inst->n;
-
-	return r;
+	return inst->sum_bits / inst->n;
 }
 
 float get_bitrate_second(struct instant_bitrate *inst)
 {
-	size_t i;
-	float r = 0;
-
 	if (inst == NULL)
 		return 0;
 
-	for (i = 0; i < inst->n; ++i) {
-		r += inst->frames[i].duration;
-	}
-
-	return r;
+	return inst->sum_duration;
 }
 
 void add_bitrate(struct instant_bitrate *inst, int frame_bits, double duration)
 {
+	struct instant_bitrate_frame *f;
+
 	if (inst == NULL)
 		return;
 
-	if (get_bitrate_second(inst) <= 1.000) {
-		if (inst->frames == NULL || inst->n >= inst->cap) {
-			struct instant_bitrate_frame *p = realloc(inst->frames, (inst->cap + 10) * sizeof(*inst->frames));
-
-			if (p == NULL)
-				return;
-
-			inst->frames = p;
-			inst->cap += 10;
-		}
-
-		inst->frames[inst->n].framebits = frame_bits;
-		inst->frames[inst->n].duration = duration;
+	// Window is full: drop the oldest frame
+	if (inst->n > 0 && (inst->sum_duration > 1.000 || inst->n >= INST_BITRATE_FRAMES)) {
+		f = &inst->frames[inst->head];
+		inst->sum_bits -= f->framebits;
+		inst->sum_duration -= f->duration;
+		inst->head = (inst->head + 1) % INST_BITRATE_FRAMES;
+		inst->n--;
 
-		inst->n++;
-	} else {
-		memmove(&inst->frames[0], &inst->frames[1], sizeof(*inst->frames) * (inst->n - 1));
-		inst->frames[inst->n - 1].framebits = frame_bits;
-		inst->frames[inst->n - 1].duration = duration;
+		if (inst->n == 0)
+			inst->sum_duration = 0;
 	}
+
+	f = &inst->frames[(inst->head + inst->n) % INST_BITRATE_FRAMES];
+	f->framebits = frame_bits;
+	f->duration = duration;
+	inst->sum_bits += f->framebits;
+	inst->sum_duration += f->duration;
+	inst->n++;
 }
 
 void free_bitrate(struct instant_bitrate *inst)
@@ -343,10 +366,5 @@ void free_bitrate(struct instant_bitrate *inst)
 	if (inst == NULL)
 		return;
 
-	if (inst->frames != NULL) {
-		free(inst->frames);
-		inst->frames = NULL;
-	}
-
 	memset(inst, 0, sizeof(*inst));
 }
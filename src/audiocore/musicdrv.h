@@ -97,6 +97,8 @@ extern "C"
 		int (*resume) (const char *spath, const char *lpath);
 		int (*end) (void);
 		int (*probe) (const char *spath);
+		/* ֵ֧ĺ׺NULLβ */
+		const char **exts;
 
 		struct music_ops *next;
 	};
@@ -119,6 +121,8 @@ extern "C"
 	int musicdrv_resume(const char *spath, const char *lpath);
 	int musicdrv_get_info(struct music_info *info);
 	struct music_ops *musicdrv_chk_file(const char *name);
+	struct music_ops *musicdrv_first(void);
+	int musicdrv_has_ext(const char *spath, const char **exts);
 
 	bool opt_is_on(const char *str);
 
@@ -128,10 +132,15 @@ extern "C"
 		float duration;
 	};
 
+/* Upper bound of frames kept in the one-second window */
+#define INST_BITRATE_FRAMES 256
+
 	struct instant_bitrate
 	{
-		size_t n, cap;
-		struct instant_bitrate_frame *frames;
+		size_t head, n;
+		u64 sum_bits;
+		double sum_duration;
+		struct instant_bitrate_frame frames[INST_BITRATE_FRAMES];
 	};
 
 	int get_inst_bitrate(struct instant_bitrate *inst);
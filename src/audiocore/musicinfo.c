@@ -19,6 +19,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <pspkernel.h>
 #include <stdint.h>
 #include <string.h>
@@ -29,6 +30,8 @@
 #include "charsets.h"
 #include "apetaglib/APETag.h"
 #include "buffer.h"
+#include "thread_lock.h"
+#include "musicdb.h"
 #include "dbg.h"
 #ifdef DMALLOC
 #include "dmalloc.h"
@@ -56,10 +59,28 @@ typedef struct
 	MusicTagInfo id3v1;
 	MusicTagInfo id3v2;
 	MusicTagInfo apetag;
+
+	/** ID3v2 TXXX֡еĸ */
+	buffer *lyric;
+	/** iTunSMPBע͸ıӳ */
+	int enc_delay;
+	int enc_padding;
 } MusicInfoInternalTag, *PMusicInfoInternalTag;
 
 buffer *tag_lyric = NULL;
 
+/**
+ * generic_readtag_preloadԤȶȡһǩ
+ */
+static struct
+{
+	char spath[PATH_MAX];
+	MusicInfo info;
+	buffer *lyric;
+} preload;
+
+static struct psp_mutex_t preload_l;
+
 static void id3v1_get_string(char *str, int str_size, const uint8_t * buf, int buf_size)
 {
 	int i, c;
@@ -133,8 +154,139 @@ static int big2little_endian(uint8_t * p, size_t n)
 	return 0;
 }
 
-static void id3v2_read_ttag(SceUID fd, int taglen, char *dst, int dstlen, MusicTagInfo * info)
+/**
+ * ǩʱĶȡڴС
+ */
+#define TAG_READER_SIZE (32 * 1024)
+
+/**
+ * ǩȡ
+ *
+ * @note ڴн֡, ÿֶεһsceIoRead
+ * @note ǩβĶȡʧ
+ */
+typedef struct
+{
+	SceUID fd;
+	/** buf[0]ļеƫ */
+	SceOff pos;
+	/** ǩβļеƫ */
+	SceOff end;
+	uint8_t *buf;
+	/** bufеЧֽ */
+	int size;
+	/** bufеĶȡλ */
+	int cur;
+} tag_reader;
+
+static int tag_reader_init(tag_reader * r, SceUID fd, SceOff pos, SceOff end)
+{
+	r->buf = memalign(64, TAG_READER_SIZE);
+
+	if (r->buf == NULL) {
+		return -1;
+	}
+
+	r->fd = fd;
+	r->pos = pos;
+	r->end = end;
+	r->size = r->cur = 0;
+
+	return 0;
+}
+
+static void tag_reader_free(tag_reader * r)
+{
+	free(r->buf);
+	r->buf = NULL;
+}
+
+static inline SceOff tag_reader_tell(const tag_reader * r)
+{
+	return r->pos + r->cur;
+}
+
+static void tag_reader_seek(tag_reader * r, SceOff off)
 {
+	if (off >= r->pos && off <= r->pos + r->size) {
+		r->cur = off - r->pos;
+	} else {
+		r->pos = off;
+		r->size = r->cur = 0;
+	}
+}
+
+static inline void tag_reader_skip(tag_reader * r, int n)
+{
+	tag_reader_seek(r, tag_reader_tell(r) + n);
+}
+
+/**
+ * ʹȡλnֽڻп
+ *
+ * @return ָЩֽڵָ, ǩβȡʱNULL
+ */
+static const uint8_t *tag_reader_peek(tag_reader * r, int n)
+{
+	int ret;
+
+	if (n < 0 || n > TAG_READER_SIZE || tag_reader_tell(r) + n > r->end) {
+		return NULL;
+	}
+
+	if (r->cur + n <= r->size) {
+		return r->buf + r->cur;
+	}
+
+	memmove(r->buf, r->buf + r->cur, r->size - r->cur);
+	r->pos += r->cur;
+	r->size -= r->cur;
+	r->cur = 0;
+
+	if (sceIoLseek(r->fd, r->pos + r->size, PSP_SEEK_SET) != r->pos + r->size) {
+		return NULL;
+	}
+
+	ret = sceIoRead(r->fd, r->buf + r->size, min(TAG_READER_SIZE - r->size, r->end - r->pos - r->size));
+
+	if (ret > 0) {
+		r->size += ret;
+	}
+
+	return r->size >= n ? r->buf : NULL;
+}
+
+static int tag_reader_read(tag_reader * r, void *dst, int n)
+{
+	const uint8_t *p;
+	SceOff off = tag_reader_tell(r);
+
+	if (n <= TAG_READER_SIZE) {
+		p = tag_reader_peek(r, n);
+
+		if (p == NULL) {
+			return -1;
+		}
+
+		memcpy(dst, p, n);
+		r->cur += n;
+
+		return n;
+	}
+
+	/* ȴڴ, ֱӶȡ */
+	if (n < 0 || off + n > r->end || sceIoLseek(r->fd, off, PSP_SEEK_SET) != off || sceIoRead(r->fd, dst, n) != n) {
+		return -1;
+	}
+
+	tag_reader_seek(r, off + n);
+
+	return n;
+}
+
+static void id3v2_read_ttag(tag_reader * r, int taglen, char *dst, int dstlen, MusicTagInfo * info)
+{
+	const uint8_t *buf;
 	int len;
 	uint8_t b;
 
@@ -146,7 +298,14 @@ static void id3v2_read_ttag(SceUID fd, int taglen, char *dst, int dstlen, MusicT
 	taglen--;					/* account for encoding type u8 */
 	dstlen--;					/* Leave space for zero terminator */
 
-	if (sceIoRead(fd, &b, sizeof(b)) != sizeof(b)) {
+	if (tag_reader_read(r, &b, sizeof(b)) != sizeof(b)) {
+		return;
+	}
+
+	/* ֻıǰdstlenֽ */
+	buf = tag_reader_peek(r, min(taglen, TAG_READER_SIZE));
+
+	if (buf == NULL) {
 		return;
 	}
 
@@ -154,22 +313,7 @@ static void id3v2_read_ttag(SceUID fd, int taglen, char *dst, int dstlen, MusicT
 			// TODO: non-standard hack...
 		case 0:				/* ISO-8859-1 (0 - 255 maps directly into unicode) */
 			info->encode = config.mp3encode;
-			{
-				char *p = malloc(taglen);
-
-				if (p == NULL) {
-					return;
-				}
-
-				if (sceIoRead(fd, p, taglen) != taglen) {
-					free(p);
-					return;
-				}
-
-				strncpy_s(dst, dstlen, p, taglen);
-				free(p);
-			}
-
+			strncpy_s(dst, dstlen, (const char *) buf, min(taglen, TAG_READER_SIZE));
 			break;
 		case 1:
 			/*
@@ -177,114 +321,112 @@ static void id3v2_read_ttag(SceUID fd, int taglen, char *dst, int dstlen, MusicT
 			   strings in the same frame SHALL have the same byteorder.
 			   Terminated with $00 00.
 			 */
-			{
-				uint8_t *buf = malloc(taglen);
-
-				if (buf == NULL)
-					return;
-
-				if (sceIoRead(fd, buf, taglen) != taglen) {
-					free(buf);
-					return;
-				}
-
-				if (buf[0] != 0xff || buf[1] != 0xfe) {
-					free(buf);
-					return;
-				}
-
-				info->encode = conf_encode_gbk;
-				len = min(taglen - 2, dstlen - 1);
-				memcpy(dst, buf + 2, len);
-				dst[len] = 0;
-				charsets_ucs_conv((const u8 *) dst, len, (u8 *) dst, len);
-				free(buf);
-				break;
+			if (taglen < 2 || buf[0] != 0xff || buf[1] != 0xfe) {
+				return;
 			}
+
+			info->encode = conf_encode_gbk;
+			len = min(taglen - 2, dstlen - 1);
+			memcpy(dst, buf + 2, len);
+			dst[len] = 0;
+			charsets_ucs_conv((const u8 *) dst, len, (u8 *) dst, len);
+			break;
 		case 2:
 			/* UTF-16 (Big-Endian) */
-			{
-				uint8_t *buf = malloc(taglen);
-
-				if (buf == NULL)
-					return;
-
-				if (sceIoRead(fd, buf, taglen) != taglen) {
-					free(buf);
-					return;
-				}
-
-				if (big2little_endian(buf, taglen) != 0) {
-					free(buf);
-					return;
-				}
-
-				info->encode = conf_encode_gbk;
-				len = min(taglen, dstlen - 1);
-				memcpy(dst, buf, len);
-				dst[len] = 0;
-				charsets_ucs_conv((const u8 *) dst, len, (u8 *) dst, len);
-				free(buf);
-				break;
+			if ((taglen % 2) != 0) {
+				return;
 			}
+
+			info->encode = conf_encode_gbk;
+			len = min(taglen, dstlen - 1);
+			memcpy(dst, buf, len);
+			big2little_endian((uint8_t *) dst, len);
+			dst[len] = 0;
+			charsets_ucs_conv((const u8 *) dst, len, (u8 *) dst, len);
 			break;
 		case 3:				/* UTF-8 */
 			info->encode = conf_encode_utf8;
 			len = min(taglen, dstlen - 1);
-			if (sceIoRead(fd, dst, len) < 0) {
-				return;
-			}
+			memcpy(dst, buf, len);
 			dst[len] = 0;
 			break;
 	}
 }
 
-static unsigned int id3v2_get_size(SceUID fd, int len)
+/**
+ * iTunSMPBע: ʮƵ" 00000000 <ӳ> <> <> ..."
+ */
+static void id3v2_parse_smpb(MusicInfoInternalTag * tag_info, const char *p)
 {
-	int v = 0;
-	uint8_t b;
+	unsigned long v[3];
+	char *end;
+	int i;
 
-	while (len--) {
-		sceIoRead(fd, &b, sizeof(b));
-		v = (v << 8) + (b);
+	for (i = 0; i < 3; i++) {
+		v[i] = strtoul(p, &end, 16);
+
+		if (end == p)
+			return;
+
+		p = end;
 	}
 
-	return v;
+	tag_info->enc_delay = v[1];
+	tag_info->enc_padding = v[2];
 }
 
-static unsigned int get_be16(SceUID fd)
+/**
+ * ȡCOMM֡, iTunSMPB޷첥Ϣtag_infoΪע
+ */
+static void id3v2_read_comm(MusicInfoInternalTag * tag_info, tag_reader * r, int taglen)
 {
-	uint16_t val;
+	char buf[128];
+	const uint8_t *p;
+
+	/* , , "iTunSMPB\0", Ȼı */
+	if (taglen > 13 && taglen < sizeof(buf) && (p = tag_reader_peek(r, taglen)) != NULL) {
+		memcpy(buf, p, taglen);
+		buf[taglen] = '\0';
+
+		if ((buf[0] == 0 || buf[0] == 3) && !memcmp(buf + 4, "iTunSMPB", sizeof("iTunSMPB"))) {
+			id3v2_parse_smpb(tag_info, buf + 13);
+			return;
+		}
+	}
 
-	sceIoRead(fd, &val, sizeof(val));
-	val = ((val & 0xff) << 8) | (val >> 8);
-	return val;
+	id3v2_read_ttag(r, taglen, tag_info->id3v2.comment, sizeof(tag_info->id3v2.comment), &tag_info->id3v2);
 }
 
-static unsigned int get_be32(SceUID fd)
+static unsigned int id3v2_get_size(tag_reader * r, int len)
 {
-	uint32_t val;
+	const uint8_t *p = tag_reader_peek(r, len);
+	int v = 0;
+
+	if (p == NULL)
+		return 0;
+
+	r->cur += len;
+
+	while (len--) {
+		v = (v << 8) + *p++;
+	}
 
-	sceIoRead(fd, &val, sizeof(val));
-	val = LB_CONV(val);
-	return val;
+	return v;
 }
 
-static uint8_t get_byte(SceUID fd)
+static unsigned int get_be16(tag_reader * r)
 {
-	uint8_t val;
-
-	sceIoRead(fd, &val, sizeof(val));
-	return val;
+	return id3v2_get_size(r, 2);
 }
 
-static unsigned int get_be24(SceUID fd)
+static unsigned int get_be24(tag_reader * r)
 {
-	uint32_t val;
+	return id3v2_get_size(r, 3);
+}
 
-	val = get_be16(fd) << 8;
-	val |= get_byte(fd);
-	return val;
+static unsigned int get_be32(tag_reader * r)
+{
+	return id3v2_get_size(r, 4);
 }
 
 /** Support ID3 or Sony OpenMG ID3 */
@@ -298,7 +440,49 @@ static int id3v2_match(const uint8_t * buf)
 		buf[3] != 0xff && buf[4] != 0xff && (buf[6] & 0x80) == 0 && (buf[7] & 0x80) == 0 && (buf[8] & 0x80) == 0 && (buf[9] & 0x80) == 0;
 }
 
-static void id3v2_parse(MusicInfoInternalTag * tag_info, SceUID fd, int len, uint8_t version, uint8_t flags)
+static void id3v2_read_txxx(MusicInfoInternalTag * tag_info, tag_reader * r, int tlen)
+{
+	char desc[20], *p = desc;
+	uint8_t ch;
+
+	if (tag_info->lyric) {
+		buffer_free(tag_info->lyric);
+	}
+
+	tag_info->lyric = buffer_init();
+
+	tag_reader_skip(r, 1);
+	desc[0] = '\0';
+
+	// Acount for text encoding u8
+	tlen--;
+
+	while (tag_reader_read(r, &ch, 1) == 1 && p - desc < sizeof(desc) - 1 && ch != '\0') {
+		*p++ = ch;
+		tlen--;
+	}
+
+	tlen--;
+	*p = '\0';
+
+	if (!strcmp(desc, "Lyrics") && tlen > 0) {
+		char *p = malloc(tlen);
+
+		if (p == NULL) {
+			return;
+		}
+
+		if (tag_reader_read(r, p, tlen) != tlen) {
+			free(p);
+			return;
+		}
+
+		buffer_copy_string_len(tag_info->lyric, p, tlen);
+		free(p);
+	}
+}
+
+static void id3v2_parse(MusicInfoInternalTag * tag_info, tag_reader * r, int len, uint8_t version, uint8_t flags)
 {
 	int isv34, tlen;
 	uint32_t tag;
@@ -338,120 +522,92 @@ static void id3v2_parse(MusicInfoInternalTag * tag_info, SceUID fd, int len, uin
 #endif
 
 	if (isv34 && flags & 0x40) {	/* Extended header present, just skip over it */
-		sceIoLseek(fd, id3v2_get_size(fd, 4), PSP_SEEK_CUR);
+		tag_reader_skip(r, id3v2_get_size(r, 4));
 	}
 
 	while (len >= taghdrlen) {
 		if (isv34) {
-			tag = get_be32(fd);
-			tlen = id3v2_get_size(fd, 4);
-			get_be16(fd);		/* flags */
+			tag = get_be32(r);
+			tlen = id3v2_get_size(r, 4);
+			get_be16(r);		/* flags */
 		} else {
-			tag = get_be24(fd);
-			tlen = id3v2_get_size(fd, 3);
+			tag = get_be24(r);
+			tlen = id3v2_get_size(r, 3);
 		}
 		len -= taghdrlen + tlen;
 
 		if (len < 0)
 			break;
 
-		next = sceIoLseek(fd, 0, PSP_SEEK_CUR) + tlen;
+		next = tag_reader_tell(r) + tlen;
 
 		switch (tag) {
 			case MKBETAG('T', 'I', 'T', '2'):
 			case MKBETAG(0, 'T', 'T', '2'):
-				id3v2_read_ttag(fd, tlen, info->title, sizeof(info->title), info);
+				id3v2_read_ttag(r, tlen, info->title, sizeof(info->title), info);
 				break;
 			case MKBETAG('T', 'P', 'E', '1'):
 			case MKBETAG(0, 'T', 'P', '1'):
-				id3v2_read_ttag(fd, tlen, info->artist, sizeof(info->artist), info);
+				id3v2_read_ttag(r, tlen, info->artist, sizeof(info->artist), info);
 				break;
 			case MKBETAG('T', 'A', 'L', 'B'):
 			case MKBETAG(0, 'T', 'A', 'L'):
-				id3v2_read_ttag(fd, tlen, info->album, sizeof(info->album), info);
+				id3v2_read_ttag(r, tlen, info->album, sizeof(info->album), info);
 				break;
 			case MKBETAG('C', 'O', 'M', 'M'):
-				id3v2_read_ttag(fd, tlen, info->comment, sizeof(info->comment), info);
+				id3v2_read_comm(tag_info, r, tlen);
 				break;
 			case MKBETAG('T', 'X', 'X', 'X'):
-				{
-					char desc[20], *p = desc;
-					char ch;
-
-					if (tag_lyric) {
-						buffer_free(tag_lyric);
-					}
-
-					tag_lyric = buffer_init();
-
-					sceIoLseek(fd, 1, PSP_SEEK_CUR);
-					desc[0] = '\0';
-
-					// Acount for text encoding u8
-					tlen--;
-
-					while (sceIoRead(fd, &ch, 1) == 1 && p - desc < sizeof(desc) && ch != '\0') {
-						*p++ = ch;
-						tlen--;
-					}
-
-					tlen--;
-					*p = '\0';
-
-					if (!strcmp(desc, "Lyrics")) {
-						char *p = malloc(tlen);
-
-						if (p == NULL) {
-							return;
-						}
-
-						if (sceIoRead(fd, p, tlen) != tlen) {
-							free(p);
-							return;
-						}
-
-						buffer_copy_string_len(tag_lyric, p, tlen);
-						free(p);
-					}
-				}
+				id3v2_read_txxx(tag_info, r, tlen);
 				break;
 			case 0:
 				/* padding, skip to end */
-				sceIoLseek(fd, len, PSP_SEEK_CUR);
 				len = 0;
 				continue;
 		}
-		/* Skip to end of tag */
-		sceIoLseek(fd, next, PSP_SEEK_SET);
+		/* ֡β, ͼƬ֡ȡ */
+		tag_reader_seek(r, next);
 	}
 
 	tag_info->type |= ID3V2;
 
-	if (version == 4 && flags & 0x10)	/* Footer preset, always 10 bytes, skip over it */
-		sceIoLseek(fd, 10, PSP_SEEK_CUR);
 	return;
 
   error:
-	sceIoLseek(fd, len, PSP_SEEK_CUR);
+	UNUSED(reason);
 }
 
 static int read_id3v2_tag(MusicInfoInternalTag * tag, const MusicInfo * music_info, SceUID fd)
 {
+	tag_reader r;
 	uint8_t buf[ID3v2_HEADER_SIZE];
+	SceOff filesize = music_info->filesize;
 	int len;
 
-	if (sceIoRead(fd, buf, sizeof(buf)) != sizeof(buf)) {
+	/* ЩڵõļСǰȡǩ */
+	if (filesize == 0) {
+		filesize = sceIoLseek(fd, 0, PSP_SEEK_END);
+	}
+
+	// ǩͷ֡ͬһζȡж
+	if (tag_reader_init(&r, fd, 0, filesize) < 0) {
+		return -1;
+	}
+
+	if (tag_reader_read(&r, buf, sizeof(buf)) != sizeof(buf)) {
+		tag_reader_free(&r);
 		return -1;
 	}
 
 	if (id3v2_match(buf)) {
 		/* parse ID3v2 header */
 		len = ((buf[6] & 0x7f) << 21) | ((buf[7] & 0x7f) << 14) | ((buf[8] & 0x7f) << 7) | (buf[9] & 0x7f);
-		id3v2_parse(tag, fd, len, buf[3], buf[5]);
-	} else {
-		sceIoLseek(fd, 0, SEEK_SET);
+		r.end = min(r.end, (SceOff) ID3v2_HEADER_SIZE + len);
+		id3v2_parse(tag, &r, len, buf[3], buf[5]);
 	}
 
+	tag_reader_free(&r);
+
 	return 0;
 }
 
@@ -493,7 +649,7 @@ void read_ape_tag(MusicInfoInternalTag * tag_info, const char *spath)
 	}
 }
 
-int generic_readtag(MusicInfo * music_info, const char *spath)
+static int readtag(MusicInfo * music_info, const char *spath, buffer ** lyric)
 {
 	SceUID fd;
 	MusicInfoInternalTag tag;
@@ -525,6 +681,10 @@ int generic_readtag(MusicInfo * music_info, const char *spath)
 	// Search for APETag
 	read_ape_tag(&tag, spath);
 
+	*lyric = tag.lyric;
+	music_info->enc_delay = tag.enc_delay;
+	music_info->enc_padding = tag.enc_padding;
+
 	if (config.apetagorder) {
 		if (tag.type & APETAG) {
 			memcpy(&music_info->tag, &tag.apetag, sizeof(music_info->tag));
@@ -551,3 +711,124 @@ int generic_readtag(MusicInfo * music_info, const char *spath)
 
 	return 0;
 }
+
+/**
+ * ʹֿм¼ıǩ, Ҫ¶ȡʱ
+ */
+static bool readtag_cached(MusicInfo * music_info, const char *spath)
+{
+	t_musicdb_info info;
+
+	if (musicdb_get(spath, true, &info) < 0 || (info.flags & (MUSICDB_TAG | MUSICDB_LYRIC)) != MUSICDB_TAG) {
+		return false;
+	}
+
+	music_info->tag = info.tag;
+	music_info->enc_delay = info.enc_delay;
+	music_info->enc_padding = info.enc_padding;
+
+	return true;
+}
+
+int generic_readtag(MusicInfo * music_info, const char *spath)
+{
+	buffer *lyric = NULL;
+	bool hit;
+	int ret = 0;
+
+	if (music_info == NULL || spath == NULL) {
+		return -1;
+	}
+
+	xr_lock(&preload_l);
+	hit = preload.spath[0] != '\0' && !strcmp(preload.spath, spath);
+
+	if (hit) {
+		music_info->tag = preload.info.tag;
+		music_info->enc_delay = preload.info.enc_delay;
+		music_info->enc_padding = preload.info.enc_padding;
+		lyric = preload.lyric;
+		preload.lyric = NULL;
+		preload.spath[0] = '\0';
+	}
+
+	xr_unlock(&preload_l);
+
+	if (!hit) {
+		hit = readtag_cached(music_info, spath);
+	}
+
+	if (!hit) {
+		ret = readtag(music_info, spath, &lyric);
+
+		if (ret == 0) {
+			musicdb_put_tag(spath, music_info, lyric != NULL);
+		}
+	}
+
+	if (tag_lyric) {
+		buffer_free(tag_lyric);
+	}
+
+	tag_lyric = lyric;
+
+	return ret;
+}
+
+int generic_readtag_preload(const char *spath)
+{
+	MusicInfo info;
+	SceIoStat sta;
+	buffer *lyric = NULL;
+
+	if (spath == NULL || sceIoGetstat(spath, &sta) < 0) {
+		return -1;
+	}
+
+	memset(&info, 0, sizeof(info));
+	info.filesize = sta.st_size;
+
+	if (!readtag_cached(&info, spath)) {
+		if (readtag(&info, spath, &lyric) < 0) {
+			return -1;
+		}
+
+		musicdb_put_tag(spath, &info, lyric != NULL);
+	}
+
+	xr_lock(&preload_l);
+
+	if (preload.lyric) {
+		buffer_free(preload.lyric);
+	}
+
+	STRCPY_S(preload.spath, spath);
+	preload.info = info;
+	preload.lyric = lyric;
+	xr_unlock(&preload_l);
+
+	return 0;
+}
+
+int generic_readtag_scan(MusicInfo * music_info, const char *spath, bool * has_lyric)
+{
+	buffer *lyric = NULL;
+
+	if (music_info == NULL || spath == NULL) {
+		return -1;
+	}
+
+	if (readtag(music_info, spath, &lyric) < 0) {
+		return -1;
+	}
+
+	if (has_lyric) {
+		*has_lyric = lyric != NULL;
+	}
+
+	if (lyric) {
+		buffer_free(lyric);
+	}
+
+	return 0;
+}
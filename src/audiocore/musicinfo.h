@@ -61,6 +61,10 @@ extern "C"
 		double avg_bps;
 
 		MusicTagInfo tag;
+
+		/** iTunSMPBıӳ, ûʱΪ0 */
+		int enc_delay;
+		int enc_padding;
 	} MusicInfo, *PMusicInfo;
 
 	extern buffer *tag_lyric;
@@ -75,6 +79,30 @@ extern "C"
  */
 	int generic_readtag(MusicInfo * music_info, const char *spath);
 
+/**
+ * Ԥȶȡһıǩ
+ *
+ * @note ͬһ·generic_readtagΪֹ, ֻһ
+ *
+ * @param spath ļ·, 8.3ļʽ
+ *
+ * @return ɹ0, 򷵻-1
+ */
+	int generic_readtag_preload(const char *spath);
+
+/**
+ * Ϊֿȡǩ
+ *
+ * @note ıtag_lyric, ɨ߳е
+ *
+ * @param music_info Ϣṹָ, filesize
+ * @param spath ļ·, 8.3ļʽ
+ * @param has_lyric رǩǷи, ΪNULL
+ *
+ * @return ɹ0, 򷵻-1
+ */
+	int generic_readtag_scan(MusicInfo * music_info, const char *spath, bool * has_lyric);
+
 #ifdef __cplusplus
 }
 #endif
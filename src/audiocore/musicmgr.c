@@ -55,6 +55,7 @@
 #include "fs.h"
 #include "buffer.h"
 #include "musicinfo.h"
+#include "musicdb.h"
 #include "power.h"
 #include "image_queue.h"
 #include "thread_lock.h"
@@ -62,6 +63,7 @@
 #include "systemctrl.h"
 #include "musiclist.h"
 #include "stack.h"
+#include "xaudiolib.h"
 #ifdef DMALLOC
 #include "dmalloc.h"
 #endif
@@ -89,6 +91,25 @@ static int music_play(int i);
 
 static Stack g_played;
 
+/**
+ * ĿǰԤһ
+ */
+#define MUSIC_PREROLL_SECONDS 5
+
+/**
+ * music_loadĵô, ʶڲŵĿ
+ */
+static unsigned g_load_count = 0;
+
+static struct
+{
+	SceUID thid;
+	volatile bool active;
+	/** ʼԤʱg_load_count */
+	unsigned load_count;
+	char spath[PATH_MAX];
+} g_preroll = { -1, false, 0, "" };
+
 static inline void swap(int *a, int *b)
 {
 	int t;
@@ -146,7 +167,7 @@ static void music_unlock(void)
 
 int music_add(const char *spath, const char *lpath)
 {
-	int pos;
+	int pos, ret;
 
 	if (spath == NULL || lpath == NULL)
 		return -EINVAL;
@@ -160,7 +181,13 @@ int music_add(const char *spath, const char *lpath)
 		return -1;
 	}
 
-	return musiclist_add(&g_music_list, spath, lpath);
+	ret = musiclist_add(&g_music_list, spath, lpath);
+
+	if (ret >= 0) {
+		musicdb_scan_add(spath);
+	}
+
+	return ret;
 }
 
 int music_find(const char *spath, const char *lpath)
@@ -390,6 +417,114 @@ static int get_next_music(void)
 	return 0;
 }
 
+/**
+ * õget_next_musicҪŵ±, ıб״̬
+ *
+ * @return ±, бβʱ-1
+ */
+static int peek_next_music(void)
+{
+	switch (g_list.cycle_mode) {
+		case conf_cycle_single:
+			if (g_list.curr_pos == music_maxindex() - 1)
+				return -1;
+			return g_list.curr_pos + 1;
+		case conf_cycle_repeat:
+			if (g_list.curr_pos == music_maxindex() - 1)
+				return 0;
+			return g_list.curr_pos + 1;
+		case conf_cycle_repeat_one:
+			return g_list.curr_pos;
+		default:
+			break;
+	}
+
+	return -1;
+}
+
+static int music_preroll_thread(SceSize arg, void *argp)
+{
+	generic_readtag_preload(g_preroll.spath);
+	g_preroll.active = false;
+
+	return 0;
+}
+
+static void music_preroll_wait(void)
+{
+	if (g_preroll.thid < 0)
+		return;
+
+	while (g_preroll.active)
+		sceKernelDelayThread(10000);
+
+	sceKernelDeleteThread(g_preroll.thid);
+	g_preroll.thid = -1;
+}
+
+/**
+ * ǰĿӽβʱ, ڵȼ߳Ԥһıǩ
+ *
+ * @note ʹһʱͣ
+ */
+static void music_preroll(void)
+{
+	struct music_info info = { 0 };
+	MusicListEntry *entry;
+	int next;
+
+	if (!config.gapless || g_preroll.load_count == g_load_count)
+		return;
+
+	info.type = MD_GET_CURTIME | MD_GET_DURATION;
+
+	if (musicdrv_get_status() != ST_PLAYING || musicdrv_get_info(&info) != 0)
+		return;
+
+	if (info.duration <= 0 || info.duration - info.cur_time > MUSIC_PREROLL_SECONDS)
+		return;
+
+	g_preroll.load_count = g_load_count;
+	next = peek_next_music();
+	entry = next >= 0 ? musiclist_get(&g_music_list, next) : NULL;
+
+	if (entry == NULL)
+		return;
+
+	music_preroll_wait();
+	STRCPY_S(g_preroll.spath, entry->spath);
+	g_preroll.active = true;
+	g_preroll.thid = sceKernelCreateThread("Music Preroll", music_preroll_thread, 0x40, 0x10000, 0, NULL);
+
+	if (g_preroll.thid < 0 || sceKernelStartThread(g_preroll.thid, 0, NULL) < 0) {
+		if (g_preroll.thid >= 0)
+			sceKernelDeleteThread(g_preroll.thid);
+
+		g_preroll.thid = -1;
+		g_preroll.active = false;
+	}
+}
+
+/**
+ * беһ, 
+ *
+ * @note һһһ֮ʼ
+ */
+static int music_play_next(int i)
+{
+	int ret;
+
+	if (!config.gapless)
+		return music_play(i);
+
+	music_preroll_wait();
+	xAudioHold(1);
+	ret = music_play(i);
+	xAudioHold(0);
+
+	return ret;
+}
+
 int music_list_play(void)
 {
 	music_lock();
@@ -498,8 +633,10 @@ static int music_thread(SceSize arg, void *argp)
 						continue;
 					}
 
-					music_play(g_list.curr_pos);
+					music_play_next(g_list.curr_pos);
 				}
+			} else {
+				music_preroll();
 			}
 
 			music_unlock();
@@ -577,6 +714,7 @@ int music_init(void)
 	u32 seed;
 
 	cache_init();
+	musicdb_init();
 
 	seed = sctrlKernelRand();
 
@@ -684,6 +822,11 @@ int music_free(void)
 		sceKernelDeleteThread(g_music_thread);
 	}
 
+	music_preroll_wait();
+	musicdb_scan_stop();
+	musicdb_save();
+	musicdb_free();
+
 	xr_lock_destroy(&music_l);
 
 	return 0;
@@ -987,6 +1130,22 @@ int music_get_info(struct music_info *info)
 	return -EBUSY;
 }
 
+/**
+ * õĿϢֿ
+ */
+static void music_update_db(const char *spath)
+{
+	struct music_ops *drv = get_musicdrv(NULL);
+	struct music_info info;
+
+	memset(&info, 0, sizeof(info));
+	info.type = MD_GET_TITLE | MD_GET_ARTIST | MD_GET_ALBUM | MD_GET_DURATION | MD_GET_FREQ;
+
+	if (drv != NULL && musicdrv_get_info(&info) == 0) {
+		musicdb_put_stream(spath, drv->name, &info);
+	}
+}
+
 int music_load(int i)
 {
 	MusicListEntry *file = musiclist_get(&g_music_list, i);
@@ -996,6 +1155,7 @@ int music_load(int i)
 
 	if (file == NULL)
 		return -EINVAL;
+	g_load_count++;
 	ret = music_stop();
 	if (ret < 0)
 		return ret;
@@ -1008,6 +1168,7 @@ int music_load(int i)
 	ret = musicdrv_load(file->spath, file->lpath);
 	if (ret < 0)
 		return ret;
+	music_update_db(file->spath);
 #ifdef ENABLE_LYRIC
 	lyric_close(&lyric);
 
@@ -26,6 +26,7 @@
 #include "ssv.h"
 #include "scene.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "musicmgr.h"
 #include "musicdrv.h"
 #include "strsafe.h"
@@ -88,35 +89,6 @@ static ov_callbacks vorbis_callbacks = {
 	ovcb_tell
 };
 
-/**
- * ݵ
- *
- * @note ĸʽΪ˫16λ
- *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param frames ֡
- * @param channels 
- */
-static void send_to_sndbuf(void *buf, uint16_t * srcbuf, int frames, int channels)
-{
-	int n;
-	signed short *p = (signed short *) buf;
-
-	if (frames <= 0)
-		return;
-
-	if (channels == 2) {
-		memcpy(buf, srcbuf, frames * channels * sizeof(*srcbuf));
-	} else {
-		for (n = 0; n < frames * channels; n++) {
-			*p++ = srcbuf[n];
-			*p++ = srcbuf[n];
-		}
-	}
-
-}
-
 static void ogg_seek_seconds(OggVorbis_File * decoder, double npt)
 {
 	if (decoder)
@@ -214,12 +186,12 @@ static int ogg_audiocallback(void *buf, unsigned int reqn, void *pdata)
 		avail_frame = g_buff_frame_size - g_buff_frame_start;
 
 		if (avail_frame >= snd_buf_frame_size) {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], snd_buf_frame_size, g_info.channels);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], snd_buf_frame_size, g_info.channels);
 			g_buff_frame_start += snd_buf_frame_size;
 			audio_buf += snd_buf_frame_size * 2;
 			snd_buf_frame_size = 0;
 		} else {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], avail_frame, g_info.channels);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], avail_frame, g_info.channels);
 			snd_buf_frame_size -= avail_frame;
 			audio_buf += avail_frame * 2;
 
@@ -534,6 +506,10 @@ static int ogg_get_info(struct music_info *pinfo)
 	return generic_get_info(pinfo);
 }
 
+static const char *ogg_exts[] = {
+	"ogg", NULL
+};
+
 /**
  * ǷΪMPCļĿǰֻļ׺
  *
@@ -543,17 +519,7 @@ static int ogg_get_info(struct music_info *pinfo)
  */
 static int ogg_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "ogg") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, ogg_exts);
 }
 
 static int ogg_set_opt(const char *unused, const char *values)
@@ -602,6 +568,7 @@ static struct music_ops ogg_ops = {
 	.resume = ogg_resume,
 	.get_info = ogg_get_info,
 	.probe = ogg_probe,
+	.exts = ogg_exts,
 	.next = NULL
 };
 
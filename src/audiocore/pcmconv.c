@@ -0,0 +1,198 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <pspkernel.h>
+#include <string.h>
+#include "pcmconv.h"
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+/*
+ * ڲѭÿδ4֡, ûп֡, ڱչ
+ */
+
+static inline int pcm_clip16(int v)
+{
+	if (v < -32768)
+		return -32768;
+	if (v > 32767)
+		return 32767;
+	return v;
+}
+
+static inline int pcm_shift(s32 v, int shift)
+{
+	return shift >= 0 ? v >> shift : v << -shift;
+}
+
+/** һͬʱд */
+static inline u32 pcm_dup(int v)
+{
+	return (u16) v * 0x10001u;
+}
+
+/** Ϊһ֡ */
+static inline u32 pcm_pack(int l, int r)
+{
+	return (u16) l | ((u32) (u16) r << 16);
+}
+
+void pcm_s16_to_stereo(void *dst, const void *src, int frames, int channels)
+{
+	u32 *d = dst;
+	const s16 *s = src;
+
+	if (frames <= 0)
+		return;
+
+	if (channels == 2) {
+		memcpy(dst, src, frames * 2 * sizeof(*s));
+		return;
+	}
+
+	if (channels == 1) {
+		for (; frames >= 4; frames -= 4, s += 4, d += 4) {
+			d[0] = pcm_dup(s[0]);
+			d[1] = pcm_dup(s[1]);
+			d[2] = pcm_dup(s[2]);
+			d[3] = pcm_dup(s[3]);
+		}
+
+		for (; frames > 0; --frames)
+			*d++ = pcm_dup(*s++);
+
+		return;
+	}
+
+	for (; frames > 0; --frames, s += channels)
+		*d++ = pcm_pack(s[0], s[1]);
+}
+
+void pcm_s32_to_s16(void *dst, const s32 * src, int samples, int shift)
+{
+	s16 *d = dst;
+	const s32 *s = src;
+
+	for (; samples >= 4; samples -= 4, s += 4, d += 4) {
+		d[0] = pcm_clip16(pcm_shift(s[0], shift));
+		d[1] = pcm_clip16(pcm_shift(s[1], shift));
+		d[2] = pcm_clip16(pcm_shift(s[2], shift));
+		d[3] = pcm_clip16(pcm_shift(s[3], shift));
+	}
+
+	for (; samples > 0; --samples)
+		*d++ = pcm_clip16(pcm_shift(*s++, shift));
+}
+
+void pcm_s32_to_stereo(void *dst, const s32 * src, int frames, int channels, int shift)
+{
+	u32 *d = dst;
+	const s32 *s = src;
+
+	if (frames <= 0)
+		return;
+
+	if (channels == 1) {
+		for (; frames >= 4; frames -= 4, s += 4, d += 4) {
+			d[0] = pcm_dup(pcm_clip16(pcm_shift(s[0], shift)));
+			d[1] = pcm_dup(pcm_clip16(pcm_shift(s[1], shift)));
+			d[2] = pcm_dup(pcm_clip16(pcm_shift(s[2], shift)));
+			d[3] = pcm_dup(pcm_clip16(pcm_shift(s[3], shift)));
+		}
+
+		for (; frames > 0; --frames)
+			*d++ = pcm_dup(pcm_clip16(pcm_shift(*s++, shift)));
+
+		return;
+	}
+
+	if (channels == 2) {
+		for (; frames >= 2; frames -= 2, s += 4, d += 2) {
+			d[0] = pcm_pack(pcm_clip16(pcm_shift(s[0], shift)), pcm_clip16(pcm_shift(s[1], shift)));
+			d[1] = pcm_pack(pcm_clip16(pcm_shift(s[2], shift)), pcm_clip16(pcm_shift(s[3], shift)));
+		}
+	}
+
+	for (; frames > 0; --frames, s += channels)
+		*d++ = pcm_pack(pcm_clip16(pcm_shift(s[0], shift)), pcm_clip16(pcm_shift(s[1], shift)));
+}
+
+/** תΪ16λ, ضϷʽ(int)תһ */
+static inline int pcm_float16(float v)
+{
+	return pcm_clip16((int) (v * 32768.0f));
+}
+
+void pcm_float_to_stereo(void *dst, const float *src, int frames, int channels)
+{
+	u32 *d = dst;
+	const float *s = src;
+
+	if (frames <= 0)
+		return;
+
+	if (channels == 1) {
+		for (; frames >= 4; frames -= 4, s += 4, d += 4) {
+			d[0] = pcm_dup(pcm_float16(s[0]));
+			d[1] = pcm_dup(pcm_float16(s[1]));
+			d[2] = pcm_dup(pcm_float16(s[2]));
+			d[3] = pcm_dup(pcm_float16(s[3]));
+		}
+
+		for (; frames > 0; --frames)
+			*d++ = pcm_dup(pcm_float16(*s++));
+
+		return;
+	}
+
+	if (channels == 2) {
+		for (; frames >= 2; frames -= 2, s += 4, d += 2) {
+			d[0] = pcm_pack(pcm_float16(s[0]), pcm_float16(s[1]));
+			d[1] = pcm_pack(pcm_float16(s[2]), pcm_float16(s[3]));
+		}
+	}
+
+	for (; frames > 0; --frames, s += channels)
+		*d++ = pcm_pack(pcm_float16(s[0]), pcm_float16(s[1]));
+}
+
+void pcm_planar_to_stereo(void *dst, const s32 * const src[], int frames, int channels, int shift)
+{
+	u32 *d = dst;
+	const s32 *l, *r;
+	int i;
+
+	if (frames <= 0 || channels <= 0)
+		return;
+
+	l = src[0];
+	r = channels >= 2 ? src[1] : src[0];
+
+	for (i = 0; i + 4 <= frames; i += 4) {
+		d[i] = pcm_pack(pcm_clip16(pcm_shift(l[i], shift)), pcm_clip16(pcm_shift(r[i], shift)));
+		d[i + 1] = pcm_pack(pcm_clip16(pcm_shift(l[i + 1], shift)), pcm_clip16(pcm_shift(r[i + 1], shift)));
+		d[i + 2] = pcm_pack(pcm_clip16(pcm_shift(l[i + 2], shift)), pcm_clip16(pcm_shift(r[i + 2], shift)));
+		d[i + 3] = pcm_pack(pcm_clip16(pcm_shift(l[i + 3], shift)), pcm_clip16(pcm_shift(r[i + 3], shift)));
+	}
+
+	for (; i < frames; ++i)
+		d[i] = pcm_pack(pcm_clip16(pcm_shift(l[i], shift)), pcm_clip16(pcm_shift(r[i], shift)));
+}
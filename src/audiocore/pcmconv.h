@@ -0,0 +1,95 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef PCMCONV_H
+#define PCMCONV_H
+
+#include <pspkernel.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * 16λPCMתΪ˫16λPCM
+ *
+ * @note ˫ֱӸ, Ƶ, ʱֻȡǰ
+ *
+ * @param dst Ŀ껺, СΪframes * 2
+ * @param src 16λPCM
+ * @param frames ֡
+ * @param channels 
+ */
+void pcm_s16_to_stereo(void *dst, const void *src, int frames, int channels);
+
+/**
+ * 32λPCMתΪ16λPCM, ı
+ *
+ * @note 16λΧʱ
+ *
+ * @param dst Ŀ껺, СΪsamples
+ * @param src 32λPCM
+ * @param samples 
+ * @param shift λ, ʱ; 24λΪ8
+ */
+void pcm_s32_to_s16(void *dst, const s32 * src, int samples, int shift);
+
+/**
+ * 32λPCMתΪ˫16λPCM
+ *
+ * @note 16λΧʱ
+ *
+ * @param dst Ŀ껺, СΪframes * 2
+ * @param src 32λPCM
+ * @param frames ֡
+ * @param channels 
+ * @param shift λ, ʱ; 24λΪ8
+ */
+void pcm_s32_to_stereo(void *dst, const s32 * src, int frames, int channels, int shift);
+
+/**
+ * PCMתΪ˫16λPCM
+ *
+ * @note 뷶ΧΪ[-1.0, 1.0), ʱ
+ *
+ * @param dst Ŀ껺, СΪframes * 2
+ * @param src ĸPCM
+ * @param frames ֡
+ * @param channels 
+ */
+void pcm_float_to_stereo(void *dst, const float *src, int frames, int channels);
+
+/**
+ * ŵ32λPCMΪ˫16λPCM
+ *
+ * @param dst Ŀ껺, СΪframes * 2
+ * @param src ָ
+ * @param frames ֡
+ * @param channels 
+ * @param shift λ, ʱ
+ */
+void pcm_planar_to_stereo(void *dst, const s32 * const src[], int frames, int channels, int shift);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <pspkernel.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <math.h>
+#include "common/datatype.h"
+#include "resample.h"
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+struct _resampler
+{
+	int in_rate;
+	int out_rate;
+	int taps;
+	/** λ = frac >> phase_shift */
+	int phase_shift;
+	/** ˲, (1 << (32 - phase_shift)), ÿtapsQ15ϵ */
+	s16 *coef;
+	/** ÿһ֡λõ, 32λС */
+	u32 step_int;
+	u32 step_frac;
+	u32 frac;
+	/** ǰӦĵһ֡ */
+	u32 pos;
+	/** 뻺, ˫ */
+	s16 *buf;
+	u32 count;
+	u32 cap;
+};
+
+static const struct
+{
+	int taps;
+	int phase_bits;
+} tiers[] = {
+	{8, 5},
+	{16, 6},
+	{32, 8},
+};
+
+static inline int clip16(int v)
+{
+	if (v < -32768)
+		return -32768;
+	if (v > 32767)
+		return 32767;
+	return v;
+}
+
+/**
+ * ˲
+ *
+ * @note ÿ൥һʹֱΪ1, ʱϵֵ֮ԶС2,
+ * Q15ۼӲ32λ
+ */
+static int build_bank(p_resampler r, int phases)
+{
+	double fc, *h;
+	int p, k;
+
+	// ֹƵȡϵһο˹Ƶʵ90%, ʹһ
+	fc = 0.45 * (r->out_rate < r->in_rate ? (double) r->out_rate / r->in_rate : 1.0);
+
+	h = malloc(sizeof(*h) * r->taps);
+	r->coef = memalign(64, sizeof(*r->coef) * phases * r->taps);
+
+	if (h == NULL || r->coef == NULL) {
+		free(h);
+		return -1;
+	}
+
+	for (p = 0; p < phases; ++p) {
+		double sum = 0, frac = (double) p / phases;
+		int isum = 0, peak = 0;
+
+		for (k = 0; k < r->taps; ++k) {
+			double t = k - r->taps / 2 + 1 - frac;
+			double x = 2 * fc * t;
+			double w = (t + r->taps / 2) / r->taps;
+
+			// Blackman
+			w = 0.42 - 0.5 * cos(2 * M_PI * w) + 0.08 * cos(4 * M_PI * w);
+			h[k] = (x == 0 ? 1.0 : sin(M_PI * x) / (M_PI * x)) * w;
+			sum += h[k];
+		}
+
+		for (k = 0; k < r->taps; ++k) {
+			int c = (int) floor(h[k] / sum * 32768 + 0.5);
+
+			r->coef[p * r->taps + k] = clip16(c);
+			isum += r->coef[p * r->taps + k];
+
+			if (r->coef[p * r->taps + k] > r->coef[p * r->taps + peak])
+				peak = k;
+		}
+
+		// ϵ, ֱ֤׼ȷ
+		r->coef[p * r->taps + peak] = clip16(r->coef[p * r->taps + peak] + 32768 - isum);
+	}
+
+	free(h);
+
+	return 0;
+}
+
+p_resampler resample_open(int in_rate, int out_rate, int quality)
+{
+	p_resampler r;
+	u64 step;
+
+	if (in_rate <= 0 || out_rate <= 0)
+		return NULL;
+
+	if (quality < RESAMPLE_FAST || quality > RESAMPLE_BEST)
+		quality = RESAMPLE_MEDIUM;
+
+	r = calloc(1, sizeof(*r));
+
+	if (r == NULL)
+		return NULL;
+
+	r->in_rate = in_rate;
+	r->out_rate = out_rate;
+	r->taps = tiers[quality].taps;
+	r->phase_shift = 32 - tiers[quality].phase_bits;
+
+	step = ((u64) in_rate << 32) / out_rate;
+	r->step_int = step >> 32;
+	r->step_frac = (u32) step;
+
+	r->cap = r->taps + RESAMPLE_CHUNK;
+	r->buf = memalign(64, r->cap * 2 * sizeof(*r->buf));
+
+	if (r->buf == NULL || build_bank(r, 1 << tiers[quality].phase_bits) < 0) {
+		resample_close(r);
+		return NULL;
+	}
+
+	resample_reset(r);
+
+	return r;
+}
+
+void resample_reset(p_resampler r)
+{
+	// Ԥ˲ȵľ, ʹ
+	r->count = r->taps / 2 - 1;
+	memset(r->buf, 0, r->count * 2 * sizeof(*r->buf));
+	r->pos = 0;
+	r->frac = 0;
+}
+
+s16 *resample_input(p_resampler r, int *frames)
+{
+	*frames = r->cap - r->count;
+
+	return r->buf + r->count * 2;
+}
+
+void resample_commit(p_resampler r, int frames)
+{
+	if (frames > 0)
+		r->count = min(r->count + frames, r->cap);
+}
+
+int resample_run(p_resampler r, s16 * out, int frames)
+{
+	const int taps = r->taps;
+	u32 pos = r->pos, frac = r->frac, drop;
+	int n;
+
+	for (n = 0; n < frames && pos + taps <= r->count; ++n) {
+		const s16 *x = r->buf + pos * 2;
+		const s16 *c = r->coef + (frac >> r->phase_shift) * taps;
+		int k, suml = 0, sumr = 0;
+
+		for (k = 0; k < taps; k += 4) {
+			suml += c[k] * x[0] + c[k + 1] * x[2] + c[k + 2] * x[4] + c[k + 3] * x[6];
+			sumr += c[k] * x[1] + c[k + 1] * x[3] + c[k + 2] * x[5] + c[k + 3] * x[7];
+			x += 8;
+		}
+
+		*out++ = clip16((suml + 16384) >> 15);
+		*out++ = clip16((sumr + 16384) >> 15);
+
+		frac += r->step_frac;
+
+		if (frac < r->step_frac)
+			pos++;
+
+		pos += r->step_int;
+	}
+
+	// Ҫ
+	drop = min(pos, r->count);
+
+	if (drop > 0) {
+		memmove(r->buf, r->buf + drop * 2, (r->count - drop) * 2 * sizeof(*r->buf));
+		r->count -= drop;
+	}
+
+	r->pos = pos - drop;
+	r->frac = frac;
+
+	return n;
+}
+
+void resample_close(p_resampler r)
+{
+	if (r == NULL)
+		return;
+
+	free(r->coef);
+	free(r->buf);
+	free(r);
+}
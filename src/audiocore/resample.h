@@ -0,0 +1,108 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <pspkernel.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** ز */
+	enum
+	{
+		/** 8, 32 */
+		RESAMPLE_FAST = 0,
+		/** 16, 64 */
+		RESAMPLE_MEDIUM = 1,
+		/** 32, 256 */
+		RESAMPLE_BEST = 2
+	};
+
+/** ÿοд֡ */
+#define RESAMPLE_CHUNK 1024
+
+	typedef struct _resampler t_resampler, *p_resampler;
+
+/**
+ * ز
+ *
+ * @note രsinc˲, ϵڽʱһòתΪQ15
+ * @note Ϊ˫16λPCM
+ *
+ * @param in_rate 
+ * @param out_rate 
+ * @param quality , RESAMPLE_*
+ *
+ * @return ز, ʧܷNULL
+ */
+	p_resampler resample_open(int in_rate, int out_rate, int quality);
+
+/**
+ * õ뻺Ŀд
+ *
+ * @param r ز
+ * @param frames ؿд֡, RESAMPLE_CHUNK
+ *
+ * @return дλ
+ */
+	s16 *resample_input(p_resampler r, int *frames);
+
+/**
+ * ύд뻺֡
+ *
+ * @param r ز
+ * @param frames ֡
+ */
+	void resample_commit(p_resampler r, int frames);
+
+/**
+ * ݲ
+ *
+ * @param r ز
+ * @param out 
+ * @param frames ֡
+ *
+ * @return ʵʲ֡, 벻ʱСframes
+ */
+	int resample_run(p_resampler r, s16 * out, int frames);
+
+/**
+ * 뻺˲״̬
+ *
+ * @param r ز
+ */
+	void resample_reset(p_resampler r);
+
+/**
+ * ͷز
+ *
+ * @param r ز
+ */
+	void resample_close(p_resampler r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pspkernel.h>
+#include "config.h"
+#include "common/utils.h"
+#include "strsafe.h"
+#include "seekcache.h"
+#include "dbg.h"
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+#define SEEKCACHE_STEP 256
+
+void seekcache_free(p_seekcache c)
+{
+	if (c == NULL)
+		return;
+
+	free(c->points);
+	memset(c, 0, sizeof(*c));
+}
+
+void seekcache_open(p_seekcache c, const char *spath, u64 filesize, u32 spacing)
+{
+	if (c == NULL)
+		return;
+
+	if (c->points != NULL && strcmp(c->path, spath) == 0 && c->filesize == filesize && c->spacing == spacing) {
+		dbg_printf(d, "%s: reusing %u seek points", __func__, (unsigned) c->count);
+		return;
+	}
+
+	seekcache_free(c);
+	STRCPY_S(c->path, spath);
+	c->filesize = filesize;
+	c->spacing = max(spacing, 1);
+}
+
+/**
+ * ֲҵһsampleĶλ
+ */
+static u32 upper_bound(p_seekcache c, u64 sample)
+{
+	u32 lo = 0, hi = c->count;
+
+	while (lo < hi) {
+		u32 mid = lo + (hi - lo) / 2;
+
+		if (c->points[mid].sample <= sample)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+void seekcache_add(p_seekcache c, u64 sample, u64 offset)
+{
+	u32 i;
+
+	if (c == NULL || c->spacing == 0)
+		return;
+
+	// ˳򲥷ʱֻһȽ
+	if (c->count == 0 || c->points[c->count - 1].sample < sample)
+		i = c->count;
+	else
+		i = upper_bound(c, sample);
+
+	if (i > 0 && sample - c->points[i - 1].sample < c->spacing)
+		return;
+
+	if (i < c->count && c->points[i].sample - sample < c->spacing)
+		return;
+
+	if (c->count >= c->cap) {
+		t_seekpoint *p = realloc(c->points, (c->cap + SEEKCACHE_STEP) * sizeof(*p));
+
+		if (p == NULL)
+			return;
+
+		c->points = p;
+		c->cap += SEEKCACHE_STEP;
+	}
+
+	if (i < c->count)
+		memmove(&c->points[i + 1], &c->points[i], (c->count - i) * sizeof(*c->points));
+
+	c->points[i].sample = sample;
+	c->points[i].offset = offset;
+	c->count++;
+}
+
+int seekcache_find(p_seekcache c, u64 sample, t_seekpoint * pt)
+{
+	u32 i;
+
+	if (c == NULL || c->count == 0)
+		return -1;
+
+	i = upper_bound(c, sample);
+
+	if (i == 0 || sample - c->points[i - 1].sample > 2 * (u64) c->spacing)
+		return -1;
+
+	*pt = c->points[i - 1];
+
+	return 0;
+}
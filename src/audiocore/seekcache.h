@@ -0,0 +1,90 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef SEEKCACHE_H
+#define SEEKCACHE_H
+
+#include "common/datatype.h"
+
+/** λ: ֡ʼļеֽƫ */
+typedef struct
+{
+	u64 sample;
+	u64 offset;
+} t_seekpoint;
+
+/**
+ * λ㻺
+ *
+ * @note , ɲźͶλʱ뵽֡
+ */
+typedef struct
+{
+	char path[PATH_MAX];
+	u64 filesize;
+	/** ڶλС */
+	u32 spacing;
+	u32 count;
+	u32 cap;
+	t_seekpoint *points;
+} t_seekcache, *p_seekcache;
+
+/**
+ * Ϊ򿪵׼λ㻺
+ *
+ * @note ·Сϴͬʱжλ, ʹ߻ָԿʹ
+ *
+ * @param c 
+ * @param spath ļ·
+ * @param filesize ļС
+ * @param spacing ڶλС, һȡһ
+ */
+extern void seekcache_open(p_seekcache c, const char *spath, u64 filesize, u32 spacing);
+
+/**
+ * ¼һ֡λ
+ *
+ * @note жλ㲻spacing֡; ˳򲥷ʱΪ׷
+ *
+ * @param c 
+ * @param sample ֡ʼ
+ * @param offset ֡ʼֽƫ
+ */
+extern void seekcache_add(p_seekcache c, u64 sample, u64 offset);
+
+/**
+ * Ŀ֮ǰĶλ
+ *
+ * @param c 
+ * @param sample Ŀ
+ * @param pt صĶλ
+ *
+ * @return ҵĿ겻2spacingĶλ㷵0, 򷵻-1
+ */
+extern int seekcache_find(p_seekcache c, u64 sample, t_seekpoint * pt);
+
+/**
+ * ͷŶλ㻺
+ *
+ * @param c 
+ */
+extern void seekcache_free(p_seekcache c);
+
+#endif
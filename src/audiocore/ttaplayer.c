@@ -25,6 +25,7 @@
 #include "config.h"
 #include "scene.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "musicmgr.h"
 #include "musicdrv.h"
 #include "strsafe.h"
@@ -78,45 +79,55 @@ static int g_samples_decoded = 0;
 static uint32_t g_tta_data_offset = 0;
 
 /**
- * ݵ
+ * TTAλĿ֡, ٽ뵽Ŀ
  *
- * @note ĸʽΪ˫16λ
+ * @param seconds Ŀ
  *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param frames ֡
- * @param channels 
+ * @return ɹʱ0
  */
-static void send_to_sndbuf(void *buf, uint16_t * srcbuf, int frames, int channels)
+static int tta_seek_seconds(double seconds)
 {
-	int n;
-	signed short *p = (signed short *) buf;
-
-	if (frames <= 0)
-		return;
-
-	if (channels == 2) {
-		memcpy(buf, srcbuf, frames * channels * sizeof(*srcbuf));
-	} else {
-		for (n = 0; n < frames * channels; n++) {
-			*p++ = srcbuf[n];
-			*p++ = srcbuf[n];
-		}
+	uint32_t sample, frame;
+	int ret;
+
+	if (seconds >= g_info.duration) {
+		__end();
+		return 0;
 	}
 
-}
+	if (seconds < 0)
+		seconds = 0;
 
-static int tta_seek_seconds(double seconds)
-{
-	if (set_position(seconds * 1000 / SEEK_STEP) == 0) {
-		g_buff_frame_size = g_buff_frame_start = 0;
-		g_play_time = seconds;
-		g_samples_decoded = (uint32_t) (seconds * g_info.sample_freq);
-		return 0;
+	sample = (uint32_t) (seconds * g_info.sample_freq);
+	frame = sample / ttainfo.FRAMELEN;
+
+	if (set_position(frame) != 0) {
+		__end();
+		return -1;
 	}
 
-	__end();
-	return -1;
+	g_buff_frame_size = g_buff_frame_start = 0;
+	g_samples_decoded = frame * ttainfo.FRAMELEN;
+
+	while (g_samples_decoded <= sample) {
+		ret = get_samples((u8 *) g_buff);
+
+		if (ret <= 0) {
+			__end();
+			return -1;
+		}
+
+		if (g_samples_decoded + ret > sample) {
+			g_buff_frame_size = ret;
+			g_buff_frame_start = sample - g_samples_decoded;
+		}
+
+		g_samples_decoded += ret;
+	}
+
+	g_play_time = seconds;
+
+	return 0;
 }
 
 /**
@@ -140,28 +151,11 @@ static int tta_audiocallback(void *buf, unsigned int reqn, void *pdata)
 	UNUSED(pdata);
 
 	if (g_status != ST_PLAYING) {
-		if (g_status == ST_FFORWARD) {
-			g_play_time += g_seek_seconds;
-			if (g_play_time >= g_info.duration) {
-				__end();
-				return -1;
-			}
-			generic_lock();
-			generic_set_status(ST_PLAYING);
-			generic_set_playback(true);
-			generic_unlock();
-			tta_seek_seconds(g_play_time);
-		} else if (g_status == ST_FBACKWARD) {
-			g_play_time -= g_seek_seconds;
-			if (g_play_time < 0.) {
-				g_play_time = 0.;
-			}
-			generic_lock();
-			generic_set_status(ST_PLAYING);
-			generic_set_playback(true);
-			generic_unlock();
-			tta_seek_seconds(g_play_time);
+		if (generic_handle_seek(tta_seek_seconds) == -1) {
+			__end();
+			return -1;
 		}
+
 		xAudioClearSndBuf(buf, snd_buf_frame_size);
 		return 0;
 	}
@@ -170,12 +164,12 @@ static int tta_audiocallback(void *buf, unsigned int reqn, void *pdata)
 		avail_frame = g_buff_frame_size - g_buff_frame_start;
 
 		if (avail_frame >= snd_buf_frame_size) {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], snd_buf_frame_size, g_info.channels);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], snd_buf_frame_size, g_info.channels);
 			g_buff_frame_start += snd_buf_frame_size;
 			audio_buf += snd_buf_frame_size * 2;
 			snd_buf_frame_size = 0;
 		} else {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], avail_frame, g_info.channels);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], avail_frame, g_info.channels);
 			snd_buf_frame_size -= avail_frame;
 			audio_buf += avail_frame * 2;
 
@@ -451,6 +445,10 @@ static int tta_get_info(struct music_info *pinfo)
 	return 0;
 }
 
+static const char *tta_exts[] = {
+	"tta", NULL
+};
+
 /**
  * ǷΪTTAļĿǰֻļ׺
  *
@@ -460,17 +458,7 @@ static int tta_get_info(struct music_info *pinfo)
  */
 static int tta_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "tta") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, tta_exts);
 }
 
 static int tta_set_opt(const char *unused, const char *values)
@@ -524,6 +512,7 @@ static struct music_ops tta_ops = {
 	.resume = tta_resume,
 	.get_info = tta_get_info,
 	.probe = tta_probe,
+	.exts = tta_exts,
 	.next = NULL
 };
 
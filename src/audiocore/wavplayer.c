@@ -25,6 +25,7 @@
 #include "config.h"
 #include "scene.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "musicmgr.h"
 #include "musicdrv.h"
 #include "strsafe.h"
@@ -73,35 +74,6 @@ static int g_samples_decoded = 0;
  */
 static uint32_t g_wav_data_offset = 0;
 
-/**
- * ݵ
- *
- * @note ĸʽΪ˫16λ
- *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param frames ֡
- * @param channels 
- */
-static void send_to_sndbuf(void *buf, uint16_t * srcbuf, int frames, int channels)
-{
-	int n;
-	signed short *p = (signed short *) buf;
-
-	if (frames <= 0)
-		return;
-
-	if (channels == 2) {
-		memcpy(buf, srcbuf, frames * channels * sizeof(*srcbuf));
-	} else {
-		for (n = 0; n < frames * channels; n++) {
-			*p++ = srcbuf[n];
-			*p++ = srcbuf[n];
-		}
-	}
-
-}
-
 static int wav_seek_seconds(double seconds)
 {
 	int ret;
@@ -174,14 +146,14 @@ static int wav_audiocallback(void *buf, unsigned int reqn, void *pdata)
 		avail_frame = g_buff_frame_size - g_buff_frame_start;
 
 		if (avail_frame >= snd_buf_frame_size) {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], snd_buf_frame_size, g_info.channels);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], snd_buf_frame_size, g_info.channels);
 			g_buff_frame_start += snd_buf_frame_size;
 			audio_buf += snd_buf_frame_size * 2;
 			incr = (double) (snd_buf_frame_size) / g_info.sample_freq;
 			g_play_time += incr;
 			snd_buf_frame_size = 0;
 		} else {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], avail_frame, g_info.channels);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], avail_frame, g_info.channels);
 			snd_buf_frame_size -= avail_frame;
 			audio_buf += avail_frame * 2;
 
@@ -574,6 +546,10 @@ static int wav_get_info(struct music_info *pinfo)
 	return generic_get_info(pinfo);
 }
 
+static const char *wav_exts[] = {
+	"wav", "wave", NULL
+};
+
 /**
  * ǷΪWAVļĿǰֻļ׺
  *
@@ -583,20 +559,7 @@ static int wav_get_info(struct music_info *pinfo)
  */
 static int wav_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "wav") == 0) {
-			return 1;
-		}
-		if (stricmp(p, "wave") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, wav_exts);
 }
 
 static int wav_set_opt(const char *unused, const char *values)
@@ -653,6 +616,7 @@ static struct music_ops wav_ops = {
 	.resume = wav_resume,
 	.get_info = wav_get_info,
 	.probe = wav_probe,
+	.exts = wav_exts,
 	.next = NULL
 };
 
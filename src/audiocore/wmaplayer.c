@@ -30,6 +30,7 @@
 #include "ssv.h"
 #include "scene.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "musicmgr.h"
 #include "musicdrv.h"
 #include "strsafe.h"
@@ -143,35 +144,6 @@ static int64_t asf_seek_cb(void *userdata, void *buf, SceOff offset, int whence)
 	return ret;
 }
 
-/**
- * ݵ
- *
- * @note ĸʽΪ˫16λ
- *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param frames ֡
- * @param channels 
- */
-static void send_to_sndbuf(void *buf, uint16_t * srcbuf, int frames, int channels)
-{
-	int n;
-	signed short *p = (signed short *) buf;
-
-	if (frames <= 0)
-		return;
-
-	if (channels == 2) {
-		memcpy(buf, srcbuf, frames * channels * sizeof(*srcbuf));
-	} else {
-		for (n = 0; n < frames * channels; n++) {
-			*p++ = srcbuf[n];
-			*p++ = srcbuf[n];
-		}
-	}
-
-}
-
 static int wma_seek_seconds(SceAsfParser * parser, double npt)
 {
 	u32 ms = (u32) (npt * 1000L);
@@ -300,12 +272,12 @@ static int wma_audiocallback(void *buf, unsigned int reqn, void *pdata)
 		avail_frame = g_buff_frame_size - g_buff_frame_start;
 
 		if (avail_frame >= snd_buf_frame_size) {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * 2], snd_buf_frame_size, 2);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * 2], snd_buf_frame_size, 2);
 			g_buff_frame_start += snd_buf_frame_size;
 			audio_buf += snd_buf_frame_size * 2;
 			snd_buf_frame_size = 0;
 		} else {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * 2], avail_frame, 2);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * 2], avail_frame, 2);
 			snd_buf_frame_size -= avail_frame;
 			audio_buf += avail_frame * 2;
 
@@ -1152,6 +1124,10 @@ static int wma_get_info(struct music_info *pinfo)
 	return generic_get_info(pinfo);
 }
 
+static const char *wma_exts[] = {
+	"asf", "wma", "wmv", NULL
+};
+
 /**
  * ǷΪMPCļĿǰֻļ׺
  *
@@ -1161,23 +1137,7 @@ static int wma_get_info(struct music_info *pinfo)
  */
 static int wma_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "asf") == 0) {
-			return 1;
-		}
-		if (stricmp(p, "wma") == 0) {
-			return 1;
-		}
-		if (stricmp(p, "wmv") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, wma_exts);
 }
 
 static struct music_ops wma_ops = {
@@ -1194,6 +1154,7 @@ static struct music_ops wma_ops = {
 	.resume = wma_resume,
 	.get_info = wma_get_info,
 	.probe = wma_probe,
+	.exts = wma_exts,
 	.next = NULL
 };
 
@@ -26,6 +26,7 @@
 #include "config.h"
 #include "scene.h"
 #include "xaudiolib.h"
+#include "pcmconv.h"
 #include "musicmgr.h"
 #include "musicdrv.h"
 #include "strsafe.h"
@@ -93,35 +94,6 @@ static int g_mode = 0;
 
 static buffered_reader_t *wv = NULL, *wvc = NULL;
 
-/**
- * ݵ
- *
- * @note ĸʽΪ˫16λ
- *
- * @param buf ָ
- * @param srcbuf ݻָ
- * @param frames ֡
- * @param channels 
- */
-static void send_to_sndbuf(void *buf, uint16_t * srcbuf, int frames, int channels)
-{
-	int n;
-	signed short *p = (signed short *) buf;
-
-	if (frames <= 0)
-		return;
-
-	if (channels == 2) {
-		memcpy(buf, srcbuf, frames * channels * sizeof(*srcbuf));
-	} else {
-		for (n = 0; n < frames * channels; n++) {
-			*p++ = srcbuf[n];
-			*p++ = srcbuf[n];
-		}
-	}
-
-}
-
 static int wv_seek_seconds(double seconds)
 {
 	if (g_info.duration == 0)
@@ -147,104 +119,6 @@ static int wv_seek_seconds(double seconds)
 	return 0;
 }
 
-/**
- * 
- *
- * @return
- * - -1 should exit
- * - 0 OK
- */
-static int handle_seek(void)
-{
-	u64 timer_end;
-
-	if (g_status == ST_FFORWARD) {
-		sceRtcGetCurrentTick(&timer_end);
-
-		generic_lock();
-		if (g_last_seek_is_forward) {
-			generic_unlock();
-
-			if (pspDiffTime(&timer_end, (u64 *) & g_last_seek_tick) <= 1.0) {
-				generic_lock();
-
-				if (g_seek_count > 0) {
-					g_play_time += g_seek_seconds;
-					g_seek_count--;
-				}
-
-				generic_unlock();
-
-				if (g_play_time >= g_info.duration) {
-					return -1;
-				}
-
-				sceKernelDelayThread(100000);
-			} else {
-				generic_lock();
-
-				g_seek_count = 0;
-				generic_set_playback(true);
-
-				if (wv_seek_seconds(g_play_time) < 0) {
-					generic_unlock();
-					return -1;
-				}
-
-				generic_set_status(ST_PLAYING);
-
-				generic_unlock();
-				sceKernelDelayThread(100000);
-			}
-		} else {
-			generic_unlock();
-		}
-	} else if (g_status == ST_FBACKWARD) {
-		sceRtcGetCurrentTick(&timer_end);
-
-		generic_lock();
-		if (!g_last_seek_is_forward) {
-			generic_unlock();
-
-			if (pspDiffTime(&timer_end, (u64 *) & g_last_seek_tick) <= 1.0) {
-				generic_lock();
-
-				if (g_seek_count > 0) {
-					g_play_time -= g_seek_seconds;
-					g_seek_count--;
-				}
-
-				generic_unlock();
-
-				if (g_play_time < 0) {
-					g_play_time = 0;
-				}
-
-				sceKernelDelayThread(100000);
-			} else {
-				generic_lock();
-
-				g_seek_count = 0;
-				generic_set_playback(true);
-
-				if (wv_seek_seconds(g_play_time) < 0) {
-					generic_unlock();
-					return -1;
-				}
-
-				generic_set_status(ST_PLAYING);
-
-				generic_unlock();
-				sceKernelDelayThread(100000);
-			}
-		} else {
-			generic_unlock();
-		}
-	}
-
-	return 0;
-}
-
 /**
  * WvPackֲŻص
  * 𽫽
@@ -265,7 +139,7 @@ static int wv_audiocallback(void *buf, unsigned int reqn, void *pdata)
 	UNUSED(pdata);
 
 	if (g_status != ST_PLAYING) {
-		if (handle_seek() == -1) {
+		if (generic_handle_seek(wv_seek_seconds) == -1) {
 			__end();
 			return -1;
 		}
@@ -279,22 +153,19 @@ static int wv_audiocallback(void *buf, unsigned int reqn, void *pdata)
 		avail_frame = g_buff_frame_size - g_buff_frame_start;
 
 		if (avail_frame >= snd_buf_frame_size) {
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], snd_buf_frame_size, g_info.channels);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], snd_buf_frame_size, g_info.channels);
 			g_buff_frame_start += snd_buf_frame_size;
 			audio_buf += snd_buf_frame_size * 2;
 			snd_buf_frame_size = 0;
 		} else {
 			int ret;
 
-			send_to_sndbuf(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], avail_frame, g_info.channels);
+			pcm_s16_to_stereo(audio_buf, &g_buff[g_buff_frame_start * g_info.channels], avail_frame, g_info.channels);
 			snd_buf_frame_size -= avail_frame;
 			audio_buf += avail_frame * 2;
 			ret = WavpackUnpackSamples(g_decoder, wv_buffer, MAX_BLOCK_SIZE);
 
 			if (ret > 0) {
-				int i;
-				uint8_t *output;
-
 				if (ret > g_buff_size) {
 					g_buff_size = ret;
 					g_buff = safe_realloc(g_buff, g_buff_size * g_info.channels * sizeof(*g_buff));
@@ -305,14 +176,7 @@ static int wv_audiocallback(void *buf, unsigned int reqn, void *pdata)
 					}
 				}
 
-				output = (uint8_t *) g_buff;
-
-				for (i = 0; i < ret; ++i) {
-					*output++ = wv_buffer[2 * i];
-					*output++ = wv_buffer[2 * i] >> 8;
-					*output++ = wv_buffer[2 * i + 1];
-					*output++ = wv_buffer[2 * i + 1] >> 8;
-				}
+				pcm_s32_to_s16(g_buff, wv_buffer, ret * g_info.channels, 0);
 			} else {
 				__end();
 				return -1;
@@ -796,6 +660,10 @@ static int wv_get_info(struct music_info *pinfo)
 	return generic_get_info(pinfo);
 }
 
+static const char *wv_exts[] = {
+	"wv", NULL
+};
+
 /**
  * ǷΪWvPackļĿǰֻļ׺
  *
@@ -805,17 +673,7 @@ static int wv_get_info(struct music_info *pinfo)
  */
 static int wv_probe(const char *spath)
 {
-	const char *p;
-
-	p = utils_fileext(spath);
-
-	if (p) {
-		if (stricmp(p, "wv") == 0) {
-			return 1;
-		}
-	}
-
-	return 0;
+	return musicdrv_has_ext(spath, wv_exts);
 }
 
 static int wv_set_opt(const char *unused, const char *values)
@@ -869,6 +727,7 @@ static struct music_ops wv_ops = {
 	.resume = wv_resume,
 	.get_info = wv_get_info,
 	.probe = wv_probe,
+	.exts = wv_exts,
 	.next = NULL
 };
 
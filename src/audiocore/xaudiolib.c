@@ -38,9 +38,13 @@
 #include <pspaudio.h>
 #include <malloc.h>
 
+#include "common/datatype.h"
 #include "xaudiolib.h"
+#include "resample.h"
 #include "pspvaudio.h"
 #include "conf.h"
+#include "thread_lock.h"
+#include "dbg.h"
 #ifdef DMALLOC
 #include "dmalloc.h"
 #endif
@@ -48,8 +52,39 @@
 #define THREAD_STACK_SIZE (64 * 1024)
 
 static int g_sample_size = PSP_DEFAULT_NUM_AUDIO_SAMPLES;
+static int g_frequency = 44100;
 static bool g_use_vaudio = false;
 
+/**
+ * Ӳֵ֧ĲʾתΪ
+ */
+static p_resampler g_resampler = NULL;
+
+/**
+ * ԤĲ, 0ΪδԤ
+ */
+static unsigned int g_reserved_freq = 0;
+
+/**
+ * Ŀлʱ
+ */
+static volatile bool g_hold = false;
+
+/**
+ * , ûвӹ
+ */
+static bool g_detached = false;
+
+/**
+ * xAudioInitǰù֡С
+ */
+static bool g_frame_size_set = false;
+
+/**
+ * صǰʵд֡
+ */
+static volatile unsigned int g_tail_frames = 0;
+
 int setFrequency(unsigned short samples, unsigned short freq, char car)
 {
 	if (g_use_vaudio)
@@ -60,6 +95,8 @@ int setFrequency(unsigned short samples, unsigned short freq, char car)
 
 int xAudioReleaseAudio(void)
 {
+	g_reserved_freq = 0;
+
 	if (g_use_vaudio) {
 		int ret;
 
@@ -86,6 +123,44 @@ static short audio_sndbuf[PSP_NUM_AUDIO_CHANNELS][2][PSP_MAX_NUM_AUDIO_SAMPLES][
 static psp_audio_channelinfo AudioStatus[PSP_NUM_AUDIO_CHANNELS];
 static volatile int audio_terminate = 0;
 
+/**
+ * ֮߳߳PCMλ
+ *
+ * @note ߵ: wposֻɽ߳޸, rposֻ߳޸
+ * @note ߳дxAudioFlush֮lock, ǰʼݲд
+ * @note ֡Ϊλ, Ŀлʱһݽһһ֮֡
+ */
+typedef struct
+{
+	/** , count֡ */
+	u32 *buf;
+	/** ֡, Ϊ2 */
+	unsigned count;
+	/** ̵߳ʱ, g_sample_size֡ */
+	u32 *fill;
+	volatile unsigned wpos;
+	volatile unsigned rpos;
+	/** , ̰߳rposƽflush_pos */
+	volatile unsigned flush_pos;
+	volatile int flush;
+	/** ÿռ1, ߳̾ݴ˶ǰʼ */
+	volatile unsigned flush_gen;
+	struct psp_mutex_t lock;
+	/** صѱ沥Ž */
+	volatile int eof;
+	/** Ҫ߳˳ */
+	volatile int stop;
+	/** ͣ, һβ */
+	volatile int gate;
+	/** ȡյĴ */
+	volatile unsigned underruns;
+	int primed;
+	int threadhandle;
+	volatile int threadactive;
+} t_pcm_ring;
+
+static t_pcm_ring pcm_ring[PSP_NUM_AUDIO_CHANNELS];
+
 void xAudioSetVolume(int channel, int left, int right)
 {
 	if (channel >= PSP_NUM_AUDIO_CHANNELS)
@@ -132,23 +207,271 @@ int xAudioOutBlocking(unsigned int channel, unsigned int vol1, unsigned int vol2
 
 static SceUID play_sema = -1;
 
+/**
+ * òصһ, Ҫʱز
+ *
+ * @param frames д֡, صʱܲg_sample_size
+ *
+ * @return صķֵ
+ */
+static int audio_fill(int channel, xAudioCallback_t callback, void *buf, int *frames)
+{
+	s16 *out = buf;
+	int n = 0, ret;
+
+	if (g_resampler == NULL) {
+		g_tail_frames = 0;
+		ret = callback(buf, g_sample_size, AudioStatus[channel].pdata);
+		*frames = ret == 0 ? g_sample_size : min((int) g_tail_frames, g_sample_size);
+
+		return ret;
+	}
+
+	while (1) {
+		s16 *in;
+		int in_frames;
+
+		n += resample_run(g_resampler, out + n * 2, g_sample_size - n);
+
+		if (n >= g_sample_size) {
+			ret = 0;
+			break;
+		}
+
+		in = resample_input(g_resampler, &in_frames);
+		g_tail_frames = 0;
+		ret = callback(in, in_frames, AudioStatus[channel].pdata);
+
+		if (ret != 0) {
+			resample_commit(g_resampler, min((int) g_tail_frames, in_frames));
+			n += resample_run(g_resampler, out + n * 2, g_sample_size - n);
+			break;
+		}
+
+		resample_commit(g_resampler, in_frames);
+	}
+
+	*frames = n;
+
+	return ret;
+}
+
+static void ring_write(t_pcm_ring * ring, const u32 * src, unsigned frames)
+{
+	unsigned off = ring->wpos & (ring->count - 1);
+	unsigned n = min(frames, ring->count - off);
+
+	memcpy(ring->buf + off, src, n * sizeof(u32));
+	memcpy(ring->buf, src + n, (frames - n) * sizeof(u32));
+	__sync_synchronize();
+	ring->wpos += frames;
+}
+
+/**
+ * ߳: òص价λ
+ */
+static int AudioDecodeThread(int args, void *argp)
+{
+	int channel = *(int *) argp;
+	t_pcm_ring *ring = &pcm_ring[channel];
+
+	ring->threadactive = 1;
+	while (audio_terminate == 0 && ring->stop == 0) {
+		xAudioCallback_t callback;
+		int ret, frames;
+		unsigned gen;
+
+		callback = AudioStatus[channel].callback;
+		if (callback == NULL || ring->gate || ring->count - (ring->wpos - ring->rpos) < g_sample_size) {
+			// , ȴʱ
+			sceKernelDelayThread(g_sample_size * 500 / (g_frequency / 1000));
+			continue;
+		}
+
+		gen = ring->flush_gen;
+		ret = audio_fill(channel, callback, ring->fill, &frames);
+
+		// ڼ䱻ʱ, Щڶλ֮ͣǰ, 
+		xr_lock(&ring->lock);
+		if (gen == ring->flush_gen)
+			ring_write(ring, ring->fill, frames);
+		xr_unlock(&ring->lock);
+
+		if (ret != 0) {
+			ring->eof = 1;
+			break;
+		}
+	}
+	ring->threadactive = 0;
+	sceKernelExitThread(0);
+	return 0;
+}
+
+/**
+ * ӻλȡݵ
+ *
+ * @return ȡ֡
+ */
+static int ring_read(t_pcm_ring * ring, u32 * dst, unsigned frames)
+{
+	unsigned off, n;
+
+	if (ring->flush) {
+		unsigned pos;
+
+		ring->flush = 0;
+		__sync_synchronize();
+		pos = ring->flush_pos;
+
+		if ((int) (pos - ring->rpos) > 0)
+			ring->rpos = pos;
+
+		ring->primed = 0;
+	}
+
+	frames = min(frames, ring->wpos - ring->rpos);
+
+	if (frames == 0)
+		return 0;
+
+	__sync_synchronize();
+	off = ring->rpos & (ring->count - 1);
+	n = min(frames, ring->count - off);
+	memcpy(dst, ring->buf + off, n * sizeof(u32));
+	memcpy(dst + n, ring->buf, (frames - n) * sizeof(u32));
+	__sync_synchronize();
+	ring->rpos += frames;
+	ring->primed = 1;
+
+	return frames;
+}
+
+static int ring_start_decoder(int channel)
+{
+	t_pcm_ring *ring = &pcm_ring[channel];
+	char str[32];
+
+	ring->stop = 0;
+	ring->eof = 0;
+	// ߳̿ʼǰΪ, ֹͣʱ©
+	ring->threadactive = 1;
+
+	strcpy(str, "audiod0");
+	str[6] = '0' + channel;
+	ring->threadhandle = sceKernelCreateThread(str, (void *) &AudioDecodeThread, 0x13, THREAD_STACK_SIZE, PSP_THREAD_ATTR_USER, NULL);
+
+	if (ring->threadhandle < 0 || sceKernelStartThread(ring->threadhandle, sizeof(channel), &channel) != 0) {
+		if (ring->threadhandle >= 0)
+			sceKernelDeleteThread(ring->threadhandle);
+		ring->threadhandle = -1;
+		ring->threadactive = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void ring_stop_decoder(int channel)
+{
+	t_pcm_ring *ring = &pcm_ring[channel];
+
+	if (ring->threadhandle < 0)
+		return;
+
+	ring->stop = 1;
+	while (ring->threadactive)
+		sceKernelDelayThread(10000);
+	sceKernelDeleteThread(ring->threadhandle);
+	ring->threadhandle = -1;
+}
+
+static int ring_start(int channel)
+{
+	t_pcm_ring *ring = &pcm_ring[channel];
+	unsigned frames;
+
+	memset(ring, 0, sizeof(*ring));
+	ring->threadhandle = -1;
+	xr_lock_init(&ring->lock);
+
+	// ߲48000Hz֡, ȡ2Աλû
+	frames = max(XAUDIO_RING_MS * 48, g_sample_size * 2);
+
+	for (ring->count = 1; ring->count < frames; ring->count <<= 1);
+
+	ring->buf = memalign(64, ring->count * sizeof(u32));
+	ring->fill = memalign(64, g_sample_size * sizeof(u32));
+
+	if (ring->buf == NULL || ring->fill == NULL || ring_start_decoder(channel) < 0) {
+		free(ring->buf);
+		free(ring->fill);
+		ring->buf = ring->fill = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void ring_stop(int channel)
+{
+	t_pcm_ring *ring = &pcm_ring[channel];
+
+	// ֻн߳ɹʱbufŲΪ
+	if (ring->buf == NULL)
+		return;
+
+	ring_stop_decoder(channel);
+
+	dbg_printf(d, "%s: channel %d, %u underruns", __func__, channel, ring->underruns);
+	free(ring->buf);
+	free(ring->fill);
+	ring->buf = ring->fill = NULL;
+	xr_lock_destroy(&ring->lock);
+}
+
 static int AudioChannelThread(int args, void *argp)
 {
 	volatile int bufidx = 0;
 	int channel = *(int *) argp;
+	t_pcm_ring *ring = &pcm_ring[channel];
 
 	AudioStatus[channel].threadactive = 1;
 	while (audio_terminate == 0) {
 		void *bufptr = &audio_sndbuf[channel][bufidx];
 		xAudioCallback_t callback;
+		int n = 0, last = 0;
 
 		callback = AudioStatus[channel].callback;
-		if (callback) {
-			int ret = callback(bufptr, g_sample_size,
-							   AudioStatus[channel].pdata);
+		if (ring->buf != NULL) {
+			// ֻ߳ӻλ帴, ٽ
+			n = ring_read(ring, bufptr, g_sample_size);
+
+			if (n < g_sample_size && (!ring->eof || g_hold)) {
+				// Ƚ׷ϻһ, ʱ
+				int wait = g_sample_size * 500 / (g_frequency / 1000);
+
+				while (n < g_sample_size && wait > 0 && audio_terminate == 0) {
+					sceKernelDelayThread(1000);
+					wait -= 1000;
+					n += ring_read(ring, (u32 *) bufptr + n, g_sample_size - n);
+				}
+			}
 
-			if (ret != 0) {
+			if (n == 0 && ring->eof && !g_hold && !ring->gate)
 				break;
+
+			if (n < g_sample_size) {
+				if (!ring->eof && !ring->gate && ring->primed && callback)
+					ring->underruns++;
+				xAudioClearSndBuf((u32 *) bufptr + n, g_sample_size - n);
+			}
+		} else if (callback) {
+			if (audio_fill(channel, callback, bufptr, &n) != 0) {
+				if (n == 0)
+					break;
+				// صǰдĲ
+				xAudioClearSndBuf((u32 *) bufptr + n, g_sample_size - n);
+				last = 1;
 			}
 		} else {
 			unsigned int *ptr = bufptr;
@@ -162,15 +485,45 @@ static int AudioChannelThread(int args, void *argp)
 		audioOutpuBlocking(AudioStatus[0].volumeright, bufptr);
 		sceKernelSignalSema(play_sema, 1);
 		bufidx = (bufidx ? 0 : 1);
+
+		if (last)
+			break;
 	}
 	AudioStatus[channel].threadactive = 0;
 	sceKernelExitThread(0);
 	return 0;
 }
 
-int xAudioSetFrequency(unsigned short freq)
+/**
+ * ȴλеݲ
+ */
+static void ring_drain(void)
+{
+	int i;
+
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
+		t_pcm_ring *ring = &pcm_ring[i];
+
+		while (ring->buf != NULL && ring->wpos != ring->rpos && AudioStatus[i].threadactive)
+			sceKernelDelayThread(10000);
+	}
+}
+
+/**
+ * ò
+ *
+ * @note Ӳֵ֧Ĳ(88200, 96000)ز4410048000,
+ * ûصǰ
+ * @note ʲʱԤ, ӹܵ˿޷ν
+ *
+ * @param freq ֲ
+ *
+ * @return ɹ0
+ */
+int xAudioSetFrequency(unsigned int freq)
 {
 	int ret = 0;
+	unsigned int out_freq = freq;
 
 	switch (freq) {
 		case 8000:
@@ -184,22 +537,165 @@ int xAudioSetFrequency(unsigned short freq)
 		case 44100:
 			break;
 		default:
-			return -1;
+			if (freq < 4000 || freq > 192000)
+				return -1;
+			out_freq = freq % 11025 == 0 ? 44100 : 48000;
+			break;
 	}
+
+	// һβ밴ԭʲ
+	if (out_freq != g_reserved_freq)
+		ring_drain();
+
 	sceKernelWaitSema(play_sema, 1, 0);
-	xAudioReleaseAudio();
-	if (setFrequency(g_sample_size, freq, 2) < 0)
-		ret = -1;
+	if (out_freq != g_reserved_freq) {
+		xAudioReleaseAudio();
+		if (setFrequency(g_sample_size, out_freq, 2) < 0)
+			ret = -1;
+		else {
+			g_reserved_freq = out_freq;
+			g_frequency = out_freq;
+		}
+	}
+
+	resample_close(g_resampler);
+	g_resampler = NULL;
+
+	if (ret == 0 && out_freq != freq) {
+		g_resampler = resample_open(freq, out_freq, config.resample_quality);
+
+		if (g_resampler == NULL)
+			ret = -1;
+		else
+			dbg_printf(d, "%s: resampling %u Hz to %u Hz, quality %d", __func__, freq, out_freq, config.resample_quality);
+	}
 	sceKernelSignalSema(play_sema, 1);
 	return ret;
 }
 
+/**
+ * ͷ߳
+ */
+static void audio_shutdown(void)
+{
+	int i;
+
+	// ѵβʱȲ껺е
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
+		t_pcm_ring *ring = &pcm_ring[i];
+
+		while (ring->buf != NULL && ring->eof && ring->wpos != ring->rpos && AudioStatus[i].threadactive)
+			sceKernelDelayThread(10000);
+	}
+
+	audio_ready = 0;
+	audio_terminate = 1;
+
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
+		if (AudioStatus[i].threadhandle != -1) {
+			xAudioReleaseAudio();
+			//sceKernelWaitThreadEnd(AudioStatus[i].threadhandle,NULL);
+			while (AudioStatus[i].threadactive)
+				sceKernelDelayThread(100000);
+			sceKernelDeleteThread(AudioStatus[i].threadhandle);
+		}
+		AudioStatus[i].threadhandle = -1;
+		ring_stop(i);
+	}
+
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
+		if (AudioStatus[i].handle != -1) {
+			xAudioReleaseAudio();
+			AudioStatus[i].handle = -1;
+		}
+	}
+	if (play_sema >= 0) {
+		sceKernelDeleteSema(play_sema);
+		play_sema = -1;
+	}
+
+	resample_close(g_resampler);
+	g_resampler = NULL;
+
+	g_detached = false;
+	g_sample_size = PSP_DEFAULT_NUM_AUDIO_SAMPLES;
+}
+
+/**
+ * ֹͣ, ߳
+ *
+ * @return ɹ0, ֹͣʱ-1
+ */
+static int audio_detach(void)
+{
+	int i;
+
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
+		if (!AudioStatus[i].threadactive || pcm_ring[i].buf == NULL)
+			return -1;
+	}
+
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
+		ring_stop_decoder(i);
+		AudioStatus[i].callback = 0;
+		AudioStatus[i].pdata = 0;
+	}
+
+	g_detached = true;
+
+	return 0;
+}
+
+/**
+ * ӹһ
+ *
+ * @note µĽ߳xAudioHold(0)֮ǰд, һβճ
+ *
+ * @return ɹ0
+ */
+static int audio_attach(void)
+{
+	int i;
+
+	if (!g_frame_size_set && g_sample_size != PSP_DEFAULT_NUM_AUDIO_SAMPLES)
+		return -1;
+
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
+		if (!AudioStatus[i].threadactive || pcm_ring[i].buf == NULL)
+			return -1;
+	}
+
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
+		AudioStatus[i].callback = 0;
+		AudioStatus[i].pdata = 0;
+		pcm_ring[i].gate = 1;
+
+		if (ring_start_decoder(i) < 0)
+			return -1;
+	}
+
+	g_detached = false;
+	g_frame_size_set = false;
+	audio_ready = 1;
+
+	return 0;
+}
+
 int xAudioInit()
 {
 	int i, ret;
 	int failed = 0;
 	char str[32];
 
+	if (g_detached) {
+		if (audio_attach() == 0) {
+			dbg_printf(d, "%s: took over the kept channel", __func__);
+			return 0;
+		}
+
+		audio_shutdown();
+	}
+
 	xAudioReleaseAudio();
 	audio_terminate = 0;
 	audio_ready = 0;
@@ -236,6 +732,11 @@ int xAudioInit()
 	audio_ready = 1;
 	strcpy(str, "audiot0");
 	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
+		// λʧʱ˻߳н
+		if (XAUDIO_RING_MS > 0 && ring_start(i) < 0) {
+			dbg_printf(d, "%s: ring buffer for channel %d unavailable", __func__, i);
+		}
+
 		str[6] = '0' + i;
 		AudioStatus[i].threadhandle = sceKernelCreateThread(str, (void *) &AudioChannelThread, 0x12, THREAD_STACK_SIZE, PSP_THREAD_ATTR_USER, NULL);
 		if (AudioStatus[i].threadhandle < 0) {
@@ -259,6 +760,7 @@ int xAudioInit()
 				sceKernelDeleteThread(AudioStatus[i].threadhandle);
 			}
 			AudioStatus[i].threadhandle = -1;
+			ring_stop(i);
 		}
 		audio_ready = 0;
 		return -1;
@@ -269,45 +771,86 @@ int xAudioInit()
 		sceVaudioSetAlcMode(config.alc_mode);
 	}
 
+	g_frame_size_set = false;
+
 	return 0;
 }
 
 void xAudioEndPre()
 {
-	audio_ready = 0;
-	audio_terminate = 1;
+	int i, ring = 0;
+
+	// лλʱֹֻͣ, ѽ̲߳
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
+		if (pcm_ring[i].buf != NULL) {
+			pcm_ring[i].stop = 1;
+			ring = 1;
+		}
+	}
+
+	if (!ring) {
+		audio_ready = 0;
+		audio_terminate = 1;
+	}
 }
 
 void xAudioEnd()
+{
+	if (g_hold && (g_detached || audio_detach() == 0)) {
+		dbg_printf(d, "%s: channel kept for the next track", __func__);
+		return;
+	}
+
+	audio_shutdown();
+}
+
+/**
+ * Ŀлʱ
+ *
+ * @note ڼxAudioEndֹֻͣ, ̼߳Żе,
+ * һxAudioInitӹܸ
+ * @note ʱʼһ, ûвӹʱͷ
+ *
+ * @param hold 1Ϊ, 0Ϊ
+ */
+void xAudioHold(int hold)
 {
 	int i;
 
-	audio_ready = 0;
-	audio_terminate = 1;
+	g_hold = hold;
 
-	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
-		if (AudioStatus[i].threadhandle != -1) {
-			xAudioReleaseAudio();
-			//sceKernelWaitThreadEnd(AudioStatus[i].threadhandle,NULL);
-			while (AudioStatus[i].threadactive)
-				sceKernelDelayThread(100000);
-			sceKernelDeleteThread(AudioStatus[i].threadhandle);
-		}
-		AudioStatus[i].threadhandle = -1;
-	}
+	if (hold)
+		return;
 
-	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
-		if (AudioStatus[i].handle != -1) {
-			xAudioReleaseAudio();
-			AudioStatus[i].handle = -1;
-		}
-	}
-	if (play_sema >= 0) {
-		sceKernelDeleteSema(play_sema);
-		play_sema = -1;
+	if (g_detached) {
+		audio_shutdown();
+		return;
 	}
 
-	g_sample_size = PSP_DEFAULT_NUM_AUDIO_SAMPLES;
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++)
+		pcm_ring[i].gate = 0;
+}
+
+/**
+ * Ƿ񱻱ŵȴһӹ
+ *
+ * @return Ƿ1
+ */
+int xAudioIsDetached(void)
+{
+	return g_detached;
+}
+
+/**
+ * λصڽǰʵд֡
+ *
+ * @note ڻصط0ǰ, ôдݱ
+ *
+ * @param frames ֡
+ */
+void xAudioSetTailFrames(unsigned int frames)
+{
+	g_tail_frames = frames;
 }
 
 /**
@@ -321,6 +864,90 @@ void xAudioClearSndBuf(void *buf, int frames)
 	memset(buf, 0, frames * 2 * 2);
 }
 
+/**
+ * λδ֡
+ *
+ * @note յĲֲ
+ */
+static unsigned ring_queued(t_pcm_ring * ring)
+{
+	unsigned rpos = ring->rpos;
+
+	if (ring->buf == NULL)
+		return 0;
+
+	if (ring->flush && (int) (ring->flush_pos - rpos) > 0)
+		rpos = ring->flush_pos;
+
+	return ring->wpos - rpos;
+}
+
+/**
+ * λδ
+ *
+ * @note ״̬ıʱ, ʹͣЧ
+ * @note һβʱ
+ * @note ߳ڽһҲһ
+ *
+ * @return 
+ */
+double xAudioFlush(void)
+{
+	unsigned frames = 0;
+	int i;
+
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++) {
+		t_pcm_ring *ring = &pcm_ring[i];
+
+		if (ring->buf == NULL || g_detached || ring->gate)
+			continue;
+
+		xr_lock(&ring->lock);
+		frames = max(frames, ring_queued(ring));
+		ring->flush_pos = ring->wpos;
+		ring->flush_gen++;
+		__sync_synchronize();
+		ring->flush = 1;
+		xr_unlock(&ring->lock);
+	}
+
+	return (double) frames / g_frequency;
+}
+
+/**
+ * ѽ뵫δ
+ *
+ * @note g_play_timeǽλ, ȥֵλ
+ *
+ * @return 
+ */
+double xAudioGetQueuedSeconds(void)
+{
+	unsigned frames = 0;
+	int i;
+
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++)
+		frames = max(frames, ring_queued(&pcm_ring[i]));
+
+	return (double) frames / g_frequency;
+}
+
+/**
+ * õλȡյĴ
+ *
+ * @return Ĵ
+ */
+unsigned int xAudioGetUnderruns(void)
+{
+	unsigned int n = 0;
+	int i;
+
+	for (i = 0; i < PSP_NUM_AUDIO_CHANNELS; i++)
+		n += pcm_ring[i].underruns;
+
+	return n;
+}
+
 void *xAudioAlloc(size_t align, size_t bytes)
 {
 	void *p = memalign(align, bytes);
@@ -338,8 +965,15 @@ void xAudioFree(void *p)
 
 void xAudioSetFrameSize(int size)
 {
-	if (size <= PSP_MAX_NUM_AUDIO_SAMPLES)
-		g_sample_size = size;
+	if (size > PSP_MAX_NUM_AUDIO_SAMPLES)
+		return;
+
+	// ֡Сͬ, ޷ӹ
+	if (g_detached && size != g_sample_size)
+		audio_shutdown();
+
+	g_sample_size = size;
+	g_frame_size_set = true;
 }
 
 void xAudioSetUseVaudio(unsigned char use_vaudio)
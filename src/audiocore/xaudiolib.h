@@ -49,6 +49,12 @@ extern "C"
 #define PSP_MAX_NUM_AUDIO_SAMPLES (1024*4)
 #define PSP_VOLUME_MAX 0x8000
 
+/** Length of the PCM ring buffer between decode and output threads,
+ * in milliseconds. 0 decodes in the output thread. */
+#define XAUDIO_RING_MS 500
+
+	/** Fills reqn frames and returns 0, or returns nonzero at the end of
+	 * the stream after reporting a partial fill with xAudioSetTailFrames(). */
 	typedef int (*xAudioCallback_t) (void *buf, unsigned int reqn, void *pdata);
 
 	typedef struct
@@ -72,9 +78,16 @@ extern "C"
 	void xAudioChannelThreadCallback(int channel, void *buf, unsigned int reqn);
 	void xAudioSetChannelCallback(int channel, xAudioCallback_t callback, void *pdata);
 	int xAudioOutBlocking(unsigned int channel, unsigned int vol1, unsigned int vol2, void *buf);
-	int xAudioSetFrequency(unsigned short freq);
+	int xAudioSetFrequency(unsigned int freq);
+
+	void xAudioHold(int hold);
+	int xAudioIsDetached(void);
+	void xAudioSetTailFrames(unsigned int frames);
 
 	void xAudioClearSndBuf(void *buf, int frames);
+	double xAudioFlush(void);
+	double xAudioGetQueuedSeconds(void);
+	unsigned int xAudioGetUnderruns(void);
 	void *xAudioAlloc(size_t align, size_t bytes);
 	void xAudioFree(void *p);
 	void xAudioSetFrameSize(int size);
@@ -30,6 +30,7 @@ struct _bookmark
 } __attribute__ ((packed));
 typedef struct _bookmark t_bookmark, *p_bookmark;
 
+extern u32 bookmark_encode(const char *filename);
 extern void bookmark_init(const char *fn);
 extern p_bookmark bookmark_open(const char *filename);
 extern void bookmark_save(p_bookmark bm);
@@ -0,0 +1,344 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pspkernel.h>
+#include <chm_lib.h>
+#include "common/utils.h"
+#include "hash.h"
+#include "thread_lock.h"
+#include "chmcache.h"
+#include "dbg.h"
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+/** ÿCHMLZXѹ(ÿ32KB) */
+#define CHMCACHE_BLOCKS_CACHED 16
+
+/** ·ַÿС */
+#define CHMCACHE_POOL_SIZE (16 * 1024)
+
+#define CHMCACHE_ENTRY_STEP 1024
+
+typedef struct _chmcache_entry
+{
+	LONGUINT64 start;
+	LONGUINT64 length;
+	int space;
+	int flags;
+	const char *path;
+} chmcache_entry;
+
+typedef struct _chmcache_pool
+{
+	struct _chmcache_pool *next;
+	size_t used;
+	char data[CHMCACHE_POOL_SIZE];
+} chmcache_pool;
+
+static struct psp_mutex_t chmcache_l;
+static struct chmFile *cur_chm = NULL;
+static char cur_path[PATH_MAX];
+static SceOff cur_size = 0;
+static ScePspDateTime cur_mtime;
+
+static chmcache_entry *entries = NULL;
+static size_t entry_cnt = 0, entry_cap = 0;
+static struct hash_control *entry_hash = NULL;
+static chmcache_pool *pool = NULL;
+
+/** Ŀ¼״̬: 0 δ, 1 Ѽ, -1  */
+static int dir_state = 0;
+
+static char *pool_strdup(const char *s)
+{
+	size_t len = strlen(s) + 1;
+	char *p;
+
+	if (len > CHMCACHE_POOL_SIZE)
+		return NULL;
+
+	if (pool == NULL || pool->used + len > CHMCACHE_POOL_SIZE) {
+		chmcache_pool *n = malloc(sizeof(*n));
+
+		if (n == NULL)
+			return NULL;
+
+		n->next = pool;
+		n->used = 0;
+		pool = n;
+	}
+
+	p = &pool->data[pool->used];
+	memcpy(p, s, len);
+	pool->used += len;
+
+	return p;
+}
+
+static void free_dir(void)
+{
+	while (pool != NULL) {
+		chmcache_pool *n = pool->next;
+
+		free(pool);
+		pool = n;
+	}
+
+	if (entry_hash != NULL) {
+		hash_die(entry_hash);
+		entry_hash = NULL;
+	}
+
+	free(entries);
+	entries = NULL;
+	entry_cnt = entry_cap = 0;
+	dir_state = 0;
+}
+
+static void reset_chm(void)
+{
+	if (cur_chm != NULL) {
+		chm_close(cur_chm);
+		cur_chm = NULL;
+	}
+
+	cur_path[0] = '\0';
+	free_dir();
+}
+
+/**
+ * chm_enumerateĹ
+ */
+static int get_entry_flags(const char *path)
+{
+	size_t len = strlen(path);
+	int flags;
+
+	if (path[0] == '/') {
+		if (path[1] == '#' || path[1] == '$')
+			flags = CHM_ENUMERATE_SPECIAL;
+		else
+			flags = CHM_ENUMERATE_NORMAL;
+	} else
+		flags = CHM_ENUMERATE_META;
+
+	if (len > 0 && path[len - 1] == '/')
+		flags |= CHM_ENUMERATE_DIRS;
+	else
+		flags |= CHM_ENUMERATE_FILES;
+
+	return flags;
+}
+
+static int add_entry(struct chmFile *h, struct chmUnitInfo *ui, void *context)
+{
+	chmcache_entry *e;
+
+	if (entry_cnt >= entry_cap) {
+		chmcache_entry *p = safe_realloc(entries, sizeof(*entries) * (entry_cap + CHMCACHE_ENTRY_STEP));
+
+		if (p == NULL)
+			return CHM_ENUMERATOR_FAILURE;
+
+		entries = p;
+		entry_cap += CHMCACHE_ENTRY_STEP;
+	}
+
+	e = &entries[entry_cnt];
+	e->path = pool_strdup(ui->path);
+
+	if (e->path == NULL)
+		return CHM_ENUMERATOR_FAILURE;
+
+	e->start = ui->start;
+	e->length = ui->length;
+	e->space = ui->space;
+	e->flags = get_entry_flags(ui->path);
+	entry_cnt++;
+
+	return CHM_ENUMERATOR_CONTINUE;
+}
+
+/**
+ * öһCHMĿ¼, ·ɢб
+ */
+static void load_dir(void)
+{
+	size_t i;
+
+	if (chm_enumerate(cur_chm, CHM_ENUMERATE_ALL, add_entry, NULL) == 0) {
+		dbg_printf(d, "%s: enumerate %s failed", __func__, cur_path);
+		free_dir();
+		dir_state = -1;
+		return;
+	}
+
+	entry_hash = hash_new();
+
+	if (entry_hash == NULL) {
+		free_dir();
+		dir_state = -1;
+		return;
+	}
+
+	for (i = 0; i < entry_cnt; ++i) {
+		hash_insert(entry_hash, entries[i].path, (PTR) (i + 1));
+	}
+
+	dir_state = 1;
+	dbg_printf(d, "%s: %u entries cached for %s", __func__, (unsigned) entry_cnt, cur_path);
+}
+
+static void fill_unitinfo(const chmcache_entry * e, struct chmUnitInfo *ui)
+{
+	ui->start = e->start;
+	ui->length = e->length;
+	ui->space = e->space;
+	ui->flags = e->flags;
+	STRCPY_S(ui->path, e->path);
+}
+
+static bool is_same_file(const char *chmfile, SceIoStat * sta)
+{
+	if (cur_chm == NULL || strcmp(cur_path, chmfile) != 0)
+		return false;
+
+	return sta->st_size == cur_size && memcmp(&sta->st_mtime, &cur_mtime, sizeof(cur_mtime)) == 0;
+}
+
+struct chmFile *chmcache_open(const char *chmfile)
+{
+	SceIoStat sta;
+
+	if (chmfile == NULL)
+		return NULL;
+
+	xr_lock(&chmcache_l);
+
+	memset(&sta, 0, sizeof(sta));
+	sceIoGetstat(chmfile, &sta);
+
+	if (is_same_file(chmfile, &sta))
+		return cur_chm;
+
+	reset_chm();
+	cur_chm = chm_open(chmfile);
+
+	if (cur_chm == NULL) {
+		xr_unlock(&chmcache_l);
+		return NULL;
+	}
+
+	chm_set_param(cur_chm, CHM_PARAM_MAX_BLOCKS_CACHED, CHMCACHE_BLOCKS_CACHED);
+	STRCPY_S(cur_path, chmfile);
+	cur_size = sta.st_size;
+	cur_mtime = sta.st_mtime;
+
+	return cur_chm;
+}
+
+void chmcache_close(struct chmFile *chm)
+{
+	if (chm == NULL)
+		return;
+
+	xr_unlock(&chmcache_l);
+}
+
+int chmcache_resolve(struct chmFile *chm, const char *objpath, struct chmUnitInfo *ui)
+{
+	size_t idx;
+
+	if (chm != cur_chm)
+		return chm_resolve_object(chm, objpath, ui);
+
+	if (dir_state == 0)
+		load_dir();
+
+	if (dir_state > 0) {
+		idx = (size_t) hash_find(entry_hash, objpath);
+
+		if (idx != 0) {
+			fill_unitinfo(&entries[idx - 1], ui);
+			return CHM_RESOLVE_SUCCESS;
+		}
+	}
+
+	// CHM·ִСд, ɢбδʱchmlib
+	return chm_resolve_object(chm, objpath, ui);
+}
+
+int chmcache_enumerate(const char *chmfile, int what, CHM_ENUMERATOR e, void *context)
+{
+	struct chmFile *chm;
+	struct chmUnitInfo ui;
+	size_t i;
+	int ret = 1;
+
+	chm = chmcache_open(chmfile);
+
+	if (chm == NULL)
+		return 0;
+
+	if (dir_state == 0)
+		load_dir();
+
+	if (dir_state < 0) {
+		ret = chm_enumerate(chm, what, e, context);
+		chmcache_close(chm);
+		return ret;
+	}
+
+	for (i = 0; i < entry_cnt; ++i) {
+		int status;
+
+		if (!(entries[i].flags & what & (CHM_ENUMERATE_NORMAL | CHM_ENUMERATE_META | CHM_ENUMERATE_SPECIAL)))
+			continue;
+
+		if (!(entries[i].flags & what & (CHM_ENUMERATE_FILES | CHM_ENUMERATE_DIRS)))
+			continue;
+
+		fill_unitinfo(&entries[i], &ui);
+		status = (*e) (chm, &ui, context);
+
+		if (status == CHM_ENUMERATOR_FAILURE) {
+			ret = 0;
+			break;
+		}
+
+		if (status == CHM_ENUMERATOR_SUCCESS)
+			break;
+	}
+
+	chmcache_close(chm);
+
+	return ret;
+}
+
+void chmcache_free(void)
+{
+	xr_lock(&chmcache_l);
+	reset_chm();
+	xr_unlock(&chmcache_l);
+}
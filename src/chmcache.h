@@ -0,0 +1,77 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef CHMCACHE_H
+#define CHMCACHE_H
+
+#include <chm_lib.h>
+
+/**
+ * CHMļ
+ *
+ * @note ͬһCHMļľᱻ, LZXѹ黺ڶζȡ֮䱣
+ * @note ɹغCHM, chmcache_closeͷ
+ *
+ * @param chmfile CHMļ·
+ *
+ * @return CHM, ʧܷNULL
+ */
+struct chmFile *chmcache_open(const char *chmfile);
+
+/**
+ * ͷchmcache_openõľ
+ *
+ * @param chm CHM
+ */
+void chmcache_close(struct chmFile *chm);
+
+/**
+ * Ŀ¼вҶ
+ *
+ * @note ״βʱöٲĿ¼, ֮Ϊɢв
+ *
+ * @param chm chmcache_openõľ
+ * @param objpath ·
+ * @param ui صĶϢ
+ *
+ * @return CHM_RESOLVE_SUCCESSCHM_RESOLVE_FAILURE
+ */
+int chmcache_resolve(struct chmFile *chm, const char *objpath, struct chmUnitInfo *ui);
+
+/**
+ * öCHMļеĶ
+ *
+ * @note chm_enumerateͬ, ʹûĿ¼
+ *
+ * @param chmfile CHMļ·
+ * @param what CHM_ENUMERATE_*־
+ * @param e ص
+ * @param context ص
+ *
+ * @return ɹ1, ʧܷ0
+ */
+int chmcache_enumerate(const char *chmfile, int what, CHM_ENUMERATOR e, void *context);
+
+/**
+ * رջCHMͷĿ¼
+ */
+void chmcache_free(void);
+
+#endif
@@ -18,47 +18,174 @@
  * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include "qsort.h"
 #include "freq_lock.h"
-#include "scene.h"
 
-__inline void swap_data(void *data1, void *data2, int datasize)
+/* Runs shorter than this are insertion sorted before merging */
+#define SORT_INSERTION_CUTOFF 16
+
+static void insertion_sort(void **ptrs, size_t n, qsort_compare compare)
 {
-	u8 temp[datasize];
+	size_t i, j;
+
+	for (i = 1; i < n; i++) {
+		void *p = ptrs[i];
 
-	memcpy(temp, data1, datasize);
-	memcpy(data1, data2, datasize);
-	memcpy(data2, temp, datasize);
+		for (j = i; j > 0 && compare(ptrs[j - 1], p) > 0; j--)
+			ptrs[j] = ptrs[j - 1];
+
+		ptrs[j] = p;
+	}
 }
 
-void _quicksort(void *data, int left, int right, int datasize,
-				qsort_compare compare)
+static void merge_runs(void **dst, void **src, size_t lo, size_t mid, size_t hi, qsort_compare compare)
 {
-	int i, last;
-	u8(*qdata)[datasize];
+	size_t i = lo, j = mid, k = lo;
 
-	if (left >= right)
-		return;
+	while (i < mid && j < hi) {
+		// take from the left run on ties to stay stable
+		if (compare(src[j], src[i]) < 0)
+			dst[k++] = src[j++];
+		else
+			dst[k++] = src[i++];
+	}
+
+	while (i < mid)
+		dst[k++] = src[i++];
+
+	while (j < hi)
+		dst[k++] = src[j++];
+}
+
+extern int sort_pointers(void **ptrs, size_t n, qsort_compare compare)
+{
+	void **tmp, **src, **dst;
+	size_t i, width;
+
+	for (i = 0; i < n; i += SORT_INSERTION_CUTOFF)
+		insertion_sort(&ptrs[i], min(SORT_INSERTION_CUTOFF, n - i), compare);
+
+	if (n <= SORT_INSERTION_CUTOFF)
+		return 0;
+
+	tmp = malloc(n * sizeof(*tmp));
+
+	if (tmp == NULL)
+		return -1;
+
+	src = ptrs;
+	dst = tmp;
+
+	// bottom-up, no recursion
+	for (width = SORT_INSERTION_CUTOFF; width < n; width *= 2) {
+		void **t;
+
+		for (i = 0; i < n; i += 2 * width) {
+			size_t mid = min(i + width, n), hi = min(i + 2 * width, n);
+
+			merge_runs(dst, src, i, mid, hi, compare);
+		}
+
+		t = src;
+		src = dst;
+		dst = t;
+	}
+
+	if (src != ptrs)
+		memcpy(ptrs, src, n * sizeof(*ptrs));
+
+	free(tmp);
+
+	return 0;
+}
+
+extern int sort_pointers_tail(void **ptrs, size_t sorted, size_t n, qsort_compare compare)
+{
+	void **tmp;
+
+	if (sorted >= n)
+		return 0;
+
+	if (sort_pointers(&ptrs[sorted], n - sorted, compare) < 0)
+		return -1;
 
-	qdata = (u8(*)[datasize]) data;
-	if (right - left > 1)
-		swap_data(&qdata[left], &qdata[(left + right) / 2], datasize);
-	last = left;
-	for (i = left + 1; i <= right; i++)
-		if (compare(&qdata[i], &qdata[left]) < 0)
-			swap_data(&qdata[++last], &qdata[i], datasize);
-	swap_data(&qdata[left], &qdata[last], datasize);
-	_quicksort(data, left, last - 1, datasize, compare);
-	_quicksort(data, last + 1, right, datasize, compare);
+	if (sorted == 0 || compare(ptrs[sorted - 1], ptrs[sorted]) <= 0)
+		return 0;
+
+	tmp = malloc(n * sizeof(*tmp));
+
+	if (tmp == NULL)
+		return -1;
+
+	merge_runs(tmp, ptrs, 0, sorted, n, compare);
+	memcpy(ptrs, tmp, n * sizeof(*ptrs));
+	free(tmp);
+
+	return 0;
+}
+
+extern int sort_apply(void *data, void **ptrs, size_t n, int datasize)
+{
+	u8 *base = data, *temp;
+	size_t i;
+
+	temp = malloc(datasize);
+
+	if (temp == NULL)
+		return -1;
+
+	// follow each permutation cycle, every element is copied once
+	for (i = 0; i < n; i++) {
+		size_t j = i, k;
+
+		if (ptrs[i] == base + i * datasize)
+			continue;
+
+		memcpy(temp, base + i * datasize, datasize);
+
+		for (;;) {
+			k = ((u8 *) ptrs[j] - base) / datasize;
+			ptrs[j] = base + j * datasize;
+
+			if (k == i)
+				break;
+
+			memcpy(base + j * datasize, base + k * datasize, datasize);
+			j = k;
+		}
+
+		memcpy(base + j * datasize, temp, datasize);
+	}
+
+	free(temp);
+
+	return 0;
 }
 
-extern void quicksort(void *data, int left, int right, int datasize,
-					  qsort_compare compare)
+extern void quicksort(void *data, int left, int right, int datasize, qsort_compare compare)
 {
-	int fid;
+	u8 *base = (u8 *) data + left * datasize;
+	void **ptrs;
+	int fid, i, n = right - left + 1;
+
+	if (n < 2)
+		return;
+
+	ptrs = malloc(n * sizeof(*ptrs));
+
+	if (ptrs == NULL)
+		return;
+
+	for (i = 0; i < n; i++)
+		ptrs[i] = base + i * datasize;
 
 	fid = freq_enter_hotzone();
-	_quicksort(data, left, right, datasize, compare);
+
+	if (sort_pointers(ptrs, n, compare) == 0)
+		sort_apply(base, ptrs, n, datasize);
+
 	freq_leave(fid);
+	free(ptrs);
 }
@@ -24,6 +24,27 @@
 #include "datatype.h"
 
 typedef int (*qsort_compare) (void *data1, void *data2);
+
+/*
+ * Stable sort of an array of pointers: insertion sorted runs merged
+ * bottom-up, O(n log n) without recursion. Returns -1 when out of memory,
+ * leaving ptrs partially sorted.
+ */
+extern int sort_pointers(void **ptrs, size_t n, qsort_compare compare);
+
+/*
+ * Like sort_pointers when ptrs[0..sorted) is already in order: only the
+ * tail is sorted, then merged with it in one pass.
+ */
+extern int sort_pointers_tail(void **ptrs, size_t sorted, size_t n, qsort_compare compare);
+
+/*
+ * Reorder n elements of data so that slot i receives the element ptrs[i]
+ * pointed to. Each element is copied once; ptrs is consumed.
+ */
+extern int sort_apply(void *data, void **ptrs, size_t n, int datasize);
+
+/* Stable sort of data[left..right], moving each element at most once */
 extern void quicksort(void *data, int left, int right, int datasize,
 					  qsort_compare compare);
 
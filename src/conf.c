@@ -301,6 +301,8 @@ static void conf_default(p_conf conf)
 	conf->sfx_mode = 0;
 	conf->alc_mode = 0;
 	conf->use_vaudio = false;
+	conf->resample_quality = 1;
+	conf->gapless = true;
 	SPRINTF_S(conf->musicdrv_opts,
 			  "mp3_brute_mode=off mp3_buffer_size=%d "
 			  "wma_buffer_size=%d aac_buffer_size=%d wav_buffer_size=%d wv_buffer_size=%d "
@@ -1070,6 +1072,8 @@ extern bool ini_conf_load(const char *inifilename, p_conf conf)
 	conf->alc_mode = iniparser_getint(dict, "Music:alc_mode", conf->alc_mode);
 
 	conf->use_vaudio = iniparser_getboolean(dict, "Music:use_vaudio", conf->use_vaudio);
+	conf->resample_quality = iniparser_getint(dict, "Music:resample_quality", conf->resample_quality);
+	conf->gapless = iniparser_getboolean(dict, "Music:gapless", conf->gapless);
 
 	if (conf->max_cache_img == 0) {
 		conf->max_cache_img = 10;
@@ -1268,6 +1272,8 @@ extern bool ini_conf_save(p_conf conf)
 	iniparser_setstring(dict, "Music:alc_mode", intToString(buf, sizeof(buf), conf->alc_mode));
 
 	iniparser_setstring(dict, "Music:use_vaudio", booleanToString(buf, sizeof(buf), conf->use_vaudio));
+	iniparser_setstring(dict, "Music:resample_quality", intToString(buf, sizeof(buf), conf->resample_quality));
+	iniparser_setstring(dict, "Music:gapless", booleanToString(buf, sizeof(buf), conf->gapless));
 
 	iniparser_setstring(dict, "Global:max_brightness", intToString(buf, sizeof(buf), conf->max_brightness));
 
@@ -240,6 +240,18 @@ extern "C"
 		int alc_mode;
 		bool use_vaudio;
 		int max_brightness;
+	/**
+	 * ز
+	 *
+	 * 0 - 
+	 * 1 - е
+	 * 2 - 
+	 */
+		int resample_quality;
+	/**
+	 * ޷첥: ĿβǰԤһ, лʱ³ʼ
+	 */
+		bool gapless;
 	} __attribute__ ((packed)) t_conf, *p_conf;
 
 /* txt key:
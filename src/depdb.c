@@ -31,180 +31,248 @@
 
 #include <pspiofilemgr.h>
 #include <string.h>
+#include <stdlib.h>
 #include <malloc.h>
 #include <stdio.h>
+#include "common/utils.h"
 #include "depdb.h"
 #include "dbg.h"
 #ifdef DMALLOC
 #include "dmalloc.h"
 #endif
 
-bool m_littlendian;
-
-Word swap_Word(Word r)
+// PDB is big endian
+static inline Word get_be16(const void *p)
 {
-	if (m_littlendian)
-		return (r >> 8) | (r << 8);
-	else
-		return r;
-}
+	const u8 *b = p;
 
-DWord swap_DWord(DWord r)
-{
-	if (m_littlendian)
-		return ((r >> 24) & 0x00FF) | (r << 24) | ((r >> 8) & 0xFF00) | ((r << 8) & 0xFF0000);
-	else
-		return r;
+	return (b[0] << 8) | b[1];
 }
 
-#define GET_Word(fd,n)   { sceIoRead(fd, &n, 2); n = swap_Word ( n ); }
-#define GET_DWord(fd,n)  { sceIoRead(fd, &n, 4); n = swap_DWord( n ); }
-#define GET_DDWord(fd,n)  { int a; sceIoRead(fd, &n, 4); n = swap_DWord( n ); sceIoRead(fd, &a, 4);}
-
-static inline void _zero_fill(u8 * p, int len)
+static inline DWord get_be32(const void *p)
 {
-	while (len-- > 0)
-		*p++ = '\0';
+	const u8 *b = p;
+
+	return (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
 }
 
-void selectSwap()
+static int read_at(SceUID fd, SceOff pos, void *buf, u32 size)
 {
-	/*union { char c[2];  Word n; }  w;
-	   strncpy(  w.c, "\1\2",     2 );
-
-	   if ( w.n == 0x0201 )
-	   m_littlendian = true;
-	   else
-	   m_littlendian = false; */
-	m_littlendian = true;
+	if (sceIoLseek(fd, pos, PSP_SEEK_SET) != pos)
+		return -1;
+
+	return sceIoRead(fd, buf, size) == size ? 0 : -1;
 }
 
-DWord decompress_huge(buffer * m_buf, buffer ** puzbuf)
+/**
+ * PalmDOC LZ77, one record at a time
+ *
+ * @return decoded size, -1 on corrupted data
+ */
+static int palmdoc_decompress(const u8 * in, u32 len, u8 * out, u32 outsize)
 {
-	DWord i, j;
-	u8 c;
-	int di, n;
-	unsigned int temp_c;
-	char *pbuf = m_buf->ptr;
-	char *puz = (*puzbuf)->ptr;
-
-	for (i = j = 0; i < m_buf->used;) {
-
-		c = pbuf[i++];
-
-		if (c >= 1 && c <= 8)
-			while (c--)
-				puz[j++] = pbuf[i++];
-
-		else if (c > 0x7F) {
-			temp_c = c;
-			temp_c = (temp_c << 8);
-			temp_c = temp_c + (u8) pbuf[i++];
-			di = (temp_c & 0x3FFF) >> COUNT_BITS;
-			n = (temp_c & ((1 << COUNT_BITS) - 1)) + 3;
-			for (; n--; ++j)
-				puz[j] = puz[j - di];
-			temp_c = 0;
-		} else
-			puz[j++] = c;
+	u32 i = 0, j = 0;
+
+	while (i < len) {
+		u8 c = in[i++];
+
+		if (c >= 1 && c <= 8) {
+			if (i + c > len || j + c > outsize)
+				return -1;
+			memcpy(out + j, in + i, c);
+			i += c;
+			j += c;
+		} else if (c < 0x80) {
+			if (j >= outsize)
+				return -1;
+			out[j++] = c;
+		} else if (c >= 0xC0) {
+			if (j + 2 > outsize)
+				return -1;
+			out[j++] = ' ';
+			out[j++] = c ^ 0x80;
+		} else {
+			u32 pair, di, n;
+
+			if (i >= len)
+				return -1;
+
+			pair = (c << 8) | in[i++];
+			di = (pair & 0x3FFF) >> COUNT_BITS;
+			n = (pair & ((1 << COUNT_BITS) - 1)) + 3;
+
+			if (di == 0 || di > j || j + n > outsize)
+				return -1;
+
+			// Source may overlap destination, copy bytewise
+			for (; n > 0; --n, ++j)
+				out[j] = out[j - di];
+		}
 	}
-	if (i < m_buf->used) {
-		m_buf->used = m_buf->used - i + 2;
-		memcpy(m_buf->ptr, m_buf->ptr + i - 2, m_buf->used);
-	} else
-		m_buf->used = 0;
-	(*puzbuf)->used = j;
-	printf("unzip ret:%d\n", j);
+
 	return j;
 }
 
-long read_pdb_data(const char *pdbfile, buffer ** pbuf)
+extern p_pdb pdb_open(const char *pdbfile)
 {
-	size_t ret = -1;
-	SceUID fd = -1;
 	SceIoStat sta;
-	bool bCompressed = false;
-	buffer *pzbuf = NULL;
-	DWord *p_records_offset = NULL;
+	pdb_header hdr;
+	doc_record0 rec0;
+	p_pdb pdb;
+	u8 *table = NULL;
+	u32 total, i;
+
+	if (pdbfile == NULL || sceIoGetstat(pdbfile, &sta) < 0)
+		return NULL;
+
+	pdb = calloc(1, sizeof(*pdb));
+
+	if (pdb == NULL)
+		return NULL;
 
-	if (!pdbfile || !pbuf || !(*pbuf) || !(*pbuf)->ptr)
-		return ret;
+	pdb->fd = sceIoOpen(pdbfile, PSP_O_RDONLY, 0777);
+
+	if (pdb->fd < 0) {
+		free(pdb);
+		return NULL;
+	}
 
-	selectSwap();
 	do {
-		pdb_header m_header;
-		DWord file_size, offset, cur_size;
-		doc_record0 m_rec0;
-		int num_records;
-		int i = 0;
-
-		if (sceIoGetstat(pdbfile, &sta) < 0) {
-			//printf("stat file:%s error:%s\n",pdbfile,strerror(errno));
+		if (sceIoRead(pdb->fd, &hdr, PDB_HEADER_SIZE) != PDB_HEADER_SIZE)
 			break;
-		}
-		if ((fd = sceIoOpen(pdbfile, PSP_O_RDONLY, 0777)) < 0) {
-			printf("Could not open file :%s\n", pdbfile);
+
+		if (strncmp(hdr.type, DOC_TYPE, sizeof(hdr.type)) || strncmp(hdr.creator, DOC_CREATOR, sizeof(hdr.creator))) {
+			dbg_printf(d, "%s: %s is not a PalmDOC file", __func__, pdbfile);
 			break;
 		}
-		if (sceIoRead(fd, &m_header, PDB_HEADER_SIZE) < 0) {
-			//dbg_printf(d, "%s read umd file chunk error,ret:%d!",__func__,p->used);
+
+		total = get_be16(&hdr.numRecords);
+
+		if (total < 2)
 			break;
-		}
-		if (strncmp(m_header.type, DOC_TYPE, sizeof(m_header.type)) || strncmp(m_header.creator, DOC_CREATOR, sizeof(m_header.creator))) {
-			printf("type:%s,creator:%s,This file is not recognized as a PDB document\n", m_header.type, m_header.creator);
+
+		table = malloc(total * PDB_RECORD_HEADER_SIZE);
+
+		if (table == NULL || sceIoRead(pdb->fd, table, total * PDB_RECORD_HEADER_SIZE) != total * PDB_RECORD_HEADER_SIZE)
 			break;
-		}
-		// progressbar
-		num_records = swap_Word(m_header.numRecords) - 1;
-
-		printf("total %d records\n", num_records);
-		GET_DDWord(fd, offset);
-		//printf("offset %d\n",offset);
-		p_records_offset = (DWord *) calloc(num_records, sizeof(DWord));
-
-		for (i = 0; i < num_records; i++)
-			GET_DDWord(fd, p_records_offset[i]);
-		if (sceIoRead(fd, &m_rec0, sizeof(m_rec0)) < 0) {
-			//dbg_printf(d, "%s read umd file chunk error,ret:%d!",__func__,p->used);
+
+		if (read_at(pdb->fd, get_be32(table), &rec0, sizeof(rec0)) < 0)
 			break;
-		}
 
-		if (swap_Word(m_rec0.version) == 2)
-			bCompressed = true;
+		pdb->compressed = get_be16(&rec0.version) == 2;
+		pdb->text_size = get_be32(&rec0.doc_size);
+		pdb->count = min(get_be16(&rec0.numRecords), total - 1);
 
-		file_size = sta.st_size;
-		buffer_prepare_copy(*pbuf, file_size * 2);
-		//buffer_prepare_copy(*pbuf,file_size);
+		pdb->offsets = malloc((pdb->count + 1) * sizeof(DWord));
 
-		if (!p_records_offset)
+		if (pdb->offsets == NULL)
 			break;
-		pzbuf = buffer_init();
-		if (!pzbuf)
+
+		for (i = 0; i < pdb->count; ++i)
+			pdb->offsets[i] = get_be32(table + (i + 1) * PDB_RECORD_HEADER_SIZE);
+
+		// The last text record ends where the next record, or the file, starts
+		pdb->offsets[pdb->count] = pdb->count + 1 < total ? get_be32(table + (pdb->count + 1) * PDB_RECORD_HEADER_SIZE) : sta.st_size;
+
+		for (i = 0; i < pdb->count; ++i) {
+			if (pdb->offsets[i] > pdb->offsets[i + 1] || pdb->offsets[i + 1] > sta.st_size)
+				break;
+		}
+
+		if (i < pdb->count)
 			break;
-		cur_size = file_size - offset;
-		buffer_prepare_copy(pzbuf, cur_size * 2);
-		if ((cur_size = sceIoRead(fd, pzbuf->ptr, cur_size)) < 0) {
-			//dbg_printf(d, "%s read umd file chunk error,ret:%d!",__func__,p->used);
+
+		free(table);
+		dbg_printf(d, "%s: %u text records, %u bytes", __func__, (unsigned) pdb->count, (unsigned) pdb->text_size);
+
+		return pdb;
+	} while (false);
+
+	free(table);
+	pdb_close(pdb);
+
+	return NULL;
+}
+
+extern void pdb_close(p_pdb pdb)
+{
+	if (pdb == NULL)
+		return;
+
+	if (pdb->fd >= 0)
+		sceIoClose(pdb->fd);
+
+	free(pdb->offsets);
+	free(pdb);
+}
+
+extern int pdb_decode_record(p_pdb pdb, u32 index, u8 * out)
+{
+	u32 len;
+
+	if (pdb == NULL || index >= pdb->count)
+		return -1;
+
+	len = pdb->offsets[index + 1] - pdb->offsets[index];
+
+	if (!pdb->compressed) {
+		len = min(len, RECORD_SIZE_MAX);
+		return read_at(pdb->fd, pdb->offsets[index], out, len) < 0 ? -1 : (int) len;
+	}
+
+	// Compressed records may carry trailing bytes, only the decoded size is bounded
+	len = min(len, sizeof(pdb->zbuf));
+
+	if (read_at(pdb->fd, pdb->offsets[index], pdb->zbuf, len) < 0)
+		return -1;
+
+	return palmdoc_decompress(pdb->zbuf, len, out, RECORD_SIZE_MAX);
+}
+
+extern u32 pdb_text_size(p_pdb pdb)
+{
+	u32 size = pdb->count * RECORD_SIZE_MAX;
+
+	// Each record is decoded whole into dest, so leave room for the last one
+	if (pdb->text_size != 0 && pdb->text_size < size && pdb->text_size + RECORD_SIZE_MAX < size)
+		size = pdb->text_size + RECORD_SIZE_MAX;
+
+	return size;
+}
+
+extern u32 pdb_read_all(p_pdb pdb, char **dest, u32 * size)
+{
+	u32 index, used = 0;
+
+	if (pdb == NULL || dest == NULL || *dest == NULL || size == NULL)
+		return 0;
+
+	for (index = 0; index < pdb->count; ++index) {
+		int ret;
+
+		if (*size - used < RECORD_SIZE_MAX) {
+			// Record 0 understated the text, make room for every record left
+			u32 newsize = used + (pdb->count - index) * RECORD_SIZE_MAX;
+			char *p = realloc(*dest, newsize);
+
+			if (p == NULL) {
+				dbg_printf(d, "%s: no memory for %u bytes", __func__, (unsigned) newsize);
+				break;
+			}
+
+			*dest = p;
+			*size = newsize;
+		}
+
+		ret = pdb_decode_record(pdb, index, (u8 *) * dest + used);
+
+		if (ret < 0) {
+			dbg_printf(d, "%s: record %u corrupted", __func__, (unsigned) index);
 			break;
 		}
-		pzbuf->used = cur_size;
-		if (bCompressed) {
-			decompress_huge(pzbuf, pbuf);
-			//printf("\n\nlast:%s\n",(*pbuf)->ptr);
-			//buffer_append_string_buffer(*pbuf,puzbuf);
-		} else
-			buffer_append_string_buffer(*pbuf, pzbuf);
-		ret = (*pbuf)->used;
-	} while (false);
 
-	printf("parse done,ret:%d!\n", ret);
-	if (pzbuf)
-		buffer_free(pzbuf);
-	if (p_records_offset)
-		free(p_records_offset);
-	if (fd > -1)
-		sceIoClose(fd);
-	if (ret < 0)
-		buffer_free(*pbuf);
-	return ret;
+		used += ret;
+	}
+
+	return used;
 }
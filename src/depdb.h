@@ -39,6 +39,7 @@ for which a new license (GPL+exception) is in place.
 #ifndef _DEPDB_H_
 #define _DEPDB_H_
 #include "common/datatype.h"
+#include <pspiofilemgr.h>
 #include "buffer.h"
 typedef unsigned int DWord;
 typedef unsigned short Word;
@@ -82,13 +83,32 @@ typedef struct
 	DWord reserved2;
 } __attribute__ ((packed)) doc_record0;
 
+// PalmDOC reader, record table parsed once and text records decoded on demand
 typedef struct
 {
-	u8 buf[BUFFER_SIZE];
-	DWord len;
-	DWord position;
-} __attribute__ ((packed)) pdbbuffer;
+	SceUID fd;
+	bool compressed;
+	u32 count;					// text records
+	u32 text_size;				// decoded size from record 0
+	DWord *offsets;				// file offsets of the text records, count + 1 entries
+	u8 zbuf[RECORD_SIZE_MAX * 2];
+} t_pdb, *p_pdb;
 
-extern long read_pdb_data(const char *pdbfile, buffer ** pbuf);
+// Parse header and record table, NULL if not a PalmDOC file
+extern p_pdb pdb_open(const char *pdbfile);
+
+extern void pdb_close(p_pdb pdb);
+
+// Decode text record index into out (RECORD_SIZE_MAX bytes), returns decoded size or -1
+// Records don't depend on each other, so any subset can be decoded in any order
+extern int pdb_decode_record(p_pdb pdb, u32 index, u8 * out);
+
+// Decode every text record into the malloc'ed *dest of *size bytes, returns decoded size
+// *dest is reallocated and *size updated when the text does not fit
+extern u32 pdb_read_all(p_pdb pdb, char **dest, u32 * size);
+
+// Initial size for pdb_read_all's dest: the size record 0 gives plus one record of slack,
+// no more than every record decoding to RECORD_SIZE_MAX
+extern u32 pdb_text_size(p_pdb pdb);
 
 #endif
@@ -21,10 +21,12 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <malloc.h>
 #include <string.h>
 #include <pspkernel.h>
 #include <stdio.h>
 #include <pspinit.h>
+#include <zlib.h>
 #include "common/utils.h"
 #include "charsets.h"
 #include "fat.h"
@@ -38,16 +40,58 @@
 
 #define PSP_GO 4
 
+/** FATҳС,  */
+#define FAT_PAGE_SIZE 4096
+
+/** FATҳ */
+#define FAT_PAGE_COUNT 8
+
+/** Ĵ */
+#define FAT_CHAIN_COUNT 8
+
+#define FAT_EXTENT_STEP 8
+
+typedef struct
+{
+	u32 index;
+	u32 lru;
+	u8 *data;
+} t_fat_page;
+
+/** һĴ */
+typedef struct
+{
+	u32 clus;
+	u32 count;
+} t_fat_extent;
+
+typedef struct
+{
+	/** ״, 0Ϊ */
+	u32 first;
+	u32 lru;
+	/**  */
+	u32 nclus;
+	u32 nextent;
+	t_fat_extent *extents;
+} t_fat_chain;
+
 static int fatfd = -1;
 static t_fat_dbr dbr;
 static t_fat_mbr mbr;
-static u32 *fat_table = NULL;
+static t_fat_page fat_pages[FAT_PAGE_COUNT];
+static t_fat_chain fat_chains[FAT_CHAIN_COUNT];
+static u32 fat_tick = 0;
+static u32 fat_page_reads = 0;
+static u64 fat_table_pos = 0;
+static u32 fat_table_size = 0;
 static u64 dbr_pos = 0;
 static u64 root_pos = 0;
 static u64 data_pos = 0;
 static u64 bytes_per_clus = 0;
 static u32 loadcount = 0;
 static u32 clus_max = 0;
+static u32 clus_total = 0;
 static enum
 {
 	fat12,
@@ -198,6 +242,7 @@ static bool fat_init(void)
 	root_sec = (dbr.root_entry * 32 + dbr.bytes_per_sec - 1) / dbr.bytes_per_sec;
 	data_sec = total_sec - dbr.reserved_sec - (dbr.num_fats * fat_sec) - root_sec;
 	data_clus = data_sec / dbr.sec_per_clus;
+	clus_total = data_clus;
 
 	if (data_clus < 4085) {
 		fat_type = fat12;
@@ -240,66 +285,185 @@ static void fat_free(void)
 	bytes_per_clus = 0;
 	loadcount = 0;
 	clus_max = 0;
+	clus_total = 0;
 	fat_type = fat16;
 	fat_inited = false;
 	xr_lock_destroy(&fat_l);
 }
 
-static bool convert_table_fat12(void)
+/**
+ * ȡFATĳֽڵҳ
+ *
+ * @note ҳLRṶ, صָ´εǰЧ
+ *
+ * @param offset FATֽƫ
+ *
+ * @return ָֽڵָ, ʧܷNULL
+ */
+static u8 *fat_page_ptr(u32 offset)
 {
-	u16 *otable = malloc(dbr.sec_per_fat * dbr.bytes_per_sec);
-	int i, j, entrycount;
+	u32 index = offset / FAT_PAGE_SIZE, size, i;
+	t_fat_page *victim = &fat_pages[0];
+	u64 pos;
 
-	if (otable == NULL)
-		return false;
+	if (offset >= fat_table_size)
+		return NULL;
 
-	memcpy(otable, fat_table, dbr.sec_per_fat * dbr.bytes_per_sec);
-	entrycount = dbr.sec_per_fat * dbr.bytes_per_sec / sizeof(u16) * 4 / 3;
-	free(fat_table);
-	fat_table = malloc(sizeof(*fat_table) * entrycount);
+	for (i = 0; i < FAT_PAGE_COUNT; i++) {
+		t_fat_page *page = &fat_pages[i];
 
-	if (fat_table == NULL) {
-		free(otable);
-		return false;
+		if (page->data != NULL && page->index == index) {
+			page->lru = ++fat_tick;
+			return page->data + offset % FAT_PAGE_SIZE;
+		}
+
+		if (page->lru < victim->lru)
+			victim = page;
 	}
-	for (i = 0, j = 0; i < entrycount; i += 4, j += 3) {
-		fat_table[i] = otable[j] & 0x0FFF;
-		fat_table[i + 1] = ((otable[j] >> 12) & 0x000F) | ((otable[j + 1] & 0x00FF) << 4);
-		fat_table[i + 2] = ((otable[j + 1] >> 8) & 0x00FF) | ((otable[j + 2] & 0x000F)
-															  << 8);
-		fat_table[i + 3] = otable[j + 2] >> 4;
+
+	if (victim->data == NULL && (victim->data = memalign(64, FAT_PAGE_SIZE)) == NULL)
+		return NULL;
+
+	pos = fat_table_pos + 1ull * index * FAT_PAGE_SIZE;
+	size = min(FAT_PAGE_SIZE, fat_table_size - index * FAT_PAGE_SIZE);
+
+	if (_xrIoLseek(fatfd, pos, PSP_SEEK_SET) != pos || _xrIoRead(fatfd, victim->data, size) != size) {
+		victim->lru = 0;
+		victim->index = INVALID;
+		return NULL;
 	}
-	free(otable);
-	return true;
+
+	victim->index = index;
+	victim->lru = ++fat_tick;
+	fat_page_reads++;
+
+	return victim->data + offset % FAT_PAGE_SIZE;
 }
 
-static bool convert_table_fat16(void)
+/**
+ * ȡFAT
+ *
+ * @param clus غ
+ *
+ * @return һغ, ȡʧܷINVALID
+ */
+static u32 fat_next_clus(u32 clus)
 {
-	u16 *otable = malloc(dbr.sec_per_fat * dbr.bytes_per_sec);
-	int i, entrycount;
+	u8 *p;
+	u32 offset, value;
+
+	switch (fat_type) {
+		case fat12:
+			// 12λܿҳ, ֽڶȡ
+			offset = clus + clus / 2;
+			if ((p = fat_page_ptr(offset)) == NULL)
+				return INVALID;
+			value = p[0];
+			if ((p = fat_page_ptr(offset + 1)) == NULL)
+				return INVALID;
+			value |= p[0] << 8;
+			return (clus & 1) ? (value >> 4) : (value & 0x0FFF);
+		case fat16:
+			if ((p = fat_page_ptr(clus * 2)) == NULL)
+				return INVALID;
+			return p[0] | (p[1] << 8);
+		default:
+			if ((p = fat_page_ptr(clus * 4)) == NULL)
+				return INVALID;
+			return (p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24)) & 0x0FFFFFFF;
+	}
+}
 
-	if (otable == NULL)
-		return false;
+/**
+ * ȡclusʼĴ
+ *
+ * @note α, ߹Ĵ
+ *
+ * @param clus ״
+ *
+ * @return , ʧܷNULL; ȡFATʱؽض̵Ĵ
+ */
+static t_fat_chain *fat_get_chain(u32 clus)
+{
+	t_fat_chain *chain = &fat_chains[0];
+	u32 i, c;
 
-	memcpy(otable, fat_table, dbr.sec_per_fat * dbr.bytes_per_sec);
-	entrycount = dbr.sec_per_fat * dbr.bytes_per_sec / sizeof(u16);
-	free(fat_table);
-	fat_table = malloc(sizeof(*fat_table) * entrycount);
+	for (i = 0; i < FAT_CHAIN_COUNT; i++) {
+		if (fat_chains[i].first == clus) {
+			fat_chains[i].lru = ++fat_tick;
+			return &fat_chains[i];
+		}
 
-	if (fat_table == NULL) {
-		free(otable);
-		return false;
+		if (fat_chains[i].lru < chain->lru)
+			chain = &fat_chains[i];
 	}
-	for (i = 0; i < entrycount; i++)
-		fat_table[i] = otable[i];
-	free(otable);
-	return true;
+
+	chain->first = 0;
+	chain->lru = 0;
+	chain->nclus = chain->nextent = 0;
+
+	for (c = clus; c > 1 && c < clus_max; c = fat_next_clus(c)) {
+		t_fat_extent *ext = chain->nextent > 0 ? &chain->extents[chain->nextent - 1] : NULL;
+
+		// ɻ
+		if (chain->nclus >= clus_total)
+			return NULL;
+
+		if (ext == NULL || ext->clus + ext->count != c) {
+			if (chain->nextent % FAT_EXTENT_STEP == 0) {
+				t_fat_extent *p = realloc(chain->extents, (chain->nextent + FAT_EXTENT_STEP) * sizeof(*p));
+
+				if (p == NULL)
+					return NULL;
+
+				chain->extents = p;
+			}
+
+			ext = &chain->extents[chain->nextent++];
+			ext->clus = c;
+			ext->count = 0;
+		}
+
+		ext->count++;
+		chain->nclus++;
+	}
+
+	if (c == INVALID) {
+		dbg_printf(d, "%s: FAT read failed in the chain of cluster %u", __func__, (unsigned) clus);
+		return NULL;
+	}
+
+	chain->first = clus;
+	chain->lru = ++fat_tick;
+
+	return chain;
 }
 
-static bool fat_load_table(void)
+static void fat_free_cache(void)
 {
-	u32 fat_table_size;
+	u32 i;
+
+	for (i = 0; i < FAT_PAGE_COUNT; i++) {
+		free(fat_pages[i].data);
+		fat_pages[i].data = NULL;
+		fat_pages[i].lru = 0;
+	}
+
+	for (i = 0; i < FAT_CHAIN_COUNT; i++) {
+		free(fat_chains[i].extents);
+		memset(&fat_chains[i], 0, sizeof(fat_chains[i]));
+	}
 
+	fat_tick = 0;
+}
+
+/**
+ * ʼFAT
+ *
+ * @note FAT, fat_next_clusаҳȡ
+ */
+static bool fat_load_table(void)
+{
 	if (loadcount > 0) {
 		loadcount++;
 		return true;
@@ -310,23 +474,11 @@ static bool fat_load_table(void)
 	if (fatfd < 0)
 		return false;
 
+	fat_table_pos = dbr_pos + 1ull * dbr.reserved_sec * dbr.bytes_per_sec;
 	fat_table_size = ((fat_type == fat32) ? dbr.ufat.fat32.sec_per_fat : dbr.sec_per_fat) * dbr.bytes_per_sec;
-
-	if (_xrIoLseek
-		(fatfd, dbr_pos + dbr.reserved_sec * dbr.bytes_per_sec,
-		 PSP_SEEK_SET) != dbr_pos + dbr.reserved_sec * dbr.bytes_per_sec || (fat_table = malloc(fat_table_size)) == NULL) {
-		msstor_close();
-		return false;
-	}
-	if ((_xrIoRead(fatfd, fat_table, fat_table_size) != fat_table_size)
-		|| (fat_type == fat12 && !convert_table_fat12())
-		|| (fat_type == fat16 && !convert_table_fat16())) {
-		msstor_close();
-		free(fat_table);
-		fat_table = NULL;
-		return false;
-	}
+	fat_page_reads = 0;
 	loadcount = 1;
+
 	return true;
 }
 
@@ -336,10 +488,8 @@ static void fat_free_table(void)
 		loadcount--;
 		if (loadcount > 0)
 			return;
-		if (fat_table != NULL) {
-			free(fat_table);
-			fat_table = NULL;
-		}
+		dbg_printf(d, "%s: %u FAT pages read", __func__, (unsigned) fat_page_reads);
+		fat_free_cache();
 		msstor_close();
 	}
 }
@@ -371,35 +521,36 @@ static bool fat_dir_list(u32 clus, u32 * count, p_fat_entry * entrys)
 	} else {
 		u32 epc;
 		u32 ep;
-		u32 c2;
+		u32 i, next;
+		t_fat_chain *chain;
+
+		next = fat_next_clus(clus);
 
-		if (fat_table[clus] < 2)
+		if (next < 2 || next == INVALID)
 			return false;
 
-		c2 = clus;
-		*count = 1;
+		chain = fat_get_chain(clus);
+
+		if (chain == NULL || chain->nclus == 0)
+			return false;
 
-		while (fat_table[c2] < clus_max && fat_table[c2] > 1) {
-			c2 = fat_table[c2];
-			(*count)++;
-		}
-		c2 = clus;
 		epc = (bytes_per_clus / sizeof(t_fat_entry));
 		ep = 0;
 
-		(*count) *= epc;
+		*count = chain->nclus * epc;
 		if ((*entrys = malloc(*count * sizeof(**entrys))) == NULL)
 			return false;
-		do {
-			u64 epos = data_pos + 1ull * (c2 - 2) * bytes_per_clus;
+		// ÿĴһζ
+		for (i = 0; i < chain->nextent; i++) {
+			u64 epos = data_pos + 1ull * (chain->extents[i].clus - 2) * bytes_per_clus;
+			u32 size = chain->extents[i].count * bytes_per_clus;
 
-			if (_xrIoLseek(fatfd, epos, PSP_SEEK_SET) != epos || _xrIoRead(fatfd, &(*entrys)[ep], bytes_per_clus) != bytes_per_clus) {
+			if (_xrIoLseek(fatfd, epos, PSP_SEEK_SET) != epos || _xrIoRead(fatfd, &(*entrys)[ep], size) != size) {
 				free(*entrys);
 				return false;
 			}
-			ep += epc;
-			c2 = fat_table[c2];
-		} while (c2 < clus_max && c2 > 1);
+			ep += chain->extents[i].count * epc;
+		}
 	}
 	return true;
 }
@@ -619,13 +770,33 @@ static u32 fat_dir_clus(const char *dir, char *shortdir)
 
 extern u32 fat_readdir(const char *dir, char *sdir, p_fat_info * info)
 {
-	u32 clus;
+	return fat_readdir_ex(dir, sdir, info, NULL, NULL, NULL);
+}
+
+/**
+ * ȡĿ¼, Ŀ¼״Ŀ¼Уֵ
+ *
+ * @note УֵΪĿ¼ȫԭʼĿ¼CRC32, ļɾ, С仯ı
+ *
+ * @param dir Ŀ¼·
+ * @param sdir صĿ¼·
+ * @param info صĿ¼, ɵͷ
+ * @param unchanged Ϊʱ״УֵѯʵߵĻ, trueٽĿ¼, ΪNULL
+ * @param pclus Ŀ¼״, ΪNULL
+ * @param pcrc Ŀ¼Уֵ, ΪNULL
+ *
+ * @return Ŀ¼; unchangedtrueʱ0*infoΪNULL; ʧܷINVALID
+ */
+extern u32 fat_readdir_ex(const char *dir, char *sdir, p_fat_info * info, t_fat_dir_check unchanged, u32 * pclus, u32 * pcrc)
+{
+	u32 clus, crc;
 	SceUID dl = 0;
 	u32 ecount = 0;
 	p_fat_entry entrys;
 	u32 count = 0, cur = 0, i;
 	SceIoDirent sid;
 
+	*info = NULL;
 	fat_lock();
 
 	if (!fat_inited) {
@@ -648,18 +819,34 @@ extern u32 fat_readdir(const char *dir, char *sdir, p_fat_info * info)
 
 	clus = fat_dir_clus(dir, sdir);
 
-	if (clus == 0 || (dl = sceIoDopen(sdir)) < 0) {
+	if (clus == 0 || !fat_dir_list(clus, &ecount, &entrys)) {
 		fat_free_table();
-		sceIoDclose(dl);
 		fat_unlock();
 		fat_free();
 
 		return INVALID;
 	}
 
-	if (!fat_dir_list(clus, &ecount, &entrys)) {
+	crc = crc32(0, (const Bytef *) entrys, ecount * sizeof(*entrys));
+
+	if (pclus != NULL)
+		*pclus = clus;
+
+	if (pcrc != NULL)
+		*pcrc = crc;
+
+	if (unchanged != NULL && (*unchanged) (clus, crc)) {
+		free(entrys);
+		fat_free_table();
+		fat_unlock();
+		fat_free();
+
+		return 0;
+	}
+
+	if ((dl = sceIoDopen(sdir)) < 0) {
+		free(entrys);
 		fat_free_table();
-		sceIoDclose(dl);
 		fat_unlock();
 		fat_free();
 
@@ -146,6 +146,11 @@ extern void fat_powerup(void);
 extern void fat_powerdown(void);
 extern bool fat_locate(const char *name, char *sname, u32 clus, p_fat_entry info);
 extern u32 fat_readdir(const char *dir, char *sdir, p_fat_info * info);
+
+/* Asked with a directory's first cluster and entry CRC; true skips parsing it */
+typedef bool(*t_fat_dir_check) (u32 clus, u32 crc);
+
+extern u32 fat_readdir_ex(const char *dir, char *sdir, p_fat_info * info, t_fat_dir_check unchanged, u32 * pclus, u32 * pcrc);
 extern bool fat_longnametoshortname(char *shortname, const char *longname, u32 size);
 
 #endif
@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <pspuser.h>
 #include <unzip.h>
 #include <chm_lib.h>
@@ -41,7 +42,9 @@
 #include "bg.h"
 #include "image.h"
 #include "archive.h"
+#include "chmcache.h"
 #include "freq_lock.h"
+#include "thread_lock.h"
 #include "audiocore/musicdrv.h"
 #include "dbg.h"
 #ifdef DMALLOC
@@ -152,6 +155,20 @@ t_fs_specfiletype_entry ft_spec_table[] = {
 	{NULL, fs_filetype_unknown}
 };
 
+/* Open addressing, power of two, kept under half full */
+#define FT_HASH_SIZE 256
+#define FT_KEY_MAX 16
+
+typedef struct
+{
+	char key[FT_KEY_MAX];
+	t_fs_filetype ft;
+} t_fs_filetype_slot;
+
+static t_fs_filetype_slot ft_ext_hash[FT_HASH_SIZE];
+static t_fs_filetype_slot ft_name_hash[FT_HASH_SIZE];
+static volatile bool ft_hash_ready = false;
+
 int MAX_ITEM_NAME_LEN = 40;
 p_umd_chapter p_umdchapter = NULL;
 p_win_menu g_menu = NULL;
@@ -171,8 +188,12 @@ void filename_to_itemname(p_win_menuitem item, const char *filename)
 	}
 }
 
+static void fs_list_close(void);
+
 static p_win_menu menu_renew(p_win_menu * menu)
 {
+	fs_list_close();
+
 	if (*menu != NULL) {
 		win_menu_destroy(*menu);
 		*menu = NULL;
@@ -197,10 +218,11 @@ extern u32 fs_list_device(const char *dir, const char *sdir, u32 icolor, u32 sel
 		return 0;
 	}
 
-	win_menuitem_new(&item);
+	if (win_menu_item_new(g_menu, &item, "ms0:", "ms0:") < 0) {
+		return 0;
+	}
+
 	STRCPY_S(item.name, "<MemoryStick>");
-	buffer_copy_string(item.compname, "ms0:");
-	buffer_copy_string(item.shortname, "ms0:");
 	item.data = (void *) fs_filetype_dir;
 	item.width = 13;
 	item.selected = false;
@@ -211,9 +233,11 @@ extern u32 fs_list_device(const char *dir, const char *sdir, u32 icolor, u32 sel
 	win_menu_add(g_menu, &item);
 
 	if (config.hide_flash == false) {
-		win_menuitem_new(&item);
+		if (win_menu_item_new(g_menu, &item, "flash0:", NULL) < 0) {
+			return g_menu->size;
+		}
+
 		STRCPY_S(item.name, "<NandFlash 0>");
-		buffer_copy_string(item.compname, "flash0:");
 		item.data = (void *) fs_filetype_dir;
 		item.width = 13;
 		item.selected = false;
@@ -223,9 +247,11 @@ extern u32 fs_list_device(const char *dir, const char *sdir, u32 icolor, u32 sel
 		item.selbcolor = selbcolor;
 		win_menu_add(g_menu, &item);
 
-		win_menuitem_new(&item);
+		if (win_menu_item_new(g_menu, &item, "flash1:", NULL) < 0) {
+			return g_menu->size;
+		}
+
 		STRCPY_S(item.name, "<NandFlash 1>");
-		buffer_copy_string(item.compname, "flash1:");
 		item.data = (void *) fs_filetype_dir;
 		item.width = 13;
 		item.selected = false;
@@ -238,10 +264,11 @@ extern u32 fs_list_device(const char *dir, const char *sdir, u32 icolor, u32 sel
 
 #ifdef _DEBUG
 	if(psp_model == PSP_GO) {
-		win_menuitem_new(&item);
+		if (win_menu_item_new(g_menu, &item, "ef0:", "ef0:") < 0) {
+			return g_menu->size;
+		}
+
 		STRCPY_S(item.name, "<Internal Memory>");
-		buffer_copy_string(item.compname, "ef0:");
-		buffer_copy_string(item.shortname, "ef0:");
 		item.data = (void *) fs_filetype_dir;
 		item.width = sizeof("<Internal Memory>")-1;
 		item.selected = false;
@@ -264,10 +291,11 @@ static int add_parent_to_menu(p_win_menu menu, u32 icolor, u32 selicolor, u32 se
 		return -1;
 	}
 
-	win_menuitem_new(&item);
+	if (win_menu_item_new(menu, &item, "..", "..") < 0) {
+		return -1;
+	}
+
 	STRCPY_S(item.name, "<..>");
-	buffer_copy_string(item.compname, "..");
-	buffer_copy_string(item.shortname, "..");
 	item.data = (void *) fs_filetype_dir;
 	item.width = 4;
 	item.selected = false;
@@ -305,21 +333,20 @@ extern u32 fs_flashdir_to_menu(const char *dir, const char *sdir, u32 icolor, u3
 	memset(&info, 0, sizeof(SceIoDirent));
 
 	while (sceIoDread(fd, &info) > 0) {
-		win_menuitem_new(&item);
-
 		if ((info.d_stat.st_mode & FIO_S_IFMT) == FIO_S_IFDIR) {
 			if (info.d_name[0] == '.' && info.d_name[1] == 0) {
-				win_menuitem_free(&item);
 				continue;
 			}
 
 			if (strcmp(info.d_name, "..") == 0) {
-				win_menuitem_free(&item);
 				continue;
 			}
 
+			if (win_menu_item_new(g_menu, &item, info.d_name, NULL) < 0) {
+				break;
+			}
+
 			item.data = (void *) fs_filetype_dir;
-			buffer_copy_string(item.compname, info.d_name);
 			item.name[0] = '<';
 
 			if ((item.width = strlen(info.d_name) + 2) > MAX_ITEM_NAME_LEN) {
@@ -333,9 +360,11 @@ extern u32 fs_flashdir_to_menu(const char *dir, const char *sdir, u32 icolor, u3
 		} else {
 			t_fs_filetype ft = fs_file_get_type(info.d_name);
 
+			if (win_menu_item_new(g_menu, &item, info.d_name, info.d_name) < 0) {
+				break;
+			}
+
 			item.data = (void *) ft;
-			buffer_copy_string(item.compname, info.d_name);
-			buffer_copy_string(item.shortname, info.d_name);
 			filename_to_itemname(&item, info.d_name);
 		}
 
@@ -359,97 +388,539 @@ extern u32 fs_flashdir_to_menu(const char *dir, const char *sdir, u32 icolor, u3
 	return g_menu->size;
 }
 
+/* Directory listings parsed by fs_dir_to_menu, keyed by first cluster */
+#define DIRCACHE_COUNT 8
+
+/* Upper bound of memory held by all cached listings */
+#define DIRCACHE_MAX_BYTES (512 * 1024)
+
+typedef struct
+{
+	u32 longname;				// offsets into t_dircache.names
+	u32 shortname;
+	u32 filesize;
+	u16 cdate;
+	u16 ctime;
+	u16 mdate;
+	u16 mtime;
+	u8 attr;
+	t_fs_filetype ft;
+} t_dircache_entry;
+
+typedef struct
+{
+	u32 clus;
+	u32 crc;
+	u32 lru;
+	u32 count;
+	u32 bytes;
+	t_dircache_entry *entries;
+	char *names;
+} t_dircache;
+
+static t_dircache dircache[DIRCACHE_COUNT];
+static u32 dircache_tick = 0;
+static t_dircache *dircache_hit = NULL;
+
+static void dircache_free(t_dircache * dc)
+{
+	free(dc->entries);
+	free(dc->names);
+	memset(dc, 0, sizeof(*dc));
+}
+
+static bool dircache_unchanged(u32 clus, u32 crc)
+{
+	u32 i;
+
+	dircache_hit = NULL;
+
+	for (i = 0; i < DIRCACHE_COUNT; i++) {
+		if (dircache[i].entries != NULL && dircache[i].clus == clus) {
+			if (dircache[i].crc == crc) {
+				dircache_hit = &dircache[i];
+				dircache_hit->lru = ++dircache_tick;
+				return true;
+			}
+
+			dircache_free(&dircache[i]);
+			break;
+		}
+	}
+
+	return false;
+}
+
+/* Parse fat_readdir results once: long names, short names, types and sizes */
+static bool dircache_build(t_dircache * dc, p_fat_info info, u32 count)
+{
+	u32 i, size = 0, pos = 0;
+
+	for (i = 0; i < count; i++) {
+		size += strlen(info[i].longname) + strlen(info[i].filename) + 2;
+	}
+
+	dc->entries = malloc(count * sizeof(*dc->entries));
+	dc->names = malloc(size);
+
+	if (dc->entries == NULL || dc->names == NULL) {
+		dircache_free(dc);
+		return false;
+	}
+
+	for (i = 0; i < count; i++) {
+		t_dircache_entry *e = &dc->entries[i];
+
+		e->longname = pos;
+		strcpy(&dc->names[pos], info[i].longname);
+		pos += strlen(info[i].longname) + 1;
+		e->shortname = pos;
+		strcpy(&dc->names[pos], info[i].filename);
+		pos += strlen(info[i].filename) + 1;
+		e->filesize = info[i].filesize;
+		e->cdate = info[i].cdate;
+		e->ctime = info[i].ctime;
+		e->mdate = info[i].mdate;
+		e->mtime = info[i].mtime;
+		e->attr = info[i].attr;
+
+		if (info[i].attr & FAT_FILEATTR_DIRECTORY)
+			e->ft = fs_filetype_dir;
+		else if (info[i].filesize == 0)
+			e->ft = fs_filetype_unknown;
+		else
+			e->ft = fs_file_get_type(info[i].longname);
+	}
+
+	dc->count = count;
+	dc->bytes = count * sizeof(*dc->entries) + size;
+
+	return true;
+}
+
+/* Keep a freshly built listing, evicting least recently used ones over budget */
+static void dircache_store(t_dircache * dc)
+{
+	t_dircache *slot;
+	u32 i, total;
+
+	if (dc->bytes > DIRCACHE_MAX_BYTES) {
+		dircache_free(dc);
+		return;
+	}
+
+	for (;;) {
+		t_dircache *victim = NULL;
+
+		slot = NULL;
+		total = dc->bytes;
+
+		for (i = 0; i < DIRCACHE_COUNT; i++) {
+			total += dircache[i].bytes;
+
+			if (dircache[i].entries == NULL) {
+				if (slot == NULL)
+					slot = &dircache[i];
+			} else if (victim == NULL || dircache[i].lru < victim->lru)
+				victim = &dircache[i];
+		}
+
+		if (slot != NULL && total <= DIRCACHE_MAX_BYTES)
+			break;
+
+		// No empty slot or over budget: there is a cached listing to drop
+		dircache_free(victim);
+	}
+
+	dc->lru = ++dircache_tick;
+	*slot = *dc;
+}
+
+static void dircache_add_item(const t_dircache * dc, const t_dircache_entry * e, u32 icolor, u32 selicolor, u32 selrcolor, u32 selbcolor)
+{
+	t_win_menuitem item;
+	const char *longname = &dc->names[e->longname];
+	const char *shortname = &dc->names[e->shortname];
+
+	memset(&item, 0, sizeof(item));
+	item.compname = win_menu_strdup(g_menu, longname, strlen(longname));
+	item.shortname = win_menu_strdup(g_menu, shortname, strlen(shortname));
+
+	if (item.compname == NULL || item.shortname == NULL)
+		return;
+
+	item.arena = true;
+	item.data = (void *) e->ft;
+
+	if (e->ft == fs_filetype_dir) {
+		item.name[0] = '<';
+		if ((item.width = strlen(longname) + 2) > MAX_ITEM_NAME_LEN) {
+			strncpy_s(&item.name[1], NELEMS(item.name) - 1, longname, MAX_ITEM_NAME_LEN - 5);
+			item.name[MAX_ITEM_NAME_LEN - 4] = item.name[MAX_ITEM_NAME_LEN - 3] = item.name[MAX_ITEM_NAME_LEN - 2] = '.';
+			item.name[MAX_ITEM_NAME_LEN - 1] = '>';
+			item.name[MAX_ITEM_NAME_LEN] = 0;
+			item.width = MAX_ITEM_NAME_LEN;
+		} else {
+			strncpy_s(&item.name[1], NELEMS(item.name) - 1, longname, MAX_ITEM_NAME_LEN);
+			item.name[item.width - 1] = '>';
+			item.name[item.width] = 0;
+		}
+	} else {
+		filename_to_itemname(&item, longname);
+	}
+
+	item.icolor = icolor;
+	item.selicolor = selicolor;
+	item.selrcolor = selrcolor;
+	item.selbcolor = selbcolor;
+	item.selected = false;
+	item.data2[0] = e->cdate;
+	item.data2[1] = e->ctime;
+	item.data2[2] = e->mdate;
+	item.data2[3] = e->mtime;
+	item.data3 = e->filesize;
+	win_menu_add(g_menu, &item);
+}
+
 // New style fat system custom reading
 extern u32 fs_dir_to_menu(const char *dir, char *sdir, u32 icolor, u32 selicolor, u32 selrcolor, u32 selbcolor, bool showhidden, bool showunknown)
 {
 	int fid;
 	p_fat_info info;
-	u32 count;
+	u32 count, clus, crc;
 	u32 i;
-	t_win_menuitem item;
+	t_dircache built, *dc;
 
 	if (menu_renew(&g_menu) == NULL) {
 		return 0;
 	}
 
 	fid = freq_enter_hotzone();
-	count = fat_readdir(dir, sdir, &info);
+	dircache_hit = NULL;
+	count = fat_readdir_ex(dir, sdir, &info, dircache_unchanged, &clus, &crc);
 
 	if (count == INVALID) {
 		freq_leave(fid);
 		return 0;
 	}
 
+	// <..> is listed even when the directory is empty or cannot be cached
 	add_parent_to_menu(g_menu, icolor, selicolor, selrcolor, selbcolor);
 
-	for (i = 0; i < count; i++) {
-		win_menuitem_new(&item);
+	if (dircache_hit != NULL) {
+		dc = dircache_hit;
+	} else if (count == 0) {
+		// nothing to cache: an empty listing would look like a free slot
+		free(info);
+		freq_leave(fid);
+		return g_menu->size;
+	} else {
+		memset(&built, 0, sizeof(built));
+		built.clus = clus;
+		built.crc = crc;
+
+		if (!dircache_build(&built, info, count)) {
+			free(info);
+			freq_leave(fid);
+			return g_menu->size;
+		}
+
+		free(info);
+		dc = &built;
+	}
 
-		if (!showhidden && (info[i].attr & FAT_FILEATTR_HIDDEN) > 0) {
-			win_menuitem_free(&item);
+	win_menu_reserve(g_menu, g_menu->size + dc->count);
+
+	for (i = 0; i < dc->count; i++) {
+		const t_dircache_entry *e = &dc->entries[i];
+
+		if (!showhidden && (e->attr & FAT_FILEATTR_HIDDEN) > 0)
 			continue;
+
+		if (e->ft != fs_filetype_dir) {
+			if (e->filesize == 0)
+				continue;
+
+			if (!showunknown && e->ft == fs_filetype_unknown)
+				continue;
 		}
 
-		if (info[i].attr & FAT_FILEATTR_DIRECTORY) {
-			item.data = (void *) fs_filetype_dir;
-			buffer_copy_string(item.shortname, info[i].filename);
-			buffer_copy_string(item.compname, info[i].longname);
-			item.name[0] = '<';
-			if ((item.width = strlen(info[i].longname) + 2) > MAX_ITEM_NAME_LEN) {
-				strncpy_s(&item.name[1], NELEMS(item.name) - 1, info[i].longname, MAX_ITEM_NAME_LEN - 5);
-				item.name[MAX_ITEM_NAME_LEN - 4] = item.name[MAX_ITEM_NAME_LEN - 3] = item.name[MAX_ITEM_NAME_LEN - 2] = '.';
-				item.name[MAX_ITEM_NAME_LEN - 1] = '>';
-				item.name[MAX_ITEM_NAME_LEN] = 0;
-				item.width = MAX_ITEM_NAME_LEN;
-			} else {
-				strncpy_s(&item.name[1], NELEMS(item.name) - 1, info[i].longname, MAX_ITEM_NAME_LEN);
-				item.name[item.width - 1] = '>';
-				item.name[item.width] = 0;
+		dircache_add_item(dc, e, icolor, selicolor, selrcolor, selbcolor);
+	}
+
+	if (dc == &built)
+		dircache_store(&built);
+
+	freq_leave(fid);
+
+	return g_menu->size;
+}
+
+typedef struct
+{
+	t_fs_filetype ft;
+	unzFile unzf;
+	HANDLE hrar;
+	struct RAROpenArchiveData arcdata;
+	char path[PATH_MAX];
+	// Where to resume after the handles were closed by fs_list_suspend
+	bool suspended;
+	unz_file_pos zpos;
+	u32 rar_done;
+	u32 icolor;
+	u32 selicolor;
+	u32 selrcolor;
+	u32 selbcolor;
+} t_fs_arc_list;
+
+// Archive being listed into g_menu in batches
+static t_fs_arc_list arc_list = {
+	fs_filetype_unknown,
+};
+
+// fs_list_suspend runs on the power callback thread
+static struct psp_mutex_t arc_list_l;
+
+static void fs_list_close_handles(void)
+{
+	if (arc_list.unzf != NULL) {
+		unzClose(arc_list.unzf);
+		arc_list.unzf = NULL;
+	}
+
+	if (arc_list.hrar != 0) {
+		RARCloseArchive(arc_list.hrar);
+		arc_list.hrar = 0;
+	}
+}
+
+static void fs_list_close(void)
+{
+	xr_lock(&arc_list_l);
+	fs_list_close_handles();
+	arc_list.suspended = false;
+	arc_list.ft = fs_filetype_unknown;
+	xr_unlock(&arc_list_l);
+}
+
+static void fs_list_open(t_fs_filetype ft, u32 icolor, u32 selicolor, u32 selrcolor, u32 selbcolor)
+{
+	arc_list.ft = ft;
+	arc_list.suspended = false;
+	arc_list.rar_done = 0;
+	arc_list.icolor = icolor;
+	arc_list.selicolor = selicolor;
+	arc_list.selrcolor = selrcolor;
+	arc_list.selbcolor = selbcolor;
+}
+
+static int add_arc_item_to_menu(const char *compname, const char *name, t_fs_filetype ft, u32 size)
+{
+	t_win_menuitem item;
+	char t[12], *p = &t[sizeof(t) - 1];
+	u32 n = size;
+
+	*p = '\0';
+
+	do {
+		*--p = '0' + n % 10;
+		n /= 10;
+	} while (n > 0);
+
+	memset(&item, 0, sizeof(item));
+	item.compname = win_menu_strdup(g_menu, compname, strlen(compname));
+	item.shortname = win_menu_strdup(g_menu, p, &t[sizeof(t) - 1] - p);
+
+	if (item.compname == NULL || item.shortname == NULL)
+		return -1;
+
+	item.arena = true;
+	item.data = (void *) ft;
+	filename_to_itemname(&item, name);
+	item.selected = false;
+	item.icolor = arc_list.icolor;
+	item.selicolor = arc_list.selicolor;
+	item.selrcolor = arc_list.selrcolor;
+	item.selbcolor = arc_list.selbcolor;
+	item.data3 = size;
+
+	return win_menu_add(g_menu, &item);
+}
+
+static u32 fs_zip_list_more(u32 count)
+{
+	u32 i, added = 0;
+
+	for (i = 0; i < count; ++i) {
+		char fname[PATH_MAX];
+		unz_file_info file_info;
+		t_fs_filetype ft;
+
+		if (unzGetCurrentFileInfo(arc_list.unzf, &file_info, fname, PATH_MAX, NULL, 0, NULL, 0) != UNZ_OK) {
+			fs_list_close();
+			break;
+		}
+
+		if (file_info.uncompressed_size != 0) {
+			ft = fs_file_get_type(fname);
+
+			if (ft != fs_filetype_chm && ft != fs_filetype_zip && ft != fs_filetype_rar
+				&& add_arc_item_to_menu(fname, fname, ft, file_info.uncompressed_size) == 0)
+				added++;
+		}
+
+		if (unzGoToNextFile(arc_list.unzf) != UNZ_OK) {
+			fs_list_close();
+			break;
+		}
+	}
+
+	return added;
+}
+
+/**
+ * Read the next rar header, asking for a password when the headers are encrypted
+ */
+static int fs_rar_read_header(struct RARHeaderDataEx *header)
+{
+	int ret = RARReadHeaderEx(arc_list.hrar, header);
+
+	if (ret == 0)
+		return 0;
+
+	if (ret != ERAR_UNKNOWN)
+		return -1;
+
+	RARCloseArchive(arc_list.hrar);
+
+	if ((arc_list.hrar = reopen_rar_with_passwords(&arc_list.arcdata)) == 0 || RARReadHeaderEx(arc_list.hrar, header) != 0)
+		return -1;
+
+	return 0;
+}
+
+static u32 fs_rar_list_more(u32 count)
+{
+	struct RARHeaderDataEx header;
+	u32 i, added = 0;
+	int ret;
+
+	for (i = 0; i < count; ++i) {
+		t_fs_filetype ft;
+
+		if (fs_rar_read_header(&header) < 0) {
+			fs_list_close();
+			break;
+		}
+
+		if (header.UnpSize != 0) {
+			ft = fs_file_get_type(header.FileName);
+
+			if (ft != fs_filetype_chm && ft != fs_filetype_zip && ft != fs_filetype_rar) {
+				if (header.Flags & 0x200) {
+					char str[1024];
+
+					memset(str, 0, 1024);
+					charsets_utf32_conv((const u8 *) header.FileNameW, sizeof(header.FileNameW), (u8 *) str, sizeof(str));
+					ret = add_arc_item_to_menu(header.FileName, str, ft, header.UnpSize);
+				} else
+					ret = add_arc_item_to_menu(header.FileName, header.FileName, ft, header.UnpSize);
+				if (ret == 0)
+					added++;
 			}
+		}
+
+		if (RARProcessFile(arc_list.hrar, RAR_SKIP, NULL, NULL) != 0) {
+			fs_list_close();
+			break;
+		}
+
+		arc_list.rar_done++;
+	}
+
+	return added;
+}
+
+extern bool fs_list_pending(void)
+{
+	return arc_list.ft != fs_filetype_unknown;
+}
+
+extern void fs_list_suspend(void)
+{
+	xr_lock(&arc_list_l);
+
+	if (fs_list_pending() && !arc_list.suspended) {
+		if (arc_list.unzf != NULL && unzGetFilePos(arc_list.unzf, &arc_list.zpos) != UNZ_OK) {
+			fs_list_close();
 		} else {
-			t_fs_filetype ft;
+			fs_list_close_handles();
+			arc_list.suspended = true;
+		}
+	}
 
-			if (info[i].filesize == 0) {
-				win_menuitem_free(&item);
-				continue;
-			}
+	xr_unlock(&arc_list_l);
+}
+
+/**
+ * Reopen the archive closed by fs_list_suspend at the entry where listing stopped
+ */
+static int fs_list_resume(void)
+{
+	arc_list.suspended = false;
 
-			ft = fs_file_get_type(info[i].longname);
+	if (arc_list.ft == fs_filetype_zip) {
+		arc_list.unzf = unzOpen(arc_list.path);
 
-			if (!showunknown && ft == fs_filetype_unknown) {
-				win_menuitem_free(&item);
-				continue;
-			}
+		if (arc_list.unzf == NULL || unzGoToFilePos(arc_list.unzf, &arc_list.zpos) != UNZ_OK)
+			return -1;
+	} else if (arc_list.ft == fs_filetype_rar) {
+		struct RARHeaderDataEx header;
+		u32 i;
 
-			item.data = (void *) ft;
-			buffer_copy_string(item.shortname, info[i].filename);
-			buffer_copy_string(item.compname, info[i].longname);
-			filename_to_itemname(&item, info[i].longname);
+		arc_list.hrar = RAROpenArchive(&arc_list.arcdata);
+
+		if (arc_list.hrar == 0)
+			return -1;
+
+		for (i = 0; i < arc_list.rar_done; ++i) {
+			if (fs_rar_read_header(&header) < 0 || RARProcessFile(arc_list.hrar, RAR_SKIP, NULL, NULL) != 0)
+				return -1;
 		}
-		item.icolor = icolor;
-		item.selicolor = selicolor;
-		item.selrcolor = selrcolor;
-		item.selbcolor = selbcolor;
-		item.selected = false;
-		item.data2[0] = info[i].cdate;
-		item.data2[1] = info[i].ctime;
-		item.data2[2] = info[i].mdate;
-		item.data2[3] = info[i].mtime;
-		item.data3 = info[i].filesize;
-		win_menu_add(g_menu, &item);
 	}
 
-	free(info);
+	return 0;
+}
+
+extern u32 fs_list_more(u32 count)
+{
+	int fid;
+	u32 added = 0;
+
+	if (!fs_list_pending() || g_menu == NULL)
+		return 0;
+
+	fid = freq_enter_hotzone();
+	xr_lock(&arc_list_l);
+
+	if (arc_list.suspended && fs_list_resume() < 0)
+		fs_list_close();
+
+	if (arc_list.ft == fs_filetype_zip)
+		added = fs_zip_list_more(count);
+	else if (arc_list.ft == fs_filetype_rar)
+		added = fs_rar_list_more(count);
+
+	xr_unlock(&arc_list_l);
 	freq_leave(fid);
 
-	return g_menu->size;
+	return added;
 }
 
 extern u32 fs_zip_to_menu(const char *zipfile, u32 icolor, u32 selicolor, u32 selrcolor, u32 selbcolor)
 {
 	int fid;
 	unzFile unzf;
-	t_win_menuitem item;
 
 	if (menu_renew(&g_menu) == NULL) {
 		return 0;
@@ -472,55 +943,23 @@ extern u32 fs_zip_to_menu(const char *zipfile, u32 icolor, u32 selicolor, u32 se
 		return g_menu->size;
 	}
 
-	do {
-		char fname[PATH_MAX];
-		unz_file_info file_info;
-		t_fs_filetype ft;
-		char t[20];
-
-		if (unzGetCurrentFileInfo(unzf, &file_info, fname, PATH_MAX, NULL, 0, NULL, 0) != UNZ_OK)
-			break;
-
-		if (file_info.uncompressed_size == 0)
-			continue;
-
-		ft = fs_file_get_type(fname);
-
-		if (ft == fs_filetype_chm || ft == fs_filetype_zip || ft == fs_filetype_rar)
-			continue;
-
-		win_menuitem_new(&item);
-
-		item.data = (void *) ft;
-		buffer_copy_string(item.compname, fname);
-
-		SPRINTF_S(t, "%u", (unsigned int) file_info.uncompressed_size);
-		buffer_copy_string(item.shortname, t);
-		filename_to_itemname(&item, fname);
-		item.selected = false;
-		item.icolor = icolor;
-		item.selicolor = selicolor;
-		item.selrcolor = selrcolor;
-		item.selbcolor = selbcolor;
-		item.data3 = file_info.uncompressed_size;
-		win_menu_add(g_menu, &item);
-	} while (unzGoToNextFile(unzf) == UNZ_OK);
-
-	unzClose(unzf);
 	freq_leave(fid);
 
+	// only the first batch is listed here, the rest by fs_list_more
+	xr_lock(&arc_list_l);
+	STRCPY_S(arc_list.path, zipfile);
+	arc_list.unzf = unzf;
+	fs_list_open(fs_filetype_zip, icolor, selicolor, selrcolor, selbcolor);
+	fs_list_more(FS_LIST_BATCH);
+	xr_unlock(&arc_list_l);
+
 	return g_menu->size;
 }
 
 extern u32 fs_rar_to_menu(const char *rarfile, u32 icolor, u32 selicolor, u32 selrcolor, u32 selbcolor)
 {
 	int fid;
-	struct RAROpenArchiveData arcdata;
-	struct RARHeaderDataEx header;
-	int ret;
 	HANDLE hrar;
-	t_fs_filetype ft;
-	t_win_menuitem item;
 
 	if (menu_renew(&g_menu) == NULL) {
 		return 0;
@@ -528,71 +967,30 @@ extern u32 fs_rar_to_menu(const char *rarfile, u32 icolor, u32 selicolor, u32 se
 
 	fid = freq_enter_hotzone();
 
-	arcdata.ArcName = (char *) rarfile;
-	arcdata.OpenMode = RAR_OM_LIST;
-	arcdata.CmtBuf = NULL;
-	arcdata.CmtBufSize = 0;
+	// the open data is kept for reopening after fs_list_suspend
+	xr_lock(&arc_list_l);
+	STRCPY_S(arc_list.path, rarfile);
+	arc_list.arcdata.ArcName = arc_list.path;
+	arc_list.arcdata.OpenMode = RAR_OM_LIST;
+	arc_list.arcdata.CmtBuf = NULL;
+	arc_list.arcdata.CmtBufSize = 0;
 
-	hrar = RAROpenArchive(&arcdata);
+	hrar = RAROpenArchive(&arc_list.arcdata);
 
 	if (hrar == 0) {
+		xr_unlock(&arc_list_l);
 		freq_leave(fid);
 		return 0;
 	}
 
 	add_parent_to_menu(g_menu, icolor, selicolor, selrcolor, selbcolor);
-
-	do {
-		char t[20];
-
-		if ((ret = RARReadHeaderEx(hrar, &header)) != 0) {
-			if (ret != ERAR_UNKNOWN)
-				break;
-			RARCloseArchive(hrar);
-			if ((hrar = reopen_rar_with_passwords(&arcdata)) == 0)
-				break;
-			if (RARReadHeaderEx(hrar, &header) != 0)
-				break;
-		}
-		if (header.UnpSize == 0)
-			continue;
-
-		ft = fs_file_get_type(header.FileName);
-
-		if (ft == fs_filetype_chm || ft == fs_filetype_zip || ft == fs_filetype_rar)
-			continue;
-
-		win_menuitem_new(&item);
-		item.data = (void *) ft;
-
-		if (header.Flags & 0x200) {
-			char str[1024];
-			const u8 *uni;
-
-			memset(str, 0, 1024);
-			uni = (u8 *) header.FileNameW;
-			charsets_utf32_conv(uni, sizeof(header.FileNameW), (u8 *) str, sizeof(str));
-			buffer_copy_string_len(item.compname, header.FileName, 256);
-			filename_to_itemname(&item, str);
-		} else {
-			buffer_copy_string_len(item.compname, header.FileName, 256);
-			filename_to_itemname(&item, header.FileName);
-		}
-
-		SPRINTF_S(t, "%u", (unsigned int) header.UnpSize);
-		buffer_copy_string(item.shortname, t);
-		item.selected = false;
-		item.icolor = icolor;
-		item.selicolor = selicolor;
-		item.selrcolor = selrcolor;
-		item.selbcolor = selbcolor;
-		item.data3 = header.UnpSize;
-		win_menu_add(g_menu, &item);
-	} while (RARProcessFile(hrar, RAR_SKIP, NULL, NULL) == 0);
-
-	RARCloseArchive(hrar);
 	freq_leave(fid);
 
+	arc_list.hrar = hrar;
+	fs_list_open(fs_filetype_rar, icolor, selicolor, selrcolor, selbcolor);
+	fs_list_more(FS_LIST_BATCH);
+	xr_unlock(&arc_list_l);
+
 	return g_menu->size;
 }
 
@@ -632,10 +1030,11 @@ static int chmEnum(struct chmFile *h, struct chmUnitInfo *ui, void *context)
 	if (ft == fs_filetype_chm || ft == fs_filetype_zip || ft == fs_filetype_rar || ft == fs_filetype_umd || ft == fs_filetype_pdb)
 		return CHM_ENUMERATOR_CONTINUE;
 
-	win_menuitem_new(&item);
-	buffer_copy_string(item.compname, ui->path);
 	SPRINTF_S(t, "%u", (unsigned int) ui->length);
-	buffer_copy_string(item.shortname, t);
+
+	if (win_menu_item_new(g_menu, &item, ui->path, t) < 0)
+		return CHM_ENUMERATOR_FAILURE;
+
 	if (ui->path[0] == '/') {
 		strncpy_s(fname, NELEMS(fname), ui->path + 1, 256);
 	} else {
@@ -668,7 +1067,7 @@ extern u32 fs_chm_to_menu(const char *chmfile, u32 icolor, u32 selicolor, u32 se
 	}
 
 	fid = freq_enter_hotzone();
-	chm = chm_open(chmfile);
+	chm = chmcache_open(chmfile);
 
 	if (chm == NULL) {
 		freq_leave(fid);
@@ -681,8 +1080,8 @@ extern u32 fs_chm_to_menu(const char *chmfile, u32 icolor, u32 selicolor, u32 se
 	cenum.selicolor = selicolor;
 	cenum.selrcolor = selrcolor;
 	cenum.selbcolor = selbcolor;
-	chm_enumerate(chm, CHM_ENUMERATE_NORMAL | CHM_ENUMERATE_FILES, chmEnum, (void *) &cenum);
-	chm_close(chm);
+	chmcache_enumerate(chmfile, CHM_ENUMERATE_NORMAL | CHM_ENUMERATE_FILES, chmEnum, (void *) &cenum);
+	chmcache_close(chm);
 	freq_leave(fid);
 
 	return g_menu->size;
@@ -731,9 +1130,14 @@ extern u32 fs_umd_to_menu(const char *umdfile, u32 icolor, u32 selicolor, u32 se
 				stlen = p[i - 1].name->used - 1;
 				stlen = charsets_ucs_conv((const u8 *) p[i - 1].name->ptr, stlen, (u8 *) pbuf->ptr, pbuf->size);
 				SPRINTF_S(pos, "%d", p[i - 1].length);
-				win_menuitem_new(&item);
-				buffer_copy_string_len(item.shortname, pos, 20);
-				buffer_copy_string_len(item.compname, pbuf->ptr, (stlen > 256) ? 256 : stlen);
+				memset(&item, 0, sizeof(item));
+				item.shortname = win_menu_strdup(g_menu, pos, strlen(pos));
+				item.compname = win_menu_strdup(g_menu, pbuf->ptr, (stlen > 256) ? 256 : stlen);
+
+				if (item.shortname == NULL || item.compname == NULL)
+					break;
+
+				item.arena = true;
 				filename_to_itemname(&item, item.compname->ptr);
 				if (1 != p_umdchapter->umd_type) {
 					if (0 == p_umdchapter->umd_mode)
@@ -774,41 +1178,127 @@ extern u32 fs_umd_to_menu(const char *umdfile, u32 icolor, u32 selicolor, u32 se
 	return g_menu->size;
 }
 
-extern t_fs_filetype fs_file_get_type(const char *filename)
+/* FNV-1a over a key that is already lowercase */
+static u32 ft_hash_key(const char *key, size_t len)
 {
-	const char *ext = utils_fileext(filename);
-	t_fs_filetype_entry *entry = ft_table;
-	t_fs_specfiletype_entry *entry2 = ft_spec_table;
+	u32 h = 2166136261U;
 
-	if (ext) {
-		while (entry->ext != NULL) {
-			if (stricmp(ext, entry->ext) == 0)
-				return entry->ft;
-			entry++;
-		}
+	while (len-- > 0) {
+		h ^= (u8) * key++;
+		h *= 16777619U;
 	}
 
-	while (entry2->fname != NULL) {
-		const char *shortname = strrchr(filename, '/');
+	return h;
+}
 
-		if (!shortname)
-			shortname = filename;
-		else
-			shortname++;
-		if (stricmp(shortname, entry2->fname) == 0)
-			return entry2->ft;
-		entry2++;
+/**
+ * Lowercase at most FT_KEY_MAX - 1 bytes of src into dst
+ *
+ * @return length of the key, or 0 if it doesn't fit
+ */
+static size_t ft_make_key(char *dst, const char *src, size_t len)
+{
+	size_t i;
+
+	if (len == 0 || len >= FT_KEY_MAX)
+		return 0;
+
+	for (i = 0; i < len; i++)
+		dst[i] = tolower((u8) src[i]);
+
+	dst[len] = '\0';
+
+	return len;
+}
+
+static void ft_hash_insert(t_fs_filetype_slot * table, const char *name, t_fs_filetype ft)
+{
+	char key[FT_KEY_MAX];
+	size_t len = ft_make_key(key, name, strlen(name));
+	u32 i;
+
+	if (len == 0)
+		return;
+
+	i = ft_hash_key(key, len) & (FT_HASH_SIZE - 1);
+
+	while (table[i].key[0] != '\0') {
+		// First entry wins, as the linear tables did
+		if (strcmp(table[i].key, key) == 0)
+			return;
+		i = (i + 1) & (FT_HASH_SIZE - 1);
 	}
 
-#ifdef ENABLE_MUSIC
-	if (fs_is_music(filename, filename)) {
-		return fs_filetype_music;
+	memcpy(table[i].key, key, len + 1);
+	table[i].ft = ft;
+}
+
+static t_fs_filetype ft_hash_find(const t_fs_filetype_slot * table, const char *name, size_t len)
+{
+	char key[FT_KEY_MAX];
+	u32 i;
+
+	len = ft_make_key(key, name, len);
+
+	if (len == 0)
+		return fs_filetype_unknown;
+
+	i = ft_hash_key(key, len) & (FT_HASH_SIZE - 1);
+
+	while (table[i].key[0] != '\0') {
+		if (strcmp(table[i].key, key) == 0)
+			return table[i].ft;
+		i = (i + 1) & (FT_HASH_SIZE - 1);
 	}
-#endif
 
 	return fs_filetype_unknown;
 }
 
+/**
+ * Build both lookup tables from ft_table and ft_spec_table
+ *
+ * @note Building is deterministic, so two threads racing here only
+ * write the same bytes twice
+ */
+static void ft_hash_build(void)
+{
+	t_fs_filetype_entry *entry;
+	t_fs_specfiletype_entry *entry2;
+
+	for (entry = ft_table; entry->ext != NULL; entry++)
+		ft_hash_insert(ft_ext_hash, entry->ext, entry->ft);
+
+	for (entry2 = ft_spec_table; entry2->fname != NULL; entry2++)
+		ft_hash_insert(ft_name_hash, entry2->fname, entry2->ft);
+
+	ft_hash_ready = true;
+}
+
+extern t_fs_filetype fs_file_get_type(const char *filename)
+{
+	const char *p, *dot = NULL, *base = filename;
+
+	if (filename == NULL)
+		return fs_filetype_unknown;
+
+	if (!ft_hash_ready)
+		ft_hash_build();
+
+	// One pass finds both the basename and the last dot in it
+	for (p = filename; *p != '\0'; p++) {
+		if (*p == '/') {
+			base = p + 1;
+			dot = NULL;
+		} else if (*p == '.')
+			dot = p;
+	}
+
+	if (dot != NULL)
+		return ft_hash_find(ft_ext_hash, dot + 1, p - dot - 1);
+
+	return ft_hash_find(ft_name_hash, base, p - base);
+}
+
 #ifdef ENABLE_IMAGE
 extern bool fs_is_image(t_fs_filetype ft)
 {
@@ -822,6 +1312,25 @@ extern bool fs_is_txtbook(t_fs_filetype ft)
 }
 
 #ifdef ENABLE_MUSIC
+/**
+ * Add the extensions of every registered music driver to the lookup table
+ *
+ * @note Call after music_init(), before other threads classify files
+ */
+extern void fs_add_music_types(void)
+{
+	struct music_ops *drv;
+	const char **ext;
+
+	if (!ft_hash_ready)
+		ft_hash_build();
+
+	for (drv = musicdrv_first(); drv != NULL; drv = drv->next) {
+		for (ext = drv->exts; ext != NULL && *ext != NULL; ext++)
+			ft_hash_insert(ft_ext_hash, *ext, fs_filetype_music);
+	}
+}
+
 extern bool fs_is_music(const char *spath, const char *lpath)
 {
 	bool res;
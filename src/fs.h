@@ -57,6 +57,12 @@ typedef enum
 		, fs_filetype_font
 #endif
 } t_fs_filetype;
+
+enum
+{
+	FS_LIST_BATCH = 256,
+};
+
 extern p_umd_chapter p_umdchapter;
 extern u32 fs_list_device(const char *dir, const char *sdir, u32 icolor, u32 selicolor, u32 selrcolor, u32 selbcolor);
 extern u32 fs_flashdir_to_menu(const char *dir, const char *sdir, u32 icolor, u32 selicolor, u32 selrcolor, u32 selbcolor);
@@ -66,9 +72,13 @@ extern u32 fs_rar_to_menu(const char *rarfile, u32 icolor, u32 selicolor, u32 se
 extern u32 fs_chm_to_menu(const char *chmfile, u32 icolor, u32 selicolor, u32 selrcolor, u32 selbcolor);
 extern u32 fs_umd_to_menu(const char *umdfile, u32 icolor, u32 selicolor, u32 selrcolor, u32 selbcolor);
 extern u32 fs_empty_dir(u32 icolor, u32 selicolor, u32 selrcolor, u32 selbcolor);
+extern u32 fs_list_more(u32 count);
+extern bool fs_list_pending(void);
+extern void fs_list_suspend(void);
 extern t_fs_filetype fs_file_get_type(const char *filename);
 extern bool fs_is_image(t_fs_filetype ft);
 extern bool fs_is_txtbook(t_fs_filetype ft);
+extern void fs_add_music_types(void);
 extern bool fs_is_music(const char *spath, const char *lpath);
 
 #endif
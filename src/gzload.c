@@ -0,0 +1,204 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pspkernel.h>
+#include <zlib.h>
+#include "common/utils.h"
+#include "gzload.h"
+#include "dbg.h"
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+#define GZLOAD_CHUNK (16 * 1024)
+
+static u32 gz_fill(SceUID fd, z_stream * z, u8 * in)
+{
+	if (z->avail_in == 0) {
+		int n = sceIoRead(fd, in, GZLOAD_CHUNK);
+
+		if (n > 0) {
+			z->next_in = in;
+			z->avail_in = n;
+		}
+	}
+
+	return z->avail_in;
+}
+
+/**
+ * ǷGZIPԱ
+ */
+static bool gz_next_member(SceUID fd, z_stream * z, u8 * in)
+{
+	if (gz_fill(fd, z, in) < 2)
+		return false;
+
+	return z->next_in[0] == 0x1f && z->next_in[1] == 0x8b;
+}
+
+/**
+ * ѹļ, 岻ʱӱ
+ *
+ * @return ѹС, ʧܷ-1
+ */
+static int gz_inflate_all(SceUID fd, u8 ** pout, u32 * pcap)
+{
+	z_stream z;
+	u8 *in, *out = *pout;
+	u32 cap = *pcap, totout = 0;
+	int ret = Z_OK;
+
+	in = malloc(GZLOAD_CHUNK);
+
+	if (in == NULL)
+		return -1;
+
+	memset(&z, 0, sizeof(z));
+
+	if (inflateInit2(&z, 47) != Z_OK) {
+		free(in);
+		return -1;
+	}
+
+	do {
+		u32 avail_out;
+
+		if (gz_fill(fd, &z, in) == 0) {
+			ret = Z_DATA_ERROR;
+			break;
+		}
+
+		if (totout == cap) {
+			u8 *p = safe_realloc(out, cap * 2);
+
+			if (p == NULL) {
+				ret = Z_MEM_ERROR;
+				break;
+			}
+
+			out = p;
+			cap *= 2;
+		}
+
+		z.next_out = out + totout;
+		z.avail_out = cap - totout;
+		avail_out = z.avail_out;
+		ret = inflate(&z, Z_NO_FLUSH);
+		totout += avail_out - z.avail_out;
+
+		// , ֵݴ
+		if (ret != Z_OK && ret != Z_STREAM_END)
+			break;
+
+		if (ret == Z_STREAM_END && gz_next_member(fd, &z, in)) {
+			ret = inflateReset(&z);
+
+			if (ret != Z_OK)
+				break;
+		}
+	} while (ret != Z_STREAM_END);
+
+	inflateEnd(&z);
+	free(in);
+	*pout = out;
+	*pcap = cap;
+
+	if (ret != Z_STREAM_END) {
+		dbg_printf(d, "%s: inflate failed %d", __func__, ret);
+		return -1;
+	}
+
+	return totout;
+}
+
+/**
+ * ȡһԱ¼ĽѹС
+ */
+static u32 gz_get_isize(SceUID fd, SceOff filesize)
+{
+	u8 b[4];
+	u32 isize = 0;
+
+	if (filesize >= 18 && sceIoLseek(fd, filesize - 4, PSP_SEEK_SET) == filesize - 4 && sceIoRead(fd, b, 4) == 4) {
+		isize = b[0] | (b[1] << 8) | (b[2] << 16) | (b[3] << 24);
+	}
+
+	sceIoLseek(fd, 0, PSP_SEEK_SET);
+
+	return isize;
+}
+
+extern int gzload_all(const char *gzfile, char **pbuf, u32 * psize)
+{
+	SceIoStat sta;
+	SceUID fd;
+	u8 *out;
+	u32 cap;
+	int ret;
+
+	*pbuf = NULL;
+	*psize = 0;
+	memset(&sta, 0, sizeof(sta));
+
+	if (sceIoGetstat(gzfile, &sta) < 0)
+		return -1;
+
+	fd = sceIoOpen(gzfile, PSP_O_RDONLY, 0777);
+
+	if (fd < 0)
+		return -1;
+
+	cap = max(gz_get_isize(fd, sta.st_size) + 1, GZLOAD_CHUNK);
+	out = malloc(cap);
+
+	if (out == NULL) {
+		sceIoClose(fd);
+		return -1;
+	}
+
+	ret = gz_inflate_all(fd, &out, &cap);
+	sceIoClose(fd);
+
+	if (ret < 0) {
+		free(out);
+		return -1;
+	}
+
+	if ((u32) ret >= cap) {
+		u8 *p = safe_realloc(out, ret + 1);
+
+		if (p == NULL) {
+			free(out);
+			return -1;
+		}
+
+		out = p;
+	}
+
+	out[ret] = '\0';
+	*pbuf = (char *) out;
+	*psize = ret;
+
+	return 0;
+}
@@ -0,0 +1,40 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef GZLOAD_H
+#define GZLOAD_H
+
+#include "common/datatype.h"
+
+/**
+ * ѹGZIPļڴ
+ *
+ * @note ֶ֧ԱGZIPļ
+ * @note 尴GZIPβ¼ĴСһη, Աļʱټӱ
+ *
+ * @param gzfile GZIPļ·
+ * @param pbuf صĻ, ɵͷ
+ * @param psize صĽѹС
+ *
+ * @return ɹ0, ʧܷظ
+ */
+extern int gzload_all(const char *gzfile, char **pbuf, u32 * psize);
+
+#endif
@@ -130,6 +130,20 @@ struct hash_control *hash_new(void)
 void hash_die(table)
 struct hash_control *table;
 {
+	unsigned int i;
+
+	for (i = 0; i < table->size; ++i) {
+		struct hash_entry *p = table->table[i];
+
+		while (p != NULL) {
+			struct hash_entry *next = p->next;
+
+			free(p);
+			p = next;
+		}
+	}
+
+	free(table->table);
 	free(table);
 }
 
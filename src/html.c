@@ -21,451 +21,478 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include "common/utils.h"
+#include "charsets.h"
 #include "html.h"
 #ifdef DMALLOC
 #include "dmalloc.h"
 #endif
 
-static char *html_skip_spaces(char *string, size_t size)
+enum
 {
-	char *res = string;
-
-	while (size > 0 && (*res == '\r' || *res == '\n' || *res == ' ' || *res == '\t')) {
-		res++;
-		size--;
-	}
-
-	return res;
+	HTML_TEXT,
+	HTML_ENTITY,
+	HTML_TAG_OPEN,
+	HTML_TAG_NAME,
+	HTML_TAG_ATTR,
+	HTML_COMMENT,
+	HTML_SKIP,
+	HTML_SCRIPT,
+	HTML_SCRIPT_WRITE,
+};
+
+enum
+{
+	HTML_NONE,
+	HTML_NEWLINE,
+	HTML_SPACE,
+	HTML_HIDE,					// content is not text
+	HTML_JSCRIPT,				// only document.write strings are text
+	HTML_PRE,
+	HTML_VOID,					// no content, display:none is meaningless
+};
+
+typedef struct
+{
+	const char *name;
+	u8 open;
+	u8 close;
+} t_html_tag;
+
+static const t_html_tag html_tags[] = {
+	{"br", HTML_NEWLINE, HTML_NONE},
+	{"p", HTML_NEWLINE, HTML_NEWLINE},
+	{"div", HTML_NEWLINE, HTML_NEWLINE},
+	{"li", HTML_NEWLINE, HTML_NONE},
+	{"tr", HTML_NEWLINE, HTML_NONE},
+	{"table", HTML_NONE, HTML_NEWLINE},
+	{"h1", HTML_NEWLINE, HTML_NEWLINE},
+	{"h2", HTML_NEWLINE, HTML_NEWLINE},
+	{"h3", HTML_NEWLINE, HTML_NEWLINE},
+	{"h4", HTML_NEWLINE, HTML_NEWLINE},
+	{"h5", HTML_NEWLINE, HTML_NEWLINE},
+	{"h6", HTML_NEWLINE, HTML_NEWLINE},
+	{"blockquote", HTML_NEWLINE, HTML_NEWLINE},
+	{"dt", HTML_NEWLINE, HTML_NONE},
+	{"dd", HTML_NEWLINE, HTML_NONE},
+	{"hr", HTML_NEWLINE, HTML_NONE},
+	{"th", HTML_SPACE, HTML_NONE},
+	{"td", HTML_SPACE, HTML_NONE},
+	{"head", HTML_HIDE, HTML_NONE},
+	{"style", HTML_HIDE, HTML_NONE},
+	{"title", HTML_HIDE, HTML_NONE},
+	{"script", HTML_JSCRIPT, HTML_NONE},
+	{"pre", HTML_PRE, HTML_PRE},
+	{"img", HTML_VOID, HTML_NONE},
+	{"meta", HTML_VOID, HTML_NONE},
+	{"link", HTML_VOID, HTML_NONE},
+	{"input", HTML_VOID, HTML_NONE},
+};
+
+// Every replacement is shorter than "&name", so output never overtakes input
+typedef struct
+{
+	const char *name;
+	const char *text;			// ASCII replacement, or NULL to use ucs
+	u16 ucs;
+} t_html_entity;
+
+static const t_html_entity html_entities[] = {
+	{"nbsp", " ", 0},
+	{"lt", "<", 0},
+	{"gt", ">", 0},
+	{"amp", "&", 0},
+	{"quot", "\"", 0},
+	{"apos", "'", 0},
+	{"quote", "'", 0},
+	{"copy", "(C)", 0},
+	{"reg", "(R)", 0},
+	{"trade", "(TM)", 0},
+	{"ensp", " ", 0},
+	{"emsp", " ", 0},
+	{"laquo", "<<", 0},
+	{"raquo", ">>", 0},
+	{"hellip", NULL, 0x2026},
+	{"mdash", NULL, 0x2014},
+	{"ndash", NULL, 0x2013},
+	{"lsquo", NULL, 0x2018},
+	{"rsquo", NULL, 0x2019},
+	{"ldquo", NULL, 0x201C},
+	{"rdquo", NULL, 0x201D},
+	{"middot", NULL, 0x00B7},
+	{"times", NULL, 0x00D7},
+	{"divide", NULL, 0x00F7},
+	{"deg", NULL, 0x00B0},
+};
+
+static const char html_display_none[] = "display:none";
+static const char html_doc_write[] = "document.write(";
+
+static inline bool html_is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
 }
 
-static char *html_find_next_tag(char *string, size_t size, char **tag, char **property, bool * istag, bool stripeol)
+static const t_html_tag *html_find_tag(const char *name)
 {
-	char *res = string;
-	bool inquote = false;
-	char quote = ' ';
-	char *old;
-
-	*property = NULL;
-
-	while (size > 0 && *res != '\0' && *res != '<' && *res != '&') {
-		if (stripeol && (*res == ' ' || *res == '\t' || *res == '\r' || *res == '\n')) {
-			if (res > string && *(res - 1) == ' ')
-				*res = 0x1F;
-			else
-				*res = ' ';
-		}
+	size_t i;
 
-		res++;
-		size--;
+	for (i = 0; i < NELEMS(html_tags); ++i) {
+		if (strcmp(html_tags[i].name, name) == 0)
+			return &html_tags[i];
 	}
 
-	if (size == 0)
-		return res;
-
-	if (*res == 0)
-		return NULL;
-
-	if (*res == '<') {
-		*res++ = 0;
-		size--;
-
-		if (size == 0)
-			return res;
-
-		old = res;
-		res = html_skip_spaces(res, size);
-		size -= res - old;
-
-		if (size == 0)
-			return res;
+	return NULL;
+}
 
-		*tag = res;
+/**
+ * Advance a matcher over a lowercase pattern, restarting on mismatch
+ */
+static inline u32 html_match(const char *pattern, u32 pos, char c)
+{
+	if (c == pattern[pos])
+		return pos + 1;
 
-		while (size > 0 && (inquote || (*res != '\0' && *res != '>'))) {
-			if (*res == '\"' || *res == '\'') {
-				if (!inquote) {
-					inquote = true;
-					quote = *res;
-				} else if (quote == *res)
-					inquote = false;
+	return c == pattern[0] ? 1 : 0;
+}
 
-				res++;
-				size--;
+static char *html_put_ucs(char *out, u32 ucs)
+{
+	int l;
 
-				if (size == 0)
-					return res;
+	if (ucs == 0)
+		return out;
 
-			} else if (!inquote && (*res == ' ' || *res == '\t' || *res == '\r' || *res == '\n')) {
-				*res = 0;
-				res++;
-				size--;
+	if (ucs < 0x80) {
+		*out++ = ucs;
+		return out;
+	}
 
-				if (size == 0)
-					return res;
+	l = ucs <= 0xFFFF ? gbk_wctomb((u8 *) out, ucs, 2) : -1;
 
-				old = res;
-				res = html_skip_spaces(res, size);
-				size -= res - old;
+	if (l <= 0) {
+		*out++ = '?';
+		return out;
+	}
 
-				if (size == 0)
-					return res;
+	return out + l;
+}
 
-				if (*res != '>')
-					*property = res;
-			} else {
-				res++;
-				size--;
+/**
+ * Output the entity in p->token, or return NULL if it's unknown
+ */
+static char *html_put_entity(t_html_parser * p, char *out)
+{
+	const char *name = p->token;
+	size_t i;
 
-				if (size == 0)
-					return res;
-			}
-		}
+	if (name[0] == '#') {
+		bool hex = name[1] == 'x' || name[1] == 'X';
+		const char *digits = name + (hex ? 2 : 1);
+		char *end;
+		unsigned long ucs = strtoul(digits, &end, hex ? 16 : 10);
 
-		if (*res == 0)
+		if (end == digits || *end != '\0')
 			return NULL;
 
-		*res++ = 0;
-		size--;
+		p->space = false;
 
-		if (size == 0)
-			return res;
-
-		old = res;
-		res = html_skip_spaces(res, size);
-		size -= res - old;
-
-		if (size == 0)
-			return res;
-
-		*istag = true;
-	} else {
-		*res++ = 0;
-		size--;
+		return html_put_ucs(out, ucs);
+	}
 
-		if (size == 0)
-			return res;
+	for (i = 0; i < NELEMS(html_entities); ++i) {
+		const t_html_entity *e = &html_entities[i];
 
-		*tag = res;
+		if (stricmp(e->name, name) != 0)
+			continue;
 
-		while (size > 0 && *res != '\0' && *res != ' ' && *res != ';' && *res != '<' && *res != '&') {
-			res++;
-			size--;
+		if (e->text == NULL) {
+			p->space = false;
+			return html_put_ucs(out, e->ucs);
 		}
 
-		if (size == 0)
-			return res;
-
-		if (*res == 0)
-			return NULL;
-
-		if (*res == ' ' || *res == ';') {
-			*res++ = 0;
-			size--;
-
-			if (size == 0)
-				return res;
-		} else
-			*(res - 1) = 0;
+		memcpy(out, e->text, strlen(e->text));
+		p->space = e->text[0] == ' ';
 
-		*istag = false;
+		return out + strlen(e->text);
 	}
 
-	return res;
+	return NULL;
 }
 
-static char *html_skip_close_tag(char *string, size_t size, char *tag)
+static char *html_put_newline(t_html_parser * p, char *out)
 {
-	char *res = string, *sstart;
-	int len = strnlen(tag, size) + 1;
-	char ttag[len + 1];
-
-	snprintf_s(ttag, len + 1, "/%s", tag);
-
-	do {
-		while (size > 0 && *res != 0 && *res != '<') {
-			res++;
-			size--;
-		}
+	*out++ = '\n';
+	p->space = true;
 
-		if (size == 0)
-			return res;
-
-		if (*res == 0)
-			return NULL;
-
-		sstart = res;
-		res++;
-		size--;
+	return out;
+}
 
-		if (size == 0)
-			return res;
+static char *html_put_space(t_html_parser * p, char *out)
+{
+	if (!p->space) {
+		*out++ = ' ';
+		p->space = true;
+	}
 
-		res = html_skip_spaces(res, size);
+	return out;
+}
 
-		if (strncmp(ttag, res, len) == 0)
-			res += len;
-		else
-			continue;
+static void html_begin_skip(t_html_parser * p, const char *name, int state)
+{
+	snprintf_s(p->close, sizeof(p->close), "</%s", name);
+	p->match = p->match2 = 0;
+	p->state = state;
+}
 
-		res = html_skip_spaces(res, size);
-		if (*res == 0)
-			return NULL;
-	} while (*res != '>');
+/**
+ * Act on the tag in p->token once its '>' is read
+ */
+static char *html_end_tag(t_html_parser * p, char *out)
+{
+	bool closing = p->token[0] == '/';
+	const char *name = p->token + (closing ? 1 : 0);
+	const t_html_tag *tag = html_find_tag(name);
+	u8 action = tag != NULL ? (closing ? tag->close : tag->open) : HTML_NONE;
 
-	*sstart = *res++ = 0;
+	p->state = HTML_TEXT;
 
-	size--;
+	if (!closing && p->hidden && action != HTML_VOID && strcmp(name, "br") != 0 && strcmp(name, "hr") != 0) {
+		html_begin_skip(p, name, HTML_SKIP);
+		return out;
+	}
 
-	if (size == 0)
-		return res;
+	switch (action) {
+		case HTML_NEWLINE:
+			out = html_put_newline(p, out);
+			break;
+		case HTML_SPACE:
+			out = html_put_space(p, out);
+			break;
+		case HTML_HIDE:
+			html_begin_skip(p, name, HTML_SKIP);
+			break;
+		case HTML_JSCRIPT:
+			html_begin_skip(p, name, HTML_SCRIPT);
+			break;
+		case HTML_PRE:
+			p->pre = !closing;
+			break;
+	}
 
-	return res;
+	return out;
 }
 
-extern u32 html_to_text(char *string, u32 size, bool stripeol)
+static char *html_put_text(t_html_parser * p, char *out, char c)
 {
-	char *nstr = NULL, *ntag = string, *cstr = string, *str = string, *prop = NULL;
-	bool istag = false;
-
-	if (size > 0) {
-		char *cur, *end;
-
-		for (cur = string, end = cur + size; cur < end; cur++)
-			if (*cur == 0)
-				*cur = 1;
+	if (p->js_quote != '\0') {
+		if (p->esc) {
+			p->esc = false;
+		} else if (c == '\\') {
+			p->esc = true;
+			return out;
+		} else if (c == p->js_quote) {
+			p->js_quote = '\0';
+			html_begin_skip(p, "script", HTML_SCRIPT);
+			return out;
+		}
 	}
 
-	while (str != NULL && (nstr = html_find_next_tag(str, size, &ntag, &prop, &istag, stripeol)) != NULL) {
-		int len = (int) ntag - (int) str - 1;
-
-		if (len > 0) {
-			if (str != cstr) {
-				memmove(cstr, str, len);
-			}
-			cstr += len;
-			size -= len;
-
-			if (size == 0) {
-				return cstr - string;
+	switch (c) {
+		case '<':
+			p->state = HTML_TAG_OPEN;
+			p->len = 0;
+			p->hidden = false;
+			p->quote = '\0';
+			p->match = 0;
+			break;
+		case '&':
+			p->state = HTML_ENTITY;
+			p->len = 0;
+			break;
+		default:
+			if (html_is_space(c) && p->stripeol && !p->pre)
+				out = html_put_space(p, out);
+			else {
+				*out++ = c;
+				p->space = html_is_space(c);
 			}
-		} else if (len == -1) {
-			if (str != cstr) {
-				memmove(cstr, str, len);
-			}
-
-			cstr += size;
-			size = 0;
+			break;
+	}
 
-			return cstr - string;
-		}
+	return out;
+}
 
-		if (istag) {
-			if (stricmp(ntag, "head") == 0 || stricmp(ntag, "style") == 0 || stricmp(ntag, "title") == 0) {
-				char *pstr = html_skip_close_tag(nstr, size, ntag);
+extern void html_parser_init(t_html_parser * p, bool stripeol)
+{
+	memset(p, 0, sizeof(*p));
+	p->state = HTML_TEXT;
+	p->stripeol = stripeol;
+	p->space = true;
+}
 
-				if (pstr != NULL)
-					str = pstr;
-				else
-					str = nstr;
-			} else if (stricmp(ntag, "script") == 0) {
-				char *kstr = nstr;
-
-				str = html_skip_close_tag(nstr, size, ntag);
-				while ((kstr = strstr(kstr, "document.write(")) != NULL) {
-					kstr += 15;
-					while (*kstr == ' ' || *kstr == '\t')
-						kstr++;
-					if (*kstr == '\'' || *kstr == '"') {
-						char qt = *kstr;
-						char *dstr;
-
-						kstr++;
-						dstr = kstr;
-						while (*dstr != 0 && (*dstr != qt || *(dstr - 1) == '\\'))
-							dstr++;
-						if (*dstr == qt) {
-							strncpy(cstr, kstr, dstr - kstr);
-							cstr[dstr - kstr] = '\0';
-							cstr += html_to_text(cstr, dstr - kstr, true);
-							size -= dstr - kstr;
-
-							if (size == 0) {
-								return cstr - string;
-							}
-						}
-						kstr = dstr;
+extern u32 html_parser_feed(t_html_parser * p, const char *in, u32 size, char *out)
+{
+	const char *end = in + size;
+	char *start = out;
+
+	while (in < end) {
+		char c = *in, lc = tolower((u8) c);
+		bool next = true;
+
+		switch (p->state) {
+			case HTML_TEXT:
+				out = html_put_text(p, out, c);
+				break;
+			case HTML_ENTITY:
+				if ((isalnum((u8) c) || (c == '#' && p->len == 0)) && p->len < HTML_TOKEN_MAX - 1) {
+					p->token[p->len++] = c;
+					break;
+				} else {
+					char *q;
+
+					p->token[p->len] = '\0';
+					q = p->len > 0 ? html_put_entity(p, out) : NULL;
+					p->state = HTML_TEXT;
+
+					if (q != NULL) {
+						out = q;
+						next = c == ';';
+					} else {
+						// Not an entity, keep it as it was
+						*out++ = '&';
+						memcpy(out, p->token, p->len);
+						out += p->len;
+						p->space = false;
+						next = false;
 					}
 				}
-			} else if (stricmp(ntag, "pre") == 0) {
-				char *pstr = html_skip_close_tag(nstr, size, "pre");
-
-				if (pstr != NULL) {
-					len = pstr - nstr - 6;
-					strncpy(cstr, nstr, len);
-					cstr[len] = '\0';
-					cstr += html_to_text(cstr, len, false);
-					size -= len;
-
-					if (size == 0) {
-						return cstr - string;
-					}
+				break;
+			case HTML_TAG_OPEN:
+				// '?' opens a processing instruction such as <?xml ...?>, skipped like an unknown tag
+				if (isalpha((u8) c) || c == '/' || c == '!' || c == '?') {
+					p->state = HTML_TAG_NAME;
+					next = false;
+				} else {
+					// A lone '<' is text
+					*out++ = '<';
+					p->space = false;
+					p->state = HTML_TEXT;
+					next = false;
 				}
-				str = pstr;
-			} else {
-				if (stricmp(ntag, "br") == 0
-					|| stricmp(ntag, "li") == 0
-					|| stricmp(ntag, "p") == 0
-					|| stricmp(ntag, "/p") == 0
-					|| stricmp(ntag, "tr") == 0 || stricmp(ntag, "/table") == 0 || stricmp(ntag, "div") == 0 || stricmp(ntag, "/div") == 0) {
-					if (prop != NULL) {
-						char *v = strchr(prop, '=');
-
-						if (v == NULL) {
-							*cstr++ = '\n';
-							size--;
-
-							if (size == 0) {
-								return cstr - string;
-							}
-						} else {
-							char *t = v - 1;
-
-							*v = 0;
-							while (t > prop && (*t == ' ' || *t == '\t' || *t == '\r' || *t == '\n'))
-								t--;
-							*(t + 1) = 0;
-							if (stricmp(prop, "style") == 0) {
-								v++;
-								v = html_skip_spaces(v, size);
-								if (*v == '"' || *v == '\'') {
-									char *rq = strchr(v + 1,
-													  *v);
-
-									if (rq == NULL) {
-										*cstr++ = '\n';
-										size--;
-
-										if (size == 0) {
-											return cstr - string;
-										}
-										v = NULL;
-									} else {
-										*rq = 0;
-										v++;
-									}
-								}
-								if (v != NULL) {
-									if (stricmp(v, "display:none") != 0) {
-										*cstr++ = '\n';
-										size--;
-
-										if (size == 0) {
-											return cstr - string;
-										}
-									} else {
-										char *pstr = html_skip_close_tag(nstr, size,
-																		 ntag);
-
-										if (pstr != NULL)
-											nstr = pstr;
-									}
-								}
-							}
-						}
-					} else {
-						*cstr++ = '\n';
-						size--;
-
-						if (size == 0) {
-							return cstr - string;
-						}
-					}
-				} else if (stricmp(ntag, "th") == 0 || stricmp(ntag, "td") == 0) {
-					*cstr++ = ' ';
-					size--;
-
-					if (size == 0) {
-						return cstr - string;
+				break;
+			case HTML_TAG_NAME:
+				if (c == '>') {
+					p->token[p->len] = '\0';
+					out = html_end_tag(p, out);
+				} else if (html_is_space(c) || (c == '/' && p->len > 0)) {
+					p->token[p->len] = '\0';
+					p->state = HTML_TAG_ATTR;
+				} else {
+					if (p->len < HTML_TOKEN_MAX - 1)
+						p->token[p->len++] = lc;
+
+					if (p->len == 3 && memcmp(p->token, "!--", 3) == 0) {
+						p->state = HTML_COMMENT;
+						p->match = 0;
 					}
 				}
-				str = nstr;
-			}
-		} else {
-			if (stricmp(ntag, "nbsp") == 0) {
-				*cstr++ = ' ';
-				size--;
-
-				if (size == 0) {
-					return cstr - string;
+				break;
+			case HTML_TAG_ATTR:
+				if (p->quote != '\0') {
+					if (c == p->quote)
+						p->quote = '\0';
+				} else if (c == '"' || c == '\'') {
+					p->quote = c;
+				} else if (c == '>') {
+					out = html_end_tag(p, out);
+					break;
 				}
 
-			} else if (stricmp(ntag, "gt") == 0) {
-				*cstr++ = '>';
-				size--;
-
-				if (size == 0) {
-					return cstr - string;
+				if (!html_is_space(c) && !p->hidden) {
+					p->match = html_match(html_display_none, p->match, lc);
+					p->hidden = p->match == sizeof(html_display_none) - 1;
 				}
-
-			} else if (stricmp(ntag, "lt") == 0) {
-				*cstr++ = '<';
-				size--;
-
-				if (size == 0) {
-					return cstr - string;
+				break;
+			case HTML_COMMENT:
+				if (c == '>' && p->match >= 2)
+					p->state = HTML_TEXT;
+				else
+					p->match = c == '-' ? p->match + 1 : 0;
+				break;
+			case HTML_SCRIPT_WRITE:
+				if (c == '"' || c == '\'') {
+					p->js_quote = c;
+					p->esc = false;
+					p->state = HTML_TEXT;
+					break;
+				} else if (c == ' ' || c == '\t') {
+					break;
 				}
-
-			} else if (stricmp(ntag, "amp") == 0) {
-				*cstr++ = '&';
-				size--;
-
-				if (size == 0) {
-					return cstr - string;
+				p->state = HTML_SCRIPT;
+				p->match = p->match2 = 0;
+				// fall through
+			case HTML_SCRIPT:
+			case HTML_SKIP:
+				if (p->match == strlen(p->close)) {
+					if (c == '>') {
+						p->state = HTML_TEXT;
+						break;
+					} else if (html_is_space(c)) {
+						break;
+					}
+					p->match = 0;
 				}
 
-			} else if (stricmp(ntag, "quote") == 0) {
-				*cstr++ = '\'';
-				size--;
+				p->match = html_match(p->close, p->match, lc);
 
-				if (size == 0) {
-					return cstr - string;
-				}
-
-			} else if (stricmp(ntag, "copy") == 0) {
-				*cstr++ = '(';
-				size--;
+				if (p->state == HTML_SCRIPT) {
+					p->match2 = html_match(html_doc_write, p->match2, lc);
 
-				if (size == 0) {
-					return cstr - string;
+					if (p->match2 == sizeof(html_doc_write) - 1)
+						p->state = HTML_SCRIPT_WRITE;
 				}
+				break;
+		}
 
-				*cstr++ = 'C';
-				size--;
+		if (next)
+			in++;
+	}
 
-				if (size == 0) {
-					return cstr - string;
-				}
+	return out - start;
+}
 
-				*cstr++ = ')';
-				size--;
+extern u32 html_parser_finish(t_html_parser * p, char *out)
+{
+	char *start = out;
 
-				if (size == 0) {
-					return cstr - string;
-				}
+	if (p->state == HTML_ENTITY) {
+		p->token[p->len] = '\0';
 
-			}
-			str = nstr;
+		if (p->len == 0 || (out = html_put_entity(p, start)) == NULL) {
+			out = start;
+			*out++ = '&';
+			memcpy(out, p->token, p->len);
+			out += p->len;
 		}
 	}
 
-	if (str != NULL) {
-		int slen = strnlen(str, size);
+	p->state = HTML_TEXT;
 
-		memmove(cstr, str, slen);
-		cstr += slen;
-	}
+	return out - start;
+}
+
+extern u32 html_to_text(char *string, u32 size, bool stripeol)
+{
+	t_html_parser p;
+	u32 len;
+
+	html_parser_init(&p, stripeol);
+	len = html_parser_feed(&p, string, size, string);
+	len += html_parser_finish(&p, string + len);
 
-	return cstr - string;
+	return len;
 }
@@ -18,6 +18,45 @@
  * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
  */
 
+#ifndef HTML_H
+#define HTML_H
+
 #include "common/datatype.h"
 
+enum
+{
+	HTML_TOKEN_MAX = 16,
+};
+
+// Converter state, kept between html_parser_feed calls
+typedef struct
+{
+	int state;
+	bool stripeol;
+	bool pre;					// inside <pre>, whitespace kept
+	bool space;					// last output was whitespace
+	bool hidden;				// current tag has display:none
+	bool esc;					// backslash seen in a document.write string
+	char quote;					// quote char while inside an attribute value
+	char js_quote;				// quote char of the document.write string being output
+	u32 len;					// bytes in token
+	char token[HTML_TOKEN_MAX];	// tag name or entity being read
+	u32 match;					// matched bytes of close/write/display:none
+	u32 match2;
+	char close[HTML_TOKEN_MAX + 2];	// "</name" ending the skipped element
+} t_html_parser;
+
+// Start converting a document
+extern void html_parser_init(t_html_parser * p, bool stripeol);
+
+// Convert the next size bytes of a document to text, returns bytes written to out
+// Never writes more bytes in total than it has read, so out may trail in within one buffer
+extern u32 html_parser_feed(t_html_parser * p, const char *in, u32 size, char *out);
+
+// Flush what is left at the end of the document, at most HTML_TOKEN_MAX bytes
+extern u32 html_parser_finish(t_html_parser * p, char *out);
+
+// Convert a whole HTML document to text in place, returns the new size
 extern u32 html_to_text(char *string, u32 size, bool stripeol);
+
+#endif
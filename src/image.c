@@ -42,6 +42,7 @@
 #include "dbg.h"
 #include "conf.h"
 #include "archive.h"
+#include "chmcache.h"
 #include "passwdmgr.h"
 #include "bg.h"
 #include "osk.h"
@@ -768,9 +769,20 @@ static unzFile open_zip_file(const char *zipfile, const char *filename)
 
 extern int image_readpng_in_zip(const char *zipfile, const char *filename, u32 * pwidth, u32 * pheight, pixel ** image_data, pixel * bgcolor)
 {
-	unzFile unzf = open_zip_file(zipfile, filename);
+	t_image_rar rar;
+	unzFile unzf;
 	int result;
 
+	result = extract_zip_file_into_image(&rar, zipfile, filename);
+
+	if (result == 0) {
+		result = image_readpng2((void *) &rar, pwidth, pheight, image_data, bgcolor, image_png_rar_read);
+		free(rar.buf);
+		return result;
+	}
+
+	unzf = open_zip_file(zipfile, filename);
+
 	if (unzf == NULL)
 		return -1;
 
@@ -786,16 +798,16 @@ extern int image_readpng_in_chm(const char *chmfile, const char *filename, u32 *
 	t_image_chm chm;
 	int result;
 
-	chm.chm = chm_open(chmfile);
+	chm.chm = chmcache_open(chmfile);
 	if (chm.chm == NULL)
 		return -1;
-	if (chm_resolve_object(chm.chm, filename, &chm.ui) != CHM_RESOLVE_SUCCESS) {
-		chm_close(chm.chm);
+	if (chmcache_resolve(chm.chm, filename, &chm.ui) != CHM_RESOLVE_SUCCESS) {
+		chmcache_close(chm.chm);
 		return -1;
 	}
 	chm.readpos = 0;
 	result = image_readpng2((void *) &chm, pwidth, pheight, image_data, bgcolor, image_png_chm_read);
-	chm_close(chm.chm);
+	chmcache_close(chm.chm);
 
 	return result;
 }
@@ -965,9 +977,20 @@ extern int image_readgif(const char *filename, u32 * pwidth, u32 * pheight, pixe
 
 extern int image_readgif_in_zip(const char *zipfile, const char *filename, u32 * pwidth, u32 * pheight, pixel ** image_data, pixel * bgcolor)
 {
-	unzFile unzf = open_zip_file(zipfile, filename);
+	t_image_rar rar;
+	unzFile unzf;
 	int result;
 
+	result = extract_zip_file_into_image(&rar, zipfile, filename);
+
+	if (result == 0) {
+		result = image_readgif2((void *) &rar, pwidth, pheight, image_data, bgcolor, image_gif_rar_read);
+		free(rar.buf);
+		return result;
+	}
+
+	unzf = open_zip_file(zipfile, filename);
+
 	if (unzf == NULL)
 		return -1;
 
@@ -983,16 +1006,16 @@ extern int image_readgif_in_chm(const char *chmfile, const char *filename, u32 *
 	t_image_chm chm;
 	int result;
 
-	chm.chm = chm_open(chmfile);
+	chm.chm = chmcache_open(chmfile);
 	if (chm.chm == NULL)
 		return -1;
-	if (chm_resolve_object(chm.chm, filename, &chm.ui) != CHM_RESOLVE_SUCCESS) {
-		chm_close(chm.chm);
+	if (chmcache_resolve(chm.chm, filename, &chm.ui) != CHM_RESOLVE_SUCCESS) {
+		chmcache_close(chm.chm);
 		return -1;
 	}
 	chm.readpos = 0;
 	result = image_readgif2((void *) &chm, pwidth, pheight, image_data, bgcolor, image_gif_chm_read);
-	chm_close(chm.chm);
+	chmcache_close(chm.chm);
 
 	return result;
 }
@@ -1121,9 +1144,20 @@ extern int image_readjpg(const char *filename, u32 * pwidth, u32 * pheight, pixe
 
 extern int image_readjpg_in_zip(const char *zipfile, const char *filename, u32 * pwidth, u32 * pheight, pixel ** image_data, pixel * bgcolor)
 {
-	unzFile unzf = open_zip_file(zipfile, filename);
+	t_image_rar rar;
+	unzFile unzf;
 	int result;
 
+	result = extract_zip_file_into_image(&rar, zipfile, filename);
+
+	if (result == 0) {
+		result = image_readjpg2((FILE *) & rar, pwidth, pheight, image_data, bgcolor, image_rar_fread);
+		free(rar.buf);
+		return result;
+	}
+
+	unzf = open_zip_file(zipfile, filename);
+
 	if (unzf == NULL)
 		return -1;
 
@@ -1140,18 +1174,18 @@ extern int image_readjpg_in_chm(const char *chmfile, const char *filename, u32 *
 	t_image_chm chm;
 	int result;
 
-	chm.chm = chm_open(chmfile);
+	chm.chm = chmcache_open(chmfile);
 	if (chm.chm == NULL)
 		return -1;
-	if (chm_resolve_object(chm.chm, filename, &chm.ui) != CHM_RESOLVE_SUCCESS) {
-		chm_close(chm.chm);
+	if (chmcache_resolve(chm.chm, filename, &chm.ui) != CHM_RESOLVE_SUCCESS) {
+		chmcache_close(chm.chm);
 		return -1;
 	}
 
 	chm.readpos = 0;
 	result = image_readjpg2((FILE *) & chm, pwidth, pheight, image_data, bgcolor, image_chm_fread);
 
-	chm_close(chm.chm);
+	chmcache_close(chm.chm);
 
 	return result;
 }
@@ -1326,9 +1360,20 @@ extern int image_readbmp(const char *filename, u32 * pwidth, u32 * pheight, pixe
 
 extern int image_readbmp_in_zip(const char *zipfile, const char *filename, u32 * pwidth, u32 * pheight, pixel ** image_data, pixel * bgcolor)
 {
-	unzFile unzf = open_zip_file(zipfile, filename);
+	t_image_rar rar;
+	unzFile unzf;
 	int result;
 
+	result = extract_zip_file_into_image(&rar, zipfile, filename);
+
+	if (result == 0) {
+		result = image_readbmp2((FILE *) & rar, pwidth, pheight, image_data, bgcolor, image_rar_fread);
+		free(rar.buf);
+		return result;
+	}
+
+	unzf = open_zip_file(zipfile, filename);
+
 	if (unzf == NULL)
 		return -1;
 
@@ -1344,19 +1389,19 @@ extern int image_readbmp_in_chm(const char *chmfile, const char *filename, u32 *
 	t_image_chm chm;
 	int result;
 
-	chm.chm = chm_open(chmfile);
+	chm.chm = chmcache_open(chmfile);
 
 	if (chm.chm == NULL)
 		return -1;
 
-	if (chm_resolve_object(chm.chm, filename, &chm.ui) != CHM_RESOLVE_SUCCESS) {
-		chm_close(chm.chm);
+	if (chmcache_resolve(chm.chm, filename, &chm.ui) != CHM_RESOLVE_SUCCESS) {
+		chmcache_close(chm.chm);
 		return -1;
 	}
 
 	chm.readpos = 0;
 	result = image_readbmp2((FILE *) & chm, pwidth, pheight, image_data, bgcolor, image_chm_fread);
-	chm_close(chm.chm);
+	chmcache_close(chm.chm);
 
 	return result;
 }
@@ -1493,9 +1538,20 @@ extern int image_readtga(const char *filename, u32 * pwidth, u32 * pheight, pixe
 
 extern int image_readtga_in_zip(const char *zipfile, const char *filename, u32 * pwidth, u32 * pheight, pixel ** image_data, pixel * bgcolor)
 {
-	unzFile unzf = open_zip_file(zipfile, filename);
+	t_image_rar rar;
+	unzFile unzf;
 	int result;
 
+	result = extract_zip_file_into_image(&rar, zipfile, filename);
+
+	if (result == 0) {
+		result = image_readtga2((FILE *) & rar, pwidth, pheight, image_data, bgcolor, image_rar_fread, image_rar_fseek, image_rar_ftell);
+		free(rar.buf);
+		return result;
+	}
+
+	unzf = open_zip_file(zipfile, filename);
+
 	if (unzf == NULL)
 		return -1;
 
@@ -1511,17 +1567,17 @@ extern int image_readtga_in_chm(const char *chmfile, const char *filename, u32 *
 	t_image_chm chm;
 	int result;
 
-	chm.chm = chm_open(chmfile);
+	chm.chm = chmcache_open(chmfile);
 	if (chm.chm == NULL)
 		return -1;
-	if (chm_resolve_object(chm.chm, filename, &chm.ui) != CHM_RESOLVE_SUCCESS) {
-		chm_close(chm.chm);
+	if (chmcache_resolve(chm.chm, filename, &chm.ui) != CHM_RESOLVE_SUCCESS) {
+		chmcache_close(chm.chm);
 		return -1;
 	}
 
 	chm.readpos = 0;
 	result = image_readtga2((FILE *) & chm, pwidth, pheight, image_data, bgcolor, image_chm_fread, image_chm_fseek, image_chm_ftell);
-	chm_close(chm.chm);
+	chmcache_close(chm.chm);
 
 	return result;
 }
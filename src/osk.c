@@ -30,6 +30,7 @@
 #include "strsafe.h"
 #include "common/datatype.h"
 #include "conf.h"
+#include "charsets.h"
 #ifdef DMALLOC
 #include "dmalloc.h"
 #endif
@@ -43,7 +44,8 @@ static void ClearScreen(pixel * saveimage)
 
 int _get_osk_input(char *buf, int size, unsigned short desc[128])
 {
-	char tstr[128] = { 0 };
+	unsigned short tstr[128] = { 0 };
+	char gbk[128 * 2 + 1];
 	unsigned short intext[128] = { 0 };	// text already in the edit box on start
 	unsigned short outtext[128] = { 0 };	// text after input
 	SceUtilityOskData data;
@@ -135,7 +137,10 @@ int _get_osk_input(char *buf, int size, unsigned short desc[128])
 			}
 		}
 
-		strcpy_s(buf, size, tstr);
+		tstr[j] = 0;
+		// outtext is UCS-2, books are searched in GBK
+		charsets_ucs_conv((const u8 *) tstr, sizeof(tstr), (u8 *) gbk, sizeof(gbk) - 1);
+		strcpy_s(buf, size, gbk);
 		sceDisplayWaitVblankStart();
 		sceGuSwapBuffers();
 	}
@@ -152,7 +157,7 @@ int _get_osk_input(char *buf, int size, unsigned short desc[128])
 int get_osk_input(char *buf, int size)
 {
 	unsigned short desc[128] = {
-		'E', 'n', 't', 'e', 'r', ' ', 'G', 'I', 0
+		'E', 'n', 't', 'e', 'r', ' ', 'G', 'I', ',', ' ', '%', ' ', 'o', 'r', ' ', 't', 'e', 'x', 't', 0
 	};
 
 	return _get_osk_input(buf, size, desc);
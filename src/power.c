@@ -34,6 +34,9 @@
 #include "scene.h"
 #include "display.h"
 #include "ttfont.h"
+#include "chmcache.h"
+#include "zipread.h"
+#include "fs.h"
 
 extern void power_set_clock(u32 cpu, u32 bus)
 {
@@ -122,6 +125,9 @@ extern void power_down(void)
 #ifdef ENABLE_MUSIC
 	music_suspend();
 #endif
+	chmcache_free();
+	zipread_free();
+	fs_list_suspend();
 	fat_powerdown();
 }
 
@@ -66,6 +66,8 @@
 #include "exception.h"
 #include "m33boot.h"
 #include "passwdmgr.h"
+#include "chmcache.h"
+#include "zipread.h"
 #include "xr_rdriver/xr_rdriver.h"
 #include "kubridge.h"
 #include "clock.h"
@@ -457,80 +459,79 @@ static void set_background_image(p_win_menuitem item, u32 * index)
 }
 #endif
 
-int scene_filelist_compare_ext(void *data1, void *data2)
+/**
+ * ļб
+ */
+typedef struct
 {
-	const char *fn1, *fn2;
-	int cmp;
+	p_win_menuitem item;
+	/** Сдcompname */
+	const char *name;
+	/** Сдչ, ָname */
+	const char *ext;
+	u32 size;
+	/** ڸ16λ, ʱڵ16λ */
+	u32 ctime;
+	u32 mtime;
+	bool dir;
+} t_filelist_key;
 
-	if (((p_win_menuitem) data1)->compname == NULL || ((p_win_menuitem) data2)->compname == NULL) {
-		dbg_printf(d, "%s: !!!!", __func__);
-		return 0;
-	}
+#define FILELIST_KEYS(data1, data2) \
+	const t_filelist_key *k1 = (const t_filelist_key *) (data1), *k2 = (const t_filelist_key *) (data2)
+
+#define FILELIST_DIR_FIRST(k1, k2) \
+	do { \
+		if ((k1)->dir != (k2)->dir) \
+			return (k1)->dir ? -1 : 1; \
+	} while (0)
 
-	fn1 = ((p_win_menuitem) data1)->compname->ptr;
-	fn2 = ((p_win_menuitem) data2)->compname->ptr;
-	cmp = stricmp(get_file_ext(fn1), get_file_ext(fn2));
+#define FILELIST_CMP_U32(a, b) ((a) < (b) ? -1 : ((a) > (b) ? 1 : 0))
+
+int scene_filelist_compare_ext(void *data1, void *data2)
+{
+	FILELIST_KEYS(data1, data2);
+	int cmp = strcmp(k1->ext, k2->ext);
 
 	if (cmp)
 		return cmp;
 
-	return stricmp(fn1, fn2);
+	return strcmp(k1->name, k2->name);
 }
 
 int scene_filelist_compare_name(void *data1, void *data2)
 {
-	t_fs_filetype ft1, ft2;
-
-	if (((p_win_menuitem) data1)->compname == NULL || ((p_win_menuitem) data2)->compname == NULL) {
-		dbg_printf(d, "%s: !!!!", __func__);
-		return 0;
-	}
+	FILELIST_KEYS(data1, data2);
 
-	ft1 = (t_fs_filetype) ((p_win_menuitem) data1)->data;
-	ft2 = (t_fs_filetype) ((p_win_menuitem) data2)->data;
+	FILELIST_DIR_FIRST(k1, k2);
 
-	if (ft1 == fs_filetype_dir) {
-		if (ft2 != fs_filetype_dir)
-			return -1;
-	} else if (ft2 == fs_filetype_dir)
-		return 1;
-
-	return stricmp(((p_win_menuitem) data1)->compname->ptr, ((p_win_menuitem) data2)->compname->ptr);
+	return strcmp(k1->name, k2->name);
 }
 
 int scene_filelist_compare_size(void *data1, void *data2)
 {
-	t_fs_filetype ft1 = (t_fs_filetype) ((p_win_menuitem) data1)->data, ft2 = (t_fs_filetype) ((p_win_menuitem) data2)->data;
-	if (ft1 == fs_filetype_dir) {
-		if (ft2 != fs_filetype_dir)
-			return -1;
-	} else if (ft2 == fs_filetype_dir)
-		return 1;
-	return (int) ((p_win_menuitem) data1)->data3 - (int) ((p_win_menuitem) data2)->data3;
+	FILELIST_KEYS(data1, data2);
+
+	FILELIST_DIR_FIRST(k1, k2);
+
+	return FILELIST_CMP_U32(k1->size, k2->size);
 }
 
 int scene_filelist_compare_ctime(void *data1, void *data2)
 {
-	t_fs_filetype ft1 = (t_fs_filetype) ((p_win_menuitem) data1)->data, ft2 = (t_fs_filetype) ((p_win_menuitem) data2)->data;
-	if (ft1 == fs_filetype_dir) {
-		if (ft2 != fs_filetype_dir)
-			return -1;
-	} else if (ft2 == fs_filetype_dir)
-		return 1;
-	return (((int) ((p_win_menuitem) data1)->data2[0]) << 16) +
-		(int) ((p_win_menuitem) data1)->data2[1] - ((((int) ((p_win_menuitem) data2)->data2[0]) << 16) + (int) ((p_win_menuitem) data2)->data2[1]);
+	FILELIST_KEYS(data1, data2);
+
+	FILELIST_DIR_FIRST(k1, k2);
+
+	return FILELIST_CMP_U32(k1->ctime, k2->ctime);
 }
 
 int scene_filelist_compare_mtime(void *data1, void *data2)
 {
-	t_fs_filetype ft1 = (t_fs_filetype) ((p_win_menuitem) data1)->data, ft2 = (t_fs_filetype) ((p_win_menuitem) data2)->data;
-	if (ft1 == fs_filetype_dir) {
-		if (ft2 != fs_filetype_dir)
-			return -1;
-	} else if (ft2 == fs_filetype_dir)
-		return 1;
-	return (((int) ((p_win_menuitem) data1)->data2[2]) << 16) +
-		(int) ((p_win_menuitem) data1)->data2[3] - ((((int) ((p_win_menuitem) data2)->data2[2]) << 16) + (int) ((p_win_menuitem) data2)->data2[3]);
+	FILELIST_KEYS(data1, data2);
+
+	FILELIST_DIR_FIRST(k1, k2);
+
+	return FILELIST_CMP_U32(k1->mtime, k2->mtime);
 }
 
 qsort_compare compare_func[] = {
@@ -541,6 +542,103 @@ qsort_compare compare_func[] = {
 	scene_filelist_compare_mtime
 };
 
+/**
+ * ǰзʽļб
+ *
+ * @note ΪÿСдļ, չʱΪ, Լָȶ,
+ * ÿ˵ֻƶһ; ͷ<..>
+ *
+ * @param sorted бǰsortedѾ, ֻ¼ٹ鲢
+ */
+static void scene_filelist_sort_tail(u32 sorted)
+{
+	t_filelist_key *keys;
+	void **ptrs;
+	char *names = NULL;
+	u32 first, n, i;
+	size_t size = 0, pos = 0;
+	bool need_name = config.arrange == conf_arrange_ext || config.arrange == conf_arrange_name;
+	int fid;
+
+	if (g_menu == NULL || g_menu->size < 2)
+		return;
+
+	first = (g_menu->root[0].compname->ptr[0] == '.') ? 1 : 0;
+	n = g_menu->size - first;
+
+	if (n < 2)
+		return;
+
+	fid = freq_enter_hotzone();
+	keys = malloc(n * sizeof(*keys));
+	ptrs = malloc(n * sizeof(*ptrs));
+
+	if (need_name) {
+		for (i = 0; i < n; i++) {
+			p_win_menuitem item = &g_menu->root[first + i];
+
+			size += (item->compname != NULL ? strlen(item->compname->ptr) : 0) + 1;
+		}
+
+		names = malloc(size);
+	}
+
+	if (keys == NULL || ptrs == NULL || (need_name && names == NULL)) {
+		dbg_printf(d, "%s: out of memory for %u items", __func__, (unsigned) n);
+		free(keys);
+		free(ptrs);
+		free(names);
+		freq_leave(fid);
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		p_win_menuitem item = &g_menu->root[first + i];
+		t_filelist_key *k = &keys[i];
+
+		k->item = item;
+		k->name = k->ext = "";
+		k->size = item->data3;
+		k->ctime = ((u32) item->data2[0] << 16) | item->data2[1];
+		k->mtime = ((u32) item->data2[2] << 16) | item->data2[3];
+		k->dir = (t_fs_filetype) item->data == fs_filetype_dir;
+
+		if (need_name) {
+			char *name = &names[pos], *q;
+			const char *src = item->compname != NULL ? item->compname->ptr : "";
+
+			for (q = name; *src != '\0'; src++)
+				*q++ = tolower((u8) * src);
+
+			*q = '\0';
+			pos += q - name + 1;
+			k->name = name;
+			k->ext = get_file_ext(name);
+		}
+
+		ptrs[i] = k;
+	}
+
+	sorted = sorted > first ? sorted - first : 0;
+
+	if (sort_pointers_tail(ptrs, min(sorted, n), n, compare_func[(int) config.arrange]) == 0) {
+		for (i = 0; i < n; i++)
+			ptrs[i] = ((t_filelist_key *) ptrs[i])->item;
+
+		sort_apply(&g_menu->root[first], ptrs, n, sizeof(t_win_menuitem));
+	}
+
+	free(names);
+	free(ptrs);
+	free(keys);
+	freq_leave(fid);
+}
+
+static void scene_filelist_sort(void)
+{
+	scene_filelist_sort_tail(0);
+}
+
 #ifdef ENABLE_IMAGE
 t_win_menu_op scene_ioptions_menucb(u32 key, p_win_menuitem item, u32 * count, u32 max_height, u32 * topindex, u32 * index)
 {
@@ -2721,6 +2819,84 @@ u32 scene_locsave(u32 * selidx)
 	return 0;
 }
 
+/**
+ * δʱг, ֱҵϴδ򿪵ļΪֹ
+ */
+static void scene_filelist_find_lastfile(void)
+{
+	u32 i = 0;
+
+	while (fs_list_pending()) {
+		for (; i < g_menu->size; ++i) {
+			if (stricmp(g_menu->root[i].compname->ptr, config.lastfile) == 0)
+				return;
+		}
+
+		fs_list_more(FS_LIST_BATCH);
+	}
+}
+
+/**
+ * гĿ鲢ļб, ѡ
+ *
+ * @param idx ѡ
+ * @param sorted гĿǰ, ЩѾ
+ */
+static void scene_filelist_resort(u32 * idx, u32 sorted)
+{
+	buffer *sel = (*idx < g_menu->size) ? g_menu->root[*idx].compname : NULL;
+	u32 i;
+
+	scene_filelist_sort_tail(sorted);
+
+	for (i = 0; i < g_menu->size; ++i) {
+		if (g_menu->root[i].compname == sel) {
+			*idx = i;
+			break;
+		}
+	}
+}
+
+/**
+ * ļбȴʱгʣĿ
+ */
+static bool scene_filelist_idle(p_win_menuitem * item, u32 * count, u32 max_height, u32 * topindex, u32 * index)
+{
+	u32 sorted = g_menu != NULL ? g_menu->size : 0;
+
+	// ÿֻĿٹ鲢, бԽÿԽ, Լٹ鲢
+	if (fs_list_more(max(FS_LIST_BATCH, g_menu->size / 4)) == 0)
+		return false;
+
+	scene_filelist_resort(index, sorted);
+	*item = g_menu->root;
+	*count = g_menu->size;
+
+	if (*index < *topindex || *index >= *topindex + max_height)
+		*topindex = (*index >= max_height) ? (*index - max_height + 1) : 0;
+
+	return true;
+}
+
+/**
+ * гʣĿ
+ *
+ * @note 뿪ļбǰ, ͼֵȹҪб
+ *
+ * @param idx ѡ
+ */
+static void scene_filelist_finish(u32 * idx)
+{
+	u32 sorted;
+
+	if (!fs_list_pending() || g_menu == NULL)
+		return;
+
+	sorted = g_menu->size;
+	fs_list_more(INVALID);
+	scene_filelist_resort(idx, sorted);
+}
+
 static void scene_open_dir_or_archive(u32 * idx)
 {
 	u32 plen = strlen(config.path);
@@ -2762,9 +2938,8 @@ static void scene_open_dir_or_archive(u32 * idx)
 					   config.menutextcolor, config.selicolor, config.menubcolor, config.selbcolor, config.showhidden, config.showunknown);
 	}
 
-	quicksort(g_menu->root,
-			  (g_menu->size > 0
-			   && g_menu->root[0].compname->ptr[0] == '.') ? 1 : 0, g_menu->size - 1, sizeof(t_win_menuitem), compare_func[(int) config.arrange]);
+	scene_filelist_find_lastfile();
+	scene_filelist_sort();
 	*idx = 0;
 	while (*idx < g_menu->size && stricmp(g_menu->root[*idx].compname->ptr, config.lastfile) != 0)
 		(*idx)++;
@@ -4371,9 +4546,7 @@ static void scene_enter_dir(u32 * idx)
 					   config.menutextcolor, config.selicolor, config.menubcolor, config.selbcolor, config.showhidden, config.showunknown);
 	} else
 		fs_flashdir_to_menu(config.path, config.shortpath, config.menutextcolor, config.selicolor, config.menubcolor, config.selbcolor);
-	quicksort(g_menu->root,
-			  (g_menu->size > 0
-			   && g_menu->root[0].compname->ptr[0] == '.') ? 1 : 0, g_menu->size - 1, sizeof(t_win_menuitem), compare_func[(int) config.arrange]);
+	scene_filelist_sort();
 	if (isup) {
 		for (*idx = 0; *idx < g_menu->size; (*idx)++)
 			if (stricmp(g_menu->root[*idx].compname->ptr, pdir) == 0)
@@ -4422,9 +4595,7 @@ static void scene_enter_archive(u32 * idx, enum ArchiveType type)
 			break;
 	}
 	if (UMD != type)
-		quicksort(g_menu->root,
-				  (g_menu->size > 0
-				   && g_menu->root[0].compname->ptr[0] == '.') ? 1 : 0, g_menu->size - 1, sizeof(t_win_menuitem), compare_func[(int) config.arrange]);
+		scene_filelist_sort();
 }
 
 #ifdef ENABLE_IMAGE
@@ -4594,12 +4765,16 @@ void scene_filelist(void)
 					// when exit to menu specify idx to INVALID
 					idx = INVALID;
 				}
-			} else
+			} else {
+				win_menu_set_idle(scene_filelist_idle);
 				idx =
 					win_menu(240 - WRR * DISP_FONTSIZE,
 							 139 - HRR * (DISP_FONTSIZE + 1),
 							 WRR * 4, HRR * 2, g_menu->root,
 							 g_menu->size, idx, 0, config.menubcolor, false, scene_filelist_predraw, scene_filelist_postdraw, scene_filelist_menucb);
+				if (idx != INVALID)
+					scene_filelist_finish(&idx);
+			}
 		} else {
 			config.isreading = false;
 			locreading = false;
@@ -4635,9 +4810,8 @@ void scene_filelist(void)
 							   config.shortpath,
 							   config.menutextcolor, config.selicolor, config.menubcolor, config.selbcolor, config.showhidden, config.showunknown);
 			}
-			quicksort(g_menu->root,
-					  (g_menu->size > 0
-					   && g_menu->root[0].compname->ptr[0] == '.') ? 1 : 0, g_menu->size - 1, sizeof(t_win_menuitem), compare_func[(int) config.arrange]);
+			scene_filelist_find_lastfile();
+			scene_filelist_sort();
 			idx = 0;
 			while (idx < g_menu->size && stricmp(g_menu->root[idx].compname->ptr, config.lastfile) != 0)
 				idx++;
@@ -4973,6 +5147,7 @@ extern void scene_init(void)
 #ifdef ENABLE_MUSIC
 	sceRtcGetCurrentTick(&dbglasttick);
 	music_init();
+	fs_add_music_types();
 	sceRtcGetCurrentTick(&dbgnow);
 	dbg_printf(d, "music_init(): %.2fs", pspDiffTime(&dbgnow, &dbglasttick));
 
@@ -5048,6 +5223,8 @@ extern void scene_exit(void)
 		save_passwords();
 
 	free_passwords();
+	chmcache_free();
+	zipread_free();
 
 	if (fs != NULL) {
 		scene_bookmark_autosave();
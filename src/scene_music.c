@@ -46,6 +46,7 @@
 #ifdef ENABLE_MUSIC
 #include "audiocore/musicmgr.h"
 #include "audiocore/musicdrv.h"
+#include "audiocore/musicdb.h"
 #ifdef ENABLE_LYRIC
 #include "audiocore/lyric.h"
 #endif
@@ -174,6 +175,64 @@ void scene_mp3_list_predraw(p_win_menuitem item, u32 index, u32 topindex, u32 ma
 				   _("Ҫ뵽ļбѡȡļ"));
 }
 
+#ifdef ENABLE_MUSIC
+/**
+ * ֱǩַ͵תΪGBK
+ */
+static void music_tag_conv(t_conf_encode encode, char *str, size_t size)
+{
+	switch (encode) {
+		case conf_encode_utf8:
+			charsets_utf8_conv((const u8 *) str, size, (u8 *) str, size);
+			break;
+		case conf_encode_big5:
+			charsets_big5_conv((const u8 *) str, size, (u8 *) str, size);
+			break;
+		case conf_encode_sjis:
+			{
+				u8 *temp = NULL;
+				u32 len = strlen(str);
+
+				charsets_sjis_conv((const u8 *) str, (u8 **) & temp, (u32 *) & len);
+				strncpy_s(str, size, (const char *) temp, len);
+				free(temp);
+			}
+			break;
+		case conf_encode_ucs:
+			charsets_ucs_conv((const u8 *) str, size, (u8 *) str, size);
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * ȡֿм¼, " - "
+ *
+ * @return ֿбʱtrue
+ */
+static bool music_get_dbname(const char *spath, char *name, size_t size)
+{
+	t_musicdb_info info;
+
+	if (musicdb_get(spath, false, &info) < 0)
+		return false;
+
+	music_tag_conv(info.tag.encode, info.tag.title, sizeof(info.tag.title));
+	music_tag_conv(info.tag.encode, info.tag.artist, sizeof(info.tag.artist));
+
+	if (info.tag.title[0] == '\0')
+		return false;
+
+	if (info.tag.artist[0] != '\0')
+		snprintf_s(name, size, "%s - %s", info.tag.artist, info.tag.title);
+	else
+		snprintf_s(name, size, "%s", info.tag.title);
+
+	return true;
+}
+#endif
+
 void scene_mp3_list_postdraw(p_win_menuitem item, u32 index, u32 topindex, u32 max_height)
 {
 	char outstr[256];
@@ -238,14 +297,16 @@ void scene_mp3_list(void)
 
 	for (i = 0; i < music_maxindex(); i++) {
 		MusicListEntry *fl = musiclist_get(&g_music_list, i);
+		char dbname[256];
 		char *rname;
 
 		if (fl == NULL)
 			continue;
 
-		rname = strrchr(fl->lpath, '/');
-
-		if (rname == NULL)
+		// ʾֿеıǩ, ȡļ
+		if (music_get_dbname(fl->spath, dbname, sizeof(dbname)))
+			rname = dbname;
+		else if ((rname = strrchr(fl->lpath, '/')) == NULL)
 			rname = fl->lpath;
 		else
 			rname++;
@@ -403,55 +464,10 @@ static void scene_draw_mp3bar_music_staff(void)
 	if (musicdrv_get_info(&info) == 0) {
 		char tag[512];
 
-		switch (info.encode) {
-			case conf_encode_utf8:
-				charsets_utf8_conv((const u8 *) info.artist, sizeof(info.artist), (u8 *) info.artist, sizeof(info.artist));
-				charsets_utf8_conv((const u8 *) info.title, sizeof(info.title), (u8 *) info.title, sizeof(info.title));
-				charsets_utf8_conv((const u8 *) info.album, sizeof(info.album), (u8 *) info.album, sizeof(info.album));
-				charsets_utf8_conv((const u8 *) info.comment, sizeof(info.comment), (u8 *) info.comment, sizeof(info.comment));
-				break;
-			case conf_encode_big5:
-				charsets_big5_conv((const u8 *) info.artist, sizeof(info.artist), (u8 *) info.artist, sizeof(info.artist));
-				charsets_big5_conv((const u8 *) info.title, sizeof(info.title), (u8 *) info.title, sizeof(info.title));
-				charsets_big5_conv((const u8 *) info.album, sizeof(info.album), (u8 *) info.album, sizeof(info.album));
-				charsets_big5_conv((const u8 *) info.comment, sizeof(info.comment), (u8 *) info.comment, sizeof(info.comment));
-				break;
-			case conf_encode_sjis:
-				{
-					u8 *temp;
-					u32 size;
-
-					temp = NULL, size = strlen(info.artist);
-					charsets_sjis_conv((const u8 *) info.artist, (u8 **) & temp, (u32 *) & size);
-					strncpy_s(info.artist, sizeof(info.artist), (const char *) temp, size);
-					free(temp);
-					temp = NULL, size = strlen(info.title);
-					charsets_sjis_conv((const u8 *) info.title, (u8 **) & temp, (u32 *) & size);
-					strncpy_s(info.title, sizeof(info.title), (const char *) temp, size);
-					free(temp);
-					temp = NULL, size = strlen(info.album);
-					charsets_sjis_conv((const u8 *) info.album, (u8 **) & temp, (u32 *) & size);
-					strncpy_s(info.album, sizeof(info.album), (const char *) temp, size);
-					free(temp);
-					temp = NULL, size = strlen(info.comment);
-					charsets_sjis_conv((const u8 *) info.comment, (u8 **) & temp, (u32 *) & size);
-					strncpy_s(info.comment, sizeof(info.comment), (const char *) temp, size);
-					free(temp);
-				}
-				break;
-			case conf_encode_gbk:
-				break;
-			case conf_encode_ucs:
-				{
-					charsets_ucs_conv((const u8 *) info.artist, sizeof(info.artist), (u8 *) info.artist, sizeof(info.artist));
-					charsets_ucs_conv((const u8 *) info.title, sizeof(info.title), (u8 *) info.title, sizeof(info.title));
-					charsets_ucs_conv((const u8 *) info.album, sizeof(info.album), (u8 *) info.album, sizeof(info.album));
-					charsets_ucs_conv((const u8 *) info.comment, sizeof(info.comment), (u8 *) info.comment, sizeof(info.comment));
-				}
-				break;
-			default:
-				break;
-		}
+		music_tag_conv(info.encode, info.artist, sizeof(info.artist));
+		music_tag_conv(info.encode, info.title, sizeof(info.title));
+		music_tag_conv(info.encode, info.album, sizeof(info.album));
+		music_tag_conv(info.encode, info.comment, sizeof(info.comment));
 
 		if (info.artist[0] != '\0' && info.album[0] != '\0' && info.title[0] != '\0')
 			SPRINTF_S(tag, "%s - %s - %s", info.artist, info.album, info.title);
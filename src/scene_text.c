@@ -49,6 +49,7 @@
 #endif
 #endif
 #include "text.h"
+#include "textsearch.h"
 #include "bg.h"
 #include "copy.h"
 #include "common/qsort.h"
@@ -1266,6 +1267,30 @@ static void jump_to_gi(u32 gi)
 	dbg_printf(d, "%s: ûҵGIֵ%u", __func__, gi);
 }
 
+/**
+ * ıһƥ
+ *
+ * @note ıһβʱ
+ *
+ * @param str Ҫҵַ
+ */
+static void jump_to_text(const char *str)
+{
+	u32 row;
+
+	if (fs->index == NULL && fs->size >= TEXTSEARCH_MIN_SIZE)
+		textsearch_build_index(fs);
+
+	if (textsearch_next_row(fs, str, strlen(str), &row) != 0) {
+		dbg_printf(d, "%s: ûҵ%s", __func__, str);
+		return;
+	}
+
+	cur_book_view.rowtop = 0;
+	fs->crow = row;
+	cur_book_view.rrow = (fs->rows[fs->crow >> 10] + (fs->crow & 0x3FF))->start - fs->buf;
+}
+
 static void jump_to_percent(float percent)
 {
 	u32 i;
@@ -1601,6 +1626,9 @@ int book_handle_input(PBookViewData pView, u32 * selidx, u32 key)
 
 				if (sscanf(buf, "%f%%", &percent) == 1)
 					jump_to_percent(percent);
+			} else if (buf[strspn(buf, "0123456789")] != '\0') {
+				// GIֵ, Ҫҵı
+				jump_to_text(buf);
 			} else {
 				unsigned long gi = strtoul(buf, NULL, 10);
 
@@ -34,6 +34,8 @@
 #include "display.h"
 #include "html.h"
 #include "text.h"
+#include "textsearch.h"
+#include "textnorm.h"
 #include "kubridge.h"
 #include "dbg.h"
 #include "buffer.h"
@@ -42,6 +44,7 @@
 #include "conf.h"
 #include "unumd.h"
 #include "depdb.h"
+#include "gzload.h"
 #ifdef DMALLOC
 #include "dmalloc.h"
 #endif
@@ -120,25 +123,6 @@ static void text_decode(p_text txt, t_conf_encode encode)
 	}
 }
 
-bool bytetable[256] = {
-	1, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 0, 0, 1, 0, 0,	// 0x00
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x10
-	2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x20
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x30
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x40
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x50
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x60
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x70
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x80
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x90
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0xA0
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0xB0
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0xC0
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0xD0
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0xE0
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0	// 0xF0
-};
-
 #ifdef ENABLE_TTF
 extern p_ttf ettf, cttf;
 #endif
@@ -347,217 +331,6 @@ extern bool text_format(p_text txt, u32 max_pixels, u32 wordspace, bool ttf_mode
 	return true;
 }
 
-/**
- * ǷӦϲıС
- *
- * @note ǰļгƽг(1 - 1 / min_ratio) * 100%ĻӦϲ
- */
-static int min_ratio = 20;
-
-/**
- * ƽг 
- *
- * @param txtBuf ıʼַ
- * @param txtLen ıСֽڼ
- *
- * @return ƽÿеĳȣֽڼ
- */
-static size_t getTxtAvgLength(char *txtBuf, size_t txtLen)
-{
-	int linesize = 0, linecnt = 0;
-
-	while (txtLen-- > 0) {
-		if (*txtBuf == '\n') {
-			linecnt++;
-		} else {
-			if (*txtBuf != '\r') {
-				linesize++;
-			}
-		}
-		txtBuf++;
-	}
-	if (linecnt != 0)
-		return linesize / linecnt;
-	return 0;
-}
-
-/**
- * ϲı
- *
- * @note ܹϲ
- * @note ıtxtbufָ
- * @note ٶ
- *
- * @param txtbuf TXTָָ
- * @param txtlen TXTСֽڼ
- *
- * @return ļСֽڼ
- */
-static size_t text_paragraph_join_without_memory(char **txtbuf, size_t txtlen)
-{
-	char *src = *txtbuf;
-	size_t avgLength;
-	int nlinesz = 0, nol = 0;
-	int cnt = txtlen;
-
-	if (txtlen == 0 || txtbuf == NULL || *txtbuf == NULL)
-		return 0;
-
-	// ƽг
-	avgLength = getTxtAvgLength(*txtbuf, txtlen);
-
-	while (cnt-- > 0) {
-		if (*src == '\n') {
-			nol++;
-			if (nlinesz >= avgLength - avgLength * 1.0 / min_ratio) {
-				// кһкϲ
-				if (*(src - 1) == '\r') {
-					if (txtlen > src - *txtbuf) {
-						memmove(src - 1, src + 1, txtlen - (src - *txtbuf));
-						txtlen -= 2;
-					}
-				} else {
-					if (txtlen > src - *txtbuf) {
-						memmove(src, src + 1, txtlen - (src - *txtbuf));
-						txtlen--;
-					}
-				}
-			}
-			nlinesz = 0;
-		} else if (*src != '\r') {
-			nlinesz++;
-		}
-		src++;
-	}
-
-	return txtlen;
-}
-
-/**
- * ϲı䣬ڴ汾ٶȿ
- *
- * @note ܹϲ
- * @note txtbufָܽһµımallocTXT
- * @note ܷ㹻ڴ棬Զʹtext_paragraph_join_without_memory
- *
- * @param txtbuf TXTָָ룬ָһڶϷڴ
- * @param txtlen TXTСֽڼ
- *
- * @return ļС
- */
-static size_t text_paragraph_join_alloc_memory(char **txtbuf, size_t txtlen)
-{
-	char *p;
-	int nlinesz, nol;
-	int cnt;
-	size_t avgLength;
-	char *src, *dst;
-
-	if (txtlen == 0 || txtbuf == NULL || *txtbuf == NULL)
-		return 0;
-
-	// ƽг
-	avgLength = getTxtAvgLength(*txtbuf, txtlen);
-	src = *txtbuf, dst = NULL;
-
-	if ((dst = calloc(1, txtlen)) == NULL) {
-		return text_paragraph_join_without_memory(txtbuf, txtlen);
-	}
-
-	p = dst;
-	nlinesz = 0, nol = 0;
-	cnt = txtlen;
-
-	while (cnt-- > 0) {
-		if (*src == '\n') {
-			nol++;
-			if (nlinesz < avgLength - avgLength * 1.0 / min_ratio) {
-				if (*(src - 1) == '\r') {
-					*p++ = '\r';
-				}
-				*p++ = '\n';
-			}
-			nlinesz = 0;
-		} else if (*src != '\r') {
-			nlinesz++;
-			*p++ = *src;
-		}
-		src++;
-	}
-
-	free(*txtbuf);
-	*txtbuf = dst;
-
-	return p - dst;
-}
-
-/**
- * ±ı
- *
- * @note ɾ
- *
- * @param string ıʼַ
- * @param size ıС
- *
- * @return ıС
- */
-static u32 text_reorder(char *string, u32 size)
-{
-	int i;
-	char *wtxt = string, *ctxt = string, *etxt = string + size;
-
-	while (ctxt < etxt) {
-		while (ctxt < etxt && bytetable[*(u8 *) ctxt] == 0)
-			*wtxt++ = *ctxt++;
-		if (ctxt >= etxt)
-			break;
-		switch (*ctxt) {
-			case '\t':
-				*wtxt++ = ' ';
-				ctxt++;
-				for (i = 0; i < 3; i++)
-					if (*ctxt == ' ') {
-						*wtxt++ = ' ';
-						ctxt++;
-					}
-				while (ctxt < etxt && *ctxt == ' ')
-					ctxt++;
-				break;
-			case ' ':
-				*wtxt++ = ' ';
-				ctxt++;
-				if (ctxt - 1 > string && *(ctxt - 2) == '\n')
-					for (i = 0; i < 2; i++)
-						if (*ctxt == ' ') {
-							*wtxt++ = ' ';
-							ctxt++;
-						}
-				if (*ctxt == ' ') {
-					*wtxt++ = ' ';
-					ctxt++;
-				}
-				while (ctxt < etxt && *ctxt == ' ')
-					ctxt++;
-				break;
-			case '\r':
-			case '\n':
-				i = ((*ctxt == '\n') ? 1 : 0);
-				*wtxt++ = '\n';
-				ctxt++;
-				while (ctxt < etxt && (*ctxt == '\r' || *ctxt == '\n')) {
-					i += ((*ctxt == '\n') ? 1 : 0);
-					ctxt++;
-				}
-				if (i > 2)
-					*wtxt++ = '\n';
-				break;
-			case 0:
-				ctxt++;
-		}
-	}
-	return wtxt - string;
-}
-
 /**
  * ıļ
  *
@@ -595,8 +368,7 @@ static p_text text_open(const char *filename, t_fs_filetype ft, u32 max_pixels,
 	if (ft == fs_filetype_html)
 		txt->size = html_to_text(txt->buf, txt->size, true);
 	if (reorder) {
-		txt->size = text_reorder(txt->buf, txt->size);
-		txt->size = text_paragraph_join_alloc_memory(&txt->buf, txt->size);
+		txt->size = text_normalize(txt->buf, txt->size, TEXT_NORM_REORDER | TEXT_NORM_JOIN);
 	}
 	if (!text_format(txt, max_pixels, wordspace, using_ttf)) {
 		text_close(txt);
@@ -612,21 +384,6 @@ static p_text text_open(const char *filename, t_fs_filetype ft, u32 max_pixels,
 	return txt;
 }
 
-static int fix_symbian_crlf(unsigned char *pos, unsigned char *posend)
-{
-	while (pos < posend) {
-		if (pos < posend - 1 && *pos == 0xa1 && *(pos + 1) == 0xf6) {
-			*pos = '\r';
-			*(pos + 1) = '\n';
-			pos += 2;
-		} else {
-			pos++;
-		}
-	}
-
-	return 0;
-}
-
 extern p_text chapter_open_in_umd(const char *umdfile, const char *chaptername, u_int index, u32 rowpixels, u32 wordspace, t_conf_encode encode, bool reorder)
 {
 	extern p_umd_chapter p_umdchapter;
@@ -658,15 +415,11 @@ extern p_text chapter_open_in_umd(const char *umdfile, const char *chaptername,
 	txt->size = pbuf->used;
 	memcpy(txt->buf, pbuf->ptr, txt->size);
 	text_decode(txt, conf_encode_ucs);
-	fix_symbian_crlf((unsigned char *) txt->buf, (unsigned char *) txt->buf + txt->size);
 	buffer_free(pbuf);
 	dbg_printf(d, "%s: after conv file length: %u", __func__, txt->size);
 	/* if (ft == fs_filetype_html)
 	   txt->size = html_to_text(txt->buf, txt->size, true); */
-	if (reorder) {
-		txt->size = text_reorder(txt->buf, txt->size);
-		txt->size = text_paragraph_join_alloc_memory(&txt->buf, txt->size);
-	}
+	txt->size = text_normalize(txt->buf, txt->size, TEXT_NORM_SYMBIAN_CRLF | (reorder ? TEXT_NORM_REORDER | TEXT_NORM_JOIN : 0));
 	if (!text_format(txt, rowpixels, wordspace, using_ttf)) {
 		text_close(txt);
 		return NULL;
@@ -684,6 +437,7 @@ extern p_text text_open_in_umd(const char *umdfile, const char *chaptername, t_f
 	buffer *pRaw, *pbuf;
 	p_text txt;
 	char *p;
+	int flags = TEXT_NORM_SYMBIAN_CRLF;
 
 	if (sceIoGetstat(umdfile, &state) < 0) {
 		return NULL;
@@ -733,13 +487,14 @@ extern p_text text_open_in_umd(const char *umdfile, const char *chaptername, t_f
 	text_decode(txt, conf_encode_ucs);
 	buffer_free(pbuf);
 	dbg_printf(d, "%s: after conv file length %u", __func__, txt->size);
-	fix_symbian_crlf((unsigned char *) txt->buf, (unsigned char *) txt->buf + txt->size);
-	if (ft == fs_filetype_html)
+	if (ft == fs_filetype_html) {
+		txt->size = text_normalize(txt->buf, txt->size, TEXT_NORM_SYMBIAN_CRLF);
 		txt->size = html_to_text(txt->buf, txt->size, true);
-	if (reorder) {
-		txt->size = text_reorder(txt->buf, txt->size);
-		txt->size = text_paragraph_join_alloc_memory(&txt->buf, txt->size);
+		flags = 0;
 	}
+	if (reorder)
+		flags |= TEXT_NORM_REORDER | TEXT_NORM_JOIN;
+	txt->size = text_normalize(txt->buf, txt->size, flags);
 	if (!text_format(txt, rowpixels, wordspace, using_ttf)) {
 		text_close(txt);
 		return NULL;
@@ -751,49 +506,50 @@ extern p_text text_open_in_umd(const char *umdfile, const char *chaptername, t_f
 
 extern p_text text_open_in_pdb(const char *pdbfile, const char *chaptername, t_fs_filetype ft, u32 rowpixels, u32 wordspace, t_conf_encode encode, bool reorder)
 {
-	SceIoStat state;
-	size_t filesize;
-	buffer *pbuf;
+	p_pdb pdb;
 	p_text txt;
+	u32 size;
+	char *p;
 
-	if (sceIoGetstat(pdbfile, &state) < 0) {
+	if ((pdb = pdb_open(pdbfile)) == NULL) {
 		return NULL;
 	}
 
-	filesize = state.st_size;
-	pbuf = calloc(1, sizeof(*pbuf));
+	txt = calloc(1, sizeof(*txt));
 
-	if (pbuf == NULL)
+	if (txt == NULL) {
+		pdb_close(pdb);
 		return NULL;
-	buffer_prepare_copy(pbuf, filesize);
-	if (0 > read_pdb_data(pdbfile, &pbuf)) {
-		buffer_free(pbuf);
+	}
+	STRCPY_S(txt->filename, pdbfile);
+	size = pdb_text_size(pdb);
+	if ((txt->buf = (char *) calloc(1, size + 1)) == NULL) {
+		pdb_close(pdb);
+		text_close(txt);
 		return NULL;
 	}
 
-	dbg_printf(d, "%s parse file length:%d!", __func__, pbuf->size);
-	txt = calloc(1, sizeof(*txt));
+	// Records are decoded straight into the text buffer
+	txt->size = pdb_read_all(pdb, &txt->buf, &size);
+	pdb_close(pdb);
+	dbg_printf(d, "%s parse file length:%u!", __func__, (unsigned) txt->size);
 
-	if (txt == NULL) {
-		buffer_free(pbuf);
+	if (txt->size == 0) {
+		text_close(txt);
 		return NULL;
-
 	}
-	STRCPY_S(txt->filename, pdbfile);
-	if ((txt->buf = (char *) calloc(1, pbuf->used + 1)) == NULL) {
-		buffer_free(pbuf);
+
+	// pdb_read_all may have filled a grown buffer to the last byte
+	if ((p = realloc(txt->buf, txt->size + 1)) == NULL) {
 		text_close(txt);
 		return NULL;
 	}
-
-	txt->size = pbuf->used;
-	memcpy(txt->buf, pbuf->ptr, txt->size);
-	buffer_free(pbuf);
+	txt->buf = p;
+	txt->buf[txt->size] = '\0';
 	txt->ucs = 0;
 
 	if (reorder) {
-		txt->size = text_reorder(txt->buf, txt->size);
-		txt->size = text_paragraph_join_alloc_memory(&txt->buf, txt->size);
+		txt->size = text_normalize(txt->buf, txt->size, TEXT_NORM_REORDER | TEXT_NORM_JOIN);
 	}
 	if (!text_format(txt, rowpixels, wordspace, using_ttf)) {
 		text_close(txt);
@@ -926,6 +682,12 @@ static p_text text_open_in_gz(const char *gzfile, const char *filename, t_fs_fil
 	if (txt == NULL)
 		return NULL;
 
+	STRCPY_S(txt->filename, filename);
+
+	// ȳһνѹλ, ʧʱgzreadδѹ
+	if (gzload_all(gzfile, &txt->buf, &txt->size) == 0)
+		goto decode;
+
 	unzf = gzopen(gzfile, "rb");
 
 	if (unzf == NULL) {
@@ -933,7 +695,6 @@ static p_text text_open_in_gz(const char *gzfile, const char *filename, t_fs_fil
 		return NULL;
 	}
 
-	STRCPY_S(txt->filename, filename);
 	b = buffer_init();
 
 	while ((len = gzread(unzf, tempbuf, BUFSIZ)) > 0) {
@@ -956,12 +717,12 @@ static p_text text_open_in_gz(const char *gzfile, const char *filename, t_fs_fil
 	txt->size = b->used;
 	txt->buf = buffer_free_weak(b);
 
+  decode:
 	text_decode(txt, encode);
 	if (ft == fs_filetype_html)
 		txt->size = html_to_text(txt->buf, txt->size, true);
 	if (reorder) {
-		txt->size = text_reorder(txt->buf, txt->size);
-		txt->size = text_paragraph_join_alloc_memory(&txt->buf, txt->size);
+		txt->size = text_normalize(txt->buf, txt->size, TEXT_NORM_REORDER | TEXT_NORM_JOIN);
 	}
 
 	if (!text_format(txt, max_pixels, wordspace, using_ttf)) {
@@ -1112,8 +873,7 @@ extern p_text text_open_in_raw(const char *filename, const unsigned char *data,
 	if (ft == fs_filetype_html)
 		txt->size = html_to_text(txt->buf, txt->size, true);
 	if (reorder) {
-		txt->size = text_reorder(txt->buf, txt->size);
-		txt->size = text_paragraph_join_alloc_memory(&txt->buf, txt->size);
+		txt->size = text_normalize(txt->buf, txt->size, TEXT_NORM_REORDER | TEXT_NORM_JOIN);
 	}
 	if (!text_format(txt, max_pixels, wordspace, using_ttf)) {
 		text_close(txt);
@@ -1160,8 +920,7 @@ static p_text text_open_in_zip(const char *zipfile, const char *filename, t_fs_f
 	if (ft == fs_filetype_html)
 		txt->size = html_to_text(txt->buf, txt->size, true);
 	if (reorder) {
-		txt->size = text_reorder(txt->buf, txt->size);
-		txt->size = text_paragraph_join_alloc_memory(&txt->buf, txt->size);
+		txt->size = text_normalize(txt->buf, txt->size, TEXT_NORM_REORDER | TEXT_NORM_JOIN);
 	}
 	if (!text_format(txt, max_pixels, wordspace, using_ttf)) {
 		text_close(txt);
@@ -1316,8 +1075,7 @@ static p_text text_open_in_rar(const char *rarfile, const char *filename, t_fs_f
 	if (ft == fs_filetype_html)
 		txt->size = html_to_text(txt->buf, txt->size, true);
 	if (reorder) {
-		txt->size = text_reorder(txt->buf, txt->size);
-		txt->size = text_paragraph_join_alloc_memory(&txt->buf, txt->size);
+		txt->size = text_normalize(txt->buf, txt->size, TEXT_NORM_REORDER | TEXT_NORM_JOIN);
 	}
 	if (!text_format(txt, max_pixels, wordspace, using_ttf)) {
 		text_close(txt);
@@ -1362,8 +1120,7 @@ static p_text text_open_in_chm(const char *chmfile, const char *filename, t_fs_f
 	if (ft == fs_filetype_html)
 		txt->size = html_to_text(txt->buf, txt->size, true);
 	if (reorder) {
-		txt->size = text_reorder(txt->buf, txt->size);
-		txt->size = text_paragraph_join_alloc_memory(&txt->buf, txt->size);
+		txt->size = text_normalize(txt->buf, txt->size, TEXT_NORM_REORDER | TEXT_NORM_JOIN);
 	}
 	if (!text_format(txt, max_pixels, wordspace, using_ttf)) {
 		text_close(txt);
@@ -1384,6 +1141,7 @@ extern void text_close(p_text fstext)
 			if (fstext->rows[i] != NULL)
 				free(fstext->rows[i]);
 
+		textsearch_free(fstext);
 		free(fstext);
 	}
 }
@@ -31,6 +31,8 @@ typedef struct
 	u32 GI;
 } t_textrow, *p_textrow;
 
+struct _t_textsearch_index;
+
 typedef struct
 {
 	/** ļ· */
@@ -55,6 +57,9 @@ typedef struct
 
 	/** нṹָ */
 	p_textrow rows[1024];
+
+	/** ȫĲ, textsearch.h */
+	struct _t_textsearch_index *index;
 } t_text, *p_text;
 
 /**
@@ -0,0 +1,238 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <string.h>
+#include "text.h"
+#include "textnorm.h"
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+bool bytetable[256] = {
+	1, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 0, 0, 1, 0, 0,	// 0x00
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x10
+	2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x20
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x30
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x40
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x50
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x60
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x70
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x80
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x90
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0xA0
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0xB0
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0xC0
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0xD0
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0xE0
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0	// 0xF0
+};
+
+/**
+ * ǷӦϲıС
+ *
+ * @note ǰļгƽг(1 - 1 / min_ratio) * 100%ĻӦϲ
+ */
+static int min_ratio = 20;
+
+static inline bool fix_symbian_crlf_at(char *pos, const char *posend)
+{
+	if (pos < posend - 1 && *(u8 *) pos == 0xa1 && *(u8 *) (pos + 1) == 0xf6) {
+		*pos = '\r';
+		*(pos + 1) = '\n';
+		return true;
+	}
+
+	return false;
+}
+
+static void fix_symbian_crlf(char *pos, const char *posend)
+{
+	while (pos < posend)
+		pos += fix_symbian_crlf_at(pos, posend) ? 2 : 1;
+}
+
+/**
+ * ±ı
+ *
+ * @note ɾ
+ * @note ڶ֮ǰ͵໻з, ԭȵһЧͬ
+ *
+ * @param string ıʼַ
+ * @param size ıС
+ * @param symbian Ƿ໻з
+ * @param lines дĻз
+ *
+ * @return ıС
+ */
+static u32 text_reorder(char *string, u32 size, bool symbian, u32 * lines)
+{
+	int i;
+	char *wtxt = string, *ctxt = string, *etxt = string + size;
+	u32 nl = 0;
+
+	while (ctxt < etxt) {
+		while (ctxt < etxt) {
+			if (symbian)
+				fix_symbian_crlf_at(ctxt, etxt);
+			if (bytetable[*(u8 *) ctxt] != 0)
+				break;
+			*wtxt++ = *ctxt++;
+		}
+		if (ctxt >= etxt)
+			break;
+		switch (*ctxt) {
+			case '\t':
+				*wtxt++ = ' ';
+				ctxt++;
+				for (i = 0; i < 3; i++)
+					if (ctxt < etxt && *ctxt == ' ') {
+						*wtxt++ = ' ';
+						ctxt++;
+					}
+				while (ctxt < etxt && *ctxt == ' ')
+					ctxt++;
+				break;
+			case ' ':
+				*wtxt++ = ' ';
+				ctxt++;
+				if (ctxt - 1 > string && *(ctxt - 2) == '\n')
+					for (i = 0; i < 2; i++)
+						if (ctxt < etxt && *ctxt == ' ') {
+							*wtxt++ = ' ';
+							ctxt++;
+						}
+				if (ctxt < etxt && *ctxt == ' ') {
+					*wtxt++ = ' ';
+					ctxt++;
+				}
+				while (ctxt < etxt && *ctxt == ' ')
+					ctxt++;
+				break;
+			case '\r':
+			case '\n':
+				i = ((*ctxt == '\n') ? 1 : 0);
+				*wtxt++ = '\n';
+				nl++;
+				ctxt++;
+				while (ctxt < etxt) {
+					if (symbian)
+						fix_symbian_crlf_at(ctxt, etxt);
+					if (*ctxt != '\r' && *ctxt != '\n')
+						break;
+					i += ((*ctxt == '\n') ? 1 : 0);
+					ctxt++;
+				}
+				if (i > 2) {
+					*wtxt++ = '\n';
+					nl++;
+				}
+				break;
+			case 0:
+				ctxt++;
+		}
+	}
+
+	if (lines != NULL)
+		*lines = nl;
+
+	return wtxt - string;
+}
+
+/**
+ * 㻻зͲ\rֽ
+ */
+static u32 text_count_lines(const char *txtbuf, u32 txtlen, u32 * linesize)
+{
+	u32 nl = 0, cr = 0;
+	const char *p, *end = txtbuf + txtlen;
+
+	for (p = txtbuf; p < end; p++) {
+		if (*p == '\n')
+			nl++;
+		else if (*p == '\r')
+			cr++;
+	}
+
+	*linesize = txtlen - nl - cr;
+
+	return nl;
+}
+
+/**
+ * ͵غϲı
+ *
+ * @note ƽг(1 - 1 / min_ratio)һкϲ
+ * @note ֻɾֽ, дָӲָ, Ҫڴ
+ *
+ * @param txtbuf ıʼַ
+ * @param txtlen ıСֽڼ
+ * @param avgLength ƽгֽڼ
+ *
+ * @return ıСֽڼ
+ */
+static u32 text_paragraph_join(char *txtbuf, u32 txtlen, size_t avgLength)
+{
+	const char *src = txtbuf, *end = txtbuf + txtlen;
+	char *dst = txtbuf;
+	double limit = avgLength - avgLength * 1.0 / min_ratio;
+	int nlinesz = 0;
+	bool cr = false;
+
+	for (; src < end; src++) {
+		if (*src == '\n') {
+			if (nlinesz < limit) {
+				if (cr)
+					*dst++ = '\r';
+				*dst++ = '\n';
+			}
+			nlinesz = 0;
+		} else if (*src != '\r') {
+			nlinesz++;
+			*dst++ = *src;
+		}
+		cr = *src == '\r';
+	}
+
+	return dst - txtbuf;
+}
+
+extern u32 text_normalize(char *txtbuf, u32 txtlen, int flags)
+{
+	u32 lines = 0, linesize = 0;
+
+	if (txtbuf == NULL || txtlen == 0)
+		return txtlen;
+
+	if (flags & TEXT_NORM_REORDER) {
+		txtlen = text_reorder(txtbuf, txtlen, (flags & TEXT_NORM_SYMBIAN_CRLF) != 0, &lines);
+		// ±źֻʣ\n
+		linesize = txtlen - lines;
+	} else {
+		if (flags & TEXT_NORM_SYMBIAN_CRLF)
+			fix_symbian_crlf(txtbuf, txtbuf + txtlen);
+		if (flags & TEXT_NORM_JOIN)
+			lines = text_count_lines(txtbuf, txtlen, &linesize);
+	}
+
+	if (flags & TEXT_NORM_JOIN)
+		txtlen = text_paragraph_join(txtbuf, txtlen, lines != 0 ? (int) linesize / (int) lines : 0);
+
+	return txtlen;
+}
@@ -0,0 +1,50 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef TEXTNORM_H
+#define TEXTNORM_H
+
+#include "common/datatype.h"
+
+enum
+{
+	/** 0xA1F6зΪ\r\n */
+	TEXT_NORM_SYMBIAN_CRLF = 1,
+	/** ѹոTAB, ͳһз, ɾ */
+	TEXT_NORM_REORDER = 2,
+	/** ƽгϲ */
+	TEXT_NORM_JOIN = 4,
+};
+
+/**
+ * 淶ı
+ *
+ * @note : һз±, ͬʱͳ; ڶϲ
+ * @note ͵ؽ, ڴ
+ *
+ * @param txtbuf ıʼַ
+ * @param txtlen ıСֽڼ
+ * @param flags TEXT_NORM_*
+ *
+ * @return ıСֽڼ
+ */
+extern u32 text_normalize(char *txtbuf, u32 txtlen, int flags);
+
+#endif
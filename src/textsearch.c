@@ -0,0 +1,421 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pspkernel.h>
+#include <zlib.h>
+#include "common/utils.h"
+#include "bookmark.h"
+#include "scene.h"
+#include "freq_lock.h"
+#include "textsearch.h"
+#include "dbg.h"
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+#define TEXTSEARCH_MAGIC 0x58445854
+#define TEXTSEARCH_VERSION 1
+#define TEXTSEARCH_WORDS (TEXTSEARCH_BLOCK_BITS / 32)
+
+/**
+ * ÿλͼβôֽĶԪ,
+ * ʼڿڵƥǰTEXTSEARCH_OVERLAP + 1ֽһڸÿ
+ */
+#define TEXTSEARCH_OVERLAP 64
+
+typedef struct
+{
+	u32 magic;
+	u32 version;
+	u32 size;
+	u32 crc;
+	u32 blocks;
+	char path[PATH_MAX];
+} t_textsearch_header;
+
+struct _t_textsearch_index
+{
+	t_textsearch_header hdr;
+	u32 *bits;
+};
+
+/** һβҵԤ */
+typedef struct
+{
+	const u8 *pat;
+	size_t len;
+	/** Horspoolת */
+	u32 skip[256];
+	/** ַĶԪλͼ, ʱʹ */
+	u32 mask[TEXTSEARCH_WORDS];
+	bool use_index;
+} t_textsearch_query;
+
+static inline u32 bigram_bit(u8 a, u8 b)
+{
+	return ((((u32) a << 8) | b) * 2654435761U) >> 20;
+}
+
+static void textsearch_index_path(const char *filename, char *path, size_t size)
+{
+	snprintf_s(path, size, "%stextindex/%08X.idx", scene_appdir(), (unsigned) bookmark_encode(filename));
+}
+
+static void query_init(t_textsearch_query * q, p_text txt, const char *pattern, size_t len)
+{
+	size_t i;
+
+	q->pat = (const u8 *) pattern;
+	q->len = len;
+
+	for (i = 0; i < 256; ++i)
+		q->skip[i] = len;
+
+	for (i = 0; i + 1 < len; ++i)
+		q->skip[q->pat[i]] = len - 1 - i;
+
+	q->use_index = txt->index != NULL && len >= 2;
+
+	if (q->use_index) {
+		size_t n = min(len, TEXTSEARCH_OVERLAP + 1);
+
+		memset(q->mask, 0, sizeof(q->mask));
+
+		for (i = 0; i + 1 < n; ++i) {
+			u32 h = bigram_bit(q->pat[i], q->pat[i + 1]);
+
+			q->mask[h >> 5] |= 1U << (h & 31);
+		}
+	}
+}
+
+static bool block_may_match(const t_textsearch_query * q, const u32 * bits, u32 block)
+{
+	const u32 *w = bits + block * TEXTSEARCH_WORDS;
+	u32 i;
+
+	for (i = 0; i < TEXTSEARCH_WORDS; ++i) {
+		if ((w[i] & q->mask[i]) != q->mask[i])
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * [start, end)вƥĿʼλ
+ *
+ * @note ֽmemchr, Horspool, PSPûпڴ˵SIMD
+ */
+static const u8 *search_raw(const t_textsearch_query * q, const u8 * start, const u8 * end)
+{
+	const u8 *p, *last;
+	u8 tail;
+
+	if (end - start < (ptrdiff_t) q->len)
+		return NULL;
+
+	if (q->len == 1)
+		return memchr(start, q->pat[0], end - start);
+
+	tail = q->pat[q->len - 1];
+	last = end - q->len;
+
+	for (p = start; p <= last; p += q->skip[p[q->len - 1]]) {
+		if (p[q->len - 1] == tail && memcmp(p, q->pat, q->len - 1) == 0)
+			return p;
+	}
+
+	return NULL;
+}
+
+extern u32 textsearch_offset_to_row(p_text txt, u32 offset)
+{
+	u32 lo = 0, hi = txt->row_count;
+
+	while (hi - lo > 1) {
+		u32 mid = (lo + hi) / 2;
+
+		if (txt->rows[mid >> 10][mid & 0x3FF].start - txt->buf <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/**
+ * ƥλǷַ߽
+ *
+ * @note һַ߽, еװ˫ֽڱߵλ
+ */
+static bool at_char_boundary(p_text txt, const u8 * m)
+{
+	const u8 *p = (const u8 *) txt->buf;
+
+	if (txt->row_count > 0) {
+		u32 row = textsearch_offset_to_row(txt, m - p);
+
+		p = (const u8 *) txt->rows[row >> 10][row & 0x3FF].start;
+	}
+
+	while (p < m)
+		p += *p >= 0x80 ? 2 : 1;
+
+	return p == m;
+}
+
+static int search_range(p_text txt, const t_textsearch_query * q, u32 start, u32 end, u32 * pos)
+{
+	const u8 *buf = (const u8 *) txt->buf, *p = buf + start;
+
+	while ((p = search_raw(q, p, buf + end)) != NULL) {
+		if (at_char_boundary(txt, p)) {
+			*pos = p - buf;
+			return 0;
+		}
+
+		p++;
+	}
+
+	return -1;
+}
+
+static int query_find(p_text txt, const t_textsearch_query * q, u32 from, u32 * pos)
+{
+	const t_textsearch_header *hdr;
+	u32 b;
+
+	if (from >= txt->size || q->len == 0 || q->len > txt->size - from)
+		return -1;
+
+	if (!q->use_index)
+		return search_range(txt, q, from, txt->size, pos);
+
+	hdr = &txt->index->hdr;
+
+	for (b = from / TEXTSEARCH_BLOCK; b < hdr->blocks; ++b) {
+		u32 start, end;
+
+		if (!block_may_match(q, txt->index->bits, b))
+			continue;
+
+		// ֻɨ迪ʼڱƥ, βlen - 1ֽ
+		start = max(from, b * TEXTSEARCH_BLOCK);
+		end = min(txt->size, (b + 1) * TEXTSEARCH_BLOCK + q->len - 1);
+
+		if (search_range(txt, q, start, end, pos) == 0)
+			return 0;
+	}
+
+	return -1;
+}
+
+extern int textsearch_find(p_text txt, const char *pattern, size_t len, u32 from, u32 * pos)
+{
+	t_textsearch_query q;
+
+	if (txt == NULL || txt->buf == NULL || pattern == NULL || pos == NULL)
+		return -1;
+
+	query_init(&q, txt, pattern, len);
+
+	return query_find(txt, &q, from, pos);
+}
+
+extern int textsearch_next_row(p_text txt, const char *pattern, size_t len, u32 * row)
+{
+	u32 from = 0, pos;
+
+	if (txt == NULL || txt->row_count == 0 || row == NULL)
+		return -1;
+
+	if (txt->crow + 1 < txt->row_count)
+		from = txt->rows[(txt->crow + 1) >> 10][(txt->crow + 1) & 0x3FF].start - txt->buf;
+
+	if (textsearch_find(txt, pattern, len, from, &pos) != 0) {
+		if (from == 0 || textsearch_find(txt, pattern, len, 0, &pos) != 0)
+			return -1;
+	}
+
+	*row = textsearch_offset_to_row(txt, pos);
+
+	return 0;
+}
+
+extern u32 textsearch_find_all(p_text txt, const char *pattern, size_t len, u32 * pos, u32 max)
+{
+	t_textsearch_query q;
+	u32 from = 0, found, count = 0;
+	int fid;
+
+	if (txt == NULL || txt->buf == NULL || pattern == NULL || len == 0)
+		return 0;
+
+	fid = freq_enter_hotzone();
+	query_init(&q, txt, pattern, len);
+
+	while (query_find(txt, &q, from, &found) == 0) {
+		if (pos != NULL && count < max)
+			pos[count] = found;
+
+		count++;
+		from = found + len;
+	}
+
+	freq_leave(fid);
+
+	return count;
+}
+
+static void build_bits(p_text txt, u32 * bits, u32 blocks)
+{
+	const u8 *buf = (const u8 *) txt->buf;
+	u32 b;
+
+	for (b = 0; b < blocks; ++b) {
+		u32 *w = bits + b * TEXTSEARCH_WORDS;
+		u32 i = b * TEXTSEARCH_BLOCK;
+		u32 end = min(txt->size, i + TEXTSEARCH_BLOCK + TEXTSEARCH_OVERLAP);
+
+		for (; i + 1 < end; ++i) {
+			u32 h = bigram_bit(buf[i], buf[i + 1]);
+
+			w[h >> 5] |= 1U << (h & 31);
+		}
+	}
+}
+
+static int load_index(p_text txt, struct _t_textsearch_index *idx)
+{
+	char path[PATH_MAX];
+	t_textsearch_header hdr;
+	SceUID fd;
+	u32 size;
+
+	textsearch_index_path(txt->filename, path, sizeof(path));
+	fd = sceIoOpen(path, PSP_O_RDONLY, 0777);
+
+	if (fd < 0)
+		return -1;
+
+	if (sceIoRead(fd, &hdr, sizeof(hdr)) != sizeof(hdr)
+		|| hdr.magic != TEXTSEARCH_MAGIC || hdr.version != TEXTSEARCH_VERSION
+		|| hdr.size != idx->hdr.size || hdr.crc != idx->hdr.crc || hdr.blocks != idx->hdr.blocks || strcmp(hdr.path, txt->filename) != 0) {
+		sceIoClose(fd);
+		return -1;
+	}
+
+	size = hdr.blocks * TEXTSEARCH_WORDS * sizeof(u32);
+
+	if (sceIoRead(fd, idx->bits, size) != size) {
+		sceIoClose(fd);
+		return -1;
+	}
+
+	sceIoClose(fd);
+
+	return 0;
+}
+
+static void save_index(p_text txt, const struct _t_textsearch_index *idx)
+{
+	char path[PATH_MAX];
+	SceUID fd;
+	u32 size = idx->hdr.blocks * TEXTSEARCH_WORDS * sizeof(u32);
+	bool ok;
+
+	snprintf_s(path, sizeof(path), "%stextindex", scene_appdir());
+	sceIoMkdir(path, 0777);
+	textsearch_index_path(txt->filename, path, sizeof(path));
+
+	fd = sceIoOpen(path, PSP_O_WRONLY | PSP_O_CREAT | PSP_O_TRUNC, 0777);
+
+	if (fd < 0)
+		return;
+
+	ok = sceIoWrite(fd, &idx->hdr, sizeof(idx->hdr)) == sizeof(idx->hdr);
+	ok = ok && sceIoWrite(fd, idx->bits, size) == size;
+	sceIoClose(fd);
+
+	if (!ok)
+		sceIoRemove(path);
+}
+
+extern int textsearch_build_index(p_text txt)
+{
+	struct _t_textsearch_index *idx;
+	int fid;
+
+	if (txt == NULL || txt->buf == NULL || txt->size == 0)
+		return -1;
+
+	if (txt->index != NULL)
+		return 0;
+
+	idx = calloc(1, sizeof(*idx));
+
+	if (idx == NULL)
+		return -1;
+
+	idx->hdr.magic = TEXTSEARCH_MAGIC;
+	idx->hdr.version = TEXTSEARCH_VERSION;
+	idx->hdr.size = txt->size;
+	idx->hdr.blocks = (txt->size + TEXTSEARCH_BLOCK - 1) / TEXTSEARCH_BLOCK;
+	STRCPY_S(idx->hdr.path, txt->filename);
+	idx->bits = calloc(idx->hdr.blocks * TEXTSEARCH_WORDS, sizeof(u32));
+
+	if (idx->bits == NULL) {
+		free(idx);
+		return -1;
+	}
+
+	fid = freq_enter_hotzone();
+	idx->hdr.crc = crc32(0, (const Bytef *) txt->buf, txt->size);
+
+	if (load_index(txt, idx) < 0) {
+		memset(idx->bits, 0, idx->hdr.blocks * TEXTSEARCH_WORDS * sizeof(u32));
+		build_bits(txt, idx->bits, idx->hdr.blocks);
+
+		if (txt->size >= TEXTSEARCH_MIN_SIZE)
+			save_index(txt, idx);
+
+		dbg_printf(d, "%s: %u blocks built for %s", __func__, (unsigned) idx->hdr.blocks, txt->filename);
+	}
+
+	freq_leave(fid);
+	txt->index = idx;
+
+	return 0;
+}
+
+extern void textsearch_free(p_text txt)
+{
+	if (txt == NULL || txt->index == NULL)
+		return;
+
+	free(txt->index->bits);
+	free(txt->index);
+	txt->index = NULL;
+}
@@ -0,0 +1,108 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef TEXTSEARCH_H
+#define TEXTSEARCH_H
+
+#include "common/datatype.h"
+#include "text.h"
+
+/** С, ֽڼ */
+#define TEXTSEARCH_BLOCK 4096
+
+/** ÿԪλͼλ */
+#define TEXTSEARCH_BLOCK_BITS 4096
+
+/** Сڴ˴Сı */
+#define TEXTSEARCH_MIN_SIZE (1024 * 1024)
+
+/**
+ * ıвַ
+ *
+ * @note ƥַֻ߽ϳ, ˫ַֽĺһַǰ뵱ƥ
+ * @note ѽʱֻɨܺƥĿ
+ *
+ * @param txt ı
+ * @param pattern Ҫҵַ, txt->bufͬ
+ * @param len ַ
+ * @param from ʼҵֽƫ
+ * @param pos ƥֽƫ
+ *
+ * @return ҵ0, 򷵻-1
+ */
+extern int textsearch_find(p_text txt, const char *pattern, size_t len, u32 from, u32 * pos);
+
+/**
+ * ıвصƥ
+ *
+ * @param txt ı
+ * @param pattern Ҫҵַ
+ * @param len ַ
+ * @param pos ƥֽƫ, ΪNULL
+ * @param max posĴС
+ *
+ * @return ƥ, ܴmax
+ */
+extern u32 textsearch_find_all(p_text txt, const char *pattern, size_t len, u32 * pos, u32 max);
+
+/**
+ * ıĶԪ
+ *
+ * @note ڳĿ¼µtextindex/, ´δͬһıʱֱӶ
+ * @note text_closeͷ
+ *
+ * @param txt ı
+ *
+ * @return ɹ0, ʧܷظ
+ */
+extern int textsearch_build_index(p_text txt);
+
+/**
+ * ͷı
+ *
+ * @param txt ı
+ */
+extern void textsearch_free(p_text txt);
+
+/**
+ * ֽƫƵõк
+ *
+ * @param txt Ѹʽı
+ * @param offset ֽƫ
+ *
+ * @return к
+ */
+extern u32 textsearch_offset_to_row(p_text txt, u32 offset);
+
+/**
+ * һƥ
+ *
+ * @note ӵǰ(txt->crow)һпʼ, ıĩβͷ
+ *
+ * @param txt Ѹʽı
+ * @param pattern Ҫҵַ
+ * @param len ַ
+ * @param row ƥк
+ *
+ * @return ҵ0, 򷵻-1
+ */
+extern int textsearch_next_row(p_text txt, const char *pattern, size_t len, u32 * row);
+
+#endif
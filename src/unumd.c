@@ -68,10 +68,30 @@ enum umd_cover
 	COVER_TYPE_GIF = 2
 };
 
+/* text chunks never inflate to more than 32KB */
+#define UMD_CHUNK_MAX_LEN 0x8000
+#define UMD_CHUNK_STEP 64
+
 static size_t buf_offset = 0;
 static size_t umdfile_offset = 0;
 static size_t umdfile_remain = 0;
 
+static void umd_chunks_free(p_umd_chapter pchap)
+{
+	u_int i;
+
+	for (i = 0; i < UMD_CHUNK_CACHE_SIZE; i++) {
+		if (pchap->chunk_cache[i].data)
+			buffer_free(pchap->chunk_cache[i].data);
+	}
+	memset(pchap->chunk_cache, 0, sizeof(pchap->chunk_cache));
+
+	if (pchap->pchunks)
+		free(pchap->pchunks);
+	pchap->pchunks = NULL;
+	pchap->chunk_count = 0;
+}
+
 p_umd_chapter umd_chapter_init()
 {
 	p_umd_chapter pchap = (p_umd_chapter) calloc(1, sizeof(t_umd_chapter));
@@ -95,6 +115,8 @@ void umd_chapter_reset(p_umd_chapter pchap)
 	if (pchap->umdfile)
 		buffer_free(pchap->umdfile);
 
+	umd_chunks_free(pchap);
+
 	for (i = 0; i < pchap->chapter_count; i++) {
 		if (pchap->pchapters[i].name) {
 			p = pchap->pchapters[i].name;
@@ -118,6 +140,8 @@ void umd_chapter_free(p_umd_chapter pchap)
 	if (pchap->umdfile)
 		buffer_free(pchap->umdfile);
 
+	umd_chunks_free(pchap);
+
 	for (i = 0; i < pchap->chapter_count; i++) {
 		if (pchap->pchapters[i].name)
 			buffer_free(pchap->pchapters[i].name);
@@ -131,7 +155,7 @@ void umd_chapter_free(p_umd_chapter pchap)
 int umd_inflate(Byte * compr, Byte * uncompr, uLong comprLen, uLong uncomprLen)
 {
 	int err;
-	static z_stream d_stream;	/* decompression stream */
+	z_stream d_stream;			/* decompression stream */
 	uLong l;
 
 	d_stream.zalloc = (alloc_func) 0;
@@ -190,6 +214,149 @@ int read_umd_buf(SceUID fd, buffer ** pbuf)
 	return p->used;
 }
 
+static size_t umd_chunk_outlen(size_t zlen)
+{
+	return (zlen * 2 > UMD_CHUNK_MAX_LEN) ? zlen * 2 : UMD_CHUNK_MAX_LEN;
+}
+
+static int umd_add_chunk(p_umd_chapter pchap, size_t file_pos, size_t zlen, size_t content_pos, size_t length)
+{
+	struct t_umd_chunk *pc;
+
+	if (pchap->chunk_count % UMD_CHUNK_STEP == 0) {
+		pc = (struct t_umd_chunk *) realloc(pchap->pchunks, (pchap->chunk_count + UMD_CHUNK_STEP) * sizeof(*pc));
+		if (!pc)
+			return -1;
+		pchap->pchunks = pc;
+	}
+
+	pc = pchap->pchunks + pchap->chunk_count++;
+	pc->file_pos = file_pos;
+	pc->zlen = zlen;
+	pc->content_pos = content_pos;
+	pc->length = length;
+
+	return 0;
+}
+
+static int umd_find_chunk(p_umd_chapter pchap, size_t file_pos)
+{
+	int lo = 0, hi = (int) pchap->chunk_count - 1;
+
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+
+		if (pchap->pchunks[mid].file_pos == file_pos)
+			return mid;
+		if (pchap->pchunks[mid].file_pos < file_pos)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return -1;
+}
+
+/* return the inflated chunk, taking it from the LRU when possible */
+static buffer *umd_load_chunk(p_umd_chapter pchap, const char *umdfile, SceUID * pfd, int index)
+{
+	struct t_umd_chunk_cache *pcache = NULL;
+	struct t_umd_chunk *pc = pchap->pchunks + index;
+	buffer *pzbuf;
+	size_t stoutlen;
+	int i, ret;
+
+	for (i = 0; i < UMD_CHUNK_CACHE_SIZE; i++) {
+		struct t_umd_chunk_cache *pe = &pchap->chunk_cache[i];
+
+		if (pe->data && pe->index == index) {
+			pe->stamp = ++pchap->chunk_stamp;
+			return pe->data;
+		}
+		if (!pcache || !pe->data || (pcache->data && pe->stamp < pcache->stamp))
+			pcache = pe;
+	}
+
+	if (*pfd < 0 && (*pfd = sceIoOpen(umdfile, PSP_O_RDONLY, 0777)) < 0)
+		return NULL;
+	if (sceIoLseek(*pfd, pc->file_pos + sizeof(struct UMDHeaderDataEx), PSP_SEEK_SET) < 0)
+		return NULL;
+
+	pzbuf = buffer_init();
+	if (!pzbuf || buffer_prepare_copy(pzbuf, pc->zlen + 1) < 0) {
+		if (pzbuf)
+			buffer_free(pzbuf);
+		return NULL;
+	}
+	pzbuf->used = pc->zlen;
+	if (0 > read_umd_buf(*pfd, &pzbuf) || pzbuf->used != pc->zlen) {
+		buffer_free(pzbuf);
+		return NULL;
+	}
+
+	if (!pcache->data && !(pcache->data = buffer_init())) {
+		buffer_free(pzbuf);
+		return NULL;
+	}
+	stoutlen = pc->length ? pc->length : umd_chunk_outlen(pc->zlen);
+	if (buffer_prepare_copy(pcache->data, stoutlen) < 0) {
+		buffer_free(pzbuf);
+		return NULL;
+	}
+	ret = umd_inflate((Byte *) pzbuf->ptr, (Byte *) pcache->data->ptr, pc->zlen, stoutlen);
+	buffer_free(pzbuf);
+	if (ret < 0) {
+		buffer_free(pcache->data);
+		pcache->data = NULL;
+		return NULL;
+	}
+
+	pcache->data->used = ret;
+	pcache->index = index;
+	pcache->stamp = ++pchap->chunk_stamp;
+
+	return pcache->data;
+}
+
+/* copy a chapter through the chunk index, inflating only the covering chunks */
+static int read_umd_chapter_indexed(const char *umdfile, struct t_chapter *pchap, p_umd_chapter pchapter, buffer ** pbuf)
+{
+	SceUID fd = -1;
+	size_t offset = pchap->chunk_offset;
+	size_t remain = pchap->length;
+	int index = umd_find_chunk(pchapter, pchap->chunk_pos);
+
+	if (index < 0 || buffer_prepare_copy(*pbuf, remain) < 0)
+		return -1;
+
+	while (remain > 0 && index < (int) pchapter->chunk_count) {
+		buffer *pdata = umd_load_chunk(pchapter, umdfile, &fd, index);
+		size_t stlen;
+
+		if (!pdata || pdata->used < offset)
+			break;
+		stlen = pdata->used - offset;
+		if (stlen > remain)
+			stlen = remain;
+		if (buffer_append_memory(*pbuf, pdata->ptr + offset, stlen) < 0)
+			break;
+		remain -= stlen;
+		offset = 0;
+		index++;
+	}
+
+	if (fd >= 0)
+		sceIoClose(fd);
+
+	// a partial chapter is an error, the caller falls back to the sequential read
+	if (remain > 0) {
+		(*pbuf)->used = 0;
+		return -1;
+	}
+
+	return (int) pchap->length;
+}
+
 int get_chunk_buf(SceUID fd, buffer ** pbuf, char **pchunk, size_t stwant)
 {
 	buffer *p;
@@ -681,6 +848,9 @@ int read_umd_chapter_content(const char *umdfile, u_int index, p_umd_chapter pch
 	chunk_offset = pchap->chunk_offset;
 	length = pchap->length;
 
+	if (pchapter->chunk_count > 0 && (ret = read_umd_chapter_indexed(umdfile, pchap, pchapter, pbuf)) >= 0)
+		return ret;
+
 	do {
 		char *p;
 		struct UMDHeaderDataEx *pEx;
@@ -1042,6 +1212,8 @@ int parse_umd_chapters(const char *umdfile, p_umd_chapter * pchapter)
 				size_t stChapterCount;
 				size_t stcontent_length = 0;
 				bool bok = true;
+				bool blast_chapter = false;
+				bool bindex = true;
 				size_t stoutlen = 0;
 				size_t stUnzipSize = 0;
 
@@ -1078,7 +1250,7 @@ int parse_umd_chapters(const char *umdfile, p_umd_chapter * pchapter)
 				pchap = (*pchapter)->pchapters;
 				pzbuf = buffer_init();
 
-				if (!pzbuf)
+				if (!pzbuf || 1 > stChapterCount)
 					break;
 				while (*p == '$') {
 					bok = false;
@@ -1090,7 +1262,7 @@ int parse_umd_chapters(const char *umdfile, p_umd_chapter * pchapter)
 					}
 					//pchap[i++].pos = umdfile_offset - 9;
 					stlen -= 9;
-					stoutlen = stlen * 2;
+					stoutlen = umd_chunk_outlen(stlen);
 					buffer_prepare_copy(pzbuf, stoutlen);
 					if (0 > get_chunk_buf(fd, &pRaw, &p, stlen))
 						break;
@@ -1099,6 +1271,11 @@ int parse_umd_chapters(const char *umdfile, p_umd_chapter * pchapter)
 						printf("stUnzipSize %d not in limit size:%d", stUnzipSize, stoutlen);
 						break;
 					}
+					// an index with holes is worse than none: drop it and let reads walk the file
+					if (bindex && umd_add_chunk(*pchapter, umdfile_offset - 9 - stlen, stlen, stcontent_length, stUnzipSize) < 0) {
+						umd_chunks_free(*pchapter);
+						bindex = false;
+					}
 					//stcontent_length += stlen;
 					//for(;i < stChapterCount;i++)
 					while (i < stChapterCount && pchap[i].length <= stcontent_length + stUnzipSize) {
@@ -1110,14 +1287,11 @@ int parse_umd_chapters(const char *umdfile, p_umd_chapter * pchapter)
 						++i;
 					}
 					stcontent_length += stUnzipSize;
-					if (i >= stChapterCount) {
+					if (i >= stChapterCount && !blast_chapter) {
+						// keep walking so the chunks of the last chapter get indexed too
 						pchap[stChapterCount - 1].length = (*pchapter)->filesize - pchap[stChapterCount - 1].length;
 						printf("x total %d pos fileoffset:%d\n", i, umdfile_offset);
-						if (pzbuf)
-							buffer_free(pzbuf);
-						buffer_free(pRaw);
-						sceIoClose(fd);
-						return stChapterCount + 1;
+						blast_chapter = true;
 					}
 					if (*(pRaw->ptr + buf_offset) == '#') {
 						bok = true;
@@ -1154,6 +1328,12 @@ int parse_umd_chapters(const char *umdfile, p_umd_chapter * pchapter)
 							break;
 					}
 				}
+				if (blast_chapter) {
+					buffer_free(pzbuf);
+					buffer_free(pRaw);
+					sceIoClose(fd);
+					return stChapterCount + 1;
+				}
 
 			} else {
 				if (0 > get_chunk_buf(fd, &pRaw, &p, pHead->Length - stHeadSize))
@@ -1177,6 +1357,8 @@ int parse_umd_chapters(const char *umdfile, p_umd_chapter * pchapter)
 		}
 
 	} while (false);
+	if (pzbuf)
+		buffer_free(pzbuf);
 	if (pRaw)
 		buffer_free(pRaw);
 	if (fd > 0)
@@ -47,6 +47,23 @@ struct t_chapter
 	buffer *name;
 } __attribute__ ((packed));
 
+struct t_umd_chunk
+{
+	size_t file_pos;
+	size_t zlen;
+	size_t content_pos;
+	size_t length;
+};
+
+#define UMD_CHUNK_CACHE_SIZE 4
+
+struct t_umd_chunk_cache
+{
+	int index;
+	u32 stamp;
+	buffer *data;
+};
+
 struct _t_umd_chapter
 {
 	buffer *umdfile;
@@ -56,6 +73,10 @@ struct _t_umd_chapter
 	size_t filesize;
 	size_t content_pos;
 	struct t_chapter *pchapters;
+	struct t_umd_chunk *pchunks;
+	unsigned int chunk_count;
+	struct t_umd_chunk_cache chunk_cache[UMD_CHUNK_CACHE_SIZE];
+	u32 chunk_stamp;
 	//buffer*           pcontents;
 } __attribute__ ((packed));
 typedef struct _t_umd_chapter t_umd_chapter, *p_umd_chapter;
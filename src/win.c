@@ -41,6 +41,14 @@
 #endif
 
 static volatile int secticks = 0;
+static t_win_menu_idle menu_idle = NULL;
+
+struct _win_menu_arena
+{
+	struct _win_menu_arena *next;
+	size_t used;
+	char data[MENU_ARENA_SIZE];
+};
 
 extern t_win_menu_op win_menu_defcb(u32 key, p_win_menuitem item, u32 * count, u32 max_height, u32 * topindex, u32 * index)
 {
@@ -91,6 +99,36 @@ static void win_menu_delay_action(void)
 		scePowerTick(0);
 }
 
+extern void win_menu_set_idle(t_win_menu_idle idle)
+{
+	menu_idle = idle;
+}
+
+static u32 win_menu_wait_key(u64 * timer_start, t_win_menu_idle idle, p_win_menuitem * item, u32 * count, u32 max_height, u32 * topindex, u32 * index)
+{
+	u32 key;
+	u64 timer_end;
+
+	while ((key = ctrl_read()) == 0) {
+		sceRtcGetCurrentTick(&timer_end);
+		if (pspDiffTime(&timer_end, timer_start) >= 1.0) {
+			sceRtcGetCurrentTick(timer_start);
+			secticks++;
+		}
+		if (config.autosleep != 0 && secticks > 60 * config.autosleep) {
+			power_down();
+			scePowerRequestSuspend();
+			secticks = 0;
+		}
+		if (idle != NULL && idle(item, count, max_height, topindex, index))
+			return 0;
+		sceKernelDelayThread(20000);
+		win_menu_delay_action();
+	}
+
+	return key;
+}
+
 extern u32 win_menu(u32 x, u32 y, u32 max_width, u32 max_height,
 					p_win_menuitem item, u32 count, u32 initindex,
 					u32 linespace, pixel bgcolor, bool redraw, t_win_menu_draw predraw, t_win_menu_draw postdraw, t_win_menu_callback cb)
@@ -99,8 +137,10 @@ extern u32 win_menu(u32 x, u32 y, u32 max_width, u32 max_height,
 	bool needrp = true;
 	bool firstdup = true;
 	pixel *saveimage = NULL;
-	u64 timer_start, timer_end;
+	u64 timer_start;
+	t_win_menu_idle idle = menu_idle;
 
+	menu_idle = NULL;
 	secticks = 0;
 
 	if (cb == NULL)
@@ -183,39 +223,19 @@ extern u32 win_menu(u32 x, u32 y, u32 max_width, u32 max_height,
 
 		lastsel = index;
 
-		while ((key = ctrl_read()) == 0) {
-			sceRtcGetCurrentTick(&timer_end);
-			if (pspDiffTime(&timer_end, &timer_start) >= 1.0) {
-				sceRtcGetCurrentTick(&timer_start);
-				secticks++;
-			}
-			if (config.autosleep != 0 && secticks > 60 * config.autosleep) {
-				power_down();
-				scePowerRequestSuspend();
-				secticks = 0;
-			}
-			sceKernelDelayThread(20000);
-			win_menu_delay_action();
-		}
+		key = win_menu_wait_key(&timer_start, idle, &item, &count, max_height, &topindex, &index);
 		if (key != 0) {
 			secticks = 0;
-		}
-		while ((op = cb(key, item, &count, max_height, &topindex, &index)) == win_menu_op_continue) {
-			while ((key = ctrl_read()) == 0) {
-				sceRtcGetCurrentTick(&timer_end);
-				if (pspDiffTime(&timer_end, &timer_start) >= 1.0) {
-					sceRtcGetCurrentTick(&timer_start);
-					secticks++;
-				}
-				if (config.autosleep != 0 && secticks > 60 * config.autosleep) {
-					power_down();
-					scePowerRequestSuspend();
-					secticks = 0;
-				}
-				sceKernelDelayThread(20000);
-				win_menu_delay_action();
+			while ((op = cb(key, item, &count, max_height, &topindex, &index)) == win_menu_op_continue) {
+				if ((key = win_menu_wait_key(&timer_start, idle, &item, &count, max_height, &topindex, &index)) == 0)
+					break;
 			}
 		}
+		if (key == 0) {
+			// items changed by idle callback
+			op = win_menu_op_force_redraw;
+			botindex = (topindex + max_height > count) ? (count - 1) : (topindex + max_height - 1);
+		}
 		switch (op) {
 			case win_menu_op_ok:
 				if (saveimage) {
@@ -436,10 +456,79 @@ p_win_menu win_menu_new(void)
 
 	menu->root = NULL;
 	menu->size = menu->cap = 0;
+	menu->arena = NULL;
 
 	return menu;
 }
 
+buffer *win_menu_strdup(p_win_menu menu, const char *str, size_t len)
+{
+	struct _win_menu_arena *arena = menu->arena;
+	size_t size = (sizeof(buffer) + len + 1 + 3) & ~3;
+	buffer *b;
+
+	if (size > MENU_ARENA_SIZE)
+		return NULL;
+
+	if (arena == NULL || arena->used + size > MENU_ARENA_SIZE) {
+		arena = malloc(sizeof(*arena));
+
+		if (arena == NULL)
+			return NULL;
+
+		arena->next = menu->arena;
+		arena->used = 0;
+		menu->arena = arena;
+	}
+
+	b = (buffer *) & arena->data[arena->used];
+	arena->used += size;
+	b->ptr = (char *) (b + 1);
+	memcpy(b->ptr, str, len);
+	b->ptr[len] = '\0';
+	b->used = b->size = len + 1;
+
+	return b;
+}
+
+int win_menu_item_new(p_win_menu menu, p_win_menuitem p, const char *compname, const char *shortname)
+{
+	if (shortname == NULL)
+		shortname = "";
+
+	memset(p, 0, sizeof(*p));
+	p->compname = win_menu_strdup(menu, compname, strlen(compname));
+	p->shortname = win_menu_strdup(menu, shortname, strlen(shortname));
+
+	if (p->compname == NULL || p->shortname == NULL)
+		return -1;
+
+	p->arena = true;
+
+	return 0;
+}
+
+int win_menu_reserve(p_win_menu menu, u32 count)
+{
+	p_win_menuitem newmenu;
+
+	if (menu == NULL)
+		return -1;
+
+	if (count <= menu->cap)
+		return 0;
+
+	newmenu = realloc(menu->root, count * sizeof(menu->root[0]));
+
+	if (newmenu == NULL)
+		return -1;
+
+	menu->root = newmenu;
+	menu->cap = count;
+
+	return 0;
+}
+
 int win_menu_add(p_win_menu menu, p_win_menuitem item)
 {
 	if (menu == NULL || item == NULL) {
@@ -447,16 +536,10 @@ int win_menu_add(p_win_menu menu, p_win_menuitem item)
 	}
 
 	if (menu->size >= menu->cap) {
-		p_win_menuitem newmenu;
-
-		newmenu = realloc(menu->root, (MENU_REALLOC_INCR + menu->cap) * sizeof(menu->root[0]));
-
-		if (newmenu == NULL) {
+		// Grow geometrically so big listings don't copy the array over and over
+		if (win_menu_reserve(menu, max(menu->cap * 2, MENU_REALLOC_INCR)) < 0) {
 			return -1;
 		}
-
-		menu->root = newmenu;
-		menu->cap += MENU_REALLOC_INCR;
 	}
 
 	menu->root[menu->size] = *item;
@@ -481,6 +564,9 @@ int win_menu_add_copy(p_win_menu menu, p_win_menuitem item)
 
 void win_menuitem_destory(p_win_menuitem item)
 {
+	if (item->arena)
+		return;
+
 	buffer_free(item->compname);
 	buffer_free(item->shortname);
 }
@@ -493,6 +579,13 @@ void win_menu_destroy(p_win_menu menu)
 		win_menuitem_destory(&menu->root[i]);
 	}
 
+	while (menu->arena != NULL) {
+		struct _win_menu_arena *next = menu->arena->next;
+
+		free(menu->arena);
+		menu->arena = next;
+	}
+
 	free(menu->root);
 	free(menu);
 }
@@ -40,18 +40,23 @@ typedef struct
 	void *data;					// custom data for user processing
 	u16 data2[4];
 	u32 data3;
+	bool arena;					// compname/shortname allocated from menu arena
 } t_win_menuitem, *p_win_menuitem;
 
 enum
 {
 	MENU_REALLOC_INCR = 64,
+	MENU_ARENA_SIZE = 16 * 1024,
 };
 
+struct _win_menu_arena;
+
 typedef struct _t_win_menu
 {
 	p_win_menuitem root;
 	u32 size;
 	u32 cap;
+	struct _win_menu_arena *arena;
 } t_win_menu, *p_win_menu;
 
 typedef struct _win_menu_predraw_data
@@ -75,6 +80,9 @@ typedef enum
 typedef t_win_menu_op(*t_win_menu_callback) (u32 key, p_win_menuitem item, u32 * count, u32 page_count, u32 * topindex, u32 * index);
 typedef void (*t_win_menu_draw) (p_win_menuitem item, u32 index, u32 topindex, u32 max_height);
 
+// Idle callback while waiting for input, return true if item or count changed
+typedef bool(*t_win_menu_idle) (p_win_menuitem * item, u32 * count, u32 max_height, u32 * topindex, u32 * index);
+
 // Default callback for menu
 extern t_win_menu_op win_menu_defcb(u32 key, p_win_menuitem item, u32 * count, u32 page_count, u32 * topindex, u32 * index);
 
@@ -83,6 +91,9 @@ extern u32 win_menu(u32 x, u32 y, u32 max_width, u32 max_height,
 					p_win_menuitem item, u32 count, u32 initindex,
 					u32 linespace, pixel bgcolor, bool redraw, t_win_menu_draw predraw, t_win_menu_draw postdraw, t_win_menu_callback cb);
 
+// Set idle callback for the next win_menu call only
+extern void win_menu_set_idle(t_win_menu_idle idle);
+
 // Messagebox with yes/no
 extern bool win_msgbox(const char *prompt, const char *yesstr, const char *nostr, pixel fontcolor, pixel bordercolor, pixel bgcolor);
 
@@ -101,6 +112,11 @@ int win_menu_add(p_win_menu menu, p_win_menuitem item);
 int win_menu_add_copy(p_win_menu menu, p_win_menuitem item);
 void win_menuitem_destory(p_win_menuitem menu);
 void win_menu_destroy(p_win_menu menu);
+buffer *win_menu_strdup(p_win_menu menu, const char *str, size_t len);
+// Init item with compname/shortname copied into the menu arena, freed with the menu
+int win_menu_item_new(p_win_menu menu, p_win_menuitem p, const char *compname, const char *shortname);
+// Make room for count items in total
+int win_menu_reserve(p_win_menu menu, u32 count);
 void win_menuitem_new(p_win_menuitem p);
 void win_menuitem_free(p_win_menuitem p);
 
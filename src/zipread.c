@@ -0,0 +1,375 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <malloc.h>
+#include <pspkernel.h>
+#include <zlib.h>
+#include "common/utils.h"
+#include "thread_lock.h"
+#include "zipread.h"
+#include "dbg.h"
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+#define ZIP_LOCAL_SIG 0x04034b50
+#define ZIP_CENTRAL_SIG 0x02014b50
+#define ZIP_END_SIG 0x06054b50
+
+#define ZIP_LOCAL_SIZE 30
+#define ZIP_CENTRAL_SIZE 46
+#define ZIP_END_SIZE 22
+#define ZIP_COMMENT_MAX 0xffff
+
+static struct psp_mutex_t zipread_l;
+static char cd_path[PATH_MAX];
+static SceOff cd_filesize = 0;
+static ScePspDateTime cd_mtime;
+static u8 *cd_data = NULL;
+static u32 cd_size = 0;
+static u32 cd_count = 0;
+
+/** Ŀ¼ɢ, ÿ۱Ŀ¼cd_dataеλ+1, 0Ϊղ */
+static u32 *cd_hash = NULL;
+static u32 cd_hash_mask = 0;
+
+static inline u16 get_le16(const u8 * p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline u32 get_le32(const u8 * p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+static int read_at(SceUID fd, SceOff pos, void *buf, u32 size)
+{
+	if (sceIoLseek(fd, pos, PSP_SEEK_SET) != pos)
+		return -1;
+
+	return sceIoRead(fd, buf, size) == size ? 0 : -1;
+}
+
+static void free_cd(void)
+{
+	free(cd_data);
+	cd_data = NULL;
+	free(cd_hash);
+	cd_hash = NULL;
+	cd_hash_mask = 0;
+	cd_size = cd_count = 0;
+	cd_path[0] = '\0';
+}
+
+/**
+ * ִСдFNV-1aɢ, unzLocateFileıȽϷʽһ
+ */
+static u32 name_hash(const char *name, size_t len)
+{
+	u32 h = 2166136261U;
+
+	while (len-- > 0) {
+		h ^= (u8) tolower((u8) * name++);
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+/**
+ * ΪĿ¼ɢ
+ *
+ * @note Ŀ¼ʱֻ֮ǰĿ¼, ļĲһʧܲminizip
+ */
+static int build_cd_hash(void)
+{
+	u32 pos = 0, n, slots = 16;
+
+	while (slots < cd_count * 2)
+		slots <<= 1;
+
+	cd_hash = calloc(slots, sizeof(*cd_hash));
+
+	if (cd_hash == NULL)
+		return -1;
+
+	cd_hash_mask = slots - 1;
+
+	for (n = 0; n < cd_count && pos + ZIP_CENTRAL_SIZE <= cd_size; ++n) {
+		const u8 *p = cd_data + pos;
+		u16 nlen;
+		u32 i;
+
+		if (get_le32(p) != ZIP_CENTRAL_SIG)
+			break;
+
+		nlen = get_le16(p + 28);
+
+		if (pos + ZIP_CENTRAL_SIZE + nlen > cd_size)
+			break;
+
+		i = name_hash((const char *) p + ZIP_CENTRAL_SIZE, nlen) & cd_hash_mask;
+
+		while (cd_hash[i] != 0)
+			i = (i + 1) & cd_hash_mask;
+
+		cd_hash[i] = pos + 1;
+		pos += ZIP_CENTRAL_SIZE + nlen + get_le16(p + 30) + get_le16(p + 32);
+	}
+
+	return 0;
+}
+
+/**
+ * ZIPĿ¼
+ */
+static int load_cd(const char *zipfile, SceIoStat * sta)
+{
+	SceUID fd;
+	u8 *tail;
+	u32 tail_size, cd_pos;
+	int i;
+
+	free_cd();
+
+	if (sta->st_size < ZIP_END_SIZE)
+		return -1;
+
+	fd = sceIoOpen(zipfile, PSP_O_RDONLY, 0777);
+
+	if (fd < 0)
+		return -1;
+
+	tail_size = min(sta->st_size, ZIP_END_SIZE + ZIP_COMMENT_MAX);
+	tail = malloc(tail_size);
+
+	if (tail == NULL || read_at(fd, sta->st_size - tail_size, tail, tail_size) < 0) {
+		free(tail);
+		sceIoClose(fd);
+		return -1;
+	}
+
+	for (i = tail_size - ZIP_END_SIZE; i >= 0; --i) {
+		if (get_le32(tail + i) == ZIP_END_SIG)
+			break;
+	}
+
+	if (i < 0) {
+		free(tail);
+		sceIoClose(fd);
+		return -1;
+	}
+
+	cd_count = get_le16(tail + i + 10);
+	cd_size = get_le32(tail + i + 12);
+	cd_pos = get_le32(tail + i + 16);
+	free(tail);
+
+	// ZIP64𻵵ĵminizip
+	if (cd_pos == 0xffffffff || cd_size == 0xffffffff || (SceOff) cd_pos + cd_size > sta->st_size) {
+		cd_size = cd_count = 0;
+		sceIoClose(fd);
+		return -1;
+	}
+
+	cd_data = malloc(cd_size);
+
+	if (cd_data == NULL || read_at(fd, cd_pos, cd_data, cd_size) < 0) {
+		free_cd();
+		sceIoClose(fd);
+		return -1;
+	}
+
+	sceIoClose(fd);
+
+	if (build_cd_hash() < 0) {
+		free_cd();
+		return -1;
+	}
+
+	STRCPY_S(cd_path, zipfile);
+	cd_filesize = sta->st_size;
+	cd_mtime = sta->st_mtime;
+
+	return 0;
+}
+
+static int find_in_cd(const char *filename, p_zip_entry entry)
+{
+	size_t namelen = strlen(filename);
+	u32 i = name_hash(filename, namelen) & cd_hash_mask;
+
+	// build_cd_hashֻ¼Ŀ¼, ﲻټ߽
+	for (; cd_hash[i] != 0; i = (i + 1) & cd_hash_mask) {
+		const u8 *p = cd_data + cd_hash[i] - 1;
+		u16 nlen = get_le16(p + 28);
+
+		// unzLocateFileĬΪһ, ִСд
+		if (nlen == namelen && strnicmp((const char *) p + ZIP_CENTRAL_SIZE, filename, namelen) == 0) {
+			entry->flag = get_le16(p + 8);
+			entry->method = get_le16(p + 10);
+			entry->crc = get_le32(p + 16);
+			entry->csize = get_le32(p + 20);
+			entry->usize = get_le32(p + 24);
+			entry->header_pos = get_le32(p + 42);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int zipread_locate(const char *zipfile, const char *filename, p_zip_entry entry)
+{
+	SceIoStat sta;
+	int ret;
+
+	if (zipfile == NULL || filename == NULL || entry == NULL)
+		return -1;
+
+	memset(&sta, 0, sizeof(sta));
+
+	if (sceIoGetstat(zipfile, &sta) < 0)
+		return -1;
+
+	xr_lock(&zipread_l);
+
+	if (cd_data == NULL || strcmp(cd_path, zipfile) != 0 || cd_filesize != sta.st_size || memcmp(&cd_mtime, &sta.st_mtime, sizeof(cd_mtime)) != 0) {
+		if (load_cd(zipfile, &sta) < 0) {
+			xr_unlock(&zipread_l);
+			return -2;
+		}
+	}
+
+	ret = find_in_cd(filename, entry);
+	xr_unlock(&zipread_l);
+
+	if (ret < 0)
+		return -1;
+
+	if ((entry->flag & 1) || (entry->method != 0 && entry->method != Z_DEFLATED))
+		return -2;
+
+	if (entry->method == 0 && entry->csize != entry->usize)
+		return -2;
+
+	return 0;
+}
+
+static int inflate_entry(SceUID fd, const t_zip_entry * entry, void *dest)
+{
+	z_stream z;
+	u8 *inbuf;
+	u32 remain = entry->csize;
+	int err = Z_OK;
+
+	inbuf = memalign(64, ZIPREAD_BLOCK_SIZE);
+
+	if (inbuf == NULL)
+		return -1;
+
+	memset(&z, 0, sizeof(z));
+
+	if (inflateInit2(&z, -MAX_WBITS) != Z_OK) {
+		free(inbuf);
+		return -1;
+	}
+
+	z.next_out = dest;
+	z.avail_out = entry->usize;
+
+	while (err == Z_OK && remain > 0) {
+		u32 size = min(remain, ZIPREAD_BLOCK_SIZE);
+
+		if (sceIoRead(fd, inbuf, size) != size)
+			break;
+
+		remain -= size;
+		z.next_in = inbuf;
+		z.avail_in = size;
+
+		do {
+			err = inflate(&z, Z_NO_FLUSH);
+		} while (err == Z_OK && z.avail_in > 0 && z.avail_out > 0);
+	}
+
+	inflateEnd(&z);
+	free(inbuf);
+
+	if (err != Z_STREAM_END && !(err == Z_OK && z.avail_out == 0))
+		return -1;
+
+	return z.total_out;
+}
+
+int zipread_extract(const char *zipfile, const t_zip_entry * entry, void *dest)
+{
+	u8 local[ZIP_LOCAL_SIZE];
+	SceUID fd;
+	SceOff data_pos;
+	int ret;
+
+	if (zipfile == NULL || entry == NULL || dest == NULL)
+		return -1;
+
+	fd = sceIoOpen(zipfile, PSP_O_RDONLY, 0777);
+
+	if (fd < 0)
+		return -1;
+
+	if (read_at(fd, entry->header_pos, local, sizeof(local)) < 0 || get_le32(local) != ZIP_LOCAL_SIG) {
+		sceIoClose(fd);
+		return -1;
+	}
+
+	data_pos = (SceOff) entry->header_pos + ZIP_LOCAL_SIZE + get_le16(local + 26) + get_le16(local + 28);
+
+	if (sceIoLseek(fd, data_pos, PSP_SEEK_SET) != data_pos) {
+		sceIoClose(fd);
+		return -1;
+	}
+
+	if (entry->method == 0) {
+		ret = sceIoRead(fd, dest, entry->usize);
+	} else {
+		ret = inflate_entry(fd, entry, dest);
+	}
+
+	sceIoClose(fd);
+
+	if (ret != entry->usize || crc32(0, dest, entry->usize) != entry->crc) {
+		dbg_printf(d, "%s: bad data in %s", __func__, zipfile);
+		return -1;
+	}
+
+	return ret;
+}
+
+void zipread_free(void)
+{
+	xr_lock(&zipread_l);
+	free_cd();
+	xr_unlock(&zipread_l);
+}
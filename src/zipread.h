@@ -0,0 +1,72 @@
+/*
+ * This file is part of xReader.
+ *
+ * Copyright (C) 2008 hrimfaxi (outmatch@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef ZIPREAD_H
+#define ZIPREAD_H
+
+#include "common/datatype.h"
+
+/** ӼȡѹݵĿС */
+#define ZIPREAD_BLOCK_SIZE (64 * 1024)
+
+typedef struct
+{
+	u16 flag;
+	u16 method;
+	u32 crc;
+	u32 csize;
+	u32 usize;
+	u32 header_pos;
+} t_zip_entry, *p_zip_entry;
+
+/**
+ * ZIPвļ
+ *
+ * @note һδ򿪵ĵĿ¼ᱻ沢ɢ
+ *
+ * @param zipfile ZIP·
+ * @param filename ļ·
+ * @param entry صļϢ
+ *
+ * @return ɹ0
+ * - -1 Ҳļ, Ŀ¼ʱҲ, Ӧminizip
+ * - -2 ֵܻ֧ѹʽ, Ӧminizip
+ */
+int zipread_locate(const char *zipfile, const char *filename, p_zip_entry entry);
+
+/**
+ * ļֱӽѹĿ껺
+ *
+ * @note 洢(method 0)ֱӶȡ, deflate(method 8)ֱӽѹdest
+ *
+ * @param zipfile ZIP·
+ * @param entry zipread_locateصļϢ
+ * @param dest Ŀ껺, ССentry->usize
+ *
+ * @return ɹentry->usize, ʧܷظ
+ */
+int zipread_extract(const char *zipfile, const t_zip_entry * entry, void *dest);
+
+/**
+ * ͷĿ¼
+ */
+void zipread_free(void);
+
+#endif
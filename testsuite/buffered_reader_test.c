@@ -0,0 +1,131 @@
+#include <pspdebug.h>
+#include <pspkernel.h>
+#include <psprtc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "common/datatype.h"
+#include "dbg.h"
+#include "freq_lock.h"
+#include "audiocore/buffered_reader.h"
+
+#define TEST_FILE "ms0:/xTest.dat"
+#define TEST_FILE_SIZE (4 * 1024 * 1024 + 123)
+#define TEST_READS 2000
+#define TEST_MAX_READ (128 * 1024)
+
+static u8 *expected;
+
+static int make_test_file(void)
+{
+	SceUID fd;
+	int i;
+
+	expected = malloc(TEST_FILE_SIZE);
+
+	if (expected == NULL)
+		return -1;
+
+	for (i = 0; i < TEST_FILE_SIZE; ++i) {
+		expected[i] = rand();
+	}
+
+	fd = sceIoOpen(TEST_FILE, PSP_O_WRONLY | PSP_O_CREAT | PSP_O_TRUNC, 0777);
+
+	if (fd < 0)
+		return -1;
+
+	sceIoWrite(fd, expected, TEST_FILE_SIZE);
+	sceIoClose(fd);
+
+	return 0;
+}
+
+/* sequential reads like playback, then seeks like FF/REW and decoders stepping back */
+static int run_one(int seek_mode, int nblocks, u8 * buf)
+{
+	buffered_reader_t *r;
+	buffered_reader_stats_t st;
+	int pos = 0, i, errors = 0;
+	u64 start, now;
+
+	r = buffered_reader_open_ex(TEST_FILE, BUFFERED_READER_BUFFER_SIZE, seek_mode, nblocks);
+
+	if (r == NULL) {
+		dbg_printf(d, "buffered_reader_open_ex failed");
+		return -1;
+	}
+
+	sceRtcGetCurrentTick(&start);
+
+	while (pos < TEST_FILE_SIZE / 2) {
+		int n = 417 + rand() % 4096;
+		int got = buffered_reader_read(r, buf, n);
+
+		if (got != n || memcmp(buf, expected + pos, got) != 0)
+			errors++;
+
+		pos += n;
+	}
+
+	for (i = 0; i < TEST_READS; ++i) {
+		int n = rand() % TEST_MAX_READ, got, want;
+
+		if (i % 3 == 0)
+			pos = rand() % TEST_FILE_SIZE;
+		else if (i % 3 == 1)
+			pos = max(pos - rand() % 2048, 0);
+
+		buffered_reader_seek(r, pos);
+		got = buffered_reader_read(r, buf, n);
+		want = min(n, TEST_FILE_SIZE - pos);
+
+		if (got != want || memcmp(buf, expected + pos, got) != 0)
+			errors++;
+
+		pos += got;
+	}
+
+	sceRtcGetCurrentTick(&now);
+	buffered_reader_get_stats(r, &st);
+	buffered_reader_close(r);
+
+	dbg_printf(d, "Benchmark: seek mode %d, %d blocks: %.3fs, %u hits, %u misses, %u reads, %u ms waited, %d errors",
+			   seek_mode, nblocks, pspDiffTime(&now, &start), (unsigned) st.hits, (unsigned) st.misses, (unsigned) st.reads, (unsigned) (st.wait_us / 1000), errors);
+
+	return errors ? -1 : 0;
+}
+
+int buffered_reader_test(void)
+{
+	u8 *buf;
+	int fid, mode, nblocks, ret = -1;
+
+	dbg_printf(d, "Start buffered reader test");
+
+	fid = freq_enter_hotzone();
+	buf = malloc(TEST_MAX_READ);
+
+	if (buf != NULL && make_test_file() == 0) {
+		ret = 0;
+
+		for (mode = 0; mode <= 1; ++mode) {
+			for (nblocks = 2; nblocks <= 8; nblocks *= 2) {
+				if (run_one(mode, nblocks, buf) != 0)
+					ret = -1;
+			}
+		}
+	}
+
+	sceIoRemove(TEST_FILE);
+	free(expected);
+	expected = NULL;
+	free(buf);
+	freq_leave(fid);
+
+	dbg_printf(d, "Buffered reader test %s", ret == 0 ? "passed" : "FAILED");
+
+	return ret;
+}
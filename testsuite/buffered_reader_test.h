@@ -0,0 +1,6 @@
+#ifndef BUFFERED_READER_TEST_H
+#define BUFFERED_READER_TEST_H
+
+int buffered_reader_test(void);
+
+#endif
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pspkernel.h>
+#include "audiocore/buffered_reader.h"
+#include "psp_shim.h"
+
+#define TEST_FILE "buffered_reader_test.dat"
+#define TEST_FILE_SIZE (3 * 1024 * 1024 + 123)
+#define TEST_READS 3000
+#define TEST_MAX_READ (128 * 1024)
+/* consumption modelled by the test, 16 bit stereo at 44.1kHz */
+#define TEST_RATE (44100 * 4)
+
+static u8 *expected;
+static u8 *buf;
+static int failures;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+		printf(__VA_ARGS__); \
+		putchar('\n'); \
+		failures++; \
+	} \
+} while (0)
+
+static int make_test_file(void)
+{
+	FILE *fp;
+	int i;
+
+	expected = malloc(TEST_FILE_SIZE);
+
+	if (expected == NULL)
+		return -1;
+
+	for (i = 0; i < TEST_FILE_SIZE; ++i) {
+		expected[i] = rand();
+	}
+
+	fp = fopen(TEST_FILE, "wb");
+
+	if (fp == NULL)
+		return -1;
+
+	fwrite(expected, 1, TEST_FILE_SIZE, fp);
+	fclose(fp);
+
+	return 0;
+}
+
+static int expect_read(buffered_reader_t * r, int pos, int n)
+{
+	int want = n, got;
+
+	if (pos + want > TEST_FILE_SIZE)
+		want = TEST_FILE_SIZE - pos;
+
+	got = buffered_reader_read(r, buf, n);
+
+	if (got != want || memcmp(buf, expected + pos, got) != 0)
+		return -1;
+
+	return got;
+}
+
+/* sequential reads like playback, then seeks like FF/REW and decoders stepping back */
+static void test_data(int seek_mode, int nblocks)
+{
+	buffered_reader_t *r;
+	int pos = 0, i, got;
+
+	r = buffered_reader_open_ex(TEST_FILE, BUFFERED_READER_BUFFER_SIZE, seek_mode, nblocks);
+	CHECK(r != NULL, "open failed");
+
+	if (r == NULL)
+		return;
+
+	CHECK(buffered_reader_length(r) == TEST_FILE_SIZE, "length %d", buffered_reader_length(r));
+
+	while (pos < TEST_FILE_SIZE / 2) {
+		int n = 417 + rand() % 4096;
+
+		got = expect_read(r, pos, n);
+		CHECK(got == n, "mode %d, %d blocks: sequential read at %d", seek_mode, nblocks, pos);
+
+		if (got != n)
+			break;
+
+		pos += n;
+		shim_advance(n * 1000000LL / TEST_RATE);
+	}
+
+	for (i = 0; i < TEST_READS; ++i) {
+		int n = rand() % TEST_MAX_READ;
+
+		if (i % 3 == 0)
+			pos = rand() % (TEST_FILE_SIZE + 10);
+		else if (i % 3 == 1)
+			pos = pos > 2048 ? pos - rand() % 2048 : 0;
+
+		buffered_reader_seek(r, pos);
+
+		if (pos > TEST_FILE_SIZE)
+			pos = TEST_FILE_SIZE;
+
+		CHECK(buffered_reader_position(r) == pos, "position %d, expected %d", buffered_reader_position(r), pos);
+		got = expect_read(r, pos, n);
+		CHECK(got >= 0, "mode %d, %d blocks: read of %d at %d", seek_mode, nblocks, n, pos);
+
+		if (got < 0)
+			break;
+
+		pos += got;
+	}
+
+	buffered_reader_enable_cache(r, 0);
+	buffered_reader_seek(r, 1000);
+	CHECK(expect_read(r, 1000, 100) == 100, "uncached read");
+	buffered_reader_enable_cache(r, 1);
+	CHECK(expect_read(r, 1100, 100) == 100, "read after enabling the cache");
+
+	buffered_reader_close(r);
+	CHECK(shim_calls.errors == 0, "%u calls refused by the PSP", shim_calls.errors);
+}
+
+/* small sequential reads at the playback rate must neither stall nor hit a syscall per call */
+static void test_streaming(void)
+{
+	buffered_reader_t *r;
+	buffered_reader_stats_t st;
+	uint64_t head_wait;
+	int pos = 0, calls = 0, n = 64;
+	unsigned syscalls;
+
+	r = buffered_reader_open(TEST_FILE, BUFFERED_READER_BUFFER_SIZE, 0);
+	CHECK(r != NULL, "open failed");
+
+	if (r == NULL)
+		return;
+
+	// the head of the file is waited for once
+	CHECK(expect_read(r, pos, n) == n, "first read");
+	pos += n;
+	buffered_reader_get_stats(r, &st);
+	head_wait = st.wait_us;
+	shim_reset_counters();
+
+	while (pos + n <= TEST_FILE_SIZE / 2) {
+		if (expect_read(r, pos, n) != n) {
+			CHECK(0, "streaming read at %d", pos);
+			break;
+		}
+
+		pos += n;
+		calls++;
+		shim_advance(n * 1000000LL / TEST_RATE);
+	}
+
+	buffered_reader_get_stats(r, &st);
+	syscalls = shim_calls.polls + shim_calls.waits + shim_calls.clock_reads;
+
+	CHECK(st.wait_us == head_wait, "stalled for %llu us while streaming", (unsigned long long) (st.wait_us - head_wait));
+	CHECK(st.misses == 0, "%u misses while streaming", (unsigned) st.misses);
+	CHECK(syscalls * 32 < calls, "%u polls, %u waits, %u clock reads for %d reads", shim_calls.polls, shim_calls.waits, shim_calls.clock_reads, calls);
+	CHECK(st.rate > TEST_RATE * 9 / 10 && st.rate < TEST_RATE * 11 / 10, "rate %u, expected %u", (unsigned) st.rate, TEST_RATE);
+	CHECK(st.latency_us >= shim_latency_us, "latency %u us, below the injected %lld us", (unsigned) st.latency_us, (long long) shim_latency_us);
+
+	buffered_reader_close(r);
+	CHECK(shim_calls.errors == 0, "%u calls refused by the PSP", shim_calls.errors);
+}
+
+int main(void)
+{
+	int mode, nblocks;
+
+	buf = malloc(TEST_MAX_READ);
+
+	if (buf == NULL || make_test_file() != 0) {
+		printf("FAIL: cannot create %s\n", TEST_FILE);
+		return 1;
+	}
+
+	for (mode = 0; mode <= 1; ++mode) {
+		for (nblocks = 2; nblocks <= 8; nblocks *= 2) {
+			test_data(mode, nblocks);
+		}
+	}
+
+	test_streaming();
+
+	// a slow card: reads take longer than a block lasts at the playback rate
+	shim_latency_us = 200000;
+	test_data(0, 3);
+	test_data(1, 3);
+
+	remove(TEST_FILE);
+	free(expected);
+	free(buf);
+
+	printf("buffered_reader_test: %d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "depdb.h"
+
+#define TEST_FILE "depdb_test.pdb"
+#define RECORDS 6
+#define TEXT_SIZE ((RECORDS - 1) * RECORD_SIZE_MAX + 1000)
+
+static char text[TEXT_SIZE];
+static int failures;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+		printf(__VA_ARGS__); \
+		putchar('\n'); \
+		failures++; \
+	} \
+} while (0)
+
+static void put_be16(u8 * p, u32 v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static void put_be32(u8 * p, u32 v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+/* lower case words and newlines: every byte is a PalmDOC literal, so compressed records hold the text as is */
+static void make_text(void)
+{
+	u32 i;
+
+	srand(49);
+
+	for (i = 0; i < TEXT_SIZE; i++)
+		text[i] = rand() % 8 == 0 ? (rand() % 4 == 0 ? '\n' : ' ') : 'a' + rand() % 26;
+}
+
+/* a PalmDOC whose record 0 claims doc_size bytes of text */
+static void write_pdb(int version, u32 doc_size)
+{
+	u8 hdr[PDB_HEADER_SIZE], table[(RECORDS + 1) * PDB_RECORD_HEADER_SIZE], rec0[sizeof(doc_record0)];
+	u32 i, offset = sizeof(hdr) + sizeof(table);
+	FILE *fp;
+
+	memset(hdr, 0, sizeof(hdr));
+	strcpy((char *) hdr, "depdb test");
+	memcpy(hdr + 60, DOC_TYPE, 4);
+	memcpy(hdr + 64, DOC_CREATOR, 4);
+	put_be16(hdr + 76, RECORDS + 1);
+
+	memset(table, 0, sizeof(table));
+	put_be32(table, offset);
+	offset += sizeof(rec0);
+
+	for (i = 0; i < RECORDS; i++) {
+		put_be32(table + (i + 1) * PDB_RECORD_HEADER_SIZE, offset);
+		offset += i + 1 < RECORDS ? RECORD_SIZE_MAX : TEXT_SIZE - i * RECORD_SIZE_MAX;
+	}
+
+	memset(rec0, 0, sizeof(rec0));
+	put_be16(rec0, version);
+	put_be32(rec0 + 4, doc_size);
+	put_be16(rec0 + 8, RECORDS);
+	put_be16(rec0 + 10, RECORD_SIZE_MAX);
+
+	fp = fopen(TEST_FILE, "wb");
+
+	if (fp == NULL) {
+		printf("FAIL: cannot create %s\n", TEST_FILE);
+		exit(1);
+	}
+
+	fwrite(hdr, 1, sizeof(hdr), fp);
+	fwrite(table, 1, sizeof(table), fp);
+	fwrite(rec0, 1, sizeof(rec0), fp);
+	fwrite(text, 1, TEXT_SIZE, fp);
+	fclose(fp);
+}
+
+/* as text_open_in_pdb reads a book */
+static void check_read(int version, u32 doc_size)
+{
+	p_pdb pdb;
+	char *buf;
+	u32 size, len;
+
+	write_pdb(version, doc_size);
+	pdb = pdb_open(TEST_FILE);
+	CHECK(pdb != NULL, "version %d, doc_size %u: not opened", version, (unsigned) doc_size);
+
+	if (pdb == NULL)
+		return;
+
+	size = pdb_text_size(pdb);
+	CHECK(size <= RECORDS * RECORD_SIZE_MAX, "doc_size %u: %u bytes for %d records", (unsigned) doc_size, (unsigned) size, RECORDS);
+	buf = calloc(1, size + 1);
+	len = pdb_read_all(pdb, &buf, &size);
+	pdb_close(pdb);
+
+	CHECK(len == TEXT_SIZE && memcmp(buf, text, TEXT_SIZE) == 0, "version %d, doc_size %u: read %u of %u bytes", version, (unsigned) doc_size, (unsigned) len, (unsigned) TEXT_SIZE);
+	CHECK(len <= size, "version %d, doc_size %u: %u bytes read into %u", version, (unsigned) doc_size, (unsigned) len, (unsigned) size);
+	free(buf);
+}
+
+int main(void)
+{
+	int version;
+
+	make_text();
+
+	for (version = 1; version <= 2; version++) {
+		check_read(version, TEXT_SIZE);
+		check_read(version, 0);
+		// understated: the text outgrows the buffer sized from record 0
+		check_read(version, 100);
+		check_read(version, TEXT_SIZE - 2 * RECORD_SIZE_MAX);
+		check_read(version, 10 * TEXT_SIZE);
+	}
+
+	remove(TEST_FILE);
+
+	printf("depdb_test: %d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * fat_test IMAGE: list every directory of an image from mkfatimg.py and
+ * compare with IMAGE.list, walking each cluster chain with fat_next_clus();
+ * then check that a failed FAT read fails the listing instead of cutting it short
+ */
+
+#include "fat.c"
+#include <stdarg.h>
+#include "psp_shim.h"
+
+#define ENTRY_LINE_MAX 1024
+
+bool xrprx_loaded = false;
+int psp_model = 0;
+int psp_fw_version = 0x06600010;
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+		printf(__VA_ARGS__); \
+		putchar('\n'); \
+		failures++; \
+	} \
+} while (0)
+
+/* fat.c never reads the names back on this firmware, any entry will do */
+SceUID sceIoDopen(const char *dirname)
+{
+	return 100;
+}
+
+int sceIoDread(SceUID fd, SceIoDirent * dir)
+{
+	memset(dir, 0, sizeof(*dir));
+	strcpy(dir->d_name, "X");
+
+	return 1;
+}
+
+int sceIoDclose(SceUID fd)
+{
+	return 0;
+}
+
+SceUID xrIoOpen(const char *file, int flags, SceMode mode)
+{
+	return -1;
+}
+
+SceOff xrIoLseek(SceUID fd, SceOff offset, int whence)
+{
+	return -1;
+}
+
+int xrIoRead(SceUID fd, void *data, SceSize size)
+{
+	return -1;
+}
+
+int xrIoClose(SceUID fd)
+{
+	return -1;
+}
+
+int xrKernelInitApitype(void)
+{
+	return 0;
+}
+
+struct psp_mutex_t *xr_lock_init(struct psp_mutex_t *s)
+{
+	return s;
+}
+
+void xr_lock_destroy(struct psp_mutex_t *s)
+{
+}
+
+int xr_lock(struct psp_mutex_t *s)
+{
+	return 0;
+}
+
+int xr_unlock(struct psp_mutex_t *s)
+{
+	return 0;
+}
+
+static bool same_dir(u32 clus, u32 crc)
+{
+	return true;
+}
+
+/* compare the chain fat_next_clus() walks with the comma separated list */
+static void check_chain(const char *name, u32 first, const char *expect)
+{
+	u32 c = first, n = 0;
+	const char *p = expect;
+
+	// fat_readdir() drops the volume geometry on return
+	fat_init();
+	fat_lock();
+	fat_load_table();
+
+	while (c > 1 && c < clus_max && *p != '\0' && n <= clus_total) {
+		u32 want = strtoul(p, (char **) &p, 10);
+
+		if (c != want)
+			break;
+
+		if (*p == ',')
+			p++;
+
+		c = fat_next_clus(c);
+		n++;
+	}
+
+	CHECK(*p == '\0' && !(c > 1 && c < clus_max), "%s: chain differs after %u clusters at %u", name, (unsigned) n, (unsigned) c);
+
+	fat_free_table();
+	fat_unlock();
+	fat_free();
+}
+
+static void check_dir(const char *path, p_fat_info info, u32 count, char lines[][ENTRY_LINE_MAX], u32 nlines, int pages)
+{
+	u32 i;
+
+	CHECK(count == nlines, "%s: %u entries, expected %u", path, (unsigned) count, (unsigned) nlines);
+
+	if (pages >= 0)
+		CHECK(fat_page_reads == pages, "%s: %u FAT pages read, expected %d", path, (unsigned) fat_page_reads, pages);
+
+	for (i = 0; i < count && i < nlines; i++) {
+		char got[ENTRY_LINE_MAX], *chain;
+
+		snprintf(got, sizeof(got), "E|%s|%s|%u|%u|%u|", info[i].filename, info[i].longname, (unsigned) info[i].filesize, (unsigned) info[i].clus, (unsigned) info[i].attr);
+		CHECK(strncmp(got, lines[i], strlen(got)) == 0, "%s: got %s, expected %s", path, got, lines[i]);
+		chain = lines[i] + strlen(got);
+
+		if (strncmp(got, lines[i], strlen(got)) == 0 && info[i].clus != 0)
+			check_chain(info[i].longname, info[i].clus, chain);
+	}
+}
+
+static void list_dir(const char *path, char lines[][ENTRY_LINE_MAX], u32 nlines, int pages)
+{
+	char dir[ENTRY_LINE_MAX], sdir[256];
+	p_fat_info info = NULL;
+	u32 count, clus, crc;
+
+	snprintf(dir, sizeof(dir), "ms0:/%s", path);
+	count = fat_readdir_ex(dir, sdir, &info, NULL, &clus, &crc);
+
+	if (count == INVALID) {
+		CHECK(0, "%s: fat_readdir failed", path);
+		return;
+	}
+
+	check_dir(path, info, count, lines, nlines, pages);
+	free(info);
+
+	// an unchanged directory is not parsed again
+	count = fat_readdir_ex(dir, sdir, &info, same_dir, NULL, NULL);
+	CHECK(count == 0 && info == NULL, "%s: unchanged directory parsed again", path);
+	free(info);
+}
+
+/* the FAT page holding offset cannot be read, path must not list */
+static void list_dir_failing(const char *path, SceOff offset)
+{
+	char dir[ENTRY_LINE_MAX], sdir[256];
+	p_fat_info info = NULL;
+	u32 count;
+
+	snprintf(dir, sizeof(dir), "ms0:/%s", path);
+	shim_fail_offset = offset;
+	count = fat_readdir_ex(dir, sdir, &info, NULL, NULL, NULL);
+	shim_fail_offset = -1;
+
+	CHECK(count == INVALID, "%s: listed %u entries with a FAT page unreadable", path, (unsigned) count);
+
+	if (count != INVALID)
+		free(info);
+}
+
+int main(int argc, char *argv[])
+{
+	static char lines[512][ENTRY_LINE_MAX], fails[16][ENTRY_LINE_MAX];
+	char line[ENTRY_LINE_MAX], path[ENTRY_LINE_MAX] = "";
+	u32 nlines = 0, ndirs = 0, nfails = 0, i;
+	int pages = -1;
+	FILE *fp;
+
+	if (argc != 2) {
+		printf("usage: %s IMAGE\n", argv[0]);
+		return 2;
+	}
+
+	snprintf(line, sizeof(line), "%s.list", argv[1]);
+	fp = fopen(line, "r");
+
+	if (fp == NULL) {
+		printf("FAIL: cannot open %s\n", line);
+		return 1;
+	}
+
+	shim_mount("msstor:", argv[1]);
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		line[strcspn(line, "\n")] = '\0';
+
+		if (line[0] == 'D') {
+			if (ndirs++ > 0)
+				list_dir(path, lines, nlines, pages);
+
+			STRCPY_S(path, line + 2);
+			nlines = 0;
+			pages = -1;
+		} else if (line[0] == 'P') {
+			pages = atoi(line + 2);
+		} else if (line[0] == 'E' && nlines < 512) {
+			STRCPY_S(lines[nlines++], line);
+		} else if (line[0] == 'X' && nfails < 16) {
+			STRCPY_S(fails[nfails++], line + 2);
+		}
+	}
+
+	if (ndirs > 0)
+		list_dir(path, lines, nlines, pages);
+
+	fclose(fp);
+
+	for (i = 0; i < nfails; i++) {
+		char *offset = strrchr(fails[i], ' ');
+
+		*offset++ = '\0';
+		list_dir_failing(fails[i], strtoll(offset, NULL, 10));
+	}
+
+	printf("fat_test %s: %u directories, %u failed reads, %d failures\n", argv[1], (unsigned) ndirs, (unsigned) nfails, failures);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "html.h"
+#include "strsafe.h"
+
+#define DOC_SIZE (8 << 20)
+#define FUZZ_RUNS 20000
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+		printf(__VA_ARGS__); \
+		putchar('\n'); \
+		failures++; \
+	} \
+} while (0)
+
+static void check_text(const char *html, bool stripeol, const char *text)
+{
+	char buf[4096];
+	u32 len;
+
+	STRCPY_S(buf, html);
+	len = html_to_text(buf, strlen(buf), stripeol);
+	buf[len] = '\0';
+
+	CHECK(strcmp(buf, text) == 0, "%s\n  gave [%s]\n  expected [%s]", html, buf, text);
+}
+
+/* the reader converts in place, a page fed in chunks must come out the same */
+static u32 feed_chunks(const char *in, u32 size, char *out, u32 max_chunk)
+{
+	t_html_parser p;
+	u32 pos = 0, len = 0;
+
+	html_parser_init(&p, true);
+
+	while (pos < size) {
+		u32 n = 1 + rand() % max_chunk;
+
+		if (n > size - pos)
+			n = size - pos;
+
+		len += html_parser_feed(&p, in + pos, n, out + len);
+		pos += n;
+	}
+
+	return len + html_parser_finish(&p, out + len);
+}
+
+static void check_chunked(void)
+{
+	static const char *pieces[] = {
+		"<p>", "</p>", "&amp;", "&#x4e00;", "text ", "<script>document.write('a<br>b')</script>",
+		"<div style='display:none'>z</div>", "<!-- -- -->", " \t\n", "<b>", "\xb0\xa1", "&lt;", "<td>",
+		"<?xml version=\"1.0\"?>", "AT&T", "<pre> x\n y </pre>",
+	};
+	static const char alphabet[] = "<>/&#;x1 \"'=-!?pbrdiv:none";
+	char *doc = malloc(DOC_SIZE), *inplace = malloc(DOC_SIZE), *out = malloc(DOC_SIZE + 64);
+	u32 size = 0, len, len2;
+	clock_t t;
+	int i;
+
+	while (size < DOC_SIZE - 64) {
+		const char *s = pieces[rand() % (sizeof(pieces) / sizeof(pieces[0]))];
+
+		memcpy(doc + size, s, strlen(s));
+		size += strlen(s);
+	}
+
+	memcpy(inplace, doc, size);
+	t = clock();
+	len = html_to_text(inplace, size, true);
+	t = clock() - t;
+	len2 = feed_chunks(doc, size, out, 5000);
+
+	CHECK(len == len2 && memcmp(inplace, out, len) == 0, "%u bytes of markup: in place %u bytes, chunked %u bytes", (unsigned) size, (unsigned) len, (unsigned) len2);
+	printf("html_test: %u bytes of markup converted in %.3fs\n", (unsigned) size, (double) t / CLOCKS_PER_SEC);
+
+	// short random documents cut anywhere, including inside tags and entities
+	for (i = 0; i < FUZZ_RUNS; i++) {
+		u32 n = rand() % 300, j;
+
+		for (j = 0; j < n; j++) {
+			doc[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+		}
+
+		memcpy(inplace, doc, n);
+		len = html_to_text(inplace, n, true);
+		len2 = feed_chunks(doc, n, out, 8);
+
+		if (len != len2 || memcmp(inplace, out, len) != 0) {
+			doc[n] = '\0';
+			CHECK(0, "chunked feed differs for %s", doc);
+			break;
+		}
+	}
+
+	free(doc);
+	free(inplace);
+	free(out);
+}
+
+int main(void)
+{
+	check_text("<html><head><title>T</title><style>p{}</style></head><body><p>Hello&nbsp;&amp;   world</p>  <br/>"
+			   "AT&T &lt;x&gt; &#65;&#x42; &hellip; x < y<div style=\"display: none\">hidden<b>x</b></div>after<!-- c > d --> ok</body></html>",
+			   true, "\nHello & world\n\nAT&T <x> AB \xA1\xAD x < yafter ok");
+	check_text("<script>var a=1; document.write('<b>js</b> \\'q\\''); if(a</b)x;</script>tail", true, "js 'q'tail");
+	check_text("<pre>  a\n  b</pre>  <td>c<td>d</tr>", true, "  a\n  b c d");
+	check_text("x &unknown; &am", true, "x &unknown; &am");
+	check_text("a\n  b", false, "a\n  b");
+	check_text("<?xml version=\"1.0\" encoding=\"gbk\"?>\n<!DOCTYPE html><p>text</p>", true, "\ntext\n");
+	check_text("<?php echo '>'; ?>end", true, "end");
+	check_text("a <? b", true, "a ");
+	check_text("1 <? 2", true, "1 ");
+
+	check_chunked();
+
+	printf("html_test: %d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
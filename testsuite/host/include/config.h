@@ -0,0 +1,5 @@
+/* the host tests build without configure, no optional features */
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#endif
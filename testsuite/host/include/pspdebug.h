@@ -0,0 +1,5 @@
+/* host stand-in for the PSPSDK header, nothing the host tests use */
+#ifndef PSPDEBUG_H
+#define PSPDEBUG_H
+
+#endif
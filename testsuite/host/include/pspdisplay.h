@@ -0,0 +1,7 @@
+/* host stand-in for the PSPSDK header, only what the host tests use */
+#ifndef PSPDISPLAY_H
+#define PSPDISPLAY_H
+
+int sceDisplayWaitVblankStart(void);
+
+#endif
@@ -0,0 +1,5 @@
+/* host stand-in for the PSPSDK header, nothing the host tests use */
+#ifndef PSPGU_H
+#define PSPGU_H
+
+#endif
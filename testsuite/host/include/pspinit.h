@@ -0,0 +1,5 @@
+/* host stand-in for the PSPSDK header, only what the host tests use */
+#ifndef PSPINIT_H
+#define PSPINIT_H
+
+#endif
@@ -0,0 +1,63 @@
+/* host stand-in for the PSPSDK header, only what the host tests use */
+#ifndef PSPIOFILEMGR_H
+#define PSPIOFILEMGR_H
+
+#include <pspkerneltypes.h>
+
+#define PSP_O_RDONLY	0x0001
+#define PSP_O_WRONLY	0x0002
+#define PSP_O_RDWR	(PSP_O_RDONLY | PSP_O_WRONLY)
+#define PSP_O_APPEND	0x0100
+#define PSP_O_CREAT	0x0200
+#define PSP_O_TRUNC	0x0400
+
+#define PSP_SEEK_SET	0
+#define PSP_SEEK_CUR	1
+#define PSP_SEEK_END	2
+
+#define FIO_S_IFMT	0xF000
+#define FIO_S_IFDIR	0x1000
+#define FIO_S_IFREG	0x2000
+
+/* glibc's sys/stat.h defines these as macros for struct stat */
+#undef st_ctime
+#undef st_atime
+#undef st_mtime
+
+typedef struct
+{
+	SceMode st_mode;
+	unsigned int st_attr;
+	SceOff st_size;
+	ScePspDateTime st_ctime;
+	ScePspDateTime st_atime;
+	ScePspDateTime st_mtime;
+	unsigned int st_private[6];
+} SceIoStat;
+
+typedef struct
+{
+	SceIoStat d_stat;
+	char d_name[256];
+	void *d_private;
+	int dummy;
+} SceIoDirent;
+
+SceUID sceIoOpen(const char *file, int flags, SceMode mode);
+int sceIoClose(SceUID fd);
+int sceIoRead(SceUID fd, void *data, SceSize size);
+int sceIoWrite(SceUID fd, const void *data, SceSize size);
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence);
+int sceIoLseek32(SceUID fd, int offset, int whence);
+int sceIoRemove(const char *file);
+int sceIoMkdir(const char *dir, SceMode mode);
+int sceIoGetstat(const char *file, SceIoStat * stat);
+int sceIoReadAsync(SceUID fd, void *data, SceSize size);
+int sceIoWaitAsync(SceUID fd, SceInt64 * res);
+int sceIoPollAsync(SceUID fd, SceInt64 * res);
+int sceIoChangeAsyncPriority(SceUID fd, int pri);
+SceUID sceIoDopen(const char *dirname);
+int sceIoDread(SceUID fd, SceIoDirent * dir);
+int sceIoDclose(SceUID fd);
+
+#endif
@@ -0,0 +1,9 @@
+/* host stand-in for the PSPSDK header, only what the host tests use */
+#ifndef PSPKERNEL_H
+#define PSPKERNEL_H
+
+#include <pspkerneltypes.h>
+#include <pspiofilemgr.h>
+#include <pspthreadman.h>
+
+#endif
@@ -0,0 +1,15 @@
+/* host stand-in for the PSPSDK header, only what the host tests use */
+#ifndef PSPKERNELTYPES_H
+#define PSPKERNELTYPES_H
+
+#include <psptypes.h>
+
+typedef int SceUID;
+typedef unsigned int SceSize;
+typedef int SceMode;
+typedef s64 SceOff;
+typedef u32 SceUInt;
+typedef s64 SceInt64;
+typedef u64 SceUInt64;
+
+#endif
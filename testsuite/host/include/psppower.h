@@ -0,0 +1,8 @@
+/* host stand-in for the PSPSDK header, only what the host tests use */
+#ifndef PSPPOWER_H
+#define PSPPOWER_H
+
+int scePowerTick(int type);
+int scePowerRequestSuspend(void);
+
+#endif
@@ -0,0 +1,9 @@
+/* host stand-in for the PSPSDK header, only what the host tests use */
+#ifndef PSPRTC_H
+#define PSPRTC_H
+
+#include <psptypes.h>
+
+int sceRtcGetCurrentTick(u64 * tick);
+
+#endif
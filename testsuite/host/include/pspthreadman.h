@@ -0,0 +1,10 @@
+/* host stand-in for the PSPSDK header, only what the host tests use */
+#ifndef PSPTHREADMAN_H
+#define PSPTHREADMAN_H
+
+#include <pspkerneltypes.h>
+
+SceInt64 sceKernelGetSystemTimeWide(void);
+int sceKernelDelayThread(SceUInt delay);
+
+#endif
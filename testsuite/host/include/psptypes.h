@@ -0,0 +1,28 @@
+/* host stand-in for the PSPSDK header, only what the host tests use */
+#ifndef PSPTYPES_H
+#define PSPTYPES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef struct
+{
+	u16 year;
+	u16 month;
+	u16 day;
+	u16 hour;
+	u16 minute;
+	u16 second;
+	u32 microsecond;
+} ScePspDateTime;
+
+#endif
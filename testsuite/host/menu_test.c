@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "win.h"
+#include "conf.h"
+#include "strsafe.h"
+
+#define ITEMS 2000
+#define ROUNDS 200
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+		printf(__VA_ARGS__); \
+		putchar('\n'); \
+		failures++; \
+	} \
+} while (0)
+
+/* linked with --wrap, counts what building and freeing a listing costs */
+static unsigned heap_calls;
+
+void *__real_malloc(size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+	heap_calls++;
+	return __real_malloc(size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	heap_calls++;
+	return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+	if (ptr != NULL)
+		heap_calls++;
+	__real_free(ptr);
+}
+
+/* win.c draws menus too, none of that runs here */
+t_conf config;
+int DISP_FONTSIZE = 12;
+
+u32 ctrl_read(void)
+{
+	return 0;
+}
+
+u32 ctrl_waitany(void)
+{
+	return 0;
+}
+
+u32 ctrl_waitmask(u32 keymask)
+{
+	return 0;
+}
+
+void ctrl_waitrelease(void)
+{
+}
+
+void disp_flip(void)
+{
+}
+
+void disp_getimage(u32 x, u32 y, u32 w, u32 h, pixel * buf)
+{
+}
+
+void disp_putimage(u32 x, u32 y, u32 w, u32 h, u32 startx, u32 starty, pixel * buf)
+{
+}
+
+void disp_duptocache(void)
+{
+}
+
+void disp_duptocachealpha(int percent)
+{
+}
+
+void disp_rectduptocache(u32 x1, u32 y1, u32 x2, u32 y2)
+{
+}
+
+void disp_rectduptocachealpha(u32 x1, u32 y1, u32 x2, u32 y2, int percent)
+{
+}
+
+void disp_putnstring(int x, int y, pixel color, const u8 * str, int count, u32 wordspace, int top, int height, int bot)
+{
+}
+
+void disp_fillrect(u32 x1, u32 y1, u32 x2, u32 y2, pixel color)
+{
+}
+
+void disp_rectangle(u32 x1, u32 y1, u32 x2, u32 y2, pixel color)
+{
+}
+
+void disp_line(u32 x1, u32 y1, u32 x2, u32 y2, pixel color)
+{
+}
+
+int text_get_string_width_sys(const u8 * pos, size_t size, u32 wordspace)
+{
+	return 0;
+}
+
+void power_down(void)
+{
+}
+
+double pspDiffTime(u64 * t1, u64 * t2)
+{
+	return 0;
+}
+
+int scePowerTick(int type)
+{
+	return 0;
+}
+
+int scePowerRequestSuspend(void)
+{
+	return 0;
+}
+
+int sceRtcGetCurrentTick(u64 * tick)
+{
+	*tick = 0;
+	return 0;
+}
+
+int sceDisplayWaitVblankStart(void)
+{
+	return 0;
+}
+
+static char longnames[ITEMS][64];
+static char shortnames[ITEMS][16];
+
+static void make_names(void)
+{
+	int i;
+
+	for (i = 0; i < ITEMS; i++) {
+		SPRINTF_S(longnames[i], "%04d %.*s.txt", i, 1 + i % 40, "The quick brown fox jumps over the lazy dog");
+		SPRINTF_S(shortnames[i], "%04d~1.TXT", i);
+	}
+}
+
+/* how listings were built before the arena: two heap buffers per item, 64 more slots at a time */
+static p_win_menu fill_buffers(void)
+{
+	p_win_menu menu = win_menu_new();
+	t_win_menuitem item;
+	int i;
+
+	for (i = 0; i < ITEMS; i++) {
+		win_menuitem_new(&item);
+		buffer_copy_string(item.compname, longnames[i]);
+		buffer_copy_string(item.shortname, shortnames[i]);
+
+		if (menu->size >= menu->cap)
+			win_menu_reserve(menu, menu->cap + MENU_REALLOC_INCR);
+
+		win_menu_add(menu, &item);
+	}
+
+	return menu;
+}
+
+/* how fs_dir_to_menu builds them now */
+static p_win_menu fill_arena(void)
+{
+	p_win_menu menu = win_menu_new();
+	t_win_menuitem item;
+	int i;
+
+	win_menu_reserve(menu, ITEMS);
+
+	for (i = 0; i < ITEMS; i++) {
+		if (win_menu_item_new(menu, &item, longnames[i], shortnames[i]) < 0)
+			break;
+
+		win_menu_add(menu, &item);
+	}
+
+	return menu;
+}
+
+static void check_same(p_win_menu menu)
+{
+	int i;
+
+	CHECK(menu->size == ITEMS, "%u items", (unsigned) menu->size);
+
+	for (i = 0; i < menu->size; i++) {
+		if (strcmp(menu->root[i].compname->ptr, longnames[i]) != 0 || strcmp(menu->root[i].shortname->ptr, shortnames[i]) != 0) {
+			CHECK(false, "item %d is %s/%s", i, menu->root[i].compname->ptr, menu->root[i].shortname->ptr);
+			return;
+		}
+	}
+}
+
+/* build and free the listing ROUNDS times, returns seconds, heap calls per item in *calls */
+static double bench(p_win_menu(*fill) (void), double *calls)
+{
+	clock_t t;
+	int i;
+
+	heap_calls = 0;
+	t = clock();
+
+	for (i = 0; i < ROUNDS; i++) {
+		p_win_menu menu = fill();
+
+		if (i == 0)
+			check_same(menu);
+
+		win_menu_destroy(menu);
+	}
+
+	t = clock() - t;
+	*calls = (double) heap_calls / ROUNDS / ITEMS;
+
+	return (double) t / CLOCKS_PER_SEC;
+}
+
+int main(void)
+{
+	double tbuf, tarena, cbuf, carena;
+
+	make_names();
+
+	tbuf = bench(fill_buffers, &cbuf);
+	tarena = bench(fill_arena, &carena);
+
+	printf("menu_test: %d listings of %d items, per-item buffers %.3fs %.2f heap calls/item, arena %.3fs %.2f heap calls/item\n", ROUNDS, ITEMS, tbuf, cbuf, tarena, carena);
+
+	CHECK(carena * 10 < cbuf, "arena makes %.2f heap calls per item, buffers %.2f", carena, cbuf);
+
+	printf("menu_test: %d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
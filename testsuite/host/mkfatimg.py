@@ -0,0 +1,290 @@
+#!/usr/bin/env python3
+"""Write a partitioned FAT12/16/32 image for fat_test and the listing fat.c
+should produce for it.
+
+Usage: mkfatimg.py 12|16|32 IMAGE
+
+IMAGE.list has one block per directory:
+
+    D <path>
+    P <FAT pages read to list it>
+    E|<short name>|<long name>|<size>|<first cluster>|<attr>|<cluster chain>
+
+and then, for each directory that must fail to list when one FAT page
+cannot be read, the image offset of a FAT entry on that page:
+
+    X <path> <offset>
+
+Directory chains are fragmented by the files created between their entries,
+and SCATTER.BIN is chained in random order across the end of the volume,
+through the FAT12 entries that straddle a FAT page. FAT32 entries carry
+random reserved high bits. FAR has its second cluster on a FAT page no
+other chain uses, so a failed read of that page cuts its chain short.
+"""
+
+import random
+import struct
+import sys
+
+SECTOR = 512
+PART_START = 63
+FAT_PAGE_SIZE = 4096
+FAT_PAGE_COUNT = 8
+
+# total sectors, root entries; one sector per cluster keeps the images small
+LAYOUT = {12: (3000, 224), 16: (40000, 512), 32: (80000, 0)}
+EOC = {12: 0xFFF, 16: 0xFFFF, 32: 0x0FFFFFFF}
+
+
+def short11(name):
+    base, _, ext = name.partition('.')
+    return (base.ljust(8) + ext.ljust(3)).encode()
+
+
+def lfn_entries(longname, name11):
+    chksum = 0
+    for ch in name11:
+        chksum = (((chksum & 1) << 7) + (chksum >> 1) + ch) & 0xff
+    u = longname.encode('utf-16-le') + b'\0\0'
+    u += b'\xff' * ((26 - len(u) % 26) % 26)
+    n = len(u) // 26
+    out = []
+    for i in range(n):
+        part = u[i * 26:(i + 1) * 26]
+        order = (i + 1) | (0x40 if i == n - 1 else 0)
+        out.append(bytes([order]) + part[0:10] + bytes([0x0f, 0, chksum]) + part[10:22] + b'\0\0' + part[22:26])
+    return list(reversed(out))
+
+
+def dir_entry(name11, attr, clus, size):
+    date, time = 0x5021, 0x6000
+    return struct.pack('<11sBBBHHHHHHHI', name11, attr, 0, 0, time, date, date,
+                       clus >> 16, time, date, clus & 0xffff, size)
+
+
+class Volume:
+    def __init__(self, kind):
+        self.kind = kind
+        self.total, self.root_entries = LAYOUT[kind]
+        self.reserved = 32 if kind == 32 else 1
+        self.nfats = 2
+        self.root_sectors = (self.root_entries * 32 + SECTOR - 1) // SECTOR
+        self.fat_sectors = 1
+        while True:
+            data = self.total - self.reserved - self.nfats * self.fat_sectors - self.root_sectors
+            self.nclus = data
+            need = {12: (self.nclus + 2) * 3 // 2 + 1, 16: (self.nclus + 2) * 2, 32: (self.nclus + 2) * 4}[kind]
+            if self.fat_sectors * SECTOR >= need:
+                break
+            self.fat_sectors += 1
+        self.img = bytearray((PART_START + self.total) * SECTOR)
+        self.fat = [0] * (self.nclus + 2)
+        self.fat[0], self.fat[1] = 0x0FFFFFF8, 0x0FFFFFFF
+        self.next_free = 2
+        self.fat_pos = (PART_START + self.reserved) * SECTOR
+        self.root_pos = self.fat_pos + self.nfats * self.fat_sectors * SECTOR
+        self.data_pos = self.root_pos + self.root_sectors * SECTOR
+        self.dirs = {}
+        self.listing = {}
+        self.chains = {}
+        self.fail_reads = []
+
+    def alloc(self, prev=None, c=None):
+        if c is None:
+            while self.fat[self.next_free] != 0:
+                self.next_free += 1
+            c = self.next_free
+        self.fat[c] = EOC[self.kind]
+        if prev is not None:
+            self.fat[prev] = c
+        return c
+
+    def cluster(self, c):
+        pos = self.data_pos + (c - 2) * SECTOR
+        return slice(pos, pos + SECTOR)
+
+    def chain(self, first):
+        out = []
+        c = first
+        while 2 <= c < EOC[self.kind] - 0xF:
+            out.append(c)
+            c = self.fat[c]
+        return out
+
+    def mkdir(self, path):
+        if path == '' and self.kind != 32:
+            d = {'chain': None, 'entries': []}
+        else:
+            d = {'chain': [self.alloc()], 'entries': []}
+        self.dirs[path] = d
+        self.listing[path] = []
+        return d
+
+    def add_entries(self, parent, entries):
+        d = self.dirs[parent]
+        d['entries'] += entries
+        if d['chain'] is None:
+            assert len(d['entries']) <= self.root_entries
+            return
+        while len(d['entries']) * 32 > len(d['chain']) * SECTOR:
+            d['chain'].append(self.alloc(d['chain'][-1], d.pop('far', None)))
+
+    def add(self, parent, name, attr, first, size, longname):
+        entries = lfn_entries(longname, short11(name)) if longname else []
+        self.add_entries(parent, entries + [dir_entry(short11(name), attr, first, size)])
+        self.listing[parent].append((name, longname or name, size, first, attr))
+
+    def newdir(self, parent, name, longname=None):
+        path = (parent + '/' + (longname or name)).lstrip('/')
+        d = self.mkdir(path)
+        first = d['chain'][0]
+        self.add(parent, name, 0x10, first, 0, longname)
+        up = self.dirs[parent]['chain']
+        self.add_entries(path, [dir_entry(b'.          ', 0x10, first, 0),
+                                dir_entry(b'..         ', 0x10, up[0] if up and parent else 0, 0)])
+        return path
+
+    def newfile(self, parent, name, size, longname=None, clusters=None):
+        if clusters is None:
+            clusters = []
+            for i in range((size + SECTOR - 1) // SECTOR):
+                clusters.append(self.alloc(clusters[-1] if clusters else None))
+        else:
+            for a, b in zip(clusters, clusters[1:]):
+                self.fat[a] = b
+            self.fat[clusters[-1]] = EOC[self.kind]
+        for c in clusters:
+            self.img[self.cluster(c)] = bytes([random.randrange(256)]) * SECTOR
+        self.add(parent, name, 0x20, clusters[0] if clusters else 0, size, longname)
+
+    def entry_offset(self, c):
+        return {12: c + c // 2, 16: c * 2, 32: c * 4}[self.kind]
+
+    def entry_pages(self, c):
+        if self.kind == 12:
+            off = c + c // 2
+            return {off // FAT_PAGE_SIZE, (off + 1) // FAT_PAGE_SIZE}
+        return {c * (self.kind // 8) // FAT_PAGE_SIZE}
+
+    def dir_pages(self, path):
+        """FAT pages fat.c reads to list path: every directory chain on the way, up to the end marker"""
+        pages = set()
+        parts = path.split('/') if path else []
+        for i in range(len(parts) + 1):
+            chain = self.dirs['/'.join(parts[:i])]['chain']
+            for c in chain or []:
+                pages |= self.entry_pages(c)
+        return pages
+
+    def write_fat(self):
+        fb = bytearray(self.fat_sectors * SECTOR)
+        if self.kind == 12:
+            for i, v in enumerate(self.fat):
+                v &= 0xfff
+                o = i * 3 // 2
+                if i & 1:
+                    fb[o] = (fb[o] & 0x0f) | ((v << 4) & 0xf0)
+                    fb[o + 1] = v >> 4
+                else:
+                    fb[o] = v & 0xff
+                    fb[o + 1] = (fb[o + 1] & 0xf0) | (v >> 8)
+        elif self.kind == 16:
+            struct.pack_into('<%dH' % len(self.fat), fb, 0, *[v & 0xffff for v in self.fat])
+        else:
+            struct.pack_into('<%dI' % len(self.fat), fb, 0,
+                             *[(v & 0x0fffffff) | (random.randrange(16) << 28) for v in self.fat])
+        for k in range(self.nfats):
+            pos = self.fat_pos + k * self.fat_sectors * SECTOR
+            self.img[pos:pos + len(fb)] = fb
+
+    def write(self, path):
+        for p, d in self.dirs.items():
+            raw = b''.join(d['entries'])
+            if d['chain'] is None:
+                self.img[self.root_pos:self.root_pos + len(raw)] = raw
+            else:
+                raw = raw.ljust(len(d['chain']) * SECTOR, b'\0')
+                for i, c in enumerate(d['chain']):
+                    self.img[self.cluster(c)] = raw[i * SECTOR:(i + 1) * SECTOR]
+        self.write_fat()
+
+        mbr = bytearray(SECTOR)
+        struct.pack_into('<B3sB3sII', mbr, 0x1BE, 0x80, b'\0\0\0', 0x0c, b'\0\0\0', PART_START, self.total)
+        mbr[510:512] = b'\x55\xaa'
+        self.img[0:SECTOR] = mbr
+
+        bs = bytearray(SECTOR)
+        small = self.total < 65536 and self.kind != 32
+        struct.pack_into('<3s8sHBHBHHBHHHII', bs, 0, b'\xeb\x3c\x90', b'MSDOS5.0', SECTOR, 1,
+                         self.reserved, self.nfats, self.root_entries, self.total if small else 0, 0xf8,
+                         0 if self.kind == 32 else self.fat_sectors, 63, 255, PART_START,
+                         0 if small else self.total)
+        if self.kind == 32:
+            struct.pack_into('<IHHIHH', bs, 36, self.fat_sectors, 0, 0, self.dirs['']['chain'][0], 1, 6)
+        bs[510:512] = b'\x55\xaa'
+        self.img[PART_START * SECTOR:(PART_START + 1) * SECTOR] = bs
+
+        with open(path, 'wb') as f:
+            f.write(self.img)
+
+        with open(path + '.list', 'w') as f:
+            for p in self.dirs:
+                f.write('D %s\n' % p)
+                pages = self.dir_pages(p)
+                if len(pages) <= FAT_PAGE_COUNT:
+                    f.write('P %d\n' % len(pages))
+                for name, longname, size, first, attr in self.listing[p]:
+                    chain = ','.join(str(c) for c in self.chain(first)) if first else ''
+                    f.write('E|%s|%s|%d|%d|%d|%s\n' % (name, longname, size, first, attr, chain))
+            for p, c in self.fail_reads:
+                f.write('X %s %d\n' % (p, self.fat_pos + self.entry_offset(c)))
+
+
+def build(kind, path):
+    random.seed(kind)
+    v = Volume(kind)
+
+    # the scattered file takes its clusters first so nothing else lands there
+    top = list(range(v.nclus * 3 // 4, v.nclus + 2))
+    scatter = random.sample(top, 40)
+    if kind == 12:
+        # the entries at byte 4095 and 8190 straddle a FAT page
+        scatter += [c for c in (2730, 5460) if c < v.nclus + 2 and c not in scatter]
+    scatter.append(v.nclus + 1)
+    scatter = list(dict.fromkeys(scatter))
+    random.shuffle(scatter)
+    for c in scatter:
+        v.fat[c] = EOC[kind]
+    far = max(c for c in top if c not in scatter)
+    v.fat[far] = EOC[kind]
+
+    v.mkdir('')
+    a = v.newdir('', 'A')
+    b = v.newdir(a, 'B')
+    c = v.newdir(b, 'C', longname='Deep Folder Name')
+    for i in range(5):
+        v.newfile(c, 'F%d.TXT' % i, 1000 * i + 1)
+    big = v.newdir('', 'BIG')
+    for i in range(60 if kind == 12 else 200):
+        v.newfile(big, 'FILE%d.MP3' % i, random.randrange(1, 3000),
+                  longname=('Long file name number %d.mp3' % i) if i % 3 == 0 else None)
+        if i % 7 == 0:
+            v.newfile(a, 'J%d.DAT' % i, 700)
+    f = v.newdir('', 'FAR')
+    v.dirs[f]['far'] = far
+    for i in range(40):
+        v.newfile(f, 'N%d.TXT' % i, 100)
+    chain = v.dirs[f]['chain']
+    assert len(chain) == 3 and chain[1] == far
+    assert not v.entry_pages(far) & (v.dir_pages('') | v.entry_pages(chain[0]) | v.entry_pages(chain[2]))
+    v.fail_reads.append((f, far))
+    for i in range(10):
+        v.newfile('', 'R%d.BIN' % i, 5000)
+    v.newfile('', 'SCATTER.BIN', len(scatter) * SECTOR, clusters=scatter)
+    v.write(path)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3 or sys.argv[1] not in ('12', '16', '32'):
+        sys.exit(__doc__)
+    build(int(sys.argv[1]), sys.argv[2])
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pspkernel.h>
+#include "dbg.h"
+#include "psp_shim.h"
+
+#define SHIM_MAX_FD 64
+
+/* returned by the PSP for I/O on a handle with an async read in flight */
+#define SHIM_ERROR_ASYNC_BUSY	0x80020329
+/* returned for a read failed by shim_fail_offset */
+#define SHIM_ERROR_IO	0x80010005
+
+struct async_op
+{
+	int busy;
+	void *data;
+	SceSize size;
+	off_t pos;
+	SceInt64 done;
+};
+
+struct shim_counters shim_calls;
+SceInt64 shim_latency_us = 5000;
+SceInt64 shim_us_per_kb = 50;
+SceOff shim_fail_offset = -1;
+
+static SceInt64 now_us;
+static struct async_op ops[SHIM_MAX_FD];
+static const char *mount_device, *mount_path;
+
+DBG *d;
+
+int dbg_printf(DBG * d, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (getenv("SHIM_VERBOSE") == NULL)
+		return 0;
+
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	putchar('\n');
+
+	return 0;
+}
+
+/* for charsets.c, common/utils.c needs more of the SDK than this file provides */
+void *safe_realloc(void *ptr, size_t size)
+{
+	return realloc(ptr, size);
+}
+
+void shim_mount(const char *device, const char *path)
+{
+	mount_device = device;
+	mount_path = path;
+}
+
+void shim_advance(SceInt64 us)
+{
+	now_us += us;
+}
+
+void shim_reset_counters(void)
+{
+	memset(&shim_calls, 0, sizeof(shim_calls));
+}
+
+static SceInt64 transfer_time(SceSize size)
+{
+	return shim_latency_us + shim_us_per_kb * size / 1024;
+}
+
+static int busy(SceUID fd)
+{
+	if (fd < 0 || fd >= SHIM_MAX_FD || !ops[fd].busy)
+		return 0;
+
+	shim_calls.errors++;
+	return 1;
+}
+
+SceUID sceIoOpen(const char *file, int flags, SceMode mode)
+{
+	int oflags = (flags & PSP_O_RDWR) == PSP_O_RDWR ? O_RDWR : (flags & PSP_O_WRONLY) ? O_WRONLY : O_RDONLY;
+	int fd;
+
+	if (flags & PSP_O_CREAT)
+		oflags |= O_CREAT;
+	if (flags & PSP_O_TRUNC)
+		oflags |= O_TRUNC;
+	if (flags & PSP_O_APPEND)
+		oflags |= O_APPEND;
+
+	if (mount_device != NULL && strcmp(file, mount_device) == 0)
+		file = mount_path;
+
+	shim_calls.opens++;
+	fd = open(file, oflags, mode);
+
+	if (fd >= SHIM_MAX_FD) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int sceIoClose(SceUID fd)
+{
+	if (busy(fd))
+		return SHIM_ERROR_ASYNC_BUSY;
+
+	return close(fd);
+}
+
+int sceIoRead(SceUID fd, void *data, SceSize size)
+{
+	off_t pos = lseek(fd, 0, SEEK_CUR);
+
+	if (busy(fd))
+		return SHIM_ERROR_ASYNC_BUSY;
+
+	shim_calls.reads++;
+	now_us += transfer_time(size);
+
+	if (shim_fail_offset >= pos && shim_fail_offset < pos + (off_t) size)
+		return SHIM_ERROR_IO;
+
+	return read(fd, data, size);
+}
+
+int sceIoWrite(SceUID fd, const void *data, SceSize size)
+{
+	if (busy(fd))
+		return SHIM_ERROR_ASYNC_BUSY;
+
+	return write(fd, data, size);
+}
+
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence)
+{
+	if (busy(fd))
+		return SHIM_ERROR_ASYNC_BUSY;
+
+	shim_calls.seeks++;
+
+	return lseek(fd, offset, whence);
+}
+
+int sceIoLseek32(SceUID fd, int offset, int whence)
+{
+	return sceIoLseek(fd, offset, whence);
+}
+
+int sceIoRemove(const char *file)
+{
+	return unlink(file);
+}
+
+int sceIoMkdir(const char *dir, SceMode mode)
+{
+	return mkdir(dir, mode);
+}
+
+int sceIoGetstat(const char *file, SceIoStat * buf)
+{
+	struct stat st;
+
+	if (mount_device != NULL && strcmp(file, mount_device) == 0)
+		file = mount_path;
+
+	if (stat(file, &st) < 0)
+		return -1;
+
+	memset(buf, 0, sizeof(*buf));
+	buf->st_mode = S_ISDIR(st.st_mode) ? FIO_S_IFDIR : FIO_S_IFREG;
+	buf->st_size = st.st_size;
+
+	return 0;
+}
+
+int sceIoReadAsync(SceUID fd, void *data, SceSize size)
+{
+	struct async_op *op = &ops[fd];
+
+	if (busy(fd))
+		return SHIM_ERROR_ASYNC_BUSY;
+
+	shim_calls.async_reads++;
+	op->busy = 1;
+	op->data = data;
+	op->size = size;
+	op->pos = lseek(fd, 0, SEEK_CUR);
+	op->done = now_us + transfer_time(size);
+
+	return 0;
+}
+
+static int complete(SceUID fd, SceInt64 * res)
+{
+	struct async_op *op = &ops[fd];
+	ssize_t n = pread(fd, op->data, op->size, op->pos);
+
+	if (n > 0)
+		lseek(fd, op->pos + n, SEEK_SET);
+
+	op->busy = 0;
+	*res = n;
+
+	return 0;
+}
+
+int sceIoWaitAsync(SceUID fd, SceInt64 * res)
+{
+	shim_calls.waits++;
+
+	if (!ops[fd].busy) {
+		*res = 0;
+		return 0;
+	}
+
+	if (now_us < ops[fd].done)
+		now_us = ops[fd].done;
+
+	return complete(fd, res);
+}
+
+int sceIoPollAsync(SceUID fd, SceInt64 * res)
+{
+	shim_calls.polls++;
+
+	if (!ops[fd].busy) {
+		*res = 0;
+		return 0;
+	}
+
+	if (now_us < ops[fd].done)
+		return 1;
+
+	return complete(fd, res);
+}
+
+int sceIoChangeAsyncPriority(SceUID fd, int pri)
+{
+	return 0;
+}
+
+SceInt64 sceKernelGetSystemTimeWide(void)
+{
+	shim_calls.clock_reads++;
+
+	return now_us;
+}
+
+int sceKernelDelayThread(SceUInt delay)
+{
+	now_us += delay;
+
+	return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef PSP_SHIM_H
+#define PSP_SHIM_H
+
+#include <pspkerneltypes.h>
+
+/*
+ * The sceIo calls are served from host files on a simulated clock. An async
+ * read completes shim_latency_us plus shim_us_per_kb per KB after it was
+ * issued, sceIoWaitAsync moves the clock there, sceIoPollAsync only looks.
+ * The test moves the clock with shim_advance() to model consumption.
+ */
+struct shim_counters
+{
+	unsigned opens;
+	unsigned reads;
+	unsigned async_reads;
+	unsigned polls;
+	unsigned waits;
+	unsigned seeks;
+	unsigned clock_reads;
+	/* calls the PSP would have refused, e.g. a seek with a read in flight */
+	unsigned errors;
+};
+
+extern struct shim_counters shim_calls;
+extern SceInt64 shim_latency_us;
+extern SceInt64 shim_us_per_kb;
+/* a sceIoRead covering this file offset fails, -1 for none */
+extern SceOff shim_fail_offset;
+
+/* sceIoOpen() of device opens the host file path instead */
+void shim_mount(const char *device, const char *path);
+void shim_advance(SceInt64 us);
+void shim_reset_counters(void);
+
+#endif
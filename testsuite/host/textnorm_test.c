@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "text.h"
+#include "textnorm.h"
+
+#define DOC_SIZE (8 << 20)
+#define FUZZ_RUNS 100000
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+		printf(__VA_ARGS__); \
+		putchar('\n'); \
+		failures++; \
+	} \
+} while (0)
+
+/*
+ * The separate passes text_normalize replaced, as they were. They read one
+ * byte before and one byte after the text, so old_normalize pads it.
+ */
+static int min_ratio = 20;
+
+static int old_fix_symbian_crlf(unsigned char *pos, unsigned char *posend)
+{
+	while (pos < posend) {
+		if (pos < posend - 1 && *pos == 0xa1 && *(pos + 1) == 0xf6) {
+			*pos = '\r';
+			*(pos + 1) = '\n';
+			pos += 2;
+		} else {
+			pos++;
+		}
+	}
+
+	return 0;
+}
+
+static u32 old_text_reorder(char *string, u32 size)
+{
+	int i;
+	char *wtxt = string, *ctxt = string, *etxt = string + size;
+
+	while (ctxt < etxt) {
+		while (ctxt < etxt && bytetable[*(u8 *) ctxt] == 0)
+			*wtxt++ = *ctxt++;
+		if (ctxt >= etxt)
+			break;
+		switch (*ctxt) {
+			case '\t':
+				*wtxt++ = ' ';
+				ctxt++;
+				for (i = 0; i < 3; i++)
+					if (*ctxt == ' ') {
+						*wtxt++ = ' ';
+						ctxt++;
+					}
+				while (ctxt < etxt && *ctxt == ' ')
+					ctxt++;
+				break;
+			case ' ':
+				*wtxt++ = ' ';
+				ctxt++;
+				if (ctxt - 1 > string && *(ctxt - 2) == '\n')
+					for (i = 0; i < 2; i++)
+						if (*ctxt == ' ') {
+							*wtxt++ = ' ';
+							ctxt++;
+						}
+				if (*ctxt == ' ') {
+					*wtxt++ = ' ';
+					ctxt++;
+				}
+				while (ctxt < etxt && *ctxt == ' ')
+					ctxt++;
+				break;
+			case '\r':
+			case '\n':
+				i = ((*ctxt == '\n') ? 1 : 0);
+				*wtxt++ = '\n';
+				ctxt++;
+				while (ctxt < etxt && (*ctxt == '\r' || *ctxt == '\n')) {
+					i += ((*ctxt == '\n') ? 1 : 0);
+					ctxt++;
+				}
+				if (i > 2)
+					*wtxt++ = '\n';
+				break;
+			case 0:
+				ctxt++;
+		}
+	}
+	return wtxt - string;
+}
+
+static size_t old_getTxtAvgLength(char *txtBuf, size_t txtLen)
+{
+	int linesize = 0, linecnt = 0;
+
+	while (txtLen-- > 0) {
+		if (*txtBuf == '\n') {
+			linecnt++;
+		} else {
+			if (*txtBuf != '\r') {
+				linesize++;
+			}
+		}
+		txtBuf++;
+	}
+	if (linecnt != 0)
+		return linesize / linecnt;
+	return 0;
+}
+
+/* the old join wrote to a second buffer, here the caller provides it */
+static size_t old_text_paragraph_join(const char *src, size_t txtlen, char *dst)
+{
+	char *p = dst;
+	int nlinesz = 0;
+	int cnt = txtlen;
+	size_t avgLength;
+
+	if (txtlen == 0)
+		return 0;
+
+	avgLength = old_getTxtAvgLength((char *) src, txtlen);
+
+	while (cnt-- > 0) {
+		if (*src == '\n') {
+			if (nlinesz < avgLength - avgLength * 1.0 / min_ratio) {
+				if (*(src - 1) == '\r') {
+					*p++ = '\r';
+				}
+				*p++ = '\n';
+			}
+			nlinesz = 0;
+		} else if (*src != '\r') {
+			nlinesz++;
+			*p++ = *src;
+		}
+		src++;
+	}
+
+	return p - dst;
+}
+
+/* pad[1..len] holds the text, pad[0] and pad[len + 1] are 0 as after calloc(size + 1) */
+static u32 old_normalize(char *pad, u32 len, int flags, char *out)
+{
+	char *txt = pad + 1;
+
+	if (flags & TEXT_NORM_SYMBIAN_CRLF)
+		old_fix_symbian_crlf((unsigned char *) txt, (unsigned char *) txt + len);
+	if (flags & TEXT_NORM_REORDER)
+		len = old_text_reorder(txt, len);
+	if (flags & TEXT_NORM_JOIN)
+		return old_text_paragraph_join(txt, len, out);
+
+	memcpy(out, txt, len);
+
+	return len;
+}
+
+static char *pad, *want, *got;
+
+static void check_same(const char *name, const char *text, u32 len, int flags)
+{
+	u32 n, m;
+
+	pad[0] = '\0';
+	memcpy(pad + 1, text, len);
+	pad[len + 1] = '\0';
+	n = old_normalize(pad, len, flags, want);
+
+	memcpy(got, text, len);
+	m = text_normalize(got, len, flags);
+
+	CHECK(m == n && memcmp(got, want, n) == 0, "%s, flags %d: %u bytes, the old passes gave %u", name, flags, (unsigned) m, (unsigned) n);
+}
+
+static void check_all_flags(const char *name, const char *text, u32 len)
+{
+	int flags;
+
+	for (flags = 0; flags <= (TEXT_NORM_SYMBIAN_CRLF | TEXT_NORM_REORDER | TEXT_NORM_JOIN); flags++)
+		check_same(name, text, len, flags);
+}
+
+#define CHECK_TEXT(name, text) check_all_flags(name, text, sizeof(text) - 1)
+
+static void check_edges(void)
+{
+	CHECK(text_normalize(got, 0, TEXT_NORM_SYMBIAN_CRLF | TEXT_NORM_REORDER | TEXT_NORM_JOIN) == 0, "empty buffer");
+	CHECK(text_normalize(NULL, 0, TEXT_NORM_REORDER | TEXT_NORM_JOIN) == 0, "NULL buffer");
+	CHECK_TEXT("empty", "");
+	CHECK_TEXT("CRLF pairs", "a long line of text\r\nshort\r\n\r\n\r\nanother long line\r\nend\r\n");
+	CHECK_TEXT("CRLF only", "\r\n\r\n");
+	CHECK_TEXT("trailing CR", "abc\r");
+	CHECK_TEXT("trailing CR after CRLF", "abcdef\r\ng\r");
+	CHECK_TEXT("leading CR", "\rabc\n");
+	CHECK_TEXT("lone LF", "\n");
+	CHECK_TEXT("Symbian pairs", "first line\xa1\xf6second\xa1\xf6\xa1\xf6third");
+	CHECK_TEXT("Symbian lead at the end", "text\xa1");
+	CHECK_TEXT("Symbian pair after a lead byte", "\xa1\xa1\xf6x");
+	CHECK_TEXT("Symbian pair next to CRLF", "a\r\xa1\xf6\nb");
+	CHECK_TEXT("tabs and spaces", "\t  a\n    b\t\t c  \n  ");
+	CHECK_TEXT("trailing space", "abc ");
+	CHECK_TEXT("trailing tab", "abc\t");
+	CHECK_TEXT("blank lines", "a\n\n\n\n\nb\n\nc");
+	CHECK_TEXT("NUL bytes", "a\0b\n\0\n");
+}
+
+/* short random texts over the bytes every pass treats specially */
+static void check_fuzz(void)
+{
+	static const char alphabet[] = "ab \t\r\n\0\xa1\xf6\xb0";
+	char text[256];
+	int run;
+
+	srand(47);
+
+	for (run = 0; run < FUZZ_RUNS; run++) {
+		u32 len = rand() % sizeof(text), i;
+		char name[32];
+
+		for (i = 0; i < len; i++)
+			text[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+
+		snprintf(name, sizeof(name), "fuzz run %d", run);
+		check_all_flags(name, text, len);
+	}
+}
+
+/* a book-like text: lines of words, CRLF and Symbian line ends, indents and blank lines */
+static void make_doc(char *doc, u32 size)
+{
+	u32 i = 0;
+
+	srand(1);
+
+	while (i < size) {
+		int r = rand() % 100;
+
+		if (r < 2)
+			doc[i++] = '\t';
+		else if (r < 12)
+			doc[i++] = ' ';
+		else if (r < 14 && i + 1 < size) {
+			doc[i++] = '\r';
+			doc[i++] = '\n';
+		} else if (r < 15 && i + 1 < size) {
+			doc[i++] = 0xa1;
+			doc[i++] = 0xf6;
+		} else if (r < 16)
+			doc[i++] = '\n';
+		else if (r < 60 && i + 1 < size) {
+			doc[i++] = 0xb0 + rand() % 32;
+			doc[i++] = 0xa1 + rand() % 94;
+		} else
+			doc[i++] = 'a' + rand() % 26;
+	}
+}
+
+static void bench(const char *doc, u32 size, int flags, const char *what)
+{
+	clock_t t_old, t_new;
+	u32 n, m;
+
+	pad[0] = '\0';
+	memcpy(pad + 1, doc, size);
+	pad[size + 1] = '\0';
+	t_old = clock();
+	n = old_normalize(pad, size, flags, want);
+	t_old = clock() - t_old;
+
+	memcpy(got, doc, size);
+	t_new = clock();
+	m = text_normalize(got, size, flags);
+	t_new = clock() - t_new;
+
+	CHECK(m == n && memcmp(got, want, n) == 0, "%s: %u bytes, the old passes gave %u", what, (unsigned) m, (unsigned) n);
+	printf("textnorm_test: %-20s old passes %.3fs, text_normalize %.3fs\n", what, (double) t_old / CLOCKS_PER_SEC, (double) t_new / CLOCKS_PER_SEC);
+}
+
+int main(void)
+{
+	char *doc;
+
+	doc = malloc(DOC_SIZE);
+	pad = malloc(DOC_SIZE + 2);
+	want = malloc(DOC_SIZE);
+	got = malloc(DOC_SIZE);
+
+	if (doc == NULL || pad == NULL || want == NULL || got == NULL) {
+		printf("FAIL: out of memory\n");
+		return 1;
+	}
+
+	check_edges();
+	check_fuzz();
+
+	make_doc(doc, DOC_SIZE);
+	printf("textnorm_test: %u bytes of text\n", (unsigned) DOC_SIZE);
+	bench(doc, DOC_SIZE, TEXT_NORM_SYMBIAN_CRLF, "symbian");
+	bench(doc, DOC_SIZE, TEXT_NORM_REORDER, "reorder");
+	bench(doc, DOC_SIZE, TEXT_NORM_JOIN, "join");
+	bench(doc, DOC_SIZE, TEXT_NORM_REORDER | TEXT_NORM_JOIN, "reorder+join");
+	bench(doc, DOC_SIZE, TEXT_NORM_SYMBIAN_CRLF | TEXT_NORM_REORDER | TEXT_NORM_JOIN, "symbian+reorder+join");
+
+	free(doc);
+	free(pad);
+	free(want);
+	free(got);
+
+	printf("textnorm_test: %d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
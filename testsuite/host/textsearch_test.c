@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pspkernel.h>
+#include "text.h"
+#include "textsearch.h"
+#include "bookmark.h"
+#include "freq_lock.h"
+#include "scene.h"
+#include "strsafe.h"
+#include "charsets.h"
+
+/* above TEXTSEARCH_MIN_SIZE, so the index is saved and read back */
+#define TEXT_SIZE (3 * 1024 * 1024 / 2)
+#define ROW_BYTES 50
+#define MAX_MATCHES (1 << 20)
+
+static t_text txt;
+static u32 expected[MAX_MATCHES], got[MAX_MATCHES];
+static int failures;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+		printf(__VA_ARGS__); \
+		putchar('\n'); \
+		failures++; \
+	} \
+} while (0)
+
+const char *scene_appdir(void)
+{
+	return "";
+}
+
+u32 bookmark_encode(const char *filename)
+{
+	return 0x12345678;
+}
+
+int freq_enter_hotzone(void)
+{
+	return 0;
+}
+
+int freq_leave(int freq_id)
+{
+	return 0;
+}
+
+/* GBK-like text: double-byte characters, ASCII and newlines, rows split on character boundaries */
+static void make_text(void)
+{
+	u32 i = 0, pos = 0, row = 0;
+
+	STRCPY_S(txt.filename, "ms0:/book.txt");
+	txt.buf = malloc(TEXT_SIZE);
+	txt.size = TEXT_SIZE;
+
+	while (i < TEXT_SIZE) {
+		int r = rand() % 10;
+
+		if (r < 6 && i + 1 < TEXT_SIZE) {
+			int z = rand() % 3000;
+
+			txt.buf[i++] = 0xB0 + z / 94;
+			txt.buf[i++] = 0xA1 + z % 94;
+		} else if (r < 9) {
+			txt.buf[i++] = 'a' + rand() % 3;
+		} else {
+			txt.buf[i++] = '\n';
+		}
+	}
+
+	while (pos < TEXT_SIZE) {
+		u32 end = pos;
+
+		if ((row & 0x3FF) == 0)
+			txt.rows[row >> 10] = calloc(1024, sizeof(t_textrow));
+
+		txt.rows[row >> 10][row & 0x3FF].start = txt.buf + pos;
+
+		while (end < TEXT_SIZE && end - pos < ROW_BYTES)
+			end += (u8) txt.buf[end] >= 0x80 ? 2 : 1;
+
+		txt.rows[row >> 10][row & 0x3FF].count = end - pos;
+		pos = end;
+		row++;
+	}
+
+	txt.row_count = row;
+}
+
+/* non-overlapping matches starting on character boundaries */
+static u32 naive_find_all(const char *pattern, u32 * pos)
+{
+	const u8 *buf = (const u8 *) txt.buf;
+	size_t len = strlen(pattern);
+	u32 i = 0, count = 0;
+
+	while (i + len <= txt.size) {
+		if (memcmp(buf + i, pattern, len) == 0) {
+			pos[count++] = i;
+			i += len;
+		} else
+			i += buf[i] >= 0x80 ? 2 : 1;
+	}
+
+	return count;
+}
+
+static u32 row_start(u32 row)
+{
+	if (row >= txt.row_count)
+		return txt.size;
+
+	return txt.rows[row >> 10][row & 0x3FF].start - txt.buf;
+}
+
+static void check_find_all(const char *name, const char *pattern)
+{
+	u32 n = naive_find_all(pattern, expected);
+	u32 m = textsearch_find_all(&txt, pattern, strlen(pattern), got, MAX_MATCHES);
+
+	CHECK(n > 0, "%s: pattern %s does not occur", name, pattern);
+	CHECK(m == n && memcmp(got, expected, n * sizeof(u32)) == 0, "%s: %s found %u times, expected %u", name, pattern, (unsigned) m, (unsigned) n);
+}
+
+/* what the jump key in scene_text does: each search moves to the row of the next match */
+static void check_next_row(const char *pattern)
+{
+	u32 n = naive_find_all(pattern, expected), i, k = 0, row;
+
+	txt.crow = 0;
+
+	for (i = 0; i < 100 && n > 0; i++) {
+		// the first match that starts at or after the next row, wrapping to the first
+		while (k < n && expected[k] < row_start(txt.crow + 1))
+			k++;
+
+		if (k == n)
+			k = 0;
+
+		if (textsearch_next_row(&txt, pattern, strlen(pattern), &row) != 0) {
+			CHECK(0, "%s: no match after row %u", pattern, (unsigned) txt.crow);
+			return;
+		}
+
+		CHECK(row == textsearch_offset_to_row(&txt, expected[k]) && row_start(row) <= expected[k] && (row + 1 == txt.row_count || expected[k] < row_start(row + 1)),
+			  "%s: jumped to row %u, match at %u", pattern, (unsigned) row, (unsigned) expected[k]);
+
+		txt.crow = row;
+	}
+
+	// from the last row the search wraps to the first match
+	txt.crow = txt.row_count - 1;
+	CHECK(textsearch_next_row(&txt, pattern, strlen(pattern), &row) == 0 && row == textsearch_offset_to_row(&txt, expected[0]), "%s: no wrap from the last row", pattern);
+}
+
+/* the first nchars characters of a row, so the pattern occurs at least once */
+static const char *row_pattern(u32 row, u32 nchars)
+{
+	static char buf[8][32];
+	static int next;
+	char *pat = buf[next++ % 8];
+	const u8 *p = (const u8 *) txt.buf + row_start(row);
+	u32 len = 0;
+
+	while (nchars-- > 0)
+		len += p[len] >= 0x80 ? 2 : 1;
+
+	memcpy(pat, p, len);
+	pat[len] = '\0';
+
+	return pat;
+}
+
+/*
+ * A query typed on the Chinese OSK comes back as UCS-2; osk.c converts it
+ * with charsets_ucs_conv before the search, so it must find the GBK row.
+ */
+static void check_osk_query(u32 row)
+{
+	const u8 *p;
+	unsigned short ucs[16];
+	char gbk[sizeof(ucs) + 1];
+	const char *pattern;
+	u32 i, n = 0;
+
+	// a row that starts with a double-byte character
+	while ((u8) txt.buf[row_start(row)] < 0x80)
+		row++;
+
+	pattern = row_pattern(row, 4);
+
+	for (p = (const u8 *) pattern; *p != '\0'; n++) {
+		ucs4_t wc;
+		int l = gbk_mbtowc(&wc, p, 2);
+
+		CHECK(l > 0, "cannot decode %02x%02x", p[0], p[1]);
+		if (l <= 0)
+			return;
+
+		ucs[n] = wc;
+		p += l;
+	}
+
+	ucs[n] = 0;
+	CHECK(ucs[0] >= 0x80, "query %04x is ASCII", ucs[0]);
+
+	charsets_ucs_conv((const u8 *) ucs, sizeof(ucs), (u8 *) gbk, sizeof(gbk) - 1);
+	CHECK(strcmp(gbk, pattern) == 0, "UCS-2 query did not convert back to the GBK text");
+	check_next_row(gbk);
+
+	// keeping the low byte of each character, as osk.c used to, finds nothing here
+	for (i = 0; i < n; i++)
+		gbk[i] = ucs[i];
+	gbk[n] = '\0';
+	CHECK(naive_find_all(gbk, expected) == 0 || strcmp(gbk, pattern) == 0, "truncated query %s occurs", gbk);
+}
+
+int main(void)
+{
+	const char *patterns[6];
+	u32 i, row, pos, edit;
+
+	make_text();
+	patterns[0] = "a";
+	patterns[1] = row_pattern(100, 2);
+	patterns[2] = row_pattern(5000, 3);
+	patterns[3] = row_pattern(12345, 4);
+	patterns[4] = row_pattern(20000, 6);
+	patterns[5] = NULL;
+	remove("textindex/12345678.idx");
+
+	for (i = 0; i < txt.row_count; i += 37) {
+		CHECK(textsearch_offset_to_row(&txt, row_start(i)) == i, "row %u", (unsigned) i);
+		CHECK(textsearch_offset_to_row(&txt, row_start(i) + 1) == i, "inside row %u", (unsigned) i);
+	}
+
+	for (i = 0; patterns[i] != NULL; i++) {
+		check_find_all("scan", patterns[i]);
+		check_next_row(patterns[i]);
+	}
+
+	CHECK(textsearch_build_index(&txt) == 0, "building the index failed");
+	CHECK(access("textindex/12345678.idx", 0) == 0, "index not saved");
+
+	for (i = 0; patterns[i] != NULL; i++) {
+		check_find_all("built index", patterns[i]);
+		check_next_row(patterns[i]);
+	}
+
+	check_osk_query(777);
+
+	textsearch_free(&txt);
+	CHECK(textsearch_build_index(&txt) == 0, "loading the index failed");
+
+	for (i = 0; patterns[i] != NULL; i++) {
+		check_find_all("saved index", patterns[i]);
+	}
+
+	// a changed text must not use the saved index; the edit replaces a whole row
+	textsearch_free(&txt);
+	edit = row_start(txt.row_count / 2);
+	memset(txt.buf + edit, 'x', row_start(txt.row_count / 2 + 1) - edit);
+	memcpy(txt.buf + edit, "xyzzy", 5);
+	CHECK(textsearch_build_index(&txt) == 0, "rebuilding the index failed");
+	CHECK(textsearch_find(&txt, "xyzzy", 5, 0, &pos) == 0 && pos == edit, "edited text not found");
+	check_find_all("rebuilt index", patterns[0]);
+
+	// the trail byte of one character and the lead byte of the next are not a match
+	txt.crow = 0;
+	CHECK(textsearch_next_row(&txt, "\xA1\xB0", 2, &row) != 0 || naive_find_all("\xA1\xB0", expected) > 0, "match across characters");
+	CHECK(textsearch_next_row(&txt, "not in the text", 15, &row) != 0, "missing text found");
+
+	textsearch_free(&txt);
+	remove("textindex/12345678.idx");
+	remove("textindex");
+
+	printf("textsearch_test: %d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
@@ -8,6 +8,8 @@
 #include "freq_lock.h"
 #include "rar_speed_test.h"
 #include "jpeg_speed_test.h"
+#include "resample_speed_test.h"
+#include "buffered_reader_test.h"
 #include "hprm_test.h"
 #include "display.h"
 #include "image_queue.h"
@@ -83,6 +85,8 @@ int main_thr(unsigned int args, void *argp)
 //      image_queue_test();
 //      jpeg_speed_test();
 //      rar_speed_test();
+//      resample_speed_test();
+//      buffered_reader_test();
 //      hprm_test();
 //      music_test();
 		sceKernelDelayThread(100000);
@@ -0,0 +1,114 @@
+#include <pspdebug.h>
+#include <pspkernel.h>
+#include <psprtc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+#include "common/datatype.h"
+#include "strsafe.h"
+#include "dbg.h"
+#include "freq_lock.h"
+#include "audiocore/resample.h"
+
+#define TEST_SECONDS 10
+#define TEST_OUT_FRAMES 1024
+
+static const struct
+{
+	int in_rate;
+	int out_rate;
+} rates[] = {
+	{ 88200, 44100 },
+	{ 96000, 48000 },
+	{ 64000, 48000 },
+	{ 37800, 44100 },
+	{ 192000, 48000 },
+};
+
+static const char *quality_names[] = { "fast", "medium", "best" };
+
+static int run_one(int in_rate, int out_rate, int quality)
+{
+	p_resampler r;
+	s16 out[TEST_OUT_FRAMES * 2];
+	s16 *tone;
+	u32 total = 0, target = out_rate * TEST_SECONDS;
+	u32 t = 0;
+	u64 start, now;
+	int i;
+
+	// One second of a 1kHz tone holds whole cycles, so it loops seamlessly
+	// and no sin() is left inside the timed region
+	tone = malloc(in_rate * sizeof(*tone));
+
+	if (tone == NULL) {
+		dbg_printf(d, "out of memory for %d->%d", in_rate, out_rate);
+		return -1;
+	}
+
+	for (i = 0; i < in_rate; ++i) {
+		tone[i] = (s16) (sin(2 * M_PI * 1000 * i / in_rate) * 16384);
+	}
+
+	r = resample_open(in_rate, out_rate, quality);
+
+	if (r == NULL) {
+		dbg_printf(d, "resample_open %d->%d failed", in_rate, out_rate);
+		free(tone);
+		return -1;
+	}
+
+	sceRtcGetCurrentTick(&start);
+
+	while (total < target) {
+		int n = resample_run(r, out, TEST_OUT_FRAMES);
+
+		if (n < TEST_OUT_FRAMES) {
+			int frames;
+			s16 *in = resample_input(r, &frames);
+
+			for (i = 0; i < frames; ++i) {
+				in[i * 2] = in[i * 2 + 1] = tone[t];
+
+				if (++t == (u32) in_rate)
+					t = 0;
+			}
+
+			resample_commit(r, frames);
+		}
+
+		total += n;
+	}
+
+	sceRtcGetCurrentTick(&now);
+	resample_close(r);
+	free(tone);
+
+	dbg_printf(d, "Benchmark: %d->%d %s: %.1f us per second of audio",
+			   in_rate, out_rate, quality_names[quality],
+			   pspDiffTime(&now, &start) * 1000000.0 / TEST_SECONDS);
+
+	return 0;
+}
+
+int resample_speed_test(void)
+{
+	int fid, q;
+	size_t i;
+
+	dbg_printf(d, "Start resample benchmark");
+
+	fid = freq_enter_hotzone();
+
+	for (q = RESAMPLE_FAST; q <= RESAMPLE_BEST; ++q) {
+		for (i = 0; i < NELEMS(rates); ++i) {
+			run_one(rates[i].in_rate, rates[i].out_rate, q);
+		}
+	}
+
+	freq_leave(fid);
+
+	return 0;
+}
@@ -0,0 +1,6 @@
+#ifndef RESAMPLE_SPEED_TEST_H
+#define RESAMPLE_SPEED_TEST_H
+
+int resample_speed_test(void);
+
+#endif
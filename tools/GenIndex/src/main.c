@@ -25,94 +25,90 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <sys/stat.h>
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
-#ifndef WIN32
+#if defined(WIN32) || defined(_MSC_VER)
+#include <windows.h>
+#else
 #include <iconv.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #endif
 #include "strsafe.h"
 #include "config.h"
 #include "dbg.h"
 
+#ifdef WIN32
+#define strcasecmp stricmp
+#endif
+
 #if !(defined(MAGICTOKEN) && defined(SPLITTOKEN))
 #error ûжMAGICTOKEN  SPLITTOKEN
 #endif
 
+/** xReader text.ccalc_giһ: ÿ1023ֽΪһGIҳ */
+#define GI_PAGE_SIZE 1023
+
+/** Ŀ¼Сҳ໥, 󲻶 */
+#define DIR_FIXUP_MAX 8
+
+/** ½ļչбʶ */
+#define INDEX_EXT ".idx"
+#define INDEX_MAGIC "#GenIndex 1"
+
+/** ͬʱļ */
+#define MAX_JOBS 64
+
 DBG *d;
 
+#ifndef WIN32
+/** ½ļȨ, ߳ǰȡumaskõ */
+static mode_t new_file_mode = 0644;
+#endif
+
 // Ŀ¼
 typedef struct
 {
 	char *name;
+	/** нԭļеƫ */
+	size_t body_end;
+	/** пʼԭļеƫ */
+	size_t body_start;
 	size_t page;
 } DirEntry;
 
 typedef struct
 {
-	char *path;
-	char *name;
+	const char *path;
+	const char *data;
 	size_t size;
 	size_t dirsize;
 	size_t context;
 	int newline_style;
+	DirEntry *dirs;
+	size_t dircnt;
+	size_t dircap;
 } TxtFile;
 
-DirEntry *AddDirEntry(const char *name, int page);
-void ParseFile(void);
-int PrintDir(FILE * fp);
-int VPrintDir(void);
-void FreeDirEntry(void);
-
-TxtFile g_file;
-DirEntry *g_dirs = 0;
-size_t g_dircnt = 0;
-size_t g_dircap = 0;
-
-#if defined(WIN32) || defined(_MSC_VER)
-#include <windows.h>
-void GetTempFilename(char *str, size_t size)
+typedef struct
 {
-	GetTempPath(size, str);
-	GetTempFileName(str, ("GenIndex_"), 0, str);
-}
+	char *const *files;
+	int count;
+	int next;
+	int write_index;
+	/** ʧܵļ */
+	int failed;
+#ifdef WIN32
+	CRITICAL_SECTION lock;
 #else
-void GetTempFilename(char *str, size_t size)
-{
-	strcpy_s(str, size, "/tmp/genXXXXXX");
-	const char *p = mktemp(str);
-}
+	pthread_mutex_t lock;
 #endif
-
-/* return 0 if newline is unix style, return 1 if newline is dos style, return -1 on error */
-int detect_unix_dos(const char *fn)
-{
-	char buf[65536];
-	unsigned cunix, cdos;
-	FILE *fp;
-
-	fp = fopen(fn, "rb");
-
-	if (fp == NULL) {
-		return -1;
-	}
-
-	cunix = cdos = 0;
-	while (fgets(buf, sizeof(buf), fp) != NULL) {
-		size_t len = strlen(buf);
-
-		if (len >= 2 && buf[len - 1] == '\n' && buf[len - 2] == '\r') {
-			cdos++;
-		} else if (len >= 1 && buf[len - 1] == '\n') {
-			cunix++;
-		}
-	}
-
-	fclose(fp);
-
-	return cdos > cunix;
-}
+} JobQueue;
 
 char to_locale[20];
 
@@ -157,7 +153,7 @@ int conv_gbk_to_current_locale(const char *gbkstr, size_t size, char **ptr,
 
 	char *p = (char *) gbkstr;
 	char *q = *ptr;
-	int left = size, oleft = len;
+	size_t left = size, oleft = len;
 
 	while (left > 0 && (ret = (int) iconv(ic, &p, &left, &q, &oleft)) != -1) {
 	}
@@ -185,9 +181,12 @@ static int err_msg(const char *fmt, ...)
 	char *t = NULL;
 	int tsize;
 
-	conv_gbk_to_current_locale(buf, strlen(buf), &t, &tsize);
-
-	fprintf(stderr, "%s", t);
+	if (conv_gbk_to_current_locale(buf, strlen(buf), &t, &tsize) == 0
+		&& t != NULL) {
+		fprintf(stderr, "%s", t);
+	} else {
+		fprintf(stderr, "%s", buf);
+	}
 
 	free(t);
 
@@ -196,425 +195,745 @@ static int err_msg(const char *fmt, ...)
 	return 0;
 }
 
-int do_each_file(const char *fn)
+static DirEntry *AddDirEntry(TxtFile * file, const char *name, size_t len,
+							 size_t start, size_t end)
 {
-	struct stat statbuf;
+	DirEntry *e;
 
-	if (stat(fn, &statbuf) != 0) {
-		err_msg("ļ%sûҵ", fn);
-		return -1;
-	} else {
-		dbg_printf(d, "ļ: %s С: %ldֽ", fn, statbuf.st_size);
-		g_file.name = strdup(fn);
-		if (strrchr(g_file.name, '\\') != 0) {
-			memmove(g_file.name, strrchr(g_file.name, '\\') + 1,
-					strlen(strrchr(g_file.name, '\\') + 1) + 1);
+	if (file->dircnt >= file->dircap) {
+		size_t cap = file->dircap ? file->dircap * 2 : 16;
+
+		e = (DirEntry *) realloc(file->dirs, sizeof(DirEntry) * cap);
+
+		if (e == NULL) {
+			return NULL;
 		}
-		g_file.path = strdup(fn);
-		g_file.size = statbuf.st_size;
+
+		file->dirs = e;
+		file->dircap = cap;
 	}
 
-	g_file.newline_style = detect_unix_dos(g_file.name);
+	e = &file->dirs[file->dircnt];
+	e->name = (char *) malloc(len + 1);
 
-	if (g_file.newline_style == 0) {
-		dbg_printf(d, "%s: UNIX", g_file.name);
-	} else if (g_file.newline_style == 1) {
-		dbg_printf(d, "%s: DOS", g_file.name);
-	} else {
-		dbg_printf(d, "%s: Unknown, assume DOS", g_file.name);
-		g_file.newline_style = 1;
+	if (e->name == NULL) {
+		return NULL;
 	}
 
-	ParseFile();
-	FreeDirEntry();
+	memcpy(e->name, name, len);
+	e->name[len] = '\0';
+	e->body_start = start;
+	e->body_end = end;
+	e->page = 0;
+	file->dircnt++;
 
-	if (g_file.name != NULL) {
-		free(g_file.name);
-		g_file.name = NULL;
-	}
+	return e;
+}
+
+static void FreeDirEntry(TxtFile * file)
+{
+	size_t i;
 
-	if (g_file.path != NULL) {
-		free(g_file.path);
-		g_file.path = NULL;
+	for (i = 0; i < file->dircnt; ++i) {
+		free(file->dirs[i].name);
 	}
+
+	free(file->dirs);
+	file->dirs = NULL;
+	file->dircnt = file->dircap = 0;
 }
 
-int main(int argc, char *argv[])
+/**
+ * [p, end)вұ
+ *
+ * @note memchrλַٱȽ, ֽstrströ
+ */
+static const char *find_token(const char *p, const char *end,
+							  const char *token, size_t toklen)
 {
-	struct stat statbuf;
-	int i;
+	while (end - p >= (ptrdiff_t) toklen) {
+		p = memchr(p, token[0], end - p - toklen + 1);
 
-	d = dbg_init();
-	dbg_open_stream(d, stderr);
-	dbg_switch(d, 0);
+		if (p == NULL) {
+			return NULL;
+		}
 
-	if (getenv("LANG") != NULL) {
-		set_output_locale(getenv("LANG"));
-	}
+		if (memcmp(p, token, toklen) == 0) {
+			return p;
+		}
 
-	if (argc < 2) {
-		err_msg("xReader Ŀ¼ɹ GenIndex (version 0.1)\n");
-		err_msg("÷: GenIndex.exe ļ.txt [-d]\n");
-		err_msg("                               -d: ģʽ\n");
-		err_msg("ʹ÷\n");
-		err_msg("1. TXT<<<<űעÿ¿ʼ\n");
-		err_msg("\n");
-		err_msg("<<<<һ XXX\n");
-		err_msg("....\n");
-		err_msg("<<<<ڶ YYY\n");
-		err_msg
-			("2. 󣬽TXTϵGenIndexͼУGenIndexͻΪĵ\n");
-		err_msg("һĿ¼\n");
-		err_msg("===================\n");
-		err_msg("ҳ Ŀ¼\n");
-		err_msg("1    һ XXX\n");
-		err_msg("2    ڶ YYY\n");
-		err_msg("===================\n");
-		err_msg
-			("3. ҳ־GIֵʱϢʾҪƶĳ£ҳֱGIȼҵ¡GIǾҳ룬ΪСı䡣\n");
-#ifdef WIN32
-		system("pause");
-#endif
-		return -1;
+		p++;
 	}
 
-	for (i = 1; i < argc; ++i) {
-#ifdef WIN32
-		if (stricmp(argv[i], "-d") == 0) {
-			dbg_switch(d, 1);
+	return NULL;
+}
+
+/**
+ * ɨļ
+ *
+ * ͬʱɻз, ҾĿ¼Ľλúռ½ڱǡ
+ * Ŀ¼֮ǰռıڶָʱ
+ */
+static void ScanFile(TxtFile * file)
+{
+	const char *p = file->data, *end = file->data + file->size;
+	const size_t splitlen = strlen(SPLITTOKEN), toklen = strlen(MAGICTOKEN);
+	unsigned cunix = 0, cdos = 0, split = 0;
+
+	file->context = 0;
+
+	while (p < end) {
+		const char *eol = memchr(p, '\n', end - p);
+		const char *next = eol ? eol + 1 : end;
+		const char *lend = eol ? eol : end;
+		const char *mark;
+
+		if (eol != NULL) {
+			if (eol > p && eol[-1] == '\r') {
+				lend--;
+				cdos++;
+			} else {
+				cunix++;
+			}
+		} else if (lend > p && lend[-1] == '\r') {
+			lend--;
 		}
-#else
-		if (strcasecmp(argv[i], "-d") == 0) {
-			dbg_switch(d, 1);
+
+		if (split < 2 && lend - p == (ptrdiff_t) splitlen
+			&& memcmp(p, SPLITTOKEN, splitlen) == 0) {
+			if (++split == 2) {
+				size_t i;
+
+				file->context = next - file->data;
+
+				for (i = 0; i < file->dircnt; ++i) {
+					free(file->dirs[i].name);
+				}
+
+				file->dircnt = 0;
+			}
+		} else if ((mark =
+					find_token(p, lend, MAGICTOKEN, toklen)) != NULL) {
+			mark += toklen;
+			dbg_printf(d, "ҵ: %.*s", (int) (lend - p), p);
+
+			if (AddDirEntry
+				(file, mark, lend - mark, p - file->data,
+				 next - file->data) == NULL) {
+				err_msg("ڴ治\n");
+				break;
+			}
 		}
-#endif
+
+		p = next;
 	}
 
-	for (i = 1; i < argc; ++i) {
-#ifdef WIN32
-		if (stricmp(argv[i], "-d") == 0) {
-			continue;
-		}
-#else
-		if (strcasecmp(argv[i], "-d") == 0) {
-			continue;
-		}
-#endif
+	file->newline_style = cdos > cunix;
 
-		do_each_file(argv[i]);
+	if (cdos + cunix == 0) {
+		dbg_printf(d, "%s: Unknown, assume DOS", file->path);
+		file->newline_style = 1;
+	} else {
+		dbg_printf(d, "%s: %s", file->path,
+				   file->newline_style ? "DOS" : "UNIX");
 	}
 
-	dbg_close(d);
-	return 0;
+	dbg_printf(d, "Ŀʼ%luֽ", (unsigned long) file->context);
 }
 
-int GetCurPageNum(FILE * fp, int offset)
+static const char *newline_of(const TxtFile * file)
 {
-	size_t pos;
-	pos = ftell(fp) + offset;
-	if (pos / 1023 != 0) {
-		return (int) ((double) (pos) / 1023.0 + 0.5);
-	} else
-		return 1;				/* ⷵ0ҳ */
+	return file->newline_style ? "\r\n" : "\n";
 }
 
-void SearchDir(FILE * fp)
+static size_t page_width(size_t page)
 {
-	int iSplitCnt = 0;
-	char buf[65536];
+	size_t w = 1;
 
-	// Ŀ¼
-	FreeDirEntry();
+	while (page >= 10) {
+		page /= 10;
+		w++;
+	}
 
-	fseek(fp, 0, SEEK_SET);
+	return w < 4 ? 4 : w;
+}
 
-	// ҵĿ¼ַ
-	while (!feof(fp)) {
-		if (fgets(buf, sizeof(buf) / sizeof(buf[0]), fp)) {
-			size_t len = strlen(buf);
+/**
+ * Ŀ¼С, PrintDirֽһ
+ */
+static size_t VPrintDir(const TxtFile * file)
+{
+	size_t i, bytes, nl = strlen(newline_of(file));
 
-			if (len >= 2) {
-				if (buf[len - 1] == '\n') {
-					buf[len - 1] = '\0';
-				}
+	if (file->dircnt == 0)
+		return 0;
 
-				if (buf[len - 2] == '\r') {
-					buf[len - 2] = '\0';
-				}
-			}
+	bytes = (strlen(SPLITTOKEN) + nl) * 2;
+	bytes += strlen("ҳ Ŀ¼") + nl;
+
+	for (i = 0; i < file->dircnt; ++i) {
+		bytes += page_width(file->dirs[i].page) + 1 +
+			strlen(file->dirs[i].name) + nl;
+	}
+
+	return bytes;
+}
+
+static int PrintDir(const TxtFile * file, FILE * fp)
+{
+	size_t i;
+	const char *nl = newline_of(file);
+
+	dbg_printf(d, "ʼӡĿ¼:");
+
+	if (file->dircnt == 0)
+		return 0;
+
+	fprintf(fp, "%s%s", SPLITTOKEN, nl);
+	fprintf(fp, "ҳ Ŀ¼%s", nl);
 
-			if (strcmp(buf, SPLITTOKEN) == 0)
-				iSplitCnt++;
+	for (i = 0; i < file->dircnt; ++i) {
+		fprintf(fp, "%-4lu %s%s", (unsigned long) file->dirs[i].page,
+				file->dirs[i].name, nl);
+	}
+
+	return fprintf(fp, "%s%s", SPLITTOKEN, nl) < 0 ? -1 : 0;
+}
+
+/**
+ * ÿµGIҳ
+ *
+ * ҳȡнļеƫ, ͬcalc_gi: offset / 1023 + 1
+ * Ŀ¼֮ǰ, Сȡҳλ, ʵĿ¼Сٱ仯
+ */
+static void CalcPages(TxtFile * file)
+{
+	size_t i, n, dirsize = 0;
+
+	for (n = 0; n < DIR_FIXUP_MAX; ++n) {
+		for (i = 0; i < file->dircnt; ++i) {
+			file->dirs[i].page =
+				(dirsize + file->dirs[i].body_end -
+				 file->context) / GI_PAGE_SIZE + 1;
 		}
-		if (iSplitCnt >= 2)
+
+		file->dirsize = VPrintDir(file);
+
+		if (file->dirsize == dirsize)
 			break;
+
+		dirsize = file->dirsize;
 	}
 
-	if (iSplitCnt == 0)
-		g_file.context = 0;
-	if (iSplitCnt >= 2) {
-		g_file.context = ftell(fp);
+	dbg_printf(d, "Ŀ¼СΪ%luֽ", (unsigned long) file->dirsize);
+}
+
+/**
+ * ɶ½
+ *
+ * ΪINDEX_MAGIC, ֮ÿһ: ļбеֽƫ, GIҳ, ½,
+ * TABָ, ½GBK
+ */
+static int PrintIndex(const TxtFile * file, FILE * fp)
+{
+	size_t i;
+
+	fprintf(fp, "%s\n", INDEX_MAGIC);
+
+	for (i = 0; i < file->dircnt; ++i) {
+		fprintf(fp, "%lu\t%lu\t%s\n",
+				(unsigned long) (file->dirsize + file->dirs[i].body_start -
+								 file->context),
+				(unsigned long) file->dirs[i].page, file->dirs[i].name);
 	}
 
-	dbg_printf(d, "Ŀʼ%dֽ", g_file.context);
+	return ferror(fp) ? -1 : 0;
+}
+
+/**
+ * ĿļͬһĿ¼´ʱļ, Ա֤renameļϵͳ
+ */
+static FILE *open_temp(const char *path, char *tmpname, size_t size)
+{
+#ifdef WIN32
+	char dir[MAX_PATH];
+	char *p;
+
+	STRCPY_S(dir, path);
+	p = strrchr(dir, '\\');
 
-	fseek(fp, g_file.context, SEEK_SET);
+	if (p != NULL) {
+		*p = '\0';
+	} else {
+		STRCPY_S(dir, ".");
+	}
 
-	dbg_printf(d, "ɨļ,%dֽƫ", g_file.dirsize);
-	while (!feof(fp)) {
-		if (fgets(buf, sizeof(buf) / sizeof(buf[0]), fp)) {
-			size_t len = strlen(buf);
+	if (size < MAX_PATH || GetTempFileName(dir, "GenIndex_", 0, tmpname) == 0)
+		return NULL;
 
-			if (len >= 2) {
-				if (buf[len - 1] == '\n')
-					buf[len - 1] = '\0';
+	return fopen(tmpname, "wb");
+#else
+	struct stat st;
+	int fd;
+	FILE *fp;
 
-				if (buf[len - 2] == '\r') {
-					buf[len - 2] = '\0';
-				}
-			}
+	if (snprintf_s(tmpname, size, "%s.genXXXXXX", path) < 0)
+		return NULL;
 
-			if (strstr(buf, MAGICTOKEN) != 0) {
-				char *p;
-				dbg_printf(d, "ҵ: %s", buf);
+	fd = mkstemp(tmpname);
 
-				p = strstr(buf, MAGICTOKEN) + strlen(MAGICTOKEN);
-				AddDirEntry(p,
-							GetCurPageNum(fp, g_file.dirsize - g_file.context));
-				dbg_printf(d, "Ӽ¼%d(: %s ҳ %d)", g_dircnt,
-						   g_dirs[g_dircnt - 1].name,
-						   g_dirs[g_dircnt - 1].page);
-			}
-		}
+	if (fd < 0)
+		return NULL;
+
+	// mkstempļȨΪ0600, ΪԭļȨ, ļumask
+	if (fchmod(fd, stat(path, &st) == 0 ? st.st_mode & 07777 : new_file_mode) != 0) {
+		close(fd);
+		unlink(tmpname);
+		return NULL;
 	}
+
+	fp = fdopen(fd, "wb");
+
+	if (fp == NULL) {
+		close(fd);
+		unlink(tmpname);
+	}
+
+	return fp;
+#endif
+}
+
+static int replace_file(const char *tmpname, const char *path)
+{
+#ifdef WIN32
+	return MoveFileEx(tmpname, path, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+	return rename(tmpname, path);
+#endif
 }
 
-static int copy_file(const char *srcfile, const char *dstfile)
+static void remove_file(const char *path)
 {
-	FILE *fout, *fin;
-	char buf[BUFSIZ];
+#ifdef WIN32
+	DeleteFile(path);
+#else
+	unlink(path);
+#endif
+}
 
-	fout = fopen(dstfile, "wb");
+/**
+ * fillддʱļ, ɹԭ滻path
+ */
+static int write_replace(const char *path, const TxtFile * file,
+						 int (*fill) (const TxtFile * file, FILE * fp))
+{
+	char tmpname[MAX_PATH + 16];
+	FILE *fp;
+	int ret;
+
+	fp = open_temp(path, tmpname, sizeof(tmpname));
 
-	if (fout == NULL)
+	if (fp == NULL) {
+		err_msg("%sʱļʧ\n", path);
 		return -1;
+	}
 
-	fin = fopen(srcfile, "rb");
+	dbg_printf(d, "õʱļ%s", tmpname);
+	ret = fill(file, fp);
 
-	if (fin == NULL) {
-		fclose(fout);
+	if (fclose(fp) != 0)
+		ret = -1;
+
+	if (ret == 0 && replace_file(tmpname, path) != 0) {
+		err_msg("rename failed: %s\n", strerror(errno));
+		ret = -1;
+	}
+
+	if (ret != 0)
+		remove_file(tmpname);
+
+	return ret;
+}
+
+static int fill_book(const TxtFile * file, FILE * fp)
+{
+	size_t len = file->size - file->context;
+
+	if (PrintDir(file, fp) < 0)
+		return -1;
+
+	return fwrite(file->data + file->context, 1, len, fp) == len ? 0 : -1;
+}
+
+/**
+ * ļӳ䵽ڴ
+ *
+ * @return ɹ0, ļΪʱdataΪNULL
+ */
+static int map_file(TxtFile * file, void **handle)
+{
+#ifdef WIN32
+	HANDLE fh, mh;
+	DWORD high, low;
+
+	*handle = NULL;
+	fh = CreateFile(file->path, GENERIC_READ, FILE_SHARE_READ, NULL,
+					OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (fh == INVALID_HANDLE_VALUE)
+		return -1;
+
+	low = GetFileSize(fh, &high);
+	file->size = low;
+	file->data = NULL;
+
+	if (high != 0) {
+		CloseHandle(fh);
 		return -1;
 	}
 
-	size_t r;
+	if (file->size == 0) {
+		CloseHandle(fh);
+		return 0;
+	}
+
+	mh = CreateFileMapping(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(fh);
 
-	while ((r = fread(buf, 1, sizeof(buf), fin)) != 0) {
-		if (fwrite(buf, 1, r, fout) != r) {
-			fclose(fin);
-			fclose(fout);
-			return -1;
-		}
+	if (mh == NULL)
+		return -1;
+
+	file->data = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+
+	if (file->data == NULL) {
+		CloseHandle(mh);
+		return -1;
+	}
+
+	*handle = mh;
+	return 0;
+#else
+	struct stat statbuf;
+	int fd;
+	void *p;
+
+	*handle = NULL;
+	fd = open(file->path, O_RDONLY);
+
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &statbuf) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	file->size = statbuf.st_size;
+	file->data = NULL;
+
+	if (file->size == 0) {
+		close(fd);
+		return 0;
 	}
 
-	fclose(fin);
-	fclose(fout);
+	p = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (p == MAP_FAILED)
+		return -1;
+
+	madvise(p, file->size, MADV_SEQUENTIAL);
+	file->data = p;
 
 	return 0;
+#endif
 }
 
-void ParseFile(void)
+static void unmap_file(TxtFile * file, void *handle)
 {
-	int r;
-	char buf[BUFSIZ];
-	FILE *fp, *foutp;
-	char *szOutFn = 0;
-	dbg_printf(d, "TXTļ: С %d", g_file.size);
-	fp = fopen(g_file.path, "rb");
-	char str[4];
-	if (fgets(str, 4, fp) == NULL) {
+	if (file->data == NULL)
 		return;
-	}
 
-	if (str[0] == '\xef' && str[1] == '\xbb' && str[2] == '\xbf') {
-		err_msg("GenIndexܴUTF8 TXTļתΪGBK\n");
 #ifdef WIN32
-		system("pause");
+	UnmapViewOfFile(file->data);
+	CloseHandle((HANDLE) handle);
+#else
+	(void) handle;
+	munmap((void *) file->data, file->size);
 #endif
-		return;
-	}
+	file->data = NULL;
+}
 
-	g_file.dirsize = 0;
-	fseek(fp, 0, SEEK_SET);
-	SearchDir(fp);
+/**
+ * TXTļ
+ *
+ * @param fn ļ·
+ * @param write_index Ƿͬʱ½ļ
+ *
+ * @return ɹ0
+ */
+static int ParseFile(const char *fn, int write_index)
+{
+	TxtFile file;
+	void *handle;
+	int ret = -1;
 
-	g_file.dirsize = VPrintDir();
-	dbg_printf(d, "VPrintDir Ŀ¼СΪ%dֽ", g_file.dirsize);
+	memset(&file, 0, sizeof(file));
+	file.path = fn;
 
-	SearchDir(fp);
+	if (map_file(&file, &handle) != 0) {
+		err_msg("ļ%sûҵ\n", fn);
+		return -1;
+	}
 
-	szOutFn = (char *) malloc(MAX_PATH + 1);
-	GetTempFilename(szOutFn, MAX_PATH);
-	dbg_printf(d, "õʱļ%s", szOutFn);
-	foutp = fopen(szOutFn, "wb");
-	if (!foutp) {
-		dbg_printf(d, "ļ%sʧ", szOutFn);
-		return;
+	dbg_printf(d, "TXTļ: %s С %lu", fn, (unsigned long) file.size);
+
+	if (file.size == 0) {
+		return 0;
 	}
-	PrintDir(foutp);
-	// ӡ
-	fseek(fp, g_file.context, SEEK_SET);
 
-	while ((r = fread(buf, 1, sizeof(buf), fp)) != 0) {
-		if (fwrite(buf, 1, r, foutp) != r) {
-			break;
-		}
+	if (file.size >= 3 && memcmp(file.data, "\xef\xbb\xbf", 3) == 0) {
+		err_msg("%s: GenIndexܴUTF8 TXTļתΪGBK\n", fn);
+		goto exit;
 	}
 
-	fclose(fp);
-	fclose(foutp);
+	ScanFile(&file);
+	CalcPages(&file);
+
+	if (write_replace(fn, &file, fill_book) != 0)
+		goto exit;
+
+	if (write_index && file.dircnt > 0) {
+		char idxname[MAX_PATH + 8];
+
+		snprintf_s(idxname, sizeof(idxname), "%s%s", fn, INDEX_EXT);
+
+		if (write_replace(idxname, &file, PrintIndex) != 0)
+			goto exit;
+	}
+
+	dbg_printf(d, "%s: %lu ", fn, (unsigned long) file.dircnt);
+	ret = 0;
+
+  exit:
+	unmap_file(&file, handle);
+	FreeDirEntry(&file);
+
+	return ret;
+}
+
+/**
+ * ȡһļ, ͬʱ¼һļǷʧ
+ */
+static const char *queue_next(JobQueue * q, int last_failed)
+{
+	const char *fn = NULL;
+
 #ifdef WIN32
-	DeleteFile(g_file.path);
+	EnterCriticalSection(&q->lock);
 #else
-	unlink(g_file.path);
+	pthread_mutex_lock(&q->lock);
 #endif
+
+	if (last_failed)
+		q->failed++;
+
+	if (q->next < q->count)
+		fn = q->files[q->next++];
+
 #ifdef WIN32
-	MoveFile(szOutFn, g_file.path);
+	LeaveCriticalSection(&q->lock);
 #else
-	int ret = rename(szOutFn, g_file.path);
-	if (ret != 0) {
-		if (errno == EXDEV) {
-			ret = copy_file(szOutFn, g_file.path);
-			if (ret != 0) {
-				err_msg("copy_file failed\n");
-				return;
-			}
-			unlink(szOutFn);
-		} else {
-			err_msg("rename failed\n");
-			return;
-		}
-	}
+	pthread_mutex_unlock(&q->lock);
 #endif
-	dbg_printf(d, "Ŀ¼С%dֽ \n", g_file.dirsize);
-	free(szOutFn);
+
+	return fn;
 }
 
-int VPrintDirDOS()
+#ifdef WIN32
+static DWORD WINAPI worker(LPVOID arg)
+#else
+static void *worker(void *arg)
+#endif
 {
-	int i, bytes;
-	char buf[BUFSIZ];
-	if (g_dircnt == 0)
-		return 0;
-	bytes = SPRINTF_S(buf, "%s\r\n", SPLITTOKEN);
-	bytes += SPRINTF_S(buf, "ҳ Ŀ¼\r\n");
-	for (i = 0; i < g_dircnt; ++i) {
-		bytes += SPRINTF_S(buf, "%-4d %s\r\n", g_dirs[i].page, g_dirs[i].name);
+	JobQueue *q = (JobQueue *) arg;
+	const char *fn;
+	int failed = 0;
+
+	while ((fn = queue_next(q, failed)) != NULL) {
+		failed = ParseFile(fn, q->write_index) != 0;
 	}
-	bytes += SPRINTF_S(buf, "%s\r\n", SPLITTOKEN);
-	return bytes;
+
+	return 0;
 }
 
-int PrintDirDOS(FILE * fp)
+static int cpu_count(void)
 {
-	int i, bytes;
-	dbg_printf(d, "ʼӡĿ¼:");
-	if (g_dircnt == 0)
-		return 0;
-	bytes = fprintf(fp, "%s\r\n", SPLITTOKEN);
-	bytes += fprintf(fp, "ҳ Ŀ¼\r\n");
-	for (i = 0; i < g_dircnt; ++i) {
-		bytes += fprintf(fp, "%-4d %s\r\n", g_dirs[i].page, g_dirs[i].name);
-	}
-	bytes += fprintf(fp, "%s\r\n", SPLITTOKEN);
-	return bytes;
+#ifdef WIN32
+	SYSTEM_INFO si;
+
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return n > 0 ? (int) n : 1;
+#endif
 }
 
-int PrintDirUNIX(FILE * fp)
+/**
+ * jobs̲߳дļ, ÿ̴߳Ӷȡһļ
+ */
+static void run_jobs(JobQueue * q, int jobs)
 {
-	int i, bytes;
-	dbg_printf(d, "ʼӡĿ¼:");
-	if (g_dircnt == 0)
-		return 0;
-	bytes = fprintf(fp, "%s\n", SPLITTOKEN);
-	bytes += fprintf(fp, "ҳ Ŀ¼\n");
-	for (i = 0; i < g_dircnt; ++i) {
-		bytes += fprintf(fp, "%-4d %s\n", g_dirs[i].page, g_dirs[i].name);
+	int i;
+
+	if (jobs > q->count)
+		jobs = q->count;
+
+#ifdef WIN32
+	HANDLE th[MAX_JOBS];
+
+	InitializeCriticalSection(&q->lock);
+
+	if (jobs <= 1)
+		jobs = 0;
+
+	for (i = 0; i < jobs; ++i) {
+		th[i] = CreateThread(NULL, 0, worker, q, 0, NULL);
 	}
-	bytes += fprintf(fp, "%s\n", SPLITTOKEN);
-	return bytes;
-}
 
-int VPrintDirUNIX()
-{
-	int i, bytes;
-	char buf[BUFSIZ];
-	if (g_dircnt == 0)
-		return 0;
-	bytes = SPRINTF_S(buf, "%s\n", SPLITTOKEN);
-	bytes += SPRINTF_S(buf, "ҳ Ŀ¼\n");
-	for (i = 0; i < g_dircnt; ++i) {
-		bytes += SPRINTF_S(buf, "%-4d %s\n", g_dirs[i].page, g_dirs[i].name);
+	if (jobs == 0)
+		worker(q);
+
+	for (i = 0; i < jobs; ++i) {
+		if (th[i] != NULL) {
+			WaitForSingleObject(th[i], INFINITE);
+			CloseHandle(th[i]);
+		}
 	}
-	bytes += SPRINTF_S(buf, "%s\n", SPLITTOKEN);
-	return bytes;
-}
 
-int VPrintDir(void)
-{
-	if (g_file.newline_style == 0) {
-		return VPrintDirUNIX();
-	} else {
-		return VPrintDirDOS();
+	DeleteCriticalSection(&q->lock);
+#else
+	pthread_t th[MAX_JOBS];
+	int started = 0;
+
+	pthread_mutex_init(&q->lock, NULL);
+
+	for (i = 0; jobs > 1 && i < jobs; ++i) {
+		if (pthread_create(&th[started], NULL, worker, q) == 0)
+			started++;
 	}
+
+	// ̻߳޷߳ʱڵǰ߳д
+	if (started == 0)
+		worker(q);
+
+	for (i = 0; i < started; ++i) {
+		pthread_join(th[i], NULL);
+	}
+
+	pthread_mutex_destroy(&q->lock);
+#endif
 }
 
-int PrintDir(FILE * fp)
+static void usage(void)
 {
-	if (g_file.newline_style == 0) {
-		return PrintDirUNIX(fp);
-	} else {
-		return PrintDirDOS(fp);
-	}
+	err_msg("xReader Ŀ¼ɹ GenIndex (version 0.2)\n");
+	err_msg("÷: GenIndex.exe [-d] [-i] [-j ߳] ļ.txt ...\n");
+	err_msg("                               -d: ģʽ\n");
+	err_msg("                               -i: ͬʱļ.txt" INDEX_EXT
+			"½\n");
+	err_msg("                               -j: дļ, ĬΪCPU\n");
+	err_msg("ʹ÷\n");
+	err_msg("1. TXT<<<<űעÿ¿ʼ\n");
+	err_msg("\n");
+	err_msg("<<<<һ XXX\n");
+	err_msg("....\n");
+	err_msg("<<<<ڶ YYY\n");
+	err_msg
+		("2. 󣬽TXTϵGenIndexͼУGenIndexͻΪĵ\n");
+	err_msg("һĿ¼\n");
+	err_msg("===================\n");
+	err_msg("ҳ Ŀ¼\n");
+	err_msg("1    һ XXX\n");
+	err_msg("2    ڶ YYY\n");
+	err_msg("===================\n");
+	err_msg
+		("3. ҳ־GIֵʱϢʾҪƶĳ£ҳֱGIȼҵ¡GIǾҳ룬ΪСı䡣\n");
+	err_msg
+		("4. -iʱTABָ½, ÿΪ: ֽƫ GI ½\n");
+#ifdef WIN32
+	system("pause");
+#endif
 }
 
-DirEntry *AddDirEntry(const char *name, int page)
+int main(int argc, char *argv[])
 {
-	DirEntry *p;
-
-	dbg_printf(d, "g_dircnt %d g_dircap %d", g_dircnt, g_dircap);
-	if (g_dirs == NULL) {
-		g_dirs = (DirEntry *) malloc(sizeof(DirEntry));
-		g_dirs->name = strdup(name);
-		g_dirs->page = page;
-		g_dircap = 1;
-	} else {
-		if (g_dircnt >= g_dircap) {
-			g_dircap += 16;
-			p = (DirEntry *) realloc(g_dirs, sizeof(DirEntry) * g_dircap);
+	JobQueue q;
+	char **files;
+	int i, jobs = 0, debug = 0;
 
-			if (p != NULL) {
-				g_dirs = p;
-			} else {
-				return NULL;
-			}
+	d = dbg_init();
+	dbg_open_stream(d, stderr);
+	dbg_switch(d, 0);
+
+	if (getenv("LANG") != NULL) {
+		set_output_locale(getenv("LANG"));
+	}
+
+	memset(&q, 0, sizeof(q));
+	files = (char **) malloc(sizeof(char *) * argc);
+
+	if (files == NULL) {
+		return -1;
+	}
+
+	for (i = 1; i < argc; ++i) {
+		if (strcasecmp(argv[i], "-d") == 0) {
+			debug = 1;
+		} else if (strcmp(argv[i], "-i") == 0) {
+			q.write_index = 1;
+		} else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			jobs = atoi(argv[++i]);
+		} else {
+			files[q.count++] = argv[i];
 		}
-		g_dirs[g_dircnt].name = strdup(name);
-		g_dirs[g_dircnt].page = page;
 	}
-	g_dircnt++;
-	return g_dirs;
-}
 
-void FreeDirEntry(void)
-{
-	int i;
+	if (q.count == 0) {
+		usage();
+		free(files);
+		return -1;
+	}
 
-	if (g_dirs == NULL || g_dircnt == 0)
-		return;
-	for (i = 0; i < g_dircnt; ++i) {
-		free(g_dirs[i].name);
+	// ̰߳ȫ, ģʽ
+	if (debug) {
+		dbg_switch(d, 1);
+		jobs = 1;
+	} else if (jobs <= 0) {
+		jobs = cpu_count();
 	}
-	free(g_dirs);
-	g_dircnt = 0;
-	g_dirs = NULL;
+
+	if (jobs > MAX_JOBS)
+		jobs = MAX_JOBS;
+
+#ifndef WIN32
+	new_file_mode = umask(0);
+	umask(new_file_mode);
+	new_file_mode = 0666 & ~new_file_mode;
+#endif
+
+	q.files = files;
+	run_jobs(&q, jobs);
+
+	free(files);
+
+	if (q.failed > 0)
+		err_msg("%dļʧ\n", q.failed);
+
+	// stderr, رպ
+	dbg_close(d);
+
+	return q.failed > 0 ? -1 : 0;
 }